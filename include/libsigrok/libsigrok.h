@@ -133,6 +133,13 @@ enum sr_loglevel {
 /** Type definition for callback function for data reception. */
 typedef int (*sr_receive_data_callback)(int fd, int revents, void *cb_data);
 
+/**
+ * Type definition for callback functions which receive output, see
+ * sr_output_sink_new_callback().
+ */
+typedef int (*sr_output_sink_callback)(const uint8_t *data, size_t len,
+		void *cb_data);
+
 /** Data types used by sr_config_info(). */
 enum sr_datatype {
 	SR_T_UINT64 = 10000,
@@ -581,6 +588,8 @@ struct sr_input;
 struct sr_input_module;
 struct sr_output;
 struct sr_output_module;
+struct sr_output_sink;
+struct sr_output_fanout;
 struct sr_transform;
 struct sr_transform_module;
 
@@ -1031,6 +1040,9 @@ enum sr_configkey {
 	/** Number of powerline cycles for ADC integration time. */
 	SR_CONF_ADC_POWERLINE_CYCLES,
 
+	/** The device supports a reversible filter of the capturefile data. */
+	SR_CONF_CAPTURE_FILTER,
+
 	/* Update sr_key_info_config[] (hwdriver.c) upon changes! */
 
 	/*--- Acquisition modes, sample limiting ----------------------------*/
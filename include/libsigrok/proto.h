@@ -176,6 +176,7 @@ SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in);
 SR_API const struct sr_input_module *sr_input_module_get(const struct sr_input *in);
 SR_API struct sr_dev_inst *sr_input_dev_inst_get(const struct sr_input *in);
 SR_API int sr_input_send(const struct sr_input *in, GString *buf);
+SR_API int sr_input_send_file(const struct sr_input *in, const char *filename);
 SR_API int sr_input_end(const struct sr_input *in);
 SR_API int sr_input_reset(const struct sr_input *in);
 SR_API void sr_input_free(const struct sr_input *in);
@@ -198,8 +199,29 @@ SR_API gboolean sr_output_test_flag(const struct sr_output_module *omod,
 		uint64_t flag);
 SR_API int sr_output_send(const struct sr_output *o,
 		const struct sr_datafeed_packet *packet, GString **out);
+SR_API int sr_output_send_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet,
+		struct sr_output_sink *sink);
 SR_API int sr_output_free(const struct sr_output *o);
 
+/*--- output/sink.c ---------------------------------------------------------*/
+
+SR_API struct sr_output_sink *sr_output_sink_new_fd(int fd);
+SR_API struct sr_output_sink *sr_output_sink_new_file(FILE *file);
+SR_API struct sr_output_sink *sr_output_sink_new_callback(
+		sr_output_sink_callback cb, void *cb_data);
+SR_API int sr_output_sink_flush(struct sr_output_sink *sink);
+SR_API int sr_output_sink_free(struct sr_output_sink *sink);
+
+/*--- output/fanout.c -------------------------------------------------------*/
+
+SR_API struct sr_output_fanout *sr_output_fanout_new(unsigned int num_threads);
+SR_API int sr_output_fanout_add(struct sr_output_fanout *fo,
+		const struct sr_output *o, struct sr_output_sink *sink);
+SR_API int sr_output_fanout_send(struct sr_output_fanout *fo,
+		const struct sr_datafeed_packet *packet);
+SR_API int sr_output_fanout_free(struct sr_output_fanout *fo);
+
 /*--- transform/transform.c -------------------------------------------------*/
 
 SR_API const struct sr_transform_module **sr_transform_list(void);
@@ -186,8 +186,8 @@ static int dev_open(struct sr_dev_inst *sdi)
 			devc->beaglelogic->close(devc);
 			return SR_ERR;
 		}
-	} else {
-		devc->tcp_buffer = g_malloc(TCP_BUFFER_SIZE);
+	} else if (!devc->tcp_buffer) {
+		devc->tcp_buffer = g_malloc(TCP_STREAM_BUFFER_SIZE);
 	}
 
 	return SR_OK;
@@ -317,6 +317,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	/* Clear capture state */
 	devc->bytes_read = 0;
 	devc->offset = 0;
+	devc->tcp_pending = 0;
 
 	/* Configure channels */
 	devc->sampleunit = BL_SAMPLEUNIT_8_BITS;
@@ -128,5 +128,7 @@ SR_PRIV extern const struct beaglelogic_ops beaglelogic_tcp_ops;
 
 SR_PRIV int beaglelogic_tcp_detect(struct dev_context *devc);
 SR_PRIV int beaglelogic_tcp_drain(struct dev_context *devc);
+SR_PRIV int beaglelogic_tcp_stream_read(struct dev_context *devc,
+	uint8_t *buf, int maxlen);
 
 #endif
@@ -138,6 +138,85 @@ static int beaglelogic_tcp_read_data(struct dev_context *devc, char *buf,
 	return len;
 }
 
+static int beaglelogic_tcp_set_nonblocking(struct dev_context *devc,
+					   gboolean nonblocking)
+{
+#ifdef _WIN32
+	u_long mode = nonblocking;
+
+	if (ioctlsocket(devc->socket, FIONBIO, &mode) != 0)
+		return SR_ERR;
+#else
+	int flags;
+
+	if ((flags = fcntl(devc->socket, F_GETFL, 0)) < 0)
+		return SR_ERR;
+	flags = nonblocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+	if (fcntl(devc->socket, F_SETFL, flags) < 0)
+		return SR_ERR;
+#endif
+
+	return SR_OK;
+}
+
+/*
+ * Switch the socket into streaming mode: a large kernel receive buffer
+ * keeps the link busy while a packet is being processed, and non-blocking
+ * reads let beaglelogic_tcp_stream_read() drain everything that arrived.
+ */
+static int beaglelogic_tcp_stream_start(struct dev_context *devc)
+{
+	int size = TCP_STREAM_RCVBUF_SIZE;
+
+	if (setsockopt(devc->socket, SOL_SOCKET, SO_RCVBUF,
+			(const char *)&size, sizeof(size)) < 0)
+		sr_dbg("Failed to set receive buffer size: %s",
+			g_strerror(errno));
+
+	return beaglelogic_tcp_set_nonblocking(devc, TRUE);
+}
+
+static int beaglelogic_tcp_stream_stop(struct dev_context *devc)
+{
+	return beaglelogic_tcp_set_nonblocking(devc, FALSE);
+}
+
+/*
+ * Read as much sample data as is available without blocking, up to
+ * maxlen bytes. Returns the number of bytes read, 0 if the connection
+ * was closed by the peer, SR_ERR_NA if no data is available yet, or
+ * SR_ERR.
+ */
+SR_PRIV int beaglelogic_tcp_stream_read(struct dev_context *devc,
+					uint8_t *buf, int maxlen)
+{
+	int len, total;
+
+	total = 0;
+	while (total < maxlen) {
+		len = recv(devc->socket, (char *)buf + total, maxlen - total, 0);
+		if (len > 0) {
+			total += len;
+			continue;
+		}
+		if (len == 0)
+			break;
+#ifdef _WIN32
+		if (WSAGetLastError() == WSAEWOULDBLOCK)
+			return total ? total : SR_ERR_NA;
+#else
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return total ? total : SR_ERR_NA;
+		if (errno == EINTR)
+			continue;
+#endif
+		sr_err("Receive error: %s", g_strerror(errno));
+		return SR_ERR;
+	}
+
+	return total;
+}
+
 SR_PRIV int beaglelogic_tcp_drain(struct dev_context *devc)
 {
 	char *buf = g_malloc(1024);
@@ -371,11 +450,17 @@ static int beaglelogic_start(struct dev_context *devc)
 {
 	beaglelogic_tcp_drain(devc);
 
+	if (beaglelogic_tcp_stream_start(devc) != SR_OK)
+		sr_warn("Failed to switch socket to non-blocking mode.");
+
 	return beaglelogic_tcp_send_cmd(devc, "get");
 }
 
 static int beaglelogic_stop(struct dev_context *devc)
 {
+	/* Commands need a blocking socket, or they may get cut short. */
+	beaglelogic_tcp_stream_stop(devc);
+
 	return beaglelogic_tcp_send_cmd(devc, "close");
 }
 
@@ -32,14 +32,19 @@
 #include "protocol.h"
 #include "beaglelogic.h"
 
-/* Define data packet size independent of packet (bufunitsize bytes) size
- * from the BeagleLogic kernel module */
+/* Define data packet size independent of buffer unit (bufunitsize bytes)
+ * size from the BeagleLogic kernel module */
 #define PACKET_SIZE	(512 * 1024)
 
-/* This implementation is zero copy from the libsigrok side.
- * It does not copy any data, just passes a pointer from the mmap'ed
- * kernel buffers appropriately. It is up to the application which is
- * using libsigrok to decide how to deal with the data.
+/*
+ * Zero copy streaming from the mmap'ed kernel ring buffer.
+ *
+ * Each poll() wakeup signals that the buffer unit (bufunitsize bytes) at
+ * the current read position has been filled. The unit is handed to the
+ * session as logic packets pointing directly into the mapping, and then
+ * released back to the kernel by moving the file position past it. The
+ * packet data is only valid until sr_session_send() returns, as the kernel
+ * may refill the unit once it has been released.
  */
 SR_PRIV int beaglelogic_native_receive_data(int fd, int revents, void *cb_data)
 {
@@ -50,65 +55,71 @@ SR_PRIV int beaglelogic_native_receive_data(int fd, int revents, void *cb_data)
 
 	int trigger_offset;
 	int pre_trigger_samples;
-	uint32_t packetsize;
-	uint64_t bytes_remaining;
+	uint32_t unit_len;
+	uint8_t *data;
+	uint64_t bytes_remaining, length, limit;
 
 	if (!(sdi = cb_data) || !(devc = sdi->priv))
 		return TRUE;
 
-	packetsize = PACKET_SIZE;
+	unit_len = devc->bufunitsize ? devc->bufunitsize : PACKET_SIZE;
 	logic.unitsize = SAMPLEUNIT_TO_BYTES(devc->sampleunit);
+	limit = devc->limit_samples * logic.unitsize;
 
 	if (revents == G_IO_IN) {
 		sr_info("In callback G_IO_IN, offset=%d", devc->offset);
 
-		bytes_remaining = (devc->limit_samples * logic.unitsize) -
-				devc->bytes_read;
-
-		/* Configure data packet */
-		packet.type = SR_DF_LOGIC;
-		packet.payload = &logic;
-		logic.data = devc->sample_buf + devc->offset;
-		logic.length = MIN(packetsize, bytes_remaining);
+		unit_len = MIN(unit_len, devc->buffersize - devc->offset);
+		data = devc->sample_buf + devc->offset;
+		length = 0;
 
 		if (devc->trigger_fired) {
-			/* Send the incoming transfer to the session bus. */
-			sr_session_send(sdi, &packet);
+			length = unit_len;
 		} else {
-			/* Check for trigger */
+			/* Scan the whole unit for the trigger in one go. */
 			trigger_offset = soft_trigger_logic_check(devc->stl,
-					logic.data, packetsize, &pre_trigger_samples);
+					data, unit_len, &pre_trigger_samples);
 			if (trigger_offset > -1) {
 				devc->bytes_read += pre_trigger_samples * logic.unitsize;
 				trigger_offset *= logic.unitsize;
-				logic.length = MIN(packetsize - trigger_offset,
-						bytes_remaining);
-				logic.data += trigger_offset;
-
-				sr_session_send(sdi, &packet);
-
+				data += trigger_offset;
+				length = unit_len - trigger_offset;
 				devc->trigger_fired = TRUE;
 			}
 		}
 
-		/* Move the read pointer forward */
-		lseek(fd, packetsize, SEEK_CUR);
+		bytes_remaining = (limit > devc->bytes_read) ?
+				limit - devc->bytes_read : 0;
+		length = MIN(length, bytes_remaining);
+		devc->bytes_read += length;
 
-		/* Update byte count and offset (roll over if needed) */
-		devc->bytes_read += logic.length;
-		if ((devc->offset += packetsize) >= devc->buffersize) {
+		/* Hand out the unit in packets that point into the mapping. */
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		while (length > 0) {
+			logic.data = data;
+			logic.length = MIN(length, PACKET_SIZE);
+			sr_session_send(sdi, &packet);
+			data += logic.length;
+			length -= logic.length;
+		}
+
+		/* Release the unit back to the kernel. */
+		lseek(fd, unit_len, SEEK_CUR);
+
+		/* Update the offset (roll over if needed) */
+		if ((devc->offset += unit_len) >= devc->buffersize) {
 			/* One shot capture, we abort and settle with less than
 			 * the required number of samples */
 			if (devc->triggerflags == BL_TRIGGERFLAGS_CONTINUOUS)
 				devc->offset = 0;
 			else
-				packetsize = 0;
+				unit_len = 0;
 		}
 	}
 
 	/* EOF Received or we have reached the limit */
-	if (devc->bytes_read >= devc->limit_samples * logic.unitsize ||
-			packetsize == 0) {
+	if (devc->bytes_read >= limit || unit_len == 0) {
 		/* Send EOA Packet, stop polling */
 		std_session_send_df_end(sdi);
 		sr_session_source_remove_pollfd(sdi->session, &devc->pollfd);
@@ -128,37 +139,51 @@ SR_PRIV int beaglelogic_tcp_receive_data(int fd, int revents, void *cb_data)
 	int pre_trigger_samples;
 	int trigger_offset;
 	uint32_t packetsize;
-	uint64_t bytes_remaining;
+	uint64_t bytes_remaining, limit;
+
+	(void)fd;
 
 	if (!(sdi = cb_data) || !(devc = sdi->priv))
 		return TRUE;
 
-	packetsize = TCP_BUFFER_SIZE;
+	packetsize = TCP_STREAM_BUFFER_SIZE;
 	logic.unitsize = SAMPLEUNIT_TO_BYTES(devc->sampleunit);
+	limit = devc->limit_samples * logic.unitsize;
 
 	if (revents == G_IO_IN) {
 		sr_info("In callback G_IO_IN");
 
-		len = recv(fd, devc->tcp_buffer, TCP_BUFFER_SIZE, 0);
-		if (len < 0) {
-			sr_err("Receive error: %s", g_strerror(errno));
+		/* Drain everything that arrived since the last wakeup. */
+		len = beaglelogic_tcp_stream_read(devc,
+				devc->tcp_buffer + devc->tcp_pending,
+				TCP_STREAM_BUFFER_SIZE - devc->tcp_pending);
+		if (len == SR_ERR_NA)
+			/* Spurious wakeup, no data yet. */
+			return TRUE;
+		if (len < 0)
 			return SR_ERR;
-		}
-
-		packetsize = len;
 
-		bytes_remaining = (devc->limit_samples * logic.unitsize) -
-				devc->bytes_read;
+		if (len == 0) {
+			/* Connection closed by the peer. */
+			packetsize = 0;
+			devc->tcp_pending = 0;
+		} else {
+			/* Only whole samples are processed, keep the rest. */
+			len += devc->tcp_pending;
+			devc->tcp_pending = len % logic.unitsize;
+			packetsize = len - devc->tcp_pending;
+			if (packetsize == 0)
+				return TRUE;
+		}
 
 		/* Configure data packet */
 		packet.type = SR_DF_LOGIC;
 		packet.payload = &logic;
 		logic.data = devc->tcp_buffer;
-		logic.length = MIN(packetsize, bytes_remaining);
+		logic.length = 0;
 
 		if (devc->trigger_fired) {
-			/* Send the incoming transfer to the session bus. */
-			sr_session_send(sdi, &packet);
+			logic.length = packetsize;
 		} else {
 			/* Check for trigger */
 			trigger_offset = soft_trigger_logic_check(devc->stl,
@@ -166,16 +191,25 @@ SR_PRIV int beaglelogic_tcp_receive_data(int fd, int revents, void *cb_data)
 			if (trigger_offset > -1) {
 				devc->bytes_read += pre_trigger_samples * logic.unitsize;
 				trigger_offset *= logic.unitsize;
-				logic.length = MIN(packetsize - trigger_offset,
-						bytes_remaining);
+				logic.length = packetsize - trigger_offset;
 				logic.data += trigger_offset;
 
-				sr_session_send(sdi, &packet);
-
 				devc->trigger_fired = TRUE;
 			}
 		}
 
+		bytes_remaining = (limit > devc->bytes_read) ?
+				limit - devc->bytes_read : 0;
+		logic.length = MIN(logic.length, bytes_remaining);
+
+		/* Send the incoming data to the session bus. */
+		if (logic.length > 0)
+			sr_session_send(sdi, &packet);
+
+		if (devc->tcp_pending)
+			memmove(devc->tcp_buffer, devc->tcp_buffer + packetsize,
+				devc->tcp_pending);
+
 		/* Update byte count and offset (roll over if needed) */
 		devc->bytes_read += logic.length;
 		if ((devc->offset += packetsize) >= devc->buffersize) {
@@ -189,8 +223,7 @@ SR_PRIV int beaglelogic_tcp_receive_data(int fd, int revents, void *cb_data)
 	}
 
 	/* EOF Received or we have reached the limit */
-	if (devc->bytes_read >= devc->limit_samples * logic.unitsize ||
-			packetsize == 0) {
+	if (devc->bytes_read >= limit || packetsize == 0) {
 		/* Send EOA Packet, stop polling */
 		std_session_send_df_end(sdi);
 		devc->beaglelogic->stop(devc);
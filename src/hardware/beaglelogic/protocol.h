@@ -34,6 +34,14 @@
 
 #define TCP_BUFFER_SIZE         (128 * 1024)
 
+/*
+ * While streaming, each poll wakeup drains the socket into a buffer of
+ * this size (one logic packet), and the kernel receive buffer is enlarged
+ * so gigabit links don't stall while the session processes a packet.
+ */
+#define TCP_STREAM_BUFFER_SIZE  (4 * 1024 * 1024)
+#define TCP_STREAM_RCVBUF_SIZE  (8 * 1024 * 1024)
+
 /** Private, per-device-instance driver context. */
 struct dev_context {
 	int max_channels;
@@ -48,6 +56,8 @@ struct dev_context {
 	int socket;
 	unsigned int read_timeout;
 	unsigned char *tcp_buffer;
+	/* Partial sample left over at the start of tcp_buffer. */
+	uint32_t tcp_pending;
 
 	/* Acquisition settings: see beaglelogic.h */
 	uint64_t cur_samplerate;
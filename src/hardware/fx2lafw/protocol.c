@@ -277,9 +277,68 @@ SR_PRIV void fx2lafw_abort_acquisition(struct dev_context *devc)
 	}
 }
 
+static unsigned int to_bytes_per_ms(struct dev_context *devc)
+{
+	unsigned int bytes_per_ms;
+
+	bytes_per_ms = devc->cur_samplerate / 1000;
+	if (devc->sample_wide)
+		bytes_per_ms *= 2;
+
+	return bytes_per_ms ? bytes_per_ms : 1;
+}
+
+static size_t get_buffer_size(struct dev_context *devc)
+{
+	size_t s;
+
+	/*
+	 * The buffer should be large enough to hold 10ms of data and
+	 * a multiple of 512.
+	 */
+	s = 10 * to_bytes_per_ms(devc);
+	return (s + 511) & ~511;
+}
+
+static unsigned int get_buffer_budget_ms(struct dev_context *devc)
+{
+	/*
+	 * Low data rates don't need deep buffering, and a shallow queue
+	 * keeps the latency towards a live display low.
+	 */
+	if (to_bytes_per_ms(devc) < LOW_RATE_BYTES_PER_MS)
+		return BUFFER_BUDGET_LOW_MS;
+
+	return BUFFER_BUDGET_HIGH_MS;
+}
+
+static unsigned int get_number_of_transfers(struct dev_context *devc)
+{
+	unsigned int n;
+
+	/* Total buffer size should be able to hold the buffering budget. */
+	n = (get_buffer_budget_ms(devc) * to_bytes_per_ms(devc) /
+		get_buffer_size(devc));
+
+	return CLAMP(n, MIN_SIMUL_TRANSFERS, NUM_SIMUL_TRANSFERS);
+}
+
+static unsigned int get_timeout(struct dev_context *devc,
+	unsigned int num_transfers)
+{
+	size_t total_size;
+	unsigned int timeout;
+
+	total_size = get_buffer_size(devc) * num_transfers;
+	timeout = total_size / to_bytes_per_ms(devc);
+	return timeout + timeout / 4; /* Leave a headroom of 25% percent. */
+}
+
 static void finish_acquisition(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
+	const struct fx2lafw_transfer_history *h;
+	unsigned int i;
 
 	devc = sdi->priv;
 
@@ -287,6 +346,17 @@ static void finish_acquisition(struct sr_dev_inst *sdi)
 
 	usb_source_remove(sdi->session, devc->ctx);
 
+	sr_info("Transfer queue ended at %u x %zu bytes after %u changes.",
+		devc->target_transfers, devc->transfer_size,
+		devc->history_count ? devc->history_count - 1 : 0);
+	i = devc->history_count > TRANSFER_HISTORY_LEN ?
+		devc->history_count - TRANSFER_HISTORY_LEN : 0;
+	for (; i < devc->history_count; i++) {
+		h = &devc->history[i % TRANSFER_HISTORY_LEN];
+		sr_dbg("Transfer queue at %" PRId64 "us: %u x %zu bytes (%s).",
+			h->time, h->num_transfers, h->transfer_size, h->reason);
+	}
+
 	devc->num_transfers = 0;
 	g_free(devc->transfers);
 
@@ -329,8 +399,22 @@ static void free_transfer(struct libusb_transfer *transfer)
 
 static void resubmit_transfer(struct libusb_transfer *transfer)
 {
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
 	int ret;
 
+	sdi = transfer->user_data;
+	devc = sdi->priv;
+
+	/* The queue has been shrunk, retire this transfer. */
+	if ((unsigned int)devc->submitted_transfers > devc->target_transfers) {
+		free_transfer(transfer);
+		return;
+	}
+
+	/* The queue depth may have changed since the last submission. */
+	transfer->timeout = get_timeout(devc, devc->target_transfers);
+
 	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS)
 		return;
 
@@ -408,6 +492,133 @@ static void la_send_data_proc(struct sr_dev_inst *sdi,
 	sr_session_send(sdi, &packet);
 }
 
+static void record_transfer_change(struct dev_context *devc,
+	const char *reason)
+{
+	struct fx2lafw_transfer_history *h;
+
+	h = &devc->history[devc->history_count % TRANSFER_HISTORY_LEN];
+	h->time = g_get_monotonic_time() - devc->acq_start_time;
+	h->num_transfers = devc->target_transfers;
+	h->transfer_size = devc->transfer_size;
+	h->reason = reason;
+	devc->history_count++;
+
+	sr_dbg("Transfer queue: %u x %zu bytes (%s).",
+		h->num_transfers, h->transfer_size, reason);
+}
+
+static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer);
+
+static int submit_new_transfer(const struct sr_dev_inst *sdi,
+	unsigned int slot)
+{
+	struct dev_context *devc;
+	struct sr_usb_dev_inst *usb;
+	struct libusb_transfer *transfer;
+	unsigned char *buf;
+	int ret;
+
+	devc = sdi->priv;
+	usb = sdi->conn;
+
+	if (!(buf = g_try_malloc(devc->transfer_size))) {
+		sr_err("USB transfer buffer malloc failed.");
+		return SR_ERR_MALLOC;
+	}
+	transfer = libusb_alloc_transfer(0);
+	libusb_fill_bulk_transfer(transfer, usb->devhdl,
+			2 | LIBUSB_ENDPOINT_IN, buf, devc->transfer_size,
+			receive_transfer, (void *)sdi,
+			get_timeout(devc, devc->target_transfers));
+	sr_info("submitting transfer: %u", slot);
+	if ((ret = libusb_submit_transfer(transfer)) != 0) {
+		sr_err("Failed to submit transfer: %s.",
+		       libusb_error_name(ret));
+		libusb_free_transfer(transfer);
+		g_free(buf);
+		return SR_ERR;
+	}
+	devc->transfers[slot] = transfer;
+	devc->submitted_transfers++;
+
+	return SR_OK;
+}
+
+static void grow_transfers(const struct sr_dev_inst *sdi, const char *reason)
+{
+	struct dev_context *devc;
+	unsigned int i, n;
+
+	devc = sdi->priv;
+
+	if (devc->target_transfers >= MAX_SIMUL_TRANSFERS)
+		return;
+
+	n = devc->target_transfers + MAX(devc->target_transfers / 2, 1);
+	devc->target_transfers = MIN(n, MAX_SIMUL_TRANSFERS);
+	devc->last_adjust_time = g_get_monotonic_time();
+	devc->max_callback_gap = 0;
+
+	for (i = 0; i < devc->num_transfers; i++) {
+		if ((unsigned int)devc->submitted_transfers >= devc->target_transfers)
+			break;
+		if (devc->transfers[i])
+			continue;
+		if (submit_new_transfer(sdi, i) != SR_OK)
+			break;
+	}
+	/* Don't aim for more than we could actually submit. */
+	devc->target_transfers = devc->submitted_transfers;
+
+	record_transfer_change(devc, reason);
+}
+
+/*
+ * Called on every transfer callback. Grows the queue when the FX2 starts
+ * to return empty transfers or when the time between two callbacks eats
+ * into more than half of the buffering the queue provides. Once the
+ * host keeps up comfortably again, the queue slowly shrinks back to the
+ * depth it started out with.
+ */
+static void update_transfer_queue(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	int64_t now, gap, budget;
+
+	devc = sdi->priv;
+
+	now = g_get_monotonic_time();
+	gap = devc->last_callback_time ? now - devc->last_callback_time : 0;
+	devc->last_callback_time = now;
+	devc->max_callback_gap = MAX(devc->max_callback_gap, gap);
+
+	/* Let the previous change settle before judging it. */
+	budget = devc->submitted_transfers * devc->transfer_duration_us;
+	if (now - devc->last_adjust_time < budget)
+		return;
+
+	if (gap > budget / 2) {
+		grow_transfers(sdi, "callback latency");
+		return;
+	}
+
+	if (devc->empty_transfer_count >= EMPTY_TRANSFERS_GROW) {
+		grow_transfers(sdi, "empty transfers");
+		return;
+	}
+
+	if (devc->target_transfers > devc->initial_transfers &&
+			now - devc->last_adjust_time > SHRINK_HOLDOFF_US &&
+			devc->max_callback_gap < budget / 4) {
+		/* resubmit_transfer() retires the surplus transfer. */
+		devc->target_transfers--;
+		devc->last_adjust_time = now;
+		devc->max_callback_gap = 0;
+		record_transfer_change(devc, "idle");
+	}
+}
+
 static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 {
 	struct sr_dev_inst *sdi;
@@ -459,6 +670,7 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 			fx2lafw_abort_acquisition(devc);
 			free_transfer(transfer);
 		} else {
+			update_transfer_queue(sdi);
 			resubmit_transfer(transfer);
 		}
 		return;
@@ -499,8 +711,10 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 	if (devc->limit_samples && devc->sent_samples >= devc->limit_samples) {
 		fx2lafw_abort_acquisition(devc);
 		free_transfer(transfer);
-	} else
+	} else {
+		update_transfer_queue(sdi);
 		resubmit_transfer(transfer);
+	}
 }
 
 static int configure_channels(const struct sr_dev_inst *sdi)
@@ -537,48 +751,6 @@ static int configure_channels(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
-static unsigned int to_bytes_per_ms(unsigned int samplerate)
-{
-	return samplerate / 1000;
-}
-
-static size_t get_buffer_size(struct dev_context *devc)
-{
-	size_t s;
-
-	/*
-	 * The buffer should be large enough to hold 10ms of data and
-	 * a multiple of 512.
-	 */
-	s = 10 * to_bytes_per_ms(devc->cur_samplerate);
-	return (s + 511) & ~511;
-}
-
-static unsigned int get_number_of_transfers(struct dev_context *devc)
-{
-	unsigned int n;
-
-	/* Total buffer size should be able to hold about 500ms of data. */
-	n = (500 * to_bytes_per_ms(devc->cur_samplerate) /
-		get_buffer_size(devc));
-
-	if (n > NUM_SIMUL_TRANSFERS)
-		return NUM_SIMUL_TRANSFERS;
-
-	return n;
-}
-
-static unsigned int get_timeout(struct dev_context *devc)
-{
-	size_t total_size;
-	unsigned int timeout;
-
-	total_size = get_buffer_size(devc) *
-			get_number_of_transfers(devc);
-	timeout = total_size / to_bytes_per_ms(devc->cur_samplerate);
-	return timeout + timeout / 4; /* Leave a headroom of 25% percent. */
-}
-
 static int receive_data(int fd, int revents, void *cb_data)
 {
 	struct timeval tv;
@@ -598,16 +770,11 @@ static int receive_data(int fd, int revents, void *cb_data)
 static int start_transfers(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
-	struct sr_usb_dev_inst *usb;
 	struct sr_trigger *trigger;
-	struct libusb_transfer *transfer;
-	unsigned int i, num_transfers;
-	int timeout, ret;
-	unsigned char *buf;
-	size_t size;
+	unsigned int i;
+	int ret;
 
 	devc = sdi->priv;
-	usb = sdi->conn;
 
 	devc->sent_samples = 0;
 	devc->acq_aborted = FALSE;
@@ -624,40 +791,33 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 	} else
 		devc->trigger_fired = TRUE;
 
-	num_transfers = get_number_of_transfers(devc);
-
-	size = get_buffer_size(devc);
+	devc->transfer_size = get_buffer_size(devc);
+	devc->transfer_duration_us = (int64_t)devc->transfer_size * 1000 /
+		to_bytes_per_ms(devc);
+	devc->initial_transfers = get_number_of_transfers(devc);
+	devc->target_transfers = devc->initial_transfers;
 	devc->submitted_transfers = 0;
-
-	devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * num_transfers);
+	devc->acq_start_time = g_get_monotonic_time();
+	devc->last_adjust_time = devc->acq_start_time;
+	devc->last_callback_time = 0;
+	devc->max_callback_gap = 0;
+	devc->history_count = 0;
+
+	/* Leave room for the queue to grow during the acquisition. */
+	devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * MAX_SIMUL_TRANSFERS);
 	if (!devc->transfers) {
 		sr_err("USB transfers malloc failed.");
 		return SR_ERR_MALLOC;
 	}
 
-	timeout = get_timeout(devc);
-	devc->num_transfers = num_transfers;
-	for (i = 0; i < num_transfers; i++) {
-		if (!(buf = g_try_malloc(size))) {
-			sr_err("USB transfer buffer malloc failed.");
-			return SR_ERR_MALLOC;
-		}
-		transfer = libusb_alloc_transfer(0);
-		libusb_fill_bulk_transfer(transfer, usb->devhdl,
-				2 | LIBUSB_ENDPOINT_IN, buf, size,
-				receive_transfer, (void *)sdi, timeout);
-		sr_info("submitting transfer: %d", i);
-		if ((ret = libusb_submit_transfer(transfer)) != 0) {
-			sr_err("Failed to submit transfer: %s.",
-			       libusb_error_name(ret));
-			libusb_free_transfer(transfer);
-			g_free(buf);
+	devc->num_transfers = MAX_SIMUL_TRANSFERS;
+	for (i = 0; i < devc->initial_transfers; i++) {
+		if ((ret = submit_new_transfer(sdi, i)) != SR_OK) {
 			fx2lafw_abort_acquisition(devc);
-			return SR_ERR;
+			return ret;
 		}
-		devc->transfers[i] = transfer;
-		devc->submitted_transfers++;
 	}
+	record_transfer_change(devc, "initial");
 
 	/*
 	 * If this device has analog channels and at least one of them is
@@ -696,7 +856,7 @@ SR_PRIV int fx2lafw_start_acquisition(const struct sr_dev_inst *sdi)
 		return SR_ERR;
 	}
 
-	timeout = get_timeout(devc);
+	timeout = get_timeout(devc, get_number_of_transfers(devc));
 	usb_source_add(sdi->session, devc->ctx, timeout, receive_data, drvc);
 
 	size = get_buffer_size(devc);
@@ -39,6 +39,22 @@
 #define NUM_SIMUL_TRANSFERS	32
 #define MAX_EMPTY_TRANSFERS	(NUM_SIMUL_TRANSFERS * 2)
 
+/*
+ * Adaptive transfer queue. The initial depth is derived from a buffering
+ * budget which is short at low data rates (snappy live display) and long
+ * at high rates. At runtime the queue grows up to MAX_SIMUL_TRANSFERS when
+ * empty transfers show up or the time between callbacks approaches the
+ * budget, and shrinks back after a quiet period.
+ */
+#define MIN_SIMUL_TRANSFERS	4
+#define MAX_SIMUL_TRANSFERS	64
+#define BUFFER_BUDGET_LOW_MS	100
+#define BUFFER_BUDGET_HIGH_MS	500
+#define LOW_RATE_BYTES_PER_MS	1000
+#define EMPTY_TRANSFERS_GROW	2
+#define SHRINK_HOLDOFF_US	(2 * 1000 * 1000)
+#define TRANSFER_HISTORY_LEN	16
+
 #define NUM_CHANNELS		16
 
 #define FX2LAFW_REQUIRED_VERSION_MAJOR	1
@@ -87,6 +103,15 @@ struct fx2lafw_profile {
 	const char *usb_product;
 };
 
+/* One entry per change of the transfer queue geometry. */
+struct fx2lafw_transfer_history {
+	/* Time since acquisition start, in microseconds. */
+	int64_t time;
+	unsigned int num_transfers;
+	size_t transfer_size;
+	const char *reason;
+};
+
 struct dev_context {
 	const struct fx2lafw_profile *profile;
 	GSList *enabled_analog_channels;
@@ -116,6 +141,19 @@ struct dev_context {
 
 	unsigned int num_transfers;
 	struct libusb_transfer **transfers;
+
+	/* Adaptive transfer queue state. */
+	size_t transfer_size;
+	unsigned int initial_transfers;
+	unsigned int target_transfers;
+	int64_t transfer_duration_us;
+	int64_t acq_start_time;
+	int64_t last_callback_time;
+	int64_t last_adjust_time;
+	int64_t max_callback_gap;
+	struct fx2lafw_transfer_history history[TRANSFER_HISTORY_LEN];
+	unsigned int history_count;
+
 	struct sr_context *ctx;
 	void (*send_data_proc)(struct sr_dev_inst *sdi,
 		uint8_t *data, size_t length, size_t sample_width);
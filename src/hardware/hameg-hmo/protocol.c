@@ -798,20 +798,19 @@ SR_PRIV void hmo_queue_logic_data(struct dev_context *devc,
 SR_PRIV void hmo_send_logic_packet(struct sr_dev_inst *sdi,
 				   struct dev_context *devc)
 {
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_logic logic;
+	struct std_logic_feed feed;
 
 	if (!devc->logic_data)
 		return;
 
-	logic.data = devc->logic_data->data;
-	logic.length = devc->logic_data->len;
-	logic.unitsize = devc->pod_count;
-
-	packet.type = SR_DF_LOGIC;
-	packet.payload = &logic;
+	/* Split deep memory captures into packets of bounded size. */
+	if (std_logic_feed_init(&feed, sdi, devc->pod_count,
+			LOGIC_CHUNK_SIZE, -1) != SR_OK)
+		return;
 
-	sr_session_send(sdi, &packet);
+	std_logic_feed_send(&feed, devc->logic_data->data,
+		devc->logic_data->len);
+	std_logic_feed_free(&feed);
 }
 
 /* Undo previous resource allocation. */
@@ -840,7 +839,7 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
-	struct sr_datafeed_logic logic;
+	struct std_logic_feed feed;
 	size_t group;
 
 	(void)fd;
@@ -945,12 +944,11 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 		 * above for analog data.
 		 */
 		if (devc->pod_count == 1) {
-			packet.type = SR_DF_LOGIC;
-			logic.data = data->data;
-			logic.length = data->len;
-			logic.unitsize = 1;
-			packet.payload = &logic;
-			sr_session_send(sdi, &packet);
+			if (std_logic_feed_init(&feed, sdi, 1,
+					LOGIC_CHUNK_SIZE, -1) == SR_OK) {
+				std_logic_feed_send(&feed, data->data, data->len);
+				std_logic_feed_free(&feed);
+			}
 		} else {
 			group = ch->index / 8;
 			hmo_queue_logic_data(devc, group, data);
@@ -34,6 +34,9 @@
 #define MAX_DIGITAL_CHANNEL_COUNT 16
 #define MAX_DIGITAL_GROUP_COUNT	2
 
+/* Size of the logic packets sent to the session. */
+#define LOGIC_CHUNK_SIZE (64 * 1024)
+
 struct scope_config {
 	const char *name[MAX_INSTRUMENT_VERSIONS];
 	const uint8_t analog_channels;
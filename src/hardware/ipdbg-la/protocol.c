@@ -222,7 +222,7 @@ SR_PRIV int ipdbg_la_convert_trigger(const struct sr_dev_inst *sdi)
 
 	devc->num_stages = 0;
 	devc->num_transfers = 0;
-	devc->raw_sample_buf = NULL;
+	std_logic_feed_free(&devc->logic_feed);
 
 	for (uint64_t i = 0; i < devc->data_width_bytes; i++) {
 		devc->trigger_mask[i] = 0;
@@ -296,16 +296,16 @@ SR_PRIV int ipdbg_la_receive_data(int fd, int revents, void *cb_data)
 		return FALSE;
 
 	struct ipdbg_la_tcp *tcp = sdi->conn;
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_logic logic;
-
-	if (!devc->raw_sample_buf) {
-		devc->raw_sample_buf =
-			g_try_malloc(devc->limit_samples * devc->data_width_bytes);
-		if (!devc->raw_sample_buf) {
-			sr_err("Sample buffer malloc failed.");
+
+	/*
+	 * Samples are forwarded in chunks as they arrive, the trigger
+	 * position is known up front from the configured delay.
+	 */
+	if (!devc->logic_feed.buffer) {
+		if (std_logic_feed_init(&devc->logic_feed, sdi,
+				devc->data_width_bytes, LOGIC_CHUNK_SIZE,
+				devc->delay_value) != SR_OK)
 			return FALSE;
-		}
 	}
 
 	if (devc->num_transfers <
@@ -315,37 +315,14 @@ SR_PRIV int ipdbg_la_receive_data(int fd, int revents, void *cb_data)
 		if (ipdbg_la_tcp_receive(tcp, &byte) == 1) {
 			if (devc->num_transfers <
 				(devc->limit_samples * devc->data_width_bytes))
-				devc->raw_sample_buf[devc->num_transfers] = byte;
+				std_logic_feed_append(&devc->logic_feed, &byte, 1);
 
 			devc->num_transfers++;
 		}
 	} else {
-		if (devc->delay_value > 0) {
-			/* There are pre-trigger samples, send those first. */
-			packet.type = SR_DF_LOGIC;
-			packet.payload = &logic;
-			logic.length = devc->delay_value * devc->data_width_bytes;
-			logic.unitsize = devc->data_width_bytes;
-			logic.data = devc->raw_sample_buf;
-			sr_session_send(cb_data, &packet);
-		}
-
-		/* Send the trigger. */
-		packet.type = SR_DF_TRIGGER;
-		sr_session_send(cb_data, &packet);
-
-		/* Send post-trigger samples. */
-		packet.type = SR_DF_LOGIC;
-		packet.payload = &logic;
-		logic.length = (devc->limit_samples - devc->delay_value) *
-			devc->data_width_bytes;
-		logic.unitsize = devc->data_width_bytes;
-		logic.data = devc->raw_sample_buf +
-			(devc->delay_value * devc->data_width_bytes);
-		sr_session_send(cb_data, &packet);
-
-		g_free(devc->raw_sample_buf);
-		devc->raw_sample_buf = NULL;
+		/* Send the remaining samples, and the trigger if still due. */
+		std_logic_feed_flush(&devc->logic_feed);
+		std_logic_feed_free(&devc->logic_feed);
 
 		ipdbg_la_abort_acquisition(sdi);
 	}
@@ -27,6 +27,9 @@
 
 #define LOG_PREFIX "ipdbg-la"
 
+/* Size of the logic packets sent while the capture is downloaded. */
+#define LOGIC_CHUNK_SIZE (64 * 1024)
+
 struct ipdbg_la_tcp {
 	char *address;
 	char *port;
@@ -51,7 +54,7 @@ struct dev_context {
 	uint64_t delay_value;
 	int num_stages;
 	uint64_t num_transfers;
-	uint8_t *raw_sample_buf;
+	struct std_logic_feed logic_feed;
 };
 
 SR_PRIV struct ipdbg_la_tcp *ipdbg_la_tcp_new(void);
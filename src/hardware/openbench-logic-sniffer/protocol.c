@@ -337,8 +337,7 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 	struct dev_context *devc;
 	struct sr_dev_inst *sdi;
 	struct sr_serial_dev_inst *serial;
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_logic logic;
+	struct std_logic_feed feed;
 	uint32_t sample;
 	int num_ols_changrp, offset, j;
 	unsigned int i;
@@ -468,43 +467,17 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 		sr_dbg("Received %d bytes, %d samples, %d decompressed samples.",
 				devc->cnt_bytes, devc->cnt_samples,
 				devc->cnt_samples_rle);
-		if (devc->trigger_at != -1) {
-			/*
-			 * A trigger was set up, so we need to tell the frontend
-			 * about it.
-			 */
-			if (devc->trigger_at > 0) {
-				/* There are pre-trigger samples, send those first. */
-				packet.type = SR_DF_LOGIC;
-				packet.payload = &logic;
-				logic.length = devc->trigger_at * 4;
-				logic.unitsize = 4;
-				logic.data = devc->raw_sample_buf +
-					(devc->limit_samples - devc->num_samples) * 4;
-				sr_session_send(sdi, &packet);
-			}
-
-			/* Send the trigger. */
-			packet.type = SR_DF_TRIGGER;
-			sr_session_send(sdi, &packet);
-
-			/* Send post-trigger samples. */
-			packet.type = SR_DF_LOGIC;
-			packet.payload = &logic;
-			logic.length = (devc->num_samples * 4) - (devc->trigger_at * 4);
-			logic.unitsize = 4;
-			logic.data = devc->raw_sample_buf + devc->trigger_at * 4 +
-				(devc->limit_samples - devc->num_samples) * 4;
-			sr_session_send(sdi, &packet);
-		} else {
-			/* no trigger was used */
-			packet.type = SR_DF_LOGIC;
-			packet.payload = &logic;
-			logic.length = devc->num_samples * 4;
-			logic.unitsize = 4;
-			logic.data = devc->raw_sample_buf +
-				(devc->limit_samples - devc->num_samples) * 4;
-			sr_session_send(sdi, &packet);
+		/*
+		 * Send the samples in chunks of bounded size, with the
+		 * trigger (if one was set up) at its proper position.
+		 */
+		if (std_logic_feed_init(&feed, sdi, 4, LOGIC_CHUNK_SIZE,
+				devc->trigger_at) == SR_OK) {
+			std_logic_feed_send(&feed, devc->raw_sample_buf +
+				(devc->limit_samples - devc->num_samples) * 4,
+				devc->num_samples * 4);
+			std_logic_feed_flush(&feed);
+			std_logic_feed_free(&feed);
 		}
 		g_free(devc->raw_sample_buf);
 
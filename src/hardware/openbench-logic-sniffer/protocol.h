@@ -34,6 +34,7 @@
 #define CLOCK_RATE                 SR_MHZ(100)
 #define MIN_NUM_SAMPLES            4
 #define DEFAULT_SAMPLERATE         SR_KHZ(200)
+#define LOGIC_CHUNK_SIZE           (64 * 1024)
 
 /* Command opcodes */
 #define CMD_RESET                  0x00
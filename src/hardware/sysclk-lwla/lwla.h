@@ -69,6 +69,11 @@ struct sr_usb_dev_inst;
  */
 #define PACKET_SIZE		(5000 * 4 * 5)
 
+/* Spare room at the end of the logic packet buffer. This allows samples
+ * to be stored as whole 64-bit words even if the unit size is smaller.
+ */
+#define OUT_PACKET_SLACK	8
+
 /** LWLA protocol command ID codes. */
 enum command_id {
 	CMD_READ_REG	= 1,
@@ -110,12 +115,15 @@ struct acquisition_state {
 	uint64_t sample;	/* last sample read from capture memory */
 	uint64_t run_len;	/* remaining run length of current sample */
 
-	struct libusb_transfer *xfer_in;	/* USB in transfer record */
+	struct libusb_transfer *xfer_in;	/* last completed in transfer */
+	struct libusb_transfer *xfer_in_next;	/* in transfer for next read */
 	struct libusb_transfer *xfer_out;	/* USB out transfer record */
+	uint32_t *xfer_buf_in;			/* data of last in transfer */
 
 	unsigned int mem_addr_fill;	/* capture memory fill level */
 	unsigned int mem_addr_done;	/* next address to be processed */
 	unsigned int mem_addr_next;	/* start address for next async read */
+	unsigned int mem_addr_recv;	/* end address of received block */
 	unsigned int mem_addr_stop;	/* end of memory range to be read */
 	unsigned int in_index;		/* position in read transfer buffer */
 	unsigned int out_index;		/* position in logic packet buffer */
@@ -123,15 +131,16 @@ struct acquisition_state {
 
 	gboolean rle_enabled;	/* capturing in timing-state mode */
 	gboolean clock_boost;	/* switch to faster clock during capture */
+	gboolean read_pending;	/* memory read response outstanding */
 	unsigned int status;	/* last received device status */
 
 	unsigned int reg_seq_pos;	/* index of next register/value pair */
 	unsigned int reg_seq_len;	/* length of register/value sequence */
 
 	struct regval reg_sequence[MAX_REG_SEQ_LEN];	/* register buffer */
-	uint32_t xfer_buf_in[MAX_ACQ_RECV_LEN32];	/* USB in buffer */
+	uint32_t xfer_bufs_in[2][MAX_ACQ_RECV_LEN32];	/* USB in buffers */
 	uint16_t xfer_buf_out[MAX_ACQ_SEND_LEN16];	/* USB out buffer */
-	uint8_t out_packet[PACKET_SIZE];		/* logic payload */
+	uint8_t out_packet[PACKET_SIZE + OUT_PACKET_SLACK]; /* logic payload */
 };
 
 static inline void lwla_queue_regval(struct acquisition_state *acq,
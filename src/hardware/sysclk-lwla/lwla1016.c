@@ -95,7 +95,7 @@ static void read_response(struct acquisition_state *acq)
 	unsigned int max_samples, run_samples;
 	unsigned int i;
 
-	words_left = MIN(acq->mem_addr_next, acq->mem_addr_stop)
+	words_left = MIN(acq->mem_addr_recv, acq->mem_addr_stop)
 			- acq->mem_addr_done;
 	/* Calculate number of samples to write into packet. */
 	max_samples = MIN(acq->samples_max - acq->samples_done,
@@ -134,7 +134,7 @@ static void read_response_rle(struct acquisition_state *acq)
 	uint32_t word;
 	uint16_t sample;
 
-	words_left = MIN(acq->mem_addr_next, acq->mem_addr_stop)
+	words_left = MIN(acq->mem_addr_recv, acq->mem_addr_stop)
 			- acq->mem_addr_done;
 	in_p = &acq->xfer_buf_in[acq->in_index];
 
@@ -408,7 +408,7 @@ static int handle_response(const struct sr_dev_inst *sdi)
 		acq->mem_addr_stop = acq->reg_sequence[0].val + READ_START_ADDR - 1;
 		break;
 	case STATE_READ_REQUEST:
-		expect_len = (acq->mem_addr_next - acq->mem_addr_done
+		expect_len = (acq->mem_addr_recv - acq->mem_addr_done
 				+ acq->in_index) * sizeof(acq->xfer_buf_in[0]);
 		if (acq->xfer_in->actual_length != expect_len) {
 			sr_err("Received size %d does not match expected size %d.",
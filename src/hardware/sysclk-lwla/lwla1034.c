@@ -18,6 +18,7 @@
  */
 
 #include <config.h>
+#include <string.h>
 #include "lwla.h"
 #include "protocol.h"
 
@@ -183,19 +184,68 @@ static inline uint64_t bulk_long_get(const struct acquisition_state *acq,
 	return (high << 32) | low;
 }
 
+/* Unpack a slice of 8 36-bit words packed into 9 32-bit words.
+ * The first eight transfer words hold the low 32 bits of each device word,
+ * and the ninth word supplies the high nibbles. Doing the whole slice in
+ * one go keeps the loop free of dependencies, so that it vectorizes well.
+ */
+static inline void unpack_slice(const uint32_t *slice, uint64_t *words)
+{
+	uint64_t high_nibbles;
+	unsigned int i;
+
+	high_nibbles = LWLA_TO_UINT32(slice[8]);
+
+	for (i = 0; i < 8; i++)
+		words[i] = LWLA_TO_UINT32(slice[i])
+			| ((high_nibbles << (4 * i + 4)) & (UINT64_C(0xF) << 32));
+}
+
+/* Expand a run of identical samples into the logic packet buffer.
+ * Short runs are written as overlapping 64-bit stores, which relies on
+ * the slack space at the end of the packet buffer. Longer runs are filled
+ * by repeatedly doubling the already written part.
+ */
+static inline void expand_run(uint8_t *out_p, uint64_t sample,
+			      unsigned int count)
+{
+	size_t filled, total, chunk;
+	unsigned int i;
+
+	if (count == 0)
+		return;
+
+	sample = GUINT64_TO_LE(sample);
+
+	if (count <= 8) {
+		for (i = 0; i < count; i++)
+			memcpy(&out_p[i * UNIT_SIZE], &sample, sizeof(sample));
+		return;
+	}
+	memcpy(out_p, &sample, sizeof(sample));
+
+	filled = UNIT_SIZE;
+	total = (size_t)count * UNIT_SIZE;
+
+	while (filled < total) {
+		chunk = MIN(filled, total - filled);
+		memcpy(&out_p[filled], out_p, chunk);
+		filled += chunk;
+	}
+}
+
 /* Demangle and decompress incoming sample data from the transfer buffer.
  * The data chunk is taken from the acquisition state, and is expected to
  * contain a multiple of 8 packed 36-bit words.
  */
 static void read_response(struct acquisition_state *acq)
 {
-	uint64_t sample, high_nibbles, word;
-	uint32_t *slice;
-	uint8_t *out_p;
-	unsigned int words_left, max_samples, run_samples, wi, ri, si;
+	uint64_t words[8];
+	uint64_t word;
+	unsigned int words_left, max_samples, run_samples, wi, pos;
 
 	/* Number of 36-bit words remaining in the transfer buffer. */
-	words_left = MIN(acq->mem_addr_next, acq->mem_addr_stop)
+	words_left = MIN(acq->mem_addr_recv, acq->mem_addr_stop)
 			- acq->mem_addr_done;
 
 	for (wi = 0;; wi++) {
@@ -205,17 +255,9 @@ static void read_response(struct acquisition_state *acq)
 		run_samples = MIN(max_samples, acq->run_len);
 
 		/* Expand run-length samples into session packet. */
-		sample = acq->sample;
-		out_p = &acq->out_packet[acq->out_index * UNIT_SIZE];
-
-		for (ri = 0; ri < run_samples; ri++) {
-			out_p[0] =  sample        & 0xFF;
-			out_p[1] = (sample >>  8) & 0xFF;
-			out_p[2] = (sample >> 16) & 0xFF;
-			out_p[3] = (sample >> 24) & 0xFF;
-			out_p[4] = (sample >> 32) & 0xFF;
-			out_p += UNIT_SIZE;
-		}
+		expand_run(&acq->out_packet[acq->out_index * UNIT_SIZE],
+			   acq->sample, run_samples);
+
 		acq->run_len -= run_samples;
 		acq->out_index += run_samples;
 		acq->samples_done += run_samples;
@@ -225,14 +267,12 @@ static void read_response(struct acquisition_state *acq)
 		if (wi >= words_left)
 			break; /* Done with current transfer. */
 
-		/* Get the current slice of 8 packed 36-bit words. */
-		slice = &acq->xfer_buf_in[(acq->in_index + wi) / 8 * 9];
-		si = (acq->in_index + wi) % 8; /* Word index within slice. */
+		/* Unpack the next slice when crossing a slice boundary. */
+		pos = acq->in_index + wi;
+		if (wi == 0 || pos % 8 == 0)
+			unpack_slice(&acq->xfer_buf_in[pos / 8 * 9], words);
 
-		/* Extract the next 36-bit word. */
-		high_nibbles = LWLA_TO_UINT32(slice[8]);
-		word = LWLA_TO_UINT32(slice[si]);
-		word |= (high_nibbles << (4 * si + 4)) & (UINT64_C(0xF) << 32);
+		word = words[pos % 8];
 
 		if (acq->rle == RLE_STATE_DATA) {
 			acq->sample = word & ALL_CHANNELS_MASK;
@@ -527,7 +567,7 @@ static int handle_response(const struct sr_dev_inst *sdi)
 	case STATE_READ_REQUEST:
 		/* Expect a multiple of 8 36-bit words packed into 9 32-bit
 		 * words. */
-		expect_len = (acq->mem_addr_next - acq->mem_addr_done
+		expect_len = (acq->mem_addr_recv - acq->mem_addr_done
 			+ acq->in_index + 7) / 8 * 9 * sizeof(acq->xfer_buf_in[0]);
 
 		if (acq->xfer_in->actual_length != expect_len) {
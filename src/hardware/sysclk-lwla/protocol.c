@@ -118,6 +118,33 @@ static int submit_request(const struct sr_dev_inst *sdi,
 	return submit_transfer(devc, acq->xfer_out);
 }
 
+/* Submit a capture memory read request together with the in transfer
+ * that receives its response. The spare in buffer is used, so that the
+ * response to the next read may arrive while the previous block is still
+ * being unpacked.
+ */
+static int submit_read_request(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	struct acquisition_state *acq;
+	int ret;
+
+	devc = sdi->priv;
+	acq = devc->acquisition;
+
+	ret = submit_request(sdi, STATE_READ_REQUEST);
+	if (ret != SR_OK)
+		return ret;
+
+	ret = submit_transfer(devc, acq->xfer_in_next);
+	if (ret != SR_OK)
+		return ret;
+
+	acq->read_pending = TRUE;
+
+	return SR_OK;
+}
+
 /* Evaluate and act on the response to a capture status request. */
 static void handle_status_response(const struct sr_dev_inst *sdi)
 {
@@ -192,6 +219,7 @@ static void handle_read_response(const struct sr_dev_inst *sdi)
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
 	unsigned int end_addr;
+	gboolean read_more;
 
 	devc = sdi->priv;
 	acq = devc->acquisition;
@@ -202,9 +230,23 @@ static void handle_read_response(const struct sr_dev_inst *sdi)
 	logic.unitsize = (devc->model->num_channels + 7) / 8;
 	logic.data = acq->out_packet;
 
-	end_addr = MIN(acq->mem_addr_next, acq->mem_addr_stop);
+	acq->mem_addr_recv = acq->mem_addr_next;
+	end_addr = MIN(acq->mem_addr_recv, acq->mem_addr_stop);
 	acq->in_index = 0;
 
+	/*
+	 * Request the next block before unpacking the current one, so that
+	 * the device can already deliver it in the meantime. If the sample
+	 * limit is hit within the current block, the read-ahead data is
+	 * simply dropped when it arrives.
+	 */
+	read_more = !devc->cancel_requested
+			&& acq->samples_done < acq->samples_max
+			&& acq->mem_addr_next < acq->mem_addr_stop;
+
+	if (read_more && submit_read_request(sdi) != SR_OK)
+		return;
+
 	/*
 	 * Repeatedly call the model-specific read response handler until
 	 * all data received in the transfer has been accounted for.
@@ -225,13 +267,8 @@ static void handle_read_response(const struct sr_dev_inst *sdi)
 		}
 	}
 
-	if (!devc->cancel_requested
-			&& acq->samples_done < acq->samples_max
-			&& acq->mem_addr_next < acq->mem_addr_stop) {
-		/* Request the next block. */
-		submit_request(sdi, STATE_READ_REQUEST);
-		return;
-	}
+	if (read_more)
+		return; /* Wait for the next block. */
 
 	/* Send partially filled packet as it is the last one. */
 	if (!devc->cancel_requested && acq->out_index > 0) {
@@ -255,6 +292,7 @@ static void clear_acquisition_state(const struct sr_dev_inst *sdi)
 
 	if (acq) {
 		libusb_free_transfer(acq->xfer_out);
+		libusb_free_transfer(acq->xfer_in_next);
 		libusb_free_transfer(acq->xfer_in);
 		g_free(acq);
 	}
@@ -296,8 +334,14 @@ static int transfer_event(int fd, int revents, void *cb_data)
 	}
 
 	/* Stop processing events if an error occurred on a transfer. */
-	if (devc->transfer_error)
+	if (devc->transfer_error) {
+		/* Let an outstanding read complete before cleaning up. */
+		if (devc->acquisition && devc->acquisition->read_pending) {
+			libusb_cancel_transfer(devc->acquisition->xfer_in_next);
+			return G_SOURCE_CONTINUE;
+		}
 		devc->state = STATE_IDLE;
+	}
 
 	if (devc->state != STATE_IDLE)
 		return G_SOURCE_CONTINUE;
@@ -329,9 +373,11 @@ static void LIBUSB_CALL transfer_out_completed(struct libusb_transfer *transfer)
 		return;
 	}
 
-	/* If this was a read request, wait for the response. */
+	/* If this was a read request, wait for the response. Memory
+	 * reads have their response transfer submitted up front. */
 	if ((devc->state & STATE_EXPECT_RESPONSE) != 0) {
-		submit_transfer(devc, acq->xfer_in);
+		if (devc->state != STATE_READ_REQUEST)
+			submit_transfer(devc, acq->xfer_in);
 		return;
 	}
 	if (acq->reg_seq_pos < acq->reg_seq_len)
@@ -361,7 +407,7 @@ static void LIBUSB_CALL transfer_out_completed(struct libusb_transfer *transfer)
 		break;
 	case STATE_READ_PREPARE:
 		if (acq->mem_addr_next < acq->mem_addr_stop && !devc->cancel_requested)
-			submit_request(sdi, STATE_READ_REQUEST);
+			submit_read_request(sdi);
 		else
 			submit_request(sdi, STATE_READ_FINISH);
 		break;
@@ -386,6 +432,18 @@ static void LIBUSB_CALL transfer_in_completed(struct libusb_transfer *transfer)
 	devc = sdi->priv;
 	acq = devc->acquisition;
 
+	/* A completed memory read becomes the current in transfer. */
+	if (transfer == acq->xfer_in_next) {
+		acq->xfer_in_next = acq->xfer_in;
+		acq->xfer_in = transfer;
+		acq->xfer_buf_in = (uint32_t *)transfer->buffer;
+		acq->read_pending = FALSE;
+	}
+
+	if (transfer->status == LIBUSB_TRANSFER_CANCELLED
+			&& devc->transfer_error)
+		return;
+
 	if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
 		sr_err("Transfer from device failed (state %d): %s.",
 		       devc->state, libusb_error_name(transfer->status));
@@ -464,8 +522,15 @@ static int init_acquisition_state(const struct sr_dev_inst *sdi)
 		g_free(acq);
 		return SR_ERR_MALLOC;
 	}
+	acq->xfer_in_next = libusb_alloc_transfer(0);
+	if (!acq->xfer_in_next) {
+		libusb_free_transfer(acq->xfer_in);
+		g_free(acq);
+		return SR_ERR_MALLOC;
+	}
 	acq->xfer_out = libusb_alloc_transfer(0);
 	if (!acq->xfer_out) {
+		libusb_free_transfer(acq->xfer_in_next);
 		libusb_free_transfer(acq->xfer_in);
 		g_free(acq);
 		return SR_ERR_MALLOC;
@@ -477,11 +542,19 @@ static int init_acquisition_state(const struct sr_dev_inst *sdi)
 				  (struct sr_dev_inst *)sdi, USB_TIMEOUT_MS);
 
 	libusb_fill_bulk_transfer(acq->xfer_in, usb->devhdl, EP_REPLY,
-				  (unsigned char *)acq->xfer_buf_in,
-				  sizeof(acq->xfer_buf_in),
+				  (unsigned char *)acq->xfer_bufs_in[0],
+				  sizeof(acq->xfer_bufs_in[0]),
 				  &transfer_in_completed,
 				  (struct sr_dev_inst *)sdi, USB_TIMEOUT_MS);
 
+	libusb_fill_bulk_transfer(acq->xfer_in_next, usb->devhdl, EP_REPLY,
+				  (unsigned char *)acq->xfer_bufs_in[1],
+				  sizeof(acq->xfer_bufs_in[1]),
+				  &transfer_in_completed,
+				  (struct sr_dev_inst *)sdi, USB_TIMEOUT_MS);
+
+	acq->xfer_buf_in = acq->xfer_bufs_in[0];
+
 	if (devc->limit_msec > 0) {
 		acq->duration_max = devc->limit_msec;
 		sr_info("Acquisition time limit %" PRIu64 " ms.",
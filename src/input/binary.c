@@ -66,15 +66,41 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int process_buffer(struct sr_input *in)
+static int send_chunk(struct std_pipeline *pl, const uint8_t *data,
+	size_t length, unsigned int slot)
 {
+	struct sr_input *in;
+	struct context *inc;
 	struct sr_datafeed_packet packet;
-	struct sr_datafeed_meta meta;
 	struct sr_datafeed_logic logic;
+
+	(void)slot;
+
+	in = pl->cb_data;
+	inc = in->priv;
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = inc->unitsize;
+	logic.length = length;
+	logic.data = (uint8_t *)data;
+
+	return sr_session_send(in->sdi, &packet);
+}
+
+/*
+ * Send the data as logic packets, returns the number of bytes consumed.
+ * Memory mapped input gets read ahead while chunks are sent.
+ */
+static gsize process_data(struct sr_input *in, const char *data, gsize length,
+	gboolean mapped)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
 	struct sr_config *src;
 	struct context *inc;
-	gsize chunk_size, i;
-	int chunk;
+	struct std_pipeline pl;
+	gsize chunk_size;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -93,20 +119,25 @@ static int process_buffer(struct sr_input *in)
 		inc->started = TRUE;
 	}
 
-	packet.type = SR_DF_LOGIC;
-	packet.payload = &logic;
-	logic.unitsize = inc->unitsize;
-
 	/* Cut off at multiple of unitsize. */
-	chunk_size = in->buf->len / logic.unitsize * logic.unitsize;
+	chunk_size = length / inc->unitsize * inc->unitsize;
 
-	for (i = 0; i < chunk_size; i += chunk) {
-		logic.data = in->buf->str + i;
-		chunk = MIN(CHUNK_SIZE, chunk_size - i);
-		logic.length = chunk;
-		sr_session_send(in->sdi, &packet);
-	}
-	g_string_erase(in->buf, 0, chunk_size);
+	std_pipeline_init(&pl, (const uint8_t *)data, chunk_size,
+		CHUNK_SIZE / inc->unitsize * inc->unitsize);
+	pl.send = send_chunk;
+	pl.cb_data = in;
+	pl.mapped = mapped;
+	std_pipeline_run(&pl);
+
+	return chunk_size;
+}
+
+static int process_buffer(struct sr_input *in)
+{
+	gsize used;
+
+	used = process_data(in, in->buf->str, in->buf->len, FALSE);
+	g_string_erase(in->buf, 0, used);
 
 	return SR_OK;
 }
@@ -128,6 +159,21 @@ static int receive(struct sr_input *in, GString *buf)
 	return ret;
 }
 
+/* Logic packets point straight into the mapped file. */
+static int receive_mapped(struct sr_input *in, const uint8_t *data,
+	size_t length, size_t *used)
+{
+	if (!in->sdi_ready) {
+		/* sdi is ready, notify frontend. */
+		in->sdi_ready = TRUE;
+		return SR_OK;
+	}
+
+	*used = process_data(in, (const char *)data, length, TRUE);
+
+	return SR_OK;
+}
+
 static int end(struct sr_input *in)
 {
 	struct context *inc;
@@ -179,6 +225,7 @@ SR_PRIV struct sr_input_module input_binary = {
 	.options = get_options,
 	.init = init,
 	.receive = receive,
+	.receive_mapped = receive_mapped,
 	.end = end,
 	.reset = reset,
 };
@@ -0,0 +1,377 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Reads the LZ4 compressed binary logic data of the "binary-lz4" output
+ * module, see src/output/binary_lz4.c for the format. Channel names and
+ * the samplerate come from the header.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "input/binary-lz4"
+
+#define BINARY_LZ4_MAGIC	"SRBINLZ4"
+#define BINARY_LZ4_VERSION	1
+
+/* Header up to the channel list. */
+#define HEADER_SIZE		28
+#define BLOCK_STORED		(1U << 31)
+
+/* Limits which reject corrupt headers early. */
+#define MAX_UNITSIZE		64
+#define MAX_NAME_LENGTH		1024
+#define MAX_BLOCK_SIZE		(64 * 1024 * 1024)
+
+struct context {
+	gboolean create_channels;
+	gboolean started;
+	gboolean done;
+	size_t header_len;
+	uint16_t unitsize;
+	uint64_t samplerate;
+	/* Uncompressed samples of a block. */
+	uint8_t *block;
+	size_t block_size;
+};
+
+/*
+ * Check the header, and get the settings into the context when there
+ * is one. Returns SR_ERR_NA while the header is incomplete.
+ */
+static int parse_header(const uint8_t *buf, size_t len,
+		struct context *inc, struct sr_dev_inst *sdi)
+{
+	uint32_t unitsize, count, index, name_len, i;
+	size_t pos;
+	char *name;
+
+	if (len < HEADER_SIZE)
+		return SR_ERR_NA;
+	if (memcmp(buf, BINARY_LZ4_MAGIC, 8))
+		return SR_ERR;
+	if (RL32(buf + 8) != BINARY_LZ4_VERSION) {
+		sr_err("Unsupported version %u.", RL32(buf + 8));
+		return SR_ERR_DATA;
+	}
+	unitsize = RL32(buf + 12);
+	if (unitsize == 0 || unitsize > MAX_UNITSIZE) {
+		sr_err("Invalid unit size %u.", unitsize);
+		return SR_ERR_DATA;
+	}
+
+	count = RL32(buf + 24);
+	pos = HEADER_SIZE;
+	for (i = 0; i < count; i++) {
+		if (len - pos < 8)
+			return SR_ERR_NA;
+		index = RL32(buf + pos);
+		name_len = RL32(buf + pos + 4);
+		if (index >= unitsize * 8 || name_len > MAX_NAME_LENGTH) {
+			sr_err("Invalid channel %u.", i);
+			return SR_ERR_DATA;
+		}
+		pos += 8;
+		if (len - pos < name_len)
+			return SR_ERR_NA;
+		pos += name_len;
+	}
+
+	if (inc) {
+		inc->unitsize = unitsize;
+		inc->samplerate = RL64(buf + 16);
+		inc->header_len = pos;
+	}
+
+	if (sdi) {
+		pos = HEADER_SIZE;
+		for (i = 0; i < count; i++) {
+			index = RL32(buf + pos);
+			name_len = RL32(buf + pos + 4);
+			pos += 8;
+			name = g_strndup((const char *)buf + pos, name_len);
+			sr_channel_new(sdi, index, SR_CHANNEL_LOGIC, TRUE, name);
+			g_free(name);
+			pos += name_len;
+		}
+	}
+
+	return SR_OK;
+}
+
+static int format_match(GHashTable *metadata, unsigned int *confidence)
+{
+	GString *buf;
+	int ret;
+
+	buf = g_hash_table_lookup(metadata, GINT_TO_POINTER(SR_INPUT_META_HEADER));
+	ret = parse_header((const uint8_t *)buf->str, buf->len, NULL, NULL);
+	/* The channel list may not fit the header buffer. */
+	if (ret != SR_OK && ret != SR_ERR_NA)
+		return ret;
+
+	*confidence = 1;
+
+	return SR_OK;
+}
+
+static int init(struct sr_input *in, GHashTable *options)
+{
+	struct context *inc;
+
+	(void)options;
+
+	in->sdi = g_malloc0(sizeof(struct sr_dev_inst));
+	in->priv = inc = g_malloc0(sizeof(struct context));
+	inc->create_channels = TRUE;
+
+	return SR_OK;
+}
+
+/* Parse the header, create channels and notify the frontend. */
+static int check_header(struct sr_input *in, const uint8_t *data, size_t length)
+{
+	struct context *inc;
+	int ret;
+
+	inc = in->priv;
+	ret = parse_header(data, length, inc,
+		inc->create_channels ? in->sdi : NULL);
+	if (ret == SR_ERR_NA)
+		/* Not enough data yet. */
+		return SR_OK;
+	else if (ret != SR_OK)
+		return ret;
+
+	inc->create_channels = FALSE;
+
+	/* sdi is ready, notify frontend. */
+	in->sdi_ready = TRUE;
+
+	return SR_OK;
+}
+
+static int send_logic(struct sr_input *in, const uint8_t *data, size_t length)
+{
+	struct context *inc;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+
+	inc = in->priv;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = inc->unitsize;
+	logic.length = length;
+	logic.data = (uint8_t *)data;
+
+	return sr_session_send(in->sdi, &packet);
+}
+
+/* Send the complete blocks in the data, and return the bytes consumed. */
+static int process_data(struct sr_input *in, const uint8_t *data,
+		size_t length, size_t *used)
+{
+	struct context *inc;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_config *src;
+	uint32_t size, samples;
+	size_t offset, written;
+	gboolean stored;
+	int ret;
+
+	inc = in->priv;
+	offset = 0;
+	if (!inc->started) {
+		/*
+		 * Skip the header once all of it is there. After the header
+		 * check of a mapped file, end() can come without any data.
+		 */
+		if (length < inc->header_len) {
+			*used = 0;
+			return SR_OK;
+		}
+
+		std_session_send_df_header(in->sdi);
+
+		if (inc->samplerate) {
+			packet.type = SR_DF_META;
+			packet.payload = &meta;
+			src = sr_config_new(SR_CONF_SAMPLERATE, g_variant_new_uint64(inc->samplerate));
+			meta.config = g_slist_append(NULL, src);
+			sr_session_send(in->sdi, &packet);
+			g_slist_free(meta.config);
+			sr_config_free(src);
+		}
+
+		inc->started = TRUE;
+		offset = inc->header_len;
+	}
+
+	while (!inc->done && length - offset >= 4) {
+		size = RL32(data + offset);
+		if (!size) {
+			inc->done = TRUE;
+			offset += 4;
+			break;
+		}
+		if (length - offset < 8)
+			break;
+
+		stored = (size & BLOCK_STORED) != 0;
+		size &= ~BLOCK_STORED;
+		samples = RL32(data + offset + 4);
+		if (!samples || samples > MAX_BLOCK_SIZE
+				|| samples % inc->unitsize
+				|| (stored && size != samples)
+				|| size > sr_lz4_compress_bound(samples)) {
+			sr_err("Invalid block at offset %zu.", offset);
+			return SR_ERR_DATA;
+		}
+		if (length - offset - 8 < size)
+			break;
+		offset += 8;
+
+		if (stored) {
+			ret = send_logic(in, data + offset, size);
+		} else {
+			if (inc->block_size < samples) {
+				g_free(inc->block);
+				inc->block = g_malloc(samples);
+				inc->block_size = samples;
+			}
+			ret = sr_lz4_decompress(data + offset, size,
+				inc->block, samples, &written);
+			if (ret == SR_OK && written != samples) {
+				sr_err("Block has %zu bytes instead of %u.",
+					written, samples);
+				ret = SR_ERR_DATA;
+			}
+			if (ret == SR_OK)
+				ret = send_logic(in, inc->block, samples);
+		}
+		if (ret != SR_OK)
+			return ret;
+		offset += size;
+	}
+
+	*used = offset;
+
+	return SR_OK;
+}
+
+static int process_buffer(struct sr_input *in)
+{
+	size_t used;
+	int ret;
+
+	ret = process_data(in, (const uint8_t *)in->buf->str, in->buf->len, &used);
+	if (ret != SR_OK)
+		return ret;
+	g_string_erase(in->buf, 0, used);
+
+	return SR_OK;
+}
+
+static int receive(struct sr_input *in, GString *buf)
+{
+	g_string_append_len(in->buf, buf->str, buf->len);
+
+	if (!in->sdi_ready)
+		return check_header(in, (const uint8_t *)in->buf->str, in->buf->len);
+
+	return process_buffer(in);
+}
+
+/* Stored blocks get sent straight from the mapped file. */
+static int receive_mapped(struct sr_input *in, const uint8_t *data,
+	size_t length, size_t *used)
+{
+	if (!in->sdi_ready)
+		return check_header(in, data, length);
+
+	return process_data(in, data, length, used);
+}
+
+static int end(struct sr_input *in)
+{
+	struct context *inc;
+	int ret;
+
+	if (in->sdi_ready)
+		ret = process_buffer(in);
+	else
+		ret = SR_OK;
+
+	inc = in->priv;
+	if (inc->started && !inc->done && ret == SR_OK)
+		sr_warn("Data ends without an end marker, truncated file?");
+	if (inc->started)
+		std_session_send_df_end(in->sdi);
+
+	return ret;
+}
+
+static void cleanup(struct sr_input *in)
+{
+	struct context *inc;
+
+	inc = in->priv;
+	g_free(inc->block);
+	inc->block = NULL;
+	inc->block_size = 0;
+}
+
+static int reset(struct sr_input *in)
+{
+	struct context *inc;
+
+	inc = in->priv;
+	cleanup(in);
+	inc->started = FALSE;
+	inc->done = FALSE;
+	g_string_truncate(in->buf, 0);
+
+	return SR_OK;
+}
+
+static const struct sr_input_magic magic[] = {
+	{ 0, BINARY_LZ4_MAGIC, FALSE },
+	ALL_ZERO
+};
+
+SR_PRIV struct sr_input_module input_binary_lz4 = {
+	.id = "binary-lz4",
+	.name = "Binary (LZ4)",
+	.desc = "LZ4 compressed binary logic data",
+	.exts = (const char*[]){"srlz4", NULL},
+	.metadata = { SR_INPUT_META_HEADER | SR_INPUT_META_REQUIRED },
+	.magic = magic,
+	.format_match = format_match,
+	.init = init,
+	.receive = receive,
+	.receive_mapped = receive_mapped,
+	.end = end,
+	.cleanup = cleanup,
+	.reset = reset,
+};
@@ -127,7 +127,8 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int process_buffer(struct sr_input *in)
+/* Send the data as logic packets, returns the number of bytes consumed. */
+static gsize process_data(struct sr_input *in, const char *data, gsize length)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
@@ -165,11 +166,11 @@ static int process_buffer(struct sr_input *in)
 	logic.unitsize = unitsize;
 
 	/* Cut off at multiple of unitsize. Avoid sending the "header". */
-	chunk_size = in->buf->len / logic.unitsize * logic.unitsize;
+	chunk_size = length / logic.unitsize * logic.unitsize;
 	chunk_size = MIN(chunk_size, inc->samples_remain * unitsize);
 
 	for (i = 0; i < chunk_size; i += chunk) {
-		logic.data = in->buf->str + i;
+		logic.data = (char *)data + i;
 		chunk = MIN(CHUNK_SIZE, chunk_size - i);
 		if (chunk) {
 			logic.length = chunk;
@@ -177,7 +178,16 @@ static int process_buffer(struct sr_input *in)
 			inc->samples_remain -= chunk / unitsize;
 		}
 	}
-	g_string_erase(in->buf, 0, chunk_size);
+
+	return chunk_size;
+}
+
+static int process_buffer(struct sr_input *in)
+{
+	gsize used;
+
+	used = process_data(in, in->buf->str, in->buf->len);
+	g_string_erase(in->buf, 0, used);
 
 	return SR_OK;
 }
@@ -199,6 +209,24 @@ static int receive(struct sr_input *in, GString *buf)
 	return ret;
 }
 
+/*
+ * Logic packets point straight into the mapped file. The "header" after
+ * the data part remains unconsumed, and is not sent.
+ */
+static int receive_mapped(struct sr_input *in, const uint8_t *data,
+	size_t length, size_t *used)
+{
+	if (!in->sdi_ready) {
+		/* sdi is ready, notify frontend. */
+		in->sdi_ready = TRUE;
+		return SR_OK;
+	}
+
+	*used = process_data(in, (const char *)data, length);
+
+	return SR_OK;
+}
+
 static int end(struct sr_input *in)
 {
 	struct context *inc;
@@ -252,6 +280,7 @@ SR_PRIV struct sr_input_module input_chronovu_la8 = {
 	.format_match = format_match,
 	.init = init,
 	.receive = receive,
+	.receive_mapped = receive_mapped,
 	.end = end,
 	.reset = reset,
 };
@@ -28,6 +28,9 @@
 
 #define CHUNK_SIZE	(4 * 1024 * 1024)
 
+/* Precision of analog values, for datafeed consumers' display. */
+#define ANALOG_DIGITS	6
+
 /*
  * The CSV input module has the following options:
  *
@@ -67,6 +70,13 @@
  *
  * startline:     Line number to start processing sample data. Must be greater
  *                than 0. The default line number to start processing is 1.
+ *
+ * analog-columns: Comma separated list of column numbers which hold analog
+ *                values (decimal numbers like '1.25' or '-3e-3'). These
+ *                become analog channels following the logic channels, and
+ *                are skipped when logic channels get assigned to columns in
+ *                multi column mode. With a header, the header fields name
+ *                the analog channels in both modes. None by default.
  */
 
 /*
@@ -74,32 +84,19 @@
  *
  * - Determine how the text line handling can get improved, regarding
  *   all of robustness and flexibility and correctness.
- *   - The current implementation splits on "any run of CR and LF". Which
- *     translates to: Line numbers are wrong in the presence of empty
- *     lines in the input stream. See below for an (expensive) fix.
- *   - Dropping support for CR style end-of-line markers could improve
- *     the situation a lot. Code could search for and split on LF, and
- *     trim optional trailing CR. This would result in proper support
- *     for CRLF (Windows) as well as LF (Unix), and allow for correct
- *     line number counts.
- *   - When support for CR-only line termination cannot get dropped,
- *     then the current implementation is inappropriate. Currently the
- *     input stream is scanned for the first occurance of either of the
- *     supported termination styles (which is good). For the remaining
- *     session a consistent encoding of the text lines is assumed (which
- *     is acceptable).
- *   - When line numbers need to be correct and reliable, _and_ the full
- *     set of previously supported line termination sequences are required,
- *     and potentially more are to get added for improved compatibility
- *     with more platforms or generators, then the current approach of
- *     splitting on runs of termination characters needs to get replaced,
- *     by the more expensive approach to scan for and count the initially
- *     determined termination sequence.
+ *   - The input stream is scanned for the first occurance of either of
+ *     the supported termination styles (CRLF, LF, CR). For the remaining
+ *     session a consistent encoding of the text lines is assumed, lines
+ *     are split on the last character of the termination sequence, and
+ *     a CR before an LF gets trimmed. Line numbers are correct for all
+ *     of these styles, but a stray CR within an LF terminated line is
+ *     not taken as a line break.
+ *   - The initial parse (channel names, column count) still splits on
+ *     "any run of CR and LF", and its line numbers are wrong in the
+ *     presence of empty lines in the input stream.
  *
- * - Add support for analog input data? (optional)
- *   - Needs a syntax first for user specs which channels (columns) are
- *     logic and which are analog. May need heuristics(?) to guess from
- *     input data in the absence of user provided specs.
+ * - Analog columns need to be specified by the user. Heuristics could
+ *   guess them from the input data in the absence of user provided specs.
  */
 
 /* Single column formats. */
@@ -109,6 +106,13 @@ enum {
 	FORMAT_OCT
 };
 
+/* An analog channel, and the queue of its values for datafeed submission. */
+struct analog_column {
+	unsigned int column;
+	GSList *channels;
+	float *buffer;
+};
+
 struct context {
 	gboolean started;
 
@@ -127,6 +131,9 @@ struct context {
 	/* Termination character(s) used in current stream. */
 	char *termination;
 
+	/* Last character of the termination, which ends a line. */
+	char line_end;
+
 	/* Determines if sample data is stored in multiple columns. */
 	gboolean multi_column_mode;
 
@@ -158,12 +165,19 @@ struct context {
 	/* Format sample data is stored in single column mode. */
 	int format;
 
+	/* Analog channels, sorted by column number. */
+	struct analog_column *analog;
+	unsigned int num_analog;
+
+	/* Last column which holds data for any channel. */
+	unsigned int last_column;
+
 	size_t sample_unit_size;	/**!< Byte count for a single sample. */
 	uint8_t *sample_buffer;		/**!< Buffer for a single sample. */
 
 	uint8_t *datafeed_buffer;	/**!< Queue for datafeed submission. */
-	size_t datafeed_buf_size;
-	size_t datafeed_buf_fill;
+	size_t samples_per_chunk;	/**!< Queue size in samples. */
+	size_t queued_samples;		/**!< Number of queued samples. */
 
 	/* Current line number. */
 	size_t line_number;
@@ -180,11 +194,63 @@ static void strip_comment(char *buf, const GString *prefix)
 		*ptr = '\0';
 }
 
-static int parse_binstr(const char *str, struct context *inc)
+/*
+ * Find a string within a text of the given length. memchr() does the
+ * scanning for the first character, which the C library vectorizes.
+ */
+static const char *find_str(const char *text, gsize length,
+	const char *str, gsize str_length)
 {
-	gsize i, j, length;
+	const char *p, *end;
 
-	length = strlen(str);
+	if (str_length == 1)
+		return memchr(text, str[0], length);
+
+	p = text;
+	end = text + length;
+	while ((gsize)(end - p) >= str_length) {
+		p = memchr(p, str[0], end - p - str_length + 1);
+		if (!p)
+			break;
+		if (!memcmp(p, str, str_length))
+			return p;
+		p++;
+	}
+
+	return NULL;
+}
+
+/*
+ * Get the next column of a line, with surrounding whitespace removed.
+ * Returns FALSE when there are no more columns. Columns are not copied.
+ */
+static gboolean next_column(const struct context *inc, const char **pos,
+	const char *end, const char **column, gsize *length)
+{
+	const char *p, *delim;
+
+	p = *pos;
+	if (!p)
+		return FALSE;
+
+	delim = find_str(p, end - p, inc->delimiter->str, inc->delimiter->len);
+	*pos = delim ? delim + inc->delimiter->len : NULL;
+	if (!delim)
+		delim = end;
+
+	while (p < delim && g_ascii_isspace(*p))
+		p++;
+	while (delim > p && g_ascii_isspace(delim[-1]))
+		delim--;
+	*column = p;
+	*length = delim - p;
+
+	return TRUE;
+}
+
+static int parse_binstr(const char *str, gsize length, struct context *inc)
+{
+	gsize i, j;
 
 	if (!length) {
 		sr_err("Column %u in line %zu is empty.", inc->single_column,
@@ -201,8 +267,9 @@ static int parse_binstr(const char *str, struct context *inc)
 		if (str[length - i - 1] == '1') {
 			inc->sample_buffer[j / 8] |= (1 << (j % 8));
 		} else if (str[length - i - 1] != '0') {
-			sr_err("Invalid value '%s' in column %u in line %zu.",
-				str, inc->single_column, inc->line_number);
+			sr_err("Invalid value '%.*s' in column %u in line %zu.",
+				(int)length, str, inc->single_column,
+				inc->line_number);
 			return SR_ERR;
 		}
 	}
@@ -210,14 +277,12 @@ static int parse_binstr(const char *str, struct context *inc)
 	return SR_OK;
 }
 
-static int parse_hexstr(const char *str, struct context *inc)
+static int parse_hexstr(const char *str, gsize length, struct context *inc)
 {
-	gsize i, j, k, length;
+	gsize i, j, k;
 	uint8_t value;
 	char c;
 
-	length = strlen(str);
-
 	if (!length) {
 		sr_err("Column %u in line %zu is empty.", inc->single_column,
 			inc->line_number);
@@ -233,14 +298,17 @@ static int parse_hexstr(const char *str, struct context *inc)
 	for (j = 0; i < length && j < inc->num_channels; i++) {
 		c = str[length - i - 1];
 
-		if (!g_ascii_isxdigit(c)) {
-			sr_err("Invalid value '%s' in column %u in line %zu.",
-				str, inc->single_column, inc->line_number);
+		if (c >= '0' && c <= '9') {
+			value = c - '0';
+		} else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+			value = (c | 0x20) - 'a' + 10;
+		} else {
+			sr_err("Invalid value '%.*s' in column %u in line %zu.",
+				(int)length, str, inc->single_column,
+				inc->line_number);
 			return SR_ERR;
 		}
 
-		value = g_ascii_xdigit_value(c);
-
 		k = (inc->first_channel + j) % 4;
 
 		for (; j < inc->num_channels && k < 4; k++) {
@@ -254,14 +322,12 @@ static int parse_hexstr(const char *str, struct context *inc)
 	return SR_OK;
 }
 
-static int parse_octstr(const char *str, struct context *inc)
+static int parse_octstr(const char *str, gsize length, struct context *inc)
 {
-	gsize i, j, k, length;
+	gsize i, j, k;
 	uint8_t value;
 	char c;
 
-	length = strlen(str);
-
 	if (!length) {
 		sr_err("Column %u in line %zu is empty.", inc->single_column,
 			inc->line_number);
@@ -278,12 +344,13 @@ static int parse_octstr(const char *str, struct context *inc)
 		c = str[length - i - 1];
 
 		if (c < '0' || c > '7') {
-			sr_err("Invalid value '%s' in column %u in line %zu.",
-				str, inc->single_column, inc->line_number);
+			sr_err("Invalid value '%.*s' in column %u in line %zu.",
+				(int)length, str, inc->single_column,
+				inc->line_number);
 			return SR_ERR;
 		}
 
-		value = g_ascii_xdigit_value(c);
+		value = c - '0';
 
 		k = (inc->first_channel + j) % 3;
 
@@ -298,15 +365,105 @@ static int parse_octstr(const char *str, struct context *inc)
 	return SR_OK;
 }
 
+/*
+ * Parse a decimal floating point number of the given length, regardless
+ * of the locale. Numbers with up to 15 significant digits and an exponent
+ * within +-22 are exactly representable as a product or quotient of two
+ * doubles, which covers typical measurement values. Anything else (long
+ * mantissas, large exponents, "inf" and "nan") takes the slower path
+ * through g_ascii_strtod().
+ */
+static int parse_float(const char *str, gsize length, float *value)
+{
+	static const double pow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+	};
+	const char *p, *end;
+	uint64_t mantissa;
+	int digits, exponent, exp_value;
+	gboolean negative, exp_negative, have_digits;
+	char buf[64], *endptr;
+	double d;
+
+	p = str;
+	end = str + length;
+	negative = FALSE;
+	if (p < end && (*p == '+' || *p == '-'))
+		negative = *p++ == '-';
+
+	mantissa = 0;
+	digits = 0;
+	exponent = 0;
+	have_digits = FALSE;
+	for (; p < end && *p >= '0' && *p <= '9'; p++) {
+		have_digits = TRUE;
+		if (digits >= 16) {
+			exponent++;
+			continue;
+		}
+		mantissa = mantissa * 10 + (*p - '0');
+		if (mantissa)
+			digits++;
+	}
+	if (p < end && *p == '.') {
+		for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+			have_digits = TRUE;
+			if (digits >= 16)
+				continue;
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa)
+				digits++;
+			exponent--;
+		}
+	}
+	if (!have_digits)
+		goto slow;
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		exp_negative = FALSE;
+		if (p < end && (*p == '+' || *p == '-'))
+			exp_negative = *p++ == '-';
+		if (p == end || *p < '0' || *p > '9')
+			goto slow;
+		exp_value = 0;
+		for (; p < end && *p >= '0' && *p <= '9'; p++) {
+			if (exp_value < 10000)
+				exp_value = exp_value * 10 + (*p - '0');
+		}
+		exponent += exp_negative ? -exp_value : exp_value;
+	}
+	if (p != end || digits > 15 || exponent < -22 || exponent > 22)
+		goto slow;
+
+	d = (double)mantissa;
+	d = exponent < 0 ? d / pow10[-exponent] : d * pow10[exponent];
+	*value = negative ? -d : d;
+
+	return SR_OK;
+
+slow:
+	if (!length || length >= sizeof(buf))
+		return SR_ERR;
+	memcpy(buf, str, length);
+	buf[length] = '\0';
+	d = g_ascii_strtod(buf, &endptr);
+	if (*endptr)
+		return SR_ERR;
+	*value = d;
+
+	return SR_OK;
+}
+
 static char **parse_line(char *buf, struct context *inc, int max_columns)
 {
 	const char *str, *remainder;
 	GSList *list, *l;
 	char **columns;
 	char *column;
-	gsize n, k;
+	gsize k;
 
-	n = 0;
 	k = 0;
 	list = NULL;
 
@@ -314,20 +471,17 @@ static char **parse_line(char *buf, struct context *inc, int max_columns)
 	str = strstr(remainder, inc->delimiter->str);
 
 	while (str && max_columns) {
-		if (n >= inc->first_column) {
-			column = g_strndup(remainder, str - remainder);
-			list = g_slist_prepend(list, g_strstrip(column));
+		column = g_strndup(remainder, str - remainder);
+		list = g_slist_prepend(list, g_strstrip(column));
 
-			max_columns--;
-			k++;
-		}
+		max_columns--;
+		k++;
 
 		remainder = str + inc->delimiter->len;
 		str = strstr(remainder, inc->delimiter->str);
-		n++;
 	}
 
-	if (buf[0] && max_columns && n >= inc->first_column) {
+	if (buf[0] && max_columns) {
 		column = g_strdup(remainder);
 		list = g_slist_prepend(list, g_strstrip(column));
 		k++;
@@ -346,34 +500,20 @@ static char **parse_line(char *buf, struct context *inc, int max_columns)
 	return columns;
 }
 
-static int parse_multi_columns(char **columns, struct context *inc)
+static gboolean is_analog_column(const struct context *inc, unsigned int column)
 {
-	gsize i;
-	char *column;
-
-	/* Clear buffer in order to set bits only. */
-	memset(inc->sample_buffer, 0, inc->sample_unit_size);
+	unsigned int i;
 
-	for (i = 0; i < inc->num_channels; i++) {
-		column = columns[i];
-		if (column[0] == '1') {
-			inc->sample_buffer[i / 8] |= (1 << (i % 8));
-		} else if (!strlen(column)) {
-			sr_err("Column %zu in line %zu is empty.",
-				inc->first_channel + i, inc->line_number);
-			return SR_ERR;
-		} else if (column[0] != '0') {
-			sr_err("Invalid value '%s' in column %zu in line %zu.",
-				column, inc->first_channel + i,
-				inc->line_number);
-			return SR_ERR;
-		}
+	for (i = 0; i < inc->num_analog; i++) {
+		if (inc->analog[i].column == column)
+			return TRUE;
 	}
 
-	return SR_OK;
+	return FALSE;
 }
 
-static int parse_single_column(const char *column, struct context *inc)
+static int parse_single_column(const char *column, gsize length,
+	struct context *inc)
 {
 	int res;
 
@@ -381,43 +521,141 @@ static int parse_single_column(const char *column, struct context *inc)
 
 	switch (inc->format) {
 	case FORMAT_BIN:
-		res = parse_binstr(column, inc);
+		res = parse_binstr(column, length, inc);
 		break;
 	case FORMAT_HEX:
-		res = parse_hexstr(column, inc);
+		res = parse_hexstr(column, length, inc);
 		break;
 	case FORMAT_OCT:
-		res = parse_octstr(column, inc);
+		res = parse_octstr(column, length, inc);
 		break;
 	}
 
 	return res;
 }
 
+/*
+ * Parse the columns of a line in a single pass, up to the last one which
+ * holds data. Analog values go straight to their channel's queue, logic
+ * data gets assembled in the sample buffer.
+ */
+static int parse_columns(const char *line, gsize length, struct context *inc)
+{
+	const char *pos, *column;
+	gsize column_length;
+	unsigned int n, i, k;
+	gboolean have_single;
+	float *value;
+
+	/* Clear buffer in order to set bits only. */
+	if (inc->multi_column_mode && inc->sample_unit_size)
+		memset(inc->sample_buffer, 0, inc->sample_unit_size);
+
+	pos = line;
+	i = 0;
+	k = 0;
+	have_single = FALSE;
+	for (n = 0; n <= inc->last_column; n++) {
+		if (!next_column(inc, &pos, line + length, &column, &column_length))
+			break;
+
+		if (k < inc->num_analog && inc->analog[k].column == n) {
+			value = &inc->analog[k].buffer[inc->queued_samples];
+			if (parse_float(column, column_length, value) != SR_OK) {
+				sr_err("Invalid analog value '%.*s' in column %u in line %zu.",
+					(int)column_length, column, n,
+					inc->line_number);
+				return SR_ERR;
+			}
+			k++;
+		} else if (!inc->multi_column_mode) {
+			if (n != inc->first_column)
+				continue;
+			if (parse_single_column(column, column_length, inc) != SR_OK)
+				return SR_ERR;
+			have_single = TRUE;
+		} else if (n >= inc->first_column && i < inc->num_channels) {
+			if (column_length && column[0] == '1') {
+				inc->sample_buffer[i / 8] |= (1 << (i % 8));
+			} else if (!column_length) {
+				sr_err("Column %u in line %zu is empty.",
+					n, inc->line_number);
+				return SR_ERR;
+			} else if (column[0] != '0') {
+				sr_err("Invalid value '%.*s' in column %u in line %zu.",
+					(int)column_length, column, n,
+					inc->line_number);
+				return SR_ERR;
+			}
+			i++;
+		}
+	}
+
+	if (inc->multi_column_mode ? i < inc->num_channels : !have_single) {
+		if (!i)
+			sr_err("Column %u in line %zu is out of bounds.",
+				inc->first_column, inc->line_number);
+		else
+			sr_err("Not enough columns for desired number of channels in line %zu.",
+				inc->line_number);
+		return SR_ERR;
+	}
+	if (k < inc->num_analog) {
+		sr_err("Column %u in line %zu is out of bounds.",
+			inc->analog[k].column, inc->line_number);
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
 static int flush_samples(const struct sr_input *in)
 {
 	struct context *inc;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	unsigned int i;
 	int rc;
 
 	inc = in->priv;
-	if (!inc->datafeed_buf_fill)
+	if (!inc->queued_samples)
 		return SR_OK;
 
-	memset(&packet, 0, sizeof(packet));
-	memset(&logic, 0, sizeof(logic));
-	packet.type = SR_DF_LOGIC;
-	packet.payload = &logic;
-	logic.unitsize = inc->sample_unit_size;
-	logic.length = inc->datafeed_buf_fill;
-	logic.data = inc->datafeed_buffer;
+	if (inc->sample_unit_size) {
+		memset(&packet, 0, sizeof(packet));
+		memset(&logic, 0, sizeof(logic));
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		logic.unitsize = inc->sample_unit_size;
+		logic.length = inc->queued_samples * inc->sample_unit_size;
+		logic.data = inc->datafeed_buffer;
+
+		rc = sr_session_send(in->sdi, &packet);
+		if (rc != SR_OK)
+			return rc;
+	}
 
-	rc = sr_session_send(in->sdi, &packet);
-	if (rc != SR_OK)
-		return rc;
+	for (i = 0; i < inc->num_analog; i++) {
+		sr_analog_init(&analog, &encoding, &meaning, &spec, ANALOG_DIGITS);
+		packet.type = SR_DF_ANALOG;
+		packet.payload = &analog;
+		analog.num_samples = inc->queued_samples;
+		analog.data = inc->analog[i].buffer;
+		analog.meaning->channels = inc->analog[i].channels;
+		analog.meaning->mq = 0;
+		analog.meaning->mqflags = 0;
+		analog.meaning->unit = 0;
+
+		rc = sr_session_send(in->sdi, &packet);
+		if (rc != SR_OK)
+			return rc;
+	}
 
-	inc->datafeed_buf_fill = 0;
+	inc->queued_samples = 0;
 	return SR_OK;
 }
 
@@ -428,13 +666,66 @@ static int queue_samples(const struct sr_input *in)
 
 	inc = in->priv;
 
-	inc->datafeed_buf_fill += inc->sample_unit_size;
-	if (inc->datafeed_buf_fill == inc->datafeed_buf_size) {
+	inc->queued_samples++;
+	if (inc->queued_samples == inc->samples_per_chunk) {
 		rc = flush_samples(in);
 		if (rc != SR_OK)
 			return rc;
 	}
-	inc->sample_buffer = &inc->datafeed_buffer[inc->datafeed_buf_fill];
+	inc->sample_buffer = &inc->datafeed_buffer[
+		inc->queued_samples * inc->sample_unit_size];
+	return SR_OK;
+}
+
+static int compare_analog_columns(const void *a, const void *b)
+{
+	const struct analog_column *ca, *cb;
+
+	ca = a;
+	cb = b;
+
+	return (ca->column > cb->column) - (ca->column < cb->column);
+}
+
+/* Get the analog columns from a list like "3,4" and sort them. */
+static int parse_analog_columns(struct context *inc, const char *spec)
+{
+	char **fields, *end;
+	unsigned long column;
+	unsigned int i, n;
+
+	fields = g_strsplit_set(spec, ", ", 0);
+	inc->analog = g_malloc0(sizeof(*inc->analog) * (g_strv_length(fields) + 1));
+	n = 0;
+	for (i = 0; fields[i]; i++) {
+		if (!fields[i][0])
+			continue;
+		column = strtoul(fields[i], &end, 10);
+		if (*end || column > G_MAXINT) {
+			sr_err("Invalid analog column '%s'.", fields[i]);
+			g_strfreev(fields);
+			return SR_ERR_ARG;
+		}
+		inc->analog[n++].column = column;
+	}
+	g_strfreev(fields);
+	inc->num_analog = n;
+
+	qsort(inc->analog, n, sizeof(*inc->analog), compare_analog_columns);
+	for (i = 0; i < n; i++) {
+		if (i && inc->analog[i].column == inc->analog[i - 1].column) {
+			sr_err("Analog column %u specified twice.",
+				inc->analog[i].column);
+			return SR_ERR_ARG;
+		}
+		if (!inc->multi_column_mode
+				&& inc->analog[i].column == inc->single_column) {
+			sr_err("Column %u cannot hold both logic and analog data.",
+				inc->analog[i].column);
+			return SR_ERR_ARG;
+		}
+	}
+
 	return SR_OK;
 }
 
@@ -501,7 +792,8 @@ static int init(struct sr_input *in, GHashTable *options)
 		return SR_ERR_ARG;
 	}
 
-	return SR_OK;
+	s = g_variant_get_string(g_hash_table_lookup(options, "analog-columns"), NULL);
+	return parse_analog_columns(inc, s);
 }
 
 static const char *delim_set = "\r\n";
@@ -525,10 +817,12 @@ static int initial_parse(const struct sr_input *in, GString *buf)
 {
 	struct context *inc;
 	GString *channel_name;
-	unsigned int num_columns, i;
+	struct sr_channel *ch;
+	unsigned int num_columns, logic_columns, i, n;
 	size_t line_number, l;
 	int ret;
-	char **lines, *line, **columns, *column;
+	char **lines, *line, **columns;
+	const char *column;
 
 	ret = SR_OK;
 	inc = in->priv;
@@ -575,20 +869,35 @@ static int initial_parse(const struct sr_input *in, GString *buf)
 	num_columns = g_strv_length(columns);
 
 	/* Ensure that the first column is not out of bounds. */
-	if (!num_columns) {
+	if (num_columns <= inc->first_column) {
 		sr_err("Column %u in line %zu is out of bounds.",
 			inc->first_column, line_number);
 		ret = SR_ERR;
 		goto out;
 	}
+	for (i = 0; i < inc->num_analog; i++) {
+		if (inc->analog[i].column >= num_columns) {
+			sr_err("Column %u in line %zu is out of bounds.",
+				inc->analog[i].column, line_number);
+			ret = SR_ERR;
+			goto out;
+		}
+	}
 
 	if (inc->multi_column_mode) {
+		/* Logic channels use the columns which are not analog. */
+		logic_columns = 0;
+		for (n = inc->first_column; n < num_columns; n++) {
+			if (!is_analog_column(inc, n))
+				logic_columns++;
+		}
+
 		/*
 		 * Detect the number of channels in multi column mode
 		 * automatically if not specified.
 		 */
 		if (!inc->num_channels) {
-			inc->num_channels = num_columns;
+			inc->num_channels = logic_columns;
 			sr_dbg("Number of auto-detected channels: %u.",
 				inc->num_channels);
 		}
@@ -597,7 +906,7 @@ static int initial_parse(const struct sr_input *in, GString *buf)
 		 * Ensure that the number of channels does not exceed the number
 		 * of columns in multi column mode.
 		 */
-		if (num_columns < inc->num_channels) {
+		if (logic_columns < inc->num_channels) {
 			sr_err("Not enough columns for desired number of channels in line %zu.",
 				line_number);
 			ret = SR_ERR;
@@ -606,14 +915,35 @@ static int initial_parse(const struct sr_input *in, GString *buf)
 	}
 
 	channel_name = g_string_sized_new(64);
+	inc->last_column = inc->first_column;
+	n = inc->first_column;
 	for (i = 0; i < inc->num_channels; i++) {
-		column = columns[i];
-		if (inc->header && inc->multi_column_mode && column[0] != '\0')
+		if (inc->multi_column_mode) {
+			while (is_analog_column(inc, n))
+				n++;
+			inc->last_column = n;
+			column = columns[n++];
+		} else {
+			column = "";
+		}
+		if (inc->header && column[0] != '\0')
 			g_string_assign(channel_name, column);
 		else
 			g_string_printf(channel_name, "%u", i);
 		sr_channel_new(in->sdi, i, SR_CHANNEL_LOGIC, TRUE, channel_name->str);
 	}
+	for (i = 0; i < inc->num_analog; i++) {
+		n = inc->analog[i].column;
+		column = columns[n];
+		if (inc->header && column[0] != '\0')
+			g_string_assign(channel_name, column);
+		else
+			g_string_printf(channel_name, "%u", inc->num_channels + i);
+		ch = sr_channel_new(in->sdi, inc->num_channels + i,
+			SR_CHANNEL_ANALOG, TRUE, channel_name->str);
+		inc->analog[i].channels = g_slist_append(NULL, ch);
+		inc->last_column = MAX(inc->last_column, n);
+	}
 	g_string_free(channel_name, TRUE);
 
 	/*
@@ -621,14 +951,20 @@ static int initial_parse(const struct sr_input *in, GString *buf)
 	 * of all channels (unit size). Determine a larger buffer size
 	 * for datafeed submission that is a multiple of the unit size.
 	 * Allocate the larger buffer, and have the "sample buffer" point
-	 * to a location within that large buffer.
+	 * to a location within that large buffer. Analog values get
+	 * queued per channel, and are sent along with the logic data.
+	 * Limit the number of samples per chunk for them, a float per
+	 * channel and sample quickly takes more memory than the bits.
 	 */
 	inc->sample_unit_size = (inc->num_channels + 7) / 8;
-	inc->datafeed_buf_size = CHUNK_SIZE;
-	inc->datafeed_buf_size *= inc->sample_unit_size;
-	inc->datafeed_buffer = g_malloc(inc->datafeed_buf_size);
-	inc->datafeed_buf_fill = 0;
-	inc->sample_buffer = &inc->datafeed_buffer[inc->datafeed_buf_fill];
+	inc->samples_per_chunk = CHUNK_SIZE;
+	if (inc->num_analog)
+		inc->samples_per_chunk /= inc->num_analog * sizeof(float);
+	inc->datafeed_buffer = g_malloc(inc->samples_per_chunk * inc->sample_unit_size);
+	inc->queued_samples = 0;
+	inc->sample_buffer = inc->datafeed_buffer;
+	for (i = 0; i < inc->num_analog; i++)
+		inc->analog[i].buffer = g_malloc(inc->samples_per_chunk * sizeof(float));
 
 out:
 	if (columns)
@@ -685,6 +1021,7 @@ static int initial_receive(const struct sr_input *in)
 	g_string_append_c(new_buf, '\0');
 
 	inc->termination = g_strdup(termination);
+	inc->line_end = termination[strlen(termination) - 1];
 
 	if (in->buf->str[0] != '\0')
 		ret = initial_parse(in, new_buf);
@@ -696,16 +1033,68 @@ static int initial_receive(const struct sr_input *in)
 	return ret;
 }
 
+/* Process a text line, which is not NUL terminated. */
+static int process_line(const struct sr_input *in, const char *line,
+	gsize length)
+{
+	struct context *inc;
+	const char *comment;
+	int ret;
+
+	inc = in->priv;
+
+	while (length && g_ascii_isspace(line[0])) {
+		line++;
+		length--;
+	}
+	if (!length) {
+		sr_spew("Blank line %zu skipped.", inc->line_number);
+		return SR_OK;
+	}
+
+	/* Remove trailing comment. */
+	if (inc->comment->len) {
+		comment = find_str(line, length,
+			inc->comment->str, inc->comment->len);
+		if (comment)
+			length = comment - line;
+	}
+	if (!length) {
+		sr_spew("Comment-only line %zu skipped.", inc->line_number);
+		return SR_OK;
+	}
+
+	/* Skip the header line, its content was used as the channel names. */
+	if (inc->header) {
+		sr_spew("Header line %zu skipped.", inc->line_number);
+		inc->header = FALSE;
+		return SR_OK;
+	}
+
+	ret = parse_columns(line, length, inc);
+	if (ret != SR_OK)
+		return SR_ERR;
+
+	/* Send sample data to the session bus. */
+	ret = queue_samples(in);
+	if (ret != SR_OK) {
+		sr_err("Sending samples failed.");
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
 static int process_buffer(struct sr_input *in, gboolean is_eof)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
 	struct sr_config *src;
 	struct context *inc;
-	gsize num_columns;
 	uint64_t samplerate;
-	int max_columns, ret, l;
-	char *p, **lines, *line, **columns;
+	gsize length;
+	int ret;
+	char *p, *pos, *end, *eol;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -725,12 +1114,6 @@ static int process_buffer(struct sr_input *in, gboolean is_eof)
 		inc->started = TRUE;
 	}
 
-	/* Limit the number of columns to parse. */
-	if (inc->multi_column_mode)
-		max_columns = inc->num_channels;
-	else
-		max_columns = 1;
-
 	/*
 	 * Consider empty input non-fatal. Keep accumulating input until
 	 * at least one full text line has become available. Grab the
@@ -747,88 +1130,34 @@ static int process_buffer(struct sr_input *in, gboolean is_eof)
 	if (!in->buf->len)
 		return SR_OK;
 	if (is_eof) {
-		p = in->buf->str + in->buf->len;
+		end = p = in->buf->str + in->buf->len;
 	} else {
-		p = g_strrstr_len(in->buf->str, in->buf->len, inc->termination);
-		if (!p)
+		end = g_strrstr_len(in->buf->str, in->buf->len, inc->termination);
+		if (!end)
 			return SR_ERR;
-		*p = '\0';
-		p += strlen(inc->termination);
+		p = end + strlen(inc->termination);
 	}
-	g_strstrip(in->buf->str);
 
+	/*
+	 * Walk the lines in place. Lines end at the last character of the
+	 * termination sequence, a CR before an LF gets dropped.
+	 */
 	ret = SR_OK;
-	lines = g_strsplit_set(in->buf->str, delim_set, 0);
-	for (l = 0; lines[l]; l++) {
-		inc->line_number++;
-		line = lines[l];
-		if (line[0] == '\0') {
-			sr_spew("Blank line %zu skipped.", inc->line_number);
-			continue;
-		}
+	for (pos = in->buf->str; pos < end; pos = eol + 1) {
+		eol = memchr(pos, inc->line_end, end - pos);
+		if (!eol)
+			eol = end;
+		length = eol - pos;
+		if (length && pos[length - 1] == '\r')
+			length--;
 
-		/* Remove trailing comment. */
-		strip_comment(line, inc->comment);
-		if (line[0] == '\0') {
-			sr_spew("Comment-only line %zu skipped.", inc->line_number);
-			continue;
-		}
-
-		/* Skip the header line, its content was used as the channel names. */
-		if (inc->header) {
-			sr_spew("Header line %zu skipped.", inc->line_number);
-			inc->header = FALSE;
-			continue;
-		}
-
-		columns = parse_line(line, inc, max_columns);
-		if (!columns) {
-			sr_err("Error while parsing line %zu.", inc->line_number);
-			g_strfreev(lines);
-			return SR_ERR;
-		}
-		num_columns = g_strv_length(columns);
-		if (!num_columns) {
-			sr_err("Column %u in line %zu is out of bounds.",
-				inc->first_column, inc->line_number);
-			g_strfreev(columns);
-			g_strfreev(lines);
-			return SR_ERR;
-		}
-		/*
-		 * Ensure that the number of channels does not exceed the number
-		 * of columns in multi column mode.
-		 */
-		if (inc->multi_column_mode && num_columns < inc->num_channels) {
-			sr_err("Not enough columns for desired number of channels in line %zu.",
-				inc->line_number);
-			g_strfreev(columns);
-			g_strfreev(lines);
-			return SR_ERR;
-		}
-
-		if (inc->multi_column_mode)
-			ret = parse_multi_columns(columns, inc);
-		else
-			ret = parse_single_column(columns[0], inc);
-		if (ret != SR_OK) {
-			g_strfreev(columns);
-			g_strfreev(lines);
-			return SR_ERR;
-		}
-
-		/* Send sample data to the session bus. */
-		ret = queue_samples(in);
-		if (ret != SR_OK) {
-			sr_err("Sending samples failed.");
-			g_strfreev(columns);
-			g_strfreev(lines);
-			return SR_ERR;
-		}
-
-		g_strfreev(columns);
+		inc->line_number++;
+		ret = process_line(in, pos, length);
+		if (ret != SR_OK)
+			return ret;
 	}
-	g_strfreev(lines);
+
+	/* Only the incomplete last line remains in the buffer. */
 	g_string_erase(in->buf, 0, p - in->buf->str);
 
 	return ret;
@@ -883,6 +1212,27 @@ static int end(struct sr_input *in)
 	return ret;
 }
 
+/* Release the state of an import, keep the settings from the options. */
+static void release_import(struct context *inc)
+{
+	unsigned int i;
+
+	g_free(inc->termination);
+	inc->termination = NULL;
+	g_free(inc->datafeed_buffer);
+	inc->datafeed_buffer = NULL;
+	inc->sample_buffer = NULL;
+	inc->queued_samples = 0;
+	inc->line_number = 0;
+
+	for (i = 0; i < inc->num_analog; i++) {
+		g_slist_free(inc->analog[i].channels);
+		inc->analog[i].channels = NULL;
+		g_free(inc->analog[i].buffer);
+		inc->analog[i].buffer = NULL;
+	}
+}
+
 static void cleanup(struct sr_input *in)
 {
 	struct context *inc;
@@ -895,15 +1245,18 @@ static void cleanup(struct sr_input *in)
 	if (inc->comment)
 		g_string_free(inc->comment, TRUE);
 
-	g_free(inc->termination);
-	g_free(inc->datafeed_buffer);
+	release_import(inc);
+	g_free(inc->analog);
+	inc->analog = NULL;
+	inc->num_analog = 0;
 }
 
 static int reset(struct sr_input *in)
 {
 	struct context *inc = in->priv;
 
-	cleanup(in);
+	/* The analog columns stay, the next import uses them again. */
+	release_import(inc);
 	inc->started = FALSE;
 	g_string_truncate(in->buf, 0);
 
@@ -920,6 +1273,7 @@ static struct sr_option options[] = {
 	{ "first-channel", "First channel", "The column number of the first channel (multi-col. mode); bit position for the first channel (single-col. mode)", NULL, NULL },
 	{ "header", "Interpret first line as header (multi-col. mode)", "Treat the first line as header with channel names (multi-col. mode)", NULL, NULL },
 	{ "startline", "Start line", "The line number at which to start processing samples (>= 1)", NULL, NULL },
+	{ "analog-columns", "Analog columns", "Comma separated column numbers which hold analog values", NULL, NULL },
 	ALL_ZERO
 };
 
@@ -942,6 +1296,7 @@ static const struct sr_option *get_options(void)
 		options[6].def = g_variant_ref_sink(g_variant_new_int32(0));
 		options[7].def = g_variant_ref_sink(g_variant_new_boolean(FALSE));
 		options[8].def = g_variant_ref_sink(g_variant_new_int32(1));
+		options[9].def = g_variant_ref_sink(g_variant_new_string(""));
 	}
 
 	return options;
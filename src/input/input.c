@@ -31,6 +31,15 @@
 
 #define CHUNK_SIZE	(4 * 1024 * 1024)
 
+/*
+ * Modules report this confidence for matches on magic signatures, it's
+ * the best match any module reports. Scans stop when they see it.
+ */
+#define CONFIDENCE_CERTAIN	1
+
+/* The part of a file which is enough to check signatures. */
+#define SIGNATURE_SIZE	4096
+
 /**
  * @file
  *
@@ -64,6 +73,7 @@
 extern SR_PRIV struct sr_input_module input_chronovu_la8;
 extern SR_PRIV struct sr_input_module input_csv;
 extern SR_PRIV struct sr_input_module input_binary;
+extern SR_PRIV struct sr_input_module input_binary_lz4;
 extern SR_PRIV struct sr_input_module input_trace32_ad;
 extern SR_PRIV struct sr_input_module input_vcd;
 extern SR_PRIV struct sr_input_module input_wav;
@@ -74,6 +84,7 @@ extern SR_PRIV struct sr_input_module input_null;
 
 static const struct sr_input_module *input_module_list[] = {
 	&input_binary,
+	&input_binary_lz4,
 	&input_chronovu_la8,
 	&input_csv,
 	&input_trace32_ad,
@@ -336,6 +347,118 @@ static gboolean check_required_metadata(const uint8_t *metadata, uint8_t *avail)
 	return TRUE;
 }
 
+/* Returns the position after a leading UTF-8 BOM and whitespace. */
+static size_t skip_leading_space(const GString *header)
+{
+	size_t pos;
+
+	pos = 0;
+	if (header->len >= 3 && !memcmp(header->str, "\xef\xbb\xbf", 3))
+		pos = 3;
+	while (pos < header->len && g_ascii_isspace(header->str[pos]))
+		pos++;
+
+	return pos;
+}
+
+/* Returns TRUE if the header contains all of the module's signatures. */
+static gboolean check_magic(const struct sr_input_module *imod,
+	const GString *header)
+{
+	const struct sr_input_magic *magic;
+	size_t pos, len;
+
+	if (!imod->magic)
+		return TRUE;
+
+	for (magic = imod->magic; magic->text; magic++) {
+		pos = magic->offset;
+		if (magic->after_space) {
+			/* Cannot tell when there is nothing but whitespace. */
+			if (skip_leading_space(header) == header->len)
+				return TRUE;
+			pos += skip_leading_space(header);
+		}
+		len = strlen(magic->text);
+		if (pos + len > header->len)
+			return FALSE;
+		if (memcmp(header->str + pos, magic->text, len) != 0)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Returns TRUE if the module inspects the header to identify streams. */
+static gboolean use_header(const struct sr_input_module *imod)
+{
+	size_t m;
+
+	for (m = 0; m < sizeof(imod->metadata); m++) {
+		if ((imod->metadata[m] & ~SR_INPUT_META_REQUIRED) == SR_INPUT_META_HEADER)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Returns TRUE if the module is registered for the file's extension. */
+static gboolean check_extension(const struct sr_input_module *imod,
+	const char *filename)
+{
+	const char *ext;
+	size_t i;
+
+	if (!imod->exts || !filename)
+		return FALSE;
+	ext = strrchr(filename, '.');
+	if (!ext)
+		return FALSE;
+	ext++;
+	for (i = 0; imod->exts[i]; i++) {
+		if (g_ascii_strcasecmp(ext, imod->exts[i]) == 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*
+ * Determine the order in which to try the input modules, returns the
+ * number of modules in 'ranked'. Modules whose signatures are missing
+ * from the header are left out, their format_match() routine would
+ * not find a match anyway. Modules which are registered for the file
+ * name's extension are tried first, so that scans can stop early
+ * when they match.
+ */
+static size_t rank_modules(const GString *header, const char *filename,
+	const struct sr_input_module **ranked)
+{
+	const struct sr_input_module *imod;
+	size_t i, count, pass;
+
+	count = 0;
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; input_module_list[i]; i++) {
+			imod = input_module_list[i];
+			if (!imod->metadata[0]) {
+				/* Module has no metadata for matching so will take
+				 * any input. No point in letting it try to match. */
+				continue;
+			}
+			if (check_extension(imod, filename) != (pass == 0))
+				continue;
+			if (!check_magic(imod, header)) {
+				sr_spew("Skipping module %s, no signature.", imod->id);
+				continue;
+			}
+			ranked[count++] = imod;
+		}
+	}
+
+	return count;
+}
+
 /**
  * Try to find an input module that can parse the given buffer.
  *
@@ -350,6 +473,10 @@ static gboolean check_required_metadata(const uint8_t *metadata, uint8_t *avail)
  * support for the format, the one with highest confidence takes
  * precedence. Applications will see at most one input module spec.
  *
+ * Modules which cannot handle the buffer's content according to their
+ * signatures don't get asked, and the scan ends at the first match of
+ * the highest possible confidence.
+ *
  * If an instance is created, it has the given buffer used for scanning
  * already submitted to it, to be processed before more data is sent.
  * This allows a frontend to submit an initial chunk of a non-seekable
@@ -360,8 +487,10 @@ static gboolean check_required_metadata(const uint8_t *metadata, uint8_t *avail)
 SR_API int sr_input_scan_buffer(GString *buf, const struct sr_input **in)
 {
 	const struct sr_input_module *imod, *best_imod;
+	const struct sr_input_module *ranked[G_N_ELEMENTS(input_module_list)];
 	GHashTable *meta;
-	unsigned int m, i;
+	unsigned int m;
+	size_t i, count;
 	unsigned int conf, best_conf;
 	int ret;
 	uint8_t mitem, avail_metadata[8];
@@ -373,13 +502,9 @@ SR_API int sr_input_scan_buffer(GString *buf, const struct sr_input **in)
 	*in = NULL;
 	best_imod = NULL;
 	best_conf = ~0;
-	for (i = 0; input_module_list[i]; i++) {
-		imod = input_module_list[i];
-		if (!imod->metadata[0]) {
-			/* Module has no metadata for matching so will take
-			 * any input. No point in letting it try to match. */
-			continue;
-		}
+	count = rank_modules(buf, NULL, ranked);
+	for (i = 0; i < count && best_conf > CONFIDENCE_CERTAIN; i++) {
+		imod = ranked[i];
 		if (!check_required_metadata(imod->metadata, avail_metadata))
 			/* Cannot satisfy this module's requirements. */
 			continue;
@@ -434,16 +559,23 @@ SR_API int sr_input_scan_buffer(GString *buf, const struct sr_input **in)
  * support for the format, the one with highest confidence takes
  * precedence. Applications will see at most one input module spec.
  *
+ * Modules which cannot handle the file according to their signatures
+ * don't get asked. Modules which are registered for the file's name
+ * extension get asked first, and win over other modules which claim
+ * the same confidence. The scan ends at the first match of the highest
+ * possible confidence.
+ *
  */
 SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in)
 {
 	int64_t filesize;
 	FILE *stream;
 	const struct sr_input_module *imod, *best_imod;
+	const struct sr_input_module *ranked[G_N_ELEMENTS(input_module_list)];
 	GHashTable *meta;
 	GString *header;
-	size_t count;
-	unsigned int midx, i;
+	size_t count, ranked_count, i;
+	unsigned int midx;
 	unsigned int conf, best_conf;
 	int ret;
 	uint8_t avail_metadata[8];
@@ -466,16 +598,37 @@ SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in)
 		fclose(stream);
 		return SR_ERR;
 	}
+	/*
+	 * Read the start of the file, and determine the modules to try.
+	 * Only read up to the full header size when one of them inspects
+	 * the header.
+	 */
 	header = g_string_sized_new(CHUNK_SIZE);
-	count = fread(header->str, 1, header->allocated_len - 1, stream);
+	count = fread(header->str, 1, SIGNATURE_SIZE, stream);
 	if (count < 1 || ferror(stream)) {
 		sr_err("Failed to read %s: %s", filename, g_strerror(errno));
 		fclose(stream);
 		g_string_free(header, TRUE);
 		return SR_ERR;
 	}
-	fclose(stream);
 	g_string_set_size(header, count);
+	ranked_count = rank_modules(header, filename, ranked);
+	for (i = 0; i < ranked_count; i++) {
+		if (use_header(ranked[i]))
+			break;
+	}
+	if (i < ranked_count && count == SIGNATURE_SIZE) {
+		count += fread(header->str + count, 1,
+			header->allocated_len - 1 - count, stream);
+		if (ferror(stream)) {
+			sr_err("Failed to read %s: %s", filename, g_strerror(errno));
+			fclose(stream);
+			g_string_free(header, TRUE);
+			return SR_ERR;
+		}
+		g_string_set_size(header, count);
+	}
+	fclose(stream);
 
 	meta = g_hash_table_new(NULL, NULL);
 	g_hash_table_insert(meta, GINT_TO_POINTER(SR_INPUT_META_FILENAME),
@@ -493,13 +646,8 @@ SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in)
 
 	best_imod = NULL;
 	best_conf = ~0;
-	for (i = 0; input_module_list[i]; i++) {
-		imod = input_module_list[i];
-		if (!imod->metadata[0]) {
-			/* Module has no metadata for matching so will take
-			 * any input. No point in letting it try to match. */
-			continue;
-		}
+	for (i = 0; i < ranked_count && best_conf > CONFIDENCE_CERTAIN; i++) {
+		imod = ranked[i];
 		if (!check_required_metadata(imod->metadata, avail_metadata))
 			/* Cannot satisfy this module's requirements. */
 			continue;
@@ -589,6 +737,112 @@ SR_API int sr_input_send(const struct sr_input *in, GString *buf)
 	return in->module->receive((struct sr_input *)in, buf);
 }
 
+/* Feed a range of the mapped file to a module which only takes GStrings. */
+static int send_mapped_chunks(struct sr_input *in, const char *data,
+	size_t length)
+{
+	GString *buf;
+	size_t count;
+	gboolean was_ready;
+	int ret;
+
+	ret = SR_OK;
+	buf = g_string_sized_new(MIN(length, CHUNK_SIZE));
+	while (in->mapping_pos < length) {
+		count = MIN(length - in->mapping_pos, CHUNK_SIZE);
+		g_string_truncate(buf, 0);
+		g_string_append_len(buf, data + in->mapping_pos, count);
+		in->mapping_pos += count;
+
+		was_ready = in->sdi_ready;
+		ret = in->module->receive(in, buf);
+		if (ret != SR_OK || (!was_ready && in->sdi_ready))
+			break;
+	}
+	g_string_free(buf, TRUE);
+
+	return ret;
+}
+
+/**
+ * Send the content of a file to the specified input instance.
+ *
+ * This is an alternative to sr_input_send() for applications which read
+ * input from files. The file gets memory mapped, and input modules which
+ * support it process the data in place without copying it around.
+ * Other modules receive it in chunks like from sr_input_send().
+ *
+ * Like sr_input_send(), this returns the moment the device instance
+ * becomes ready. The application can then examine the device instance
+ * and attach session callbacks, and calls this routine again to send
+ * the remainder of the file, before calling sr_input_end().
+ *
+ * The file gets mapped in the first call, later calls continue with the
+ * same file. The mapping is kept until the input instance gets reset or
+ * freed. This cannot be mixed with sr_input_send() for an instance.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval other Negative error code.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_input_send_file(const struct sr_input *in_ro,
+	const char *filename)
+{
+	struct sr_input *in;
+	GError *error;
+	const char *data;
+	size_t length, used;
+	gboolean was_ready;
+	int ret;
+
+	in = (struct sr_input *)in_ro;	/* "un-const" */
+	if (!in || !in->module || !filename || !filename[0])
+		return SR_ERR_ARG;
+
+	if (!in->mapping) {
+		if (in->buf->len) {
+			sr_err("Input instance already received data.");
+			return SR_ERR_ARG;
+		}
+		error = NULL;
+		in->mapping = g_mapped_file_new(filename, FALSE, &error);
+		if (!in->mapping) {
+			sr_err("Failed to map %s: %s", filename, error->message);
+			g_error_free(error);
+			return SR_ERR;
+		}
+		in->mapping_pos = 0;
+	}
+
+	data = g_mapped_file_get_contents(in->mapping);
+	length = g_mapped_file_get_length(in->mapping);
+	sr_spew("Sending %zu bytes of %s to %s module.",
+		length - in->mapping_pos, filename, in->module->id);
+
+	if (!in->module->receive_mapped)
+		return send_mapped_chunks(in, data, length);
+
+	ret = SR_OK;
+	while (in->mapping_pos < length) {
+		was_ready = in->sdi_ready;
+		used = 0;
+		ret = in->module->receive_mapped(in,
+			(const uint8_t *)data + in->mapping_pos,
+			length - in->mapping_pos, &used);
+		if (ret != SR_OK)
+			break;
+		in->mapping_pos += used;
+		if (!was_ready && in->sdi_ready)
+			break;
+		if (!used)
+			break;
+	}
+
+	return ret;
+}
+
 /**
  * Signal the input module no more data will come.
  *
@@ -639,8 +893,8 @@ SR_API int sr_input_reset(const struct sr_input *in_ro)
 	 * in common logic. This agrees with how input module's receive()
 	 * and end() routines "amend but never seed" the 'in' information.
 	 *
-	 * Void potentially accumulated receive() buffer content, and
-	 * clear the sdi_ready flag. This makes sure that subsequent
+	 * Void potentially accumulated receive() buffer content, drop
+	 * the file mapping, and clear the sdi_ready flag. This makes sure that subsequent
 	 * processing will scan the header again before sample data gets
 	 * interpreted, and stale content from previous calls won't affect
 	 * the result.
@@ -653,6 +907,11 @@ SR_API int sr_input_reset(const struct sr_input *in_ro)
 	if (in->buf)
 		g_string_truncate(in->buf, 0);
 	in->sdi_ready = FALSE;
+	if (in->mapping) {
+		g_mapped_file_unref(in->mapping);
+		in->mapping = NULL;
+	}
+	in->mapping_pos = 0;
 
 	return rc;
 }
@@ -687,6 +946,8 @@ SR_API void sr_input_free(const struct sr_input *in)
 			" unprocessed bytes at free time.", in->buf->len);
 	}
 	g_string_free(in->buf, TRUE);
+	if (in->mapping)
+		g_mapped_file_unref(in->mapping);
 	g_free(in->priv);
 	g_free((gpointer)in);
 }
@@ -104,6 +104,7 @@ struct context {
 	char *sw_version;
 	size_t sw_build;
 	GString *cont_buff;
+	size_t header_scan_pos;
 	size_t channel_count;
 	size_t sample_lines_total;
 	size_t sample_lines_read;
@@ -439,32 +440,37 @@ static int process_inverted_channels(struct context *inc, char **flags)
 	return SR_OK;
 }
 
-static int process_sample_line(struct context *inc, char **values)
+static int process_sample_line(struct context *inc, const char *line)
 {
-	size_t count, idx;
+	size_t idx;
 	struct sample_data_entry *entry;
 	uint64_t mask;
+	const char *comma;
 	long conv_ret;
 	int rc;
 
 	/*
-	 * The 'values' array contains '0'/'1' text representation of
-	 * wire's values, as well as a (a textual representation of a)
-	 * repeat counter for that set of samples.
+	 * The line contains comma separated '0'/'1' text representation
+	 * of wire's values, as well as a (a textual representation of a)
+	 * repeat counter for that set of samples. Values are inspected
+	 * in place, this runs for every line of sample data.
 	 */
-	count = g_strv_length(values);
-	if (count != inc->channel_count + 1)
-		return SR_ERR_DATA;
 	entry = &inc->sample_data_queue[inc->sample_lines_read];
 	entry->bits = 0;
 	mask = UINT64_C(1);
 	for (idx = 0; idx < inc->channel_count; idx++, mask <<= 1) {
-		if (strcmp(values[idx], "1") == 0)
+		comma = strchr(line, ',');
+		if (!comma)
+			return SR_ERR_DATA;
+		if (comma - line == 1 && line[0] == '1')
 			entry->bits |= mask;
-		if (strcmp(values[idx], "U") == 0)
+		if (comma - line == 1 && line[0] == 'U')
 			inc->wires_undefined |= mask;
+		line = comma + 1;
 	}
-	rc = sr_atol(values[inc->channel_count], &conv_ret);
+	if (strchr(line, ','))
+		return SR_ERR_DATA;
+	rc = sr_atol(line, &conv_ret);
 	if (rc != SR_OK)
 		return rc;
 	entry->repeat = conv_ret;
@@ -513,9 +519,7 @@ static int process_keyvalue_line(struct context *inc, char *line)
 	case SAMPLEDATA_DATA_LINES:
 		while (isspace(*line))
 			line++;
-		args = g_strsplit(line, ",", 0);
-		rc = process_sample_line(inc, args);
-		g_strfreev(args);
+		rc = process_sample_line(inc, line);
 		if (rc)
 			return rc;
 		inc->sample_lines_read++;
@@ -658,21 +662,26 @@ static int process_keyvalue_line(struct context *inc, char *line)
 	return SR_OK;
 }
 
-/* Check for, and isolate another line of text input. */
-static int have_text_line(struct sr_input *in, char **line, char **next)
+/*
+ * Check for, and isolate another line of text input, starting at 'pos'
+ * and ending before 'end'.
+ */
+static int have_text_line(char *pos, char *end, char **line, char **next)
 {
-	char *sol_ptr, *eol_ptr;
+	char *eol_ptr;
 
-	if (!in || !in->buf || !in->buf->str)
-		return 0;
-	sol_ptr = in->buf->str;
-	eol_ptr = strstr(sol_ptr, CRLF);
+	eol_ptr = pos;
+	while ((eol_ptr = memchr(eol_ptr, '\n', end - eol_ptr))) {
+		if (eol_ptr > pos && eol_ptr[-1] == '\r')
+			break;
+		eol_ptr++;
+	}
 	if (!eol_ptr)
 		return 0;
 	if (line)
-		*line = sol_ptr;
-	*eol_ptr = '\0';
-	eol_ptr += strlen(CRLF);
+		*line = pos;
+	eol_ptr[-1] = '\0';
+	eol_ptr++;
 	if (next)
 		*next = eol_ptr;
 
@@ -738,33 +747,54 @@ static int process_text_line(struct context *inc, char *line)
 	return rc;
 }
 
-/* Tell whether received data is sufficient for session feed preparation. */
-static int have_header(GString *buf)
+/*
+ * Tell whether received data is sufficient for session feed preparation.
+ * Only searches the text which was not searched before.
+ */
+static int have_header(struct sr_input *in)
 {
 	const char *assumed_last_key = CRLF LAST_KEYWORD CONT_OPEN;
+	struct context *inc;
+	GString *buf;
+	size_t pos;
 
-	if (strstr(buf->str, assumed_last_key))
+	inc = in->priv;
+	buf = in->buf;
+	pos = MIN(inc->header_scan_pos, buf->len);
+	if (g_strstr_len(buf->str + pos, buf->len - pos, assumed_last_key))
 		return TRUE;
 
+	/* The key might start in the last few bytes, check them again. */
+	if (buf->len >= strlen(assumed_last_key))
+		inc->header_scan_pos = buf->len - strlen(assumed_last_key) + 1;
+
 	return FALSE;
 }
 
-/* Process/inspect previously received input data. Get header parameters. */
+/*
+ * Process/inspect previously received input data. Get header parameters.
+ * Lines are walked in place, the processed text gets removed at once.
+ */
 static int parse_header(struct sr_input *in)
 {
 	struct context *inc;
-	char *line, *next;
+	char *pos, *end, *line, *next;
 	int rc;
 
 	inc = in->priv;
-	while (have_text_line(in, &line, &next)) {
+	rc = SR_OK;
+	pos = in->buf->str;
+	end = in->buf->str + in->buf->len;
+	while (have_text_line(pos, end, &line, &next)) {
 		rc = process_text_line(inc, line);
-		g_string_erase(in->buf, 0, next - line);
+		pos = next;
 		if (rc)
-			return rc;
+			break;
 	}
+	g_string_erase(in->buf, 0, pos - in->buf->str);
+	inc->header_scan_pos = 0;
 
-	return SR_OK;
+	return rc;
 }
 
 /* Create sigrok channels and groups. */
@@ -889,14 +919,16 @@ static int send_buffer(struct sr_input *in)
 
 /*
  * Add N copies of the current sample to the buffer. Send the buffer to
- * the session feed when a maximum amount of data was collected.
+ * the session feed when a maximum amount of data was collected. Copies
+ * get filled in by repeatedly doubling the already written range, which
+ * results in a few large copies for long runs of the same sample.
  */
 static int add_samples(struct sr_input *in, uint64_t samples, size_t count)
 {
 	struct context *inc;
 	uint8_t sample_buffer[sizeof(uint64_t)];
 	size_t idx;
-	size_t copy_count;
+	size_t copy_count, fill_size, filled, chunk;
 	uint8_t *p;
 	int rc;
 
@@ -912,11 +944,17 @@ static int add_samples(struct sr_input *in, uint64_t samples, size_t count)
 		count -= copy_count;
 
 		p = inc->feed_buffer + inc->samples_in_buffer * inc->unitsize;
-		while (copy_count-- > 0) {
+		fill_size = copy_count * inc->unitsize;
+		if (inc->unitsize == 1) {
+			memset(p, sample_buffer[0], fill_size);
+		} else {
 			memcpy(p, sample_buffer, inc->unitsize);
-			p += inc->unitsize;
-			inc->samples_in_buffer++;
+			for (filled = inc->unitsize; filled < fill_size; filled += chunk) {
+				chunk = MIN(filled, fill_size - filled);
+				memcpy(p + filled, p, chunk);
+			}
 		}
+		inc->samples_in_buffer += copy_count;
 
 		if (inc->samples_in_buffer == inc->samples_per_chunk) {
 			rc = send_buffer(in);
@@ -1034,12 +1072,17 @@ static int format_match(GHashTable *metadata, unsigned int *confidence)
 	GString *buf, *tmpbuf;
 	int rc;
 	gchar *version, *build;
+	const char *eol;
 
-	/* Get a copy of the start of the file's content. */
+	/*
+	 * Get a copy of the start of the file's content. The first line
+	 * is all that gets inspected, don't copy the complete header.
+	 */
 	buf = g_hash_table_lookup(metadata, GINT_TO_POINTER(SR_INPUT_META_HEADER));
 	if (!buf || !buf->str)
 		return SR_ERR_ARG;
-	tmpbuf = g_string_new_len(buf->str, buf->len);
+	eol = memchr(buf->str, '\n', buf->len);
+	tmpbuf = g_string_new_len(buf->str, eol ? eol - buf->str : buf->len);
 	if (!tmpbuf || !tmpbuf->str)
 		return SR_ERR_MALLOC;
 
@@ -1084,7 +1127,7 @@ static int receive(struct sr_input *in, GString *buf)
 	 */
 	inc = in->priv;
 	if (!inc->got_header) {
-		if (!have_header(in->buf))
+		if (!have_header(in))
 			return SR_OK;
 		rc = parse_header(in);
 		if (rc)
@@ -1193,12 +1236,18 @@ static const struct sr_option *get_options(void)
 	return options;
 }
 
+static const struct sr_input_magic magic[] = {
+	{ 0, "Version" DC1_STR, FALSE },
+	ALL_ZERO
+};
+
 SR_PRIV struct sr_input_module input_logicport = {
 	.id = "logicport",
 	.name = "LogicPort File",
 	.desc = "Intronix LA1034 LogicPort project",
 	.exts = (const char *[]){ "lpf", NULL },
 	.metadata = { SR_INPUT_META_HEADER | SR_INPUT_META_REQUIRED },
+	.magic = magic,
 	.options = get_options,
 	.format_match = format_match,
 	.init = init,
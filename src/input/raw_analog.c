@@ -142,13 +142,36 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int process_buffer(struct sr_input *in)
+static int send_chunk(struct std_pipeline *pl, const uint8_t *data,
+	size_t length, unsigned int slot)
+{
+	struct sr_input *in;
+	struct context *inc;
+
+	(void)slot;
+
+	in = pl->cb_data;
+	inc = in->priv;
+
+	inc->analog.num_samples = length / inc->samplesize;
+	inc->analog.data = (uint8_t *)data;
+
+	return sr_session_send(in->sdi, &inc->packet);
+}
+
+/*
+ * Send the data as analog packets, returns the number of bytes consumed.
+ * Memory mapped input gets read ahead while chunks are sent.
+ */
+static gsize process_data(struct sr_input *in, const char *data, gsize length,
+	gboolean mapped)
 {
 	struct context *inc;
 	struct sr_datafeed_meta meta;
 	struct sr_datafeed_packet packet;
 	struct sr_config *src;
-	unsigned int offset, chunk_size;
+	struct std_pipeline pl;
+	gsize chunk_size;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -168,33 +191,28 @@ static int process_buffer(struct sr_input *in)
 	}
 
 	/* Round down to the last channels * unitsize boundary. */
-	inc->analog.num_samples = CHUNK_SIZE / inc->samplesize;
-	chunk_size = inc->analog.num_samples * inc->samplesize;
-	offset = 0;
-
-	while ((offset + chunk_size) < in->buf->len) {
-		inc->analog.data = in->buf->str + offset;
-		sr_session_send(in->sdi, &inc->packet);
-		offset += chunk_size;
-	}
+	chunk_size = length / inc->samplesize * inc->samplesize;
 
-	inc->analog.num_samples = (in->buf->len - offset) / inc->samplesize;
-	chunk_size = inc->analog.num_samples * inc->samplesize;
-	if (chunk_size > 0) {
-		inc->analog.data = in->buf->str + offset;
-		sr_session_send(in->sdi, &inc->packet);
-		offset += chunk_size;
-	}
+	std_pipeline_init(&pl, (const uint8_t *)data, chunk_size,
+		CHUNK_SIZE / inc->samplesize * inc->samplesize);
+	pl.send = send_chunk;
+	pl.cb_data = in;
+	pl.mapped = mapped;
+	std_pipeline_run(&pl);
 
-	if ((unsigned int)offset < in->buf->len) {
-		/*
-		 * The incoming buffer wasn't processed completely. Stash
-		 * the leftover data for next time.
-		 */
-		g_string_erase(in->buf, 0, offset);
-	} else {
-		g_string_truncate(in->buf, 0);
-	}
+	return chunk_size;
+}
+
+static int process_buffer(struct sr_input *in)
+{
+	gsize used;
+
+	/*
+	 * The incoming buffer may not get processed completely. Stash
+	 * the leftover data for next time.
+	 */
+	used = process_data(in, in->buf->str, in->buf->len, FALSE);
+	g_string_erase(in->buf, 0, used);
 
 	return SR_OK;
 }
@@ -216,6 +234,21 @@ static int receive(struct sr_input *in, GString *buf)
 	return ret;
 }
 
+/* Analog packets point straight into the mapped file. */
+static int receive_mapped(struct sr_input *in, const uint8_t *data,
+	size_t length, size_t *used)
+{
+	if (!in->sdi_ready) {
+		/* sdi is ready, notify frontend. */
+		in->sdi_ready = TRUE;
+		return SR_OK;
+	}
+
+	*used = process_data(in, (const char *)data, length, TRUE);
+
+	return SR_OK;
+}
+
 static int end(struct sr_input *in)
 {
 	struct context *inc;
@@ -285,6 +318,7 @@ SR_PRIV struct sr_input_module input_raw_analog = {
 	.options = get_options,
 	.init = init,
 	.receive = receive,
+	.receive_mapped = receive_mapped,
 	.end = end,
 	.cleanup = cleanup,
 	.reset = reset,
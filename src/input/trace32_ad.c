@@ -30,6 +30,11 @@
  * saved using /QuickCompress, /Compress or /ZIP.
  * As a workaround you may load the file in PowerView
  * using I.LOAD / IPROBE.LOAD and re-save using /NoCompress.
+ *
+ * The start-time and end-time options select a part of the recording
+ * (in seconds, relative to the trigger) to import. For large files
+ * this works best with sr_input_send_file(), which skips over the
+ * records before the range without reading them.
  */
 
 #include <config.h>
@@ -100,10 +105,15 @@ struct context {
 	int32_t last_record;
 	uint64_t samplerate;
 	double timestamp_scale;
+	gboolean have_start_time, have_end_time;
+	double start_time, end_time;
+	uint64_t range_start, range_end;
+	gboolean range_done;
 	GString *out_buf;
+	GString *run_buf;
 };
 
-static int process_header(GString *buf, struct context *inc);
+static int process_header(const char *buf, struct context *inc);
 static void create_channels(struct sr_input *in);
 
 /* Transform non-printable chars to '\xNN' presentation. */
@@ -155,14 +165,37 @@ static int init(struct sr_input *in, GHashTable *options)
 	struct context *inc;
 	int pod;
 	char id[17];
+	const char *range_text;
 
 	in->sdi = g_malloc0(sizeof(struct sr_dev_inst));
 	in->priv = g_malloc0(sizeof(struct context));
 
 	inc = in->priv;
 
+	/* Get the (optional) time range to import, relative to the trigger. */
+	range_text = g_variant_get_string(g_hash_table_lookup(options, "start-time"), NULL);
+	if (range_text && *range_text) {
+		if (sr_atod(range_text, &inc->start_time) != SR_OK) {
+			sr_err("Invalid start time '%s'.", range_text);
+			g_free(in->priv);
+			g_free(in->sdi);
+			return SR_ERR_ARG;
+		}
+		inc->have_start_time = TRUE;
+	}
+	range_text = g_variant_get_string(g_hash_table_lookup(options, "end-time"), NULL);
+	if (range_text && *range_text) {
+		if (sr_atod(range_text, &inc->end_time) != SR_OK) {
+			sr_err("Invalid end time '%s'.", range_text);
+			g_free(in->priv);
+			g_free(in->sdi);
+			return SR_ERR_ARG;
+		}
+		inc->have_end_time = TRUE;
+	}
+
 	/* Calculate the desired timestamp scaling factor. */
-	inc->samplerate = 1000000 *
+	inc->samplerate = SR_MHZ(1) *
 		g_variant_get_uint32(g_hash_table_lookup(options, "samplerate"));
 
 	inc->timestamp_scale = ((1 / TIMESTAMP_RESOLUTION) / (double)inc->samplerate);
@@ -193,7 +226,7 @@ static int format_match(GHashTable *metadata, unsigned int *confidence)
 	int rc;
 
 	buf = g_hash_table_lookup(metadata, GINT_TO_POINTER(SR_INPUT_META_HEADER));
-	rc = process_header(buf, NULL);
+	rc = process_header(buf->str, NULL);
 
 	if (rc != SR_OK)
 		return rc;
@@ -202,7 +235,21 @@ static int format_match(GHashTable *metadata, unsigned int *confidence)
 	return SR_OK;
 }
 
-static int process_header(GString *buf, struct context *inc)
+/* Convert a time relative to the trigger (in seconds) to a timestamp. */
+static uint64_t time_to_timestamp(struct context *inc, double seconds)
+{
+	double timestamp;
+
+	timestamp = inc->trigger_timestamp + seconds / TIMESTAMP_RESOLUTION;
+	if (timestamp <= 0)
+		return 0;
+	if (timestamp >= (double)UINT64_MAX)
+		return UINT64_MAX;
+
+	return (uint64_t)timestamp;
+}
+
+static int process_header(const char *buf, struct context *inc)
 {
 	char *format_name, *format_name_sig;
 	char *p;
@@ -243,7 +290,7 @@ static int process_header(GString *buf, struct context *inc)
 	 * names end on SPACE or CTRL-Z (or NUL). Trim trailing SPACE
 	 * before further processing.
 	 */
-	format_name = g_strndup(buf->str, 32);
+	format_name = g_strndup(buf, 32);
 	p = strchr(format_name, CTRLZ);
 	if (p)
 		*p = '\0';
@@ -283,7 +330,7 @@ static int process_header(GString *buf, struct context *inc)
 		sr_dbg("File says it's \"%s\" -> format type %u.", p, format);
 	g_free(p);
 
-	record_size = R8(buf->str + 56);
+	record_size = R8(buf + 56);
 	device_id = 0;
 
 	if (g_strcmp0(format_name, "trace32 power integrator data") == 0) {
@@ -310,12 +357,12 @@ static int process_header(GString *buf, struct context *inc)
 
 	inc->format       = format;
 	inc->device       = device_id;
-	inc->trigger_timestamp = RL64(buf->str + 32);
-	inc->compression  = R8(buf->str + 48); /* Maps to the enum. */
-	inc->record_mode  = R8(buf->str + 55); /* Maps to the enum. */
+	inc->trigger_timestamp = RL64(buf + 32);
+	inc->compression  = R8(buf + 48); /* Maps to the enum. */
+	inc->record_mode  = R8(buf + 55); /* Maps to the enum. */
 	inc->record_size  = record_size;
-	inc->record_count = RL32(buf->str + 60);
-	inc->last_record  = RL32S(buf->str + 64);
+	inc->record_count = RL32(buf + 60);
+	inc->last_record  = RL32S(buf + 64);
 
 	sr_dbg("Trigger occured at %lf s.",
 		inc->trigger_timestamp * TIMESTAMP_RESOLUTION);
@@ -330,6 +377,17 @@ static int process_header(GString *buf, struct context *inc)
 		return SR_ERR;
 	}
 
+	/* Determine the range of timestamps to import. */
+	inc->range_start = 0;
+	inc->range_end = UINT64_MAX;
+	if (inc->have_start_time)
+		inc->range_start = time_to_timestamp(inc, inc->start_time);
+	if (inc->have_end_time)
+		inc->range_end = time_to_timestamp(inc, inc->end_time);
+	if (inc->have_start_time || inc->have_end_time)
+		sr_dbg("Importing timestamps %" PRIu64 " to %" PRIu64 ".",
+			inc->range_start, inc->range_end);
+
 	inc->header_read = TRUE;
 
 	return SR_OK;
@@ -402,19 +460,81 @@ static void flush_output_buffer(struct sr_input *in)
 	}
 }
 
-static void process_record_pi(struct sr_input *in, gsize start)
+/* Fill 'count' samples at 'p' with the same sample value. */
+static void fill_samples(char *p, const char *sample, size_t unitsize,
+	size_t count)
+{
+	size_t filled, total, chunk;
+
+	/* Double the range which was written so far, few large copies. */
+	total = count * unitsize;
+	memcpy(p, sample, unitsize);
+	for (filled = unitsize; filled < total; filled += chunk) {
+		chunk = MIN(filled, total - filled);
+		memcpy(p + filled, p, chunk);
+	}
+}
+
+/*
+ * Add 'count' copies of a sample to the output. Records which are far
+ * apart in time result in long runs of the same sample value. Send
+ * these runs from a prepared buffer that gets re-used for as long as
+ * the sample value does not change, instead of filling them into the
+ * output buffer.
+ */
+static void add_samples(struct sr_input *in, const char *sample,
+	size_t unitsize, uint64_t count)
 {
+	struct context *inc;
 	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	size_t run_count, room, pos;
+
+	inc = in->priv;
+	run_count = CHUNK_SIZE / unitsize;
+
+	while (count) {
+		if (!inc->out_buf->len && count >= run_count) {
+			if (!inc->run_buf)
+				inc->run_buf = g_string_sized_new(CHUNK_SIZE);
+			if (inc->run_buf->len != run_count * unitsize ||
+					memcmp(inc->run_buf->str, sample, unitsize) != 0) {
+				g_string_set_size(inc->run_buf, run_count * unitsize);
+				fill_samples(inc->run_buf->str, sample, unitsize, run_count);
+			}
+			packet.type = SR_DF_LOGIC;
+			packet.payload = &logic;
+			logic.unitsize = unitsize;
+			logic.data = inc->run_buf->str;
+			logic.length = inc->run_buf->len;
+			sr_session_send(in->sdi, &packet);
+			count -= run_count;
+			continue;
+		}
+
+		room = (CHUNK_SIZE - inc->out_buf->len) / unitsize;
+		if (!room) {
+			flush_output_buffer(in);
+			continue;
+		}
+		if (room > count)
+			room = count;
+		pos = inc->out_buf->len;
+		g_string_set_size(inc->out_buf, pos + room * unitsize);
+		fill_samples(inc->out_buf->str + pos, sample, unitsize, room);
+		count -= room;
+	}
+}
+
+static int decode_record_pi(struct sr_input *in, const char *rec,
+	char *single_payload)
+{
 	struct context *inc;
-	uint64_t timestamp, next_timestamp;
 	uint32_t pod_data;
-	char single_payload[12 * 3];
-	GString *buf;
-	int i, pod_count, clk_offset, packet_count, pod;
+	int i, pod_count, clk_offset, pod;
 	int payload_bit, payload_len, value;
 
 	inc = in->priv;
-	buf = in->buf;
 
 	/*
 	 * 00-07 timestamp
@@ -439,8 +559,6 @@ static void process_record_pi(struct sr_input *in, gsize start)
 	 * 44/27    ??
 	 */
 
-	timestamp = RL64(buf->str + start);
-
 	if (inc->record_mode == AD_MODE_500MHZ) {
 		pod_count = 6;
 		clk_offset = 24;
@@ -459,52 +577,52 @@ static void process_record_pi(struct sr_input *in, gsize start)
 
 		switch (pod) {
 		case 0: /* A */
-			pod_data = RL16(buf->str + start + 8);
-			pod_data |= (RL16(buf->str + start + clk_offset) & 1) << 16;
+			pod_data = RL16(rec + 8);
+			pod_data |= (RL16(rec + clk_offset) & 1) << 16;
 			break;
 		case 1: /* B */
-			pod_data = RL16(buf->str + start + 10);
-			pod_data |= (RL16(buf->str + start + clk_offset) & 2) << 15;
+			pod_data = RL16(rec + 10);
+			pod_data |= (RL16(rec + clk_offset) & 2) << 15;
 			break;
 		case 2: /* C */
-			pod_data = RL16(buf->str + start + 12);
-			pod_data |= (RL16(buf->str + start + clk_offset) & 4) << 14;
+			pod_data = RL16(rec + 12);
+			pod_data |= (RL16(rec + clk_offset) & 4) << 14;
 			break;
 		case 3: /* D */
-			pod_data = RL16(buf->str + start + 14);
-			pod_data |= (RL16(buf->str + start + clk_offset) & 8) << 13;
+			pod_data = RL16(rec + 14);
+			pod_data |= (RL16(rec + clk_offset) & 8) << 13;
 			break;
 		case 4: /* E */
-			pod_data = RL16(buf->str + start + 16);
-			pod_data |= (RL16(buf->str + start + clk_offset) & 16) << 12;
+			pod_data = RL16(rec + 16);
+			pod_data |= (RL16(rec + clk_offset) & 16) << 12;
 			break;
 		case 5: /* F */
-			pod_data = RL16(buf->str + start + 18);
-			pod_data |= (RL16(buf->str + start + clk_offset) & 32) << 11;
+			pod_data = RL16(rec + 18);
+			pod_data |= (RL16(rec + clk_offset) & 32) << 11;
 			break;
 		case 6: /* J */
-			pod_data = RL16(buf->str + start + 24);
-			pod_data |= (RL16(buf->str + start + 41) & 1) << 16;
+			pod_data = RL16(rec + 24);
+			pod_data |= (RL16(rec + 41) & 1) << 16;
 			break;
 		case 7: /* K */
-			pod_data = RL16(buf->str + start + 26);
-			pod_data |= (RL16(buf->str + start + 41) & 2) << 15;
+			pod_data = RL16(rec + 26);
+			pod_data |= (RL16(rec + 41) & 2) << 15;
 			break;
 		case 8: /* L */
-			pod_data = RL16(buf->str + start + 28);
-			pod_data |= (RL16(buf->str + start + 41) & 4) << 14;
+			pod_data = RL16(rec + 28);
+			pod_data |= (RL16(rec + 41) & 4) << 14;
 			break;
 		case 9: /* M */
-			pod_data = RL16(buf->str + start + 30);
-			pod_data |= (RL16(buf->str + start + 41) & 8) << 13;
+			pod_data = RL16(rec + 30);
+			pod_data |= (RL16(rec + 41) & 8) << 13;
 			break;
 		case 10: /* N */
-			pod_data = RL16(buf->str + start + 32);
-			pod_data |= (RL16(buf->str + start + 41) & 16) << 12;
+			pod_data = RL16(rec + 32);
+			pod_data |= (RL16(rec + 41) & 16) << 12;
 			break;
 		case 11: /* O */
-			pod_data = RL16(buf->str + start + 34);
-			pod_data |= (RL16(buf->str + start + 41) & 32) << 11;
+			pod_data = RL16(rec + 34);
+			pod_data |= (RL16(rec + 41) & 32) << 11;
 			break;
 		default:
 			sr_err("Don't know how to obtain data for pod %d.", pod);
@@ -530,91 +648,188 @@ static void process_record_pi(struct sr_input *in, gsize start)
 	i = (g_slist_length(in->sdi->channels) + 7) / 8;
 	if (payload_len != i) {
 		sr_err("Payload unit size is %d but should be %d!", payload_len, i);
-		return;
+		return -1;
 	}
 
-	if (timestamp == inc->trigger_timestamp && !inc->trigger_sent) {
-		sr_dbg("Trigger @%lf s, record #%d.",
-			timestamp * TIMESTAMP_RESOLUTION, inc->cur_record);
-
-		packet.type = SR_DF_TRIGGER;
-		packet.payload = NULL;
-		sr_session_send(in->sdi, &packet);
-		inc->trigger_sent = TRUE;
-	}
-
-	/* Is this the last record in the file? */
-	if (inc->cur_record == inc->record_count - 1) {
-		/* It is, so send the last sample data only once. */
-		g_string_append_len(inc->out_buf, single_payload, payload_len);
-	} else {
-		/* It's not, so fill the time gap by sending lots of data. */
-		next_timestamp = RL64(buf->str + start + inc->record_size);
-		packet_count = (int)(next_timestamp - timestamp) / inc->timestamp_scale;
+	return payload_len;
+}
 
-		/* Make sure we send at least one data set. */
-		if (packet_count == 0)
-			packet_count = 1;
+static int decode_record_iprobe(const char *rec, char *single_payload)
+{
+	/*
+	 * 00-07 timestamp
+	 * 08-09 IP15..0
+	 * 10    CLK
+	 */
 
-		for (i = 0; i < packet_count; i++)
-			g_string_append_len(inc->out_buf, single_payload, payload_len);
-	}
+	single_payload[0] = R8(rec + 8);
+	single_payload[1] = R8(rec + 9);
+	single_payload[2] = R8(rec + 10) & 1;
 
-	if (inc->out_buf->len >= CHUNK_SIZE)
-		flush_output_buffer(in);
+	return 3;
 }
 
-static void process_record_iprobe(struct sr_input *in, gsize start)
+/*
+ * Process the record at 'rec'. The next record is needed to determine
+ * the time until the next change, it's NULL for the file's last record.
+ * Only the part within the selected time range gets imported.
+ */
+static int process_record(struct sr_input *in, const char *rec,
+	const char *next_rec)
 {
 	struct sr_datafeed_packet packet;
 	struct context *inc;
-	uint64_t timestamp, next_timestamp;
-	char single_payload[3];
-	int i, payload_len, packet_count;
+	uint64_t timestamp, next_timestamp, from, to, sample_count;
+	char single_payload[12 * 3];
+	int payload_len;
 
 	inc = in->priv;
 
-	/*
-	 * 00-07 timestamp
-	 * 08-09 IP15..0
-	 * 10    CLK
-	 */
+	timestamp = RL64(rec);
+	next_timestamp = next_rec ? RL64(next_rec) : timestamp;
 
-	timestamp = RL64(in->buf->str + start);
-	single_payload[0] = R8(in->buf->str + start + 8);
-	single_payload[1] = R8(in->buf->str + start + 9);
-	single_payload[2] = R8(in->buf->str + start + 10) & 1;
-	payload_len = 3;
+	/* Skip records before and after the time range. */
+	if (timestamp >= inc->range_end) {
+		inc->range_done = TRUE;
+		return SR_OK;
+	}
+	if (inc->range_start && next_timestamp <= inc->range_start)
+		return SR_OK;
 
-	if (timestamp == inc->trigger_timestamp && !inc->trigger_sent) {
+	switch (inc->device) {
+	case AD_DEVICE_PI:
+		payload_len = decode_record_pi(in, rec, single_payload);
+		break;
+	case AD_DEVICE_IPROBE:
+		payload_len = decode_record_iprobe(rec, single_payload);
+		break;
+	default:
+		sr_err("Trying to process records for unknown device!");
+		return SR_ERR;
+	}
+	if (payload_len < 0)
+		return SR_OK;
+
+	/* A trigger before the start of the time range is not imported. */
+	if (timestamp == inc->trigger_timestamp && !inc->trigger_sent
+			&& timestamp >= inc->range_start) {
 		sr_dbg("Trigger @%lf s, record #%d.",
 			timestamp * TIMESTAMP_RESOLUTION, inc->cur_record);
 
+		/* Samples before the trigger go out first. */
+		flush_output_buffer(in);
 		packet.type = SR_DF_TRIGGER;
 		packet.payload = NULL;
 		sr_session_send(in->sdi, &packet);
 		inc->trigger_sent = TRUE;
 	}
 
-	/* Is this the last record in the file? */
-	if (inc->cur_record == inc->record_count - 1) {
-		/* It is, so send the last sample data only once. */
-		g_string_append_len(inc->out_buf, single_payload, payload_len);
+	if (!next_rec) {
+		/* This is the last record in the file, send its data only once. */
+		sample_count = 1;
+	} else if (next_timestamp < timestamp) {
+		/* Time goes backwards, nothing to fill in. */
+		sample_count = 0;
 	} else {
-		/* It's not, so fill the time gap by sending lots of data. */
-		next_timestamp = RL64(in->buf->str + start + inc->record_size);
-		packet_count = (int)(next_timestamp - timestamp) / inc->timestamp_scale;
+		/* Fill the time gap (within the range) with this record's data. */
+		from = MAX(timestamp, inc->range_start);
+		to = MIN(next_timestamp, inc->range_end);
+		sample_count = (uint64_t)((to - from) / inc->timestamp_scale);
 
 		/* Make sure we send at least one data set. */
-		if (packet_count == 0)
-			packet_count = 1;
+		if (sample_count == 0)
+			sample_count = 1;
+	}
+
+	add_samples(in, single_payload, payload_len, sample_count);
+
+	return SR_OK;
+}
+
+/*
+ * Skip records which end before the start of the time range. Records
+ * have a fixed size and ascending timestamps, which allows to bisect
+ * the records of a buffer instead of inspecting all of them. For
+ * memory mapped files this means that the data before the range is
+ * not read at all. Returns the number of records to skip.
+ */
+static size_t seek_records(struct context *inc, const char *data,
+	size_t count)
+{
+	size_t low, high, mid;
+
+	if (!count || RL64(data) >= inc->range_start)
+		return 0;
+
+	/* Find the last record which starts at or before the range start. */
+	low = 0;
+	high = count;
+	while (high - low > 1) {
+		mid = low + (high - low) / 2;
+		if (RL64(data + mid * inc->record_size) <= inc->range_start)
+			low = mid;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+/*
+ * Process as many records as are available in the buffer. Returns the
+ * number of bytes consumed in 'used'.
+ */
+static int process_records(struct sr_input *in, const char *data,
+	size_t length, size_t *used)
+{
+	struct context *inc;
+	size_t count, skip, pos;
+	const char *next_rec;
+	int rc;
 
-		for (i = 0; i < packet_count; i++)
-			g_string_append_len(inc->out_buf, single_payload, payload_len);
+	inc = in->priv;
+	pos = 0;
+
+	/* Complete records in the buffer, but not beyond the last one. */
+	count = length / inc->record_size;
+	count = MIN(count, inc->record_count - inc->cur_record);
+
+	/* Skip records outside of the time range without inspecting them. */
+	skip = 0;
+	if (inc->range_done)
+		skip = count;
+	else if (inc->range_start && count > 1)
+		skip = seek_records(inc, data, count - 1);
+	if (skip) {
+		inc->cur_record += skip;
+		pos = skip * inc->record_size;
 	}
 
-	if (inc->out_buf->len >= CHUNK_SIZE)
-		flush_output_buffer(in);
+	while (inc->cur_record < inc->record_count) {
+		/* There needs to be one more record to peek into, except for the last one. */
+		if (inc->cur_record == inc->record_count - 1) {
+			if (length - pos < inc->record_size)
+				break;
+			next_rec = NULL;
+		} else {
+			if (length - pos < 2 * inc->record_size)
+				break;
+			next_rec = data + pos + inc->record_size;
+		}
+		if (!inc->range_done) {
+			rc = process_record(in, data + pos, next_rec);
+			if (rc != SR_OK)
+				return rc;
+		}
+		inc->cur_record++;
+		pos += inc->record_size;
+	}
+	if (inc->cur_record == inc->record_count)
+		inc->records_read = TRUE;
+
+	*used = pos;
+
+	return SR_OK;
 }
 
 static void process_practice_token(struct sr_input *in, char *cmd_token)
@@ -702,7 +917,7 @@ static void process_practice(struct sr_input *in)
 	int i;
 
 	/* Gather all input data until we see the end marker. */
-	if (in->buf->str[in->buf->len - 1] != 0x29)
+	if (!in->buf->len || in->buf->str[in->buf->len - 1] != 0x29)
 		return;
 
 	delimiter[0] = 0x0A;
@@ -729,12 +944,16 @@ static void process_practice(struct sr_input *in)
 static int process_buffer(struct sr_input *in)
 {
 	struct context *inc;
-	int i, chunk_size, res;
+	size_t used;
+	int res;
 
 	inc = in->priv;
 
 	if (!inc->header_read) {
-		res = process_header(in->buf, inc);
+		/* Wait for the complete header. */
+		if (in->buf->len < HEADER_SIZE)
+			return SR_OK;
+		res = process_header(in->buf->str, inc);
 		g_string_erase(in->buf, 0, HEADER_SIZE);
 		if (res != SR_OK)
 			return res;
@@ -746,31 +965,10 @@ static int process_buffer(struct sr_input *in)
 	}
 
 	if (!inc->records_read) {
-		/* Cut off at a multiple of the record size. */
-		chunk_size = ((in->buf->len) / inc->record_size) * inc->record_size;
-
-		/* There needs to be at least one more record process_record() can peek into. */
-		chunk_size -= inc->record_size;
-
-		for (i = 0; (i < chunk_size) && (!inc->records_read); i += inc->record_size) {
-			switch (inc->device) {
-			case AD_DEVICE_PI:
-				process_record_pi(in, i);
-				break;
-			case AD_DEVICE_IPROBE:
-				process_record_iprobe(in, i);
-				break;
-			default:
-				sr_err("Trying to process records for unknown device!");
-				return SR_ERR;
-			}
-
-			inc->cur_record++;
-			if (inc->cur_record == inc->record_count)
-				inc->records_read = TRUE;
-		}
-
-		g_string_erase(in->buf, 0, i);
+		res = process_records(in, in->buf->str, in->buf->len, &used);
+		g_string_erase(in->buf, 0, used);
+		if (res != SR_OK)
+			return res;
 	}
 
 	if (inc->records_read) {
@@ -794,6 +992,61 @@ static int receive(struct sr_input *in, GString *buf)
 	return process_buffer(in);
 }
 
+/*
+ * Records get processed in place. Those outside of the time range get
+ * skipped, and are not read from the file.
+ */
+static int receive_mapped(struct sr_input *in, const uint8_t *data,
+	size_t length, size_t *used)
+{
+	struct context *inc;
+	const char *p;
+	size_t pos, count;
+	int res;
+
+	if (!in->sdi_ready) {
+		/* sdi is ready, notify frontend. */
+		in->sdi_ready = TRUE;
+		return SR_OK;
+	}
+
+	inc = in->priv;
+	p = (const char *)data;
+	pos = 0;
+
+	if (!inc->header_read) {
+		if (length < HEADER_SIZE) {
+			sr_err("File is too short for a header.");
+			return SR_ERR_DATA;
+		}
+		res = process_header(p, inc);
+		pos += HEADER_SIZE;
+		if (res != SR_OK)
+			return res;
+	}
+
+	if (!inc->meta_sent) {
+		std_session_send_df_header(in->sdi);
+		send_metadata(in);
+	}
+
+	if (!inc->records_read) {
+		res = process_records(in, p + pos, length - pos, &count);
+		pos += count;
+		if (res != SR_OK)
+			return res;
+	}
+
+	/* Keep the practice commands (or an incomplete record) for later. */
+	g_string_append_len(in->buf, p + pos, length - pos);
+	*used = length;
+
+	if (inc->records_read)
+		process_practice(in);
+
+	return SR_OK;
+}
+
 static int end(struct sr_input *in)
 {
 	struct context *inc;
@@ -814,6 +1067,20 @@ static int end(struct sr_input *in)
 	return ret;
 }
 
+static void cleanup(struct sr_input *in)
+{
+	struct context *inc;
+
+	inc = in->priv;
+
+	if (inc->out_buf)
+		g_string_free(inc->out_buf, TRUE);
+	inc->out_buf = NULL;
+	if (inc->run_buf)
+		g_string_free(inc->run_buf, TRUE);
+	inc->run_buf = NULL;
+}
+
 static int reset(struct sr_input *in)
 {
 	struct context *inc = in->priv;
@@ -822,8 +1089,10 @@ static int reset(struct sr_input *in)
 	inc->header_read = FALSE;
 	inc->records_read = FALSE;
 	inc->trigger_sent = FALSE;
+	inc->range_done = FALSE;
 	inc->cur_record = 0;
 
+	g_string_truncate(inc->out_buf, 0);
 	g_string_truncate(in->buf, 0);
 
 	return SR_OK;
@@ -847,6 +1116,9 @@ static struct sr_option options[] = {
 
 	{ "samplerate", "Reduced sample rate (MHz)", "Reduce the original sample rate of 12.8 GHz to the specified sample rate in MHz", NULL, NULL },
 
+	{ "start-time", "Start time (s)", "Start of the imported time range in seconds, relative to the trigger (empty for the first record)", NULL, NULL },
+	{ "end-time", "End time (s)", "End of the imported time range in seconds, relative to the trigger (empty for the last record)", NULL, NULL },
+
 	ALL_ZERO
 };
 
@@ -866,11 +1138,18 @@ static const struct sr_option *get_options(void)
 		options[10].def = g_variant_ref_sink(g_variant_new_boolean(FALSE));
 		options[11].def = g_variant_ref_sink(g_variant_new_boolean(FALSE));
 		options[12].def = g_variant_ref_sink(g_variant_new_uint32(DEFAULT_SAMPLERATE));
+		options[13].def = g_variant_ref_sink(g_variant_new_string(""));
+		options[14].def = g_variant_ref_sink(g_variant_new_string(""));
 	}
 
 	return options;
 }
 
+static const struct sr_input_magic magic[] = {
+	{ 0, TRACE32, FALSE },
+	ALL_ZERO
+};
+
 SR_PRIV struct sr_input_module input_trace32_ad = {
 	.id = "trace32_ad",
 	.name = "Trace32_ad",
@@ -878,9 +1157,12 @@ SR_PRIV struct sr_input_module input_trace32_ad = {
 	.exts = (const char*[]){"ad", NULL},
 	.options = get_options,
 	.metadata = { SR_INPUT_META_HEADER | SR_INPUT_META_REQUIRED },
+	.magic = magic,
 	.format_match = format_match,
 	.init = init,
 	.receive = receive,
+	.receive_mapped = receive_mapped,
 	.end = end,
+	.cleanup = cleanup,
 	.reset = reset,
 };
@@ -45,16 +45,21 @@
  * Based on Verilog standard IEEE Std 1364-2001 Version C
  *
  * Supported features:
- * - $var with 'wire' and 'reg' types of scalar variables
+ * - $var with 'wire', 'reg', 'integer' and similar types of scalar
+ *   and vector variables, vectors become one logic channel per bit
+ *   and a channel group
+ * - $var with 'real' and 'realtime' types, these become analog channels
  * - $timescale definition for samplerate
  * - multiple character variable identifiers
  *
  * Most important unsupported features:
- * - vector variables (bit vectors etc.)
- * - analog, integer and real number variables
- * - $dumpvars initial value declaration
+ * - 'event' and 'string' variables
  * - $scope namespaces
  * - more than 64 channels
+ *
+ * Large blocks of the data section are split at timestamps and the
+ * pieces get tokenized on several threads. The resulting value changes
+ * are then applied in order, see parse_contents().
  */
 
 #include <config.h>
@@ -69,6 +74,74 @@
 
 #define CHUNK_SIZE (4 * 1024 * 1024)
 
+/*
+ * Identifiers consist of printable ASCII characters. Those of one or two
+ * characters (which covers the first 8930 signals of typical simulator
+ * output) get looked up in a directly indexed table, longer ones in a
+ * hash table.
+ */
+#define IDENT_CHAR_FIRST	'!'
+#define IDENT_CHAR_LAST		'~'
+#define IDENT_CHAR_COUNT	(IDENT_CHAR_LAST - IDENT_CHAR_FIRST + 1)
+#define IDENT_SHORT_SLOTS	(IDENT_CHAR_COUNT * (IDENT_CHAR_COUNT + 1))
+
+/*
+ * The data section gets split into at most this many segments, each of
+ * at least PARSE_SEGMENT_MIN bytes, for parallel tokenization.
+ */
+#define MAX_PARSE_THREADS	8
+#define PARSE_SEGMENT_MIN	(1024 * 1024)
+
+/* Analog values get the precision of a float. */
+#define ANALOG_DIGITS		6
+
+/*
+ * Tokens are delimited by whitespace. Control characters count as
+ * whitespace, which includes the NUL terminators of tokenized data.
+ */
+#define IS_DELIM(c)		((unsigned char)(c) <= ' ')
+
+enum vcd_event_type {
+	EVENT_TIMESTAMP,
+	EVENT_BITS,
+	EVENT_WIDE_BITS,
+	EVENT_REAL,
+	EVENT_END,
+};
+
+/* A tokenized item of the data section, see parse_segment(). */
+struct vcd_event {
+	uint32_t type;
+	uint32_t index;
+	union {
+		uint64_t timestamp;
+		/* Vector values of up to 64 bits, LSB first. */
+		uint64_t bits;
+		/* Wider vector values as text, MSB first. */
+		const char *wide_bits;
+		double real;
+	} value;
+};
+
+struct vcd_segment {
+	const struct context *inc;
+	/* Input to apply events to right away, or NULL to queue them. */
+	const struct sr_input *in;
+	char *data;
+	size_t len;
+	gboolean skip_at_start;
+	gboolean skip_at_end;
+	GArray *events;
+	GThread *thread;
+};
+
+struct vcd_analog {
+	/* The analog channel, as a list for the packet's meaning. */
+	GSList *channels;
+	float value;
+	float *buffer;
+};
+
 struct context {
 	gboolean started;
 	gboolean got_header;
@@ -80,17 +153,34 @@ struct context {
 	unsigned compress;
 	int64_t skip;
 	gboolean skip_until_end;
-	GSList *channels;
+	gboolean ignore_until_end;
+	unsigned int max_threads;
+	GPtrArray *channels;
+	int *ident_short;
+	GHashTable *ident_long;
+	size_t logic_count;
 	size_t bytes_per_sample;
+	size_t samples_per_chunk;
 	size_t samples_in_buffer;
 	uint8_t *buffer;
 	uint8_t *current_levels;
+	size_t analog_count;
+	struct vcd_analog *analogs;
+	struct vcd_segment segments[MAX_PARSE_THREADS];
 	GSList *prev_sr_channels;
 };
 
 struct vcd_channel {
 	gchar *name;
 	gchar *identifier;
+	/* Name of the variable without a bit range, and the range. */
+	gchar *base_name;
+	int lsb;
+	int step;
+	enum sr_channeltype type;
+	size_t size;
+	/* Index of the first logic bit, or of the analog value. */
+	size_t array_index;
 };
 
 /*
@@ -159,6 +249,7 @@ static void free_channel(void *data)
 		return;
 	g_free(vcd_ch->name);
 	g_free(vcd_ch->identifier);
+	g_free(vcd_ch->base_name);
 	g_free(vcd_ch);
 }
 
@@ -176,6 +267,86 @@ static void remove_empty_parts(gchar **parts)
 	*dest = NULL;
 }
 
+/* Get the direct lookup table slot for short identifiers, or -1. */
+static int ident_short_slot(const char *identifier, size_t len)
+{
+	unsigned int c0, c1;
+
+	if (len < 1 || len > 2)
+		return -1;
+
+	c0 = (unsigned char)identifier[0] - IDENT_CHAR_FIRST;
+	if (c0 >= IDENT_CHAR_COUNT)
+		return -1;
+	if (len == 1)
+		return c0;
+
+	c1 = (unsigned char)identifier[1] - IDENT_CHAR_FIRST;
+	if (c1 >= IDENT_CHAR_COUNT)
+		return -1;
+
+	return IDENT_CHAR_COUNT * (c1 + 1) + c0;
+}
+
+/*
+ * Register a channel's identifier. When several variables share an
+ * identifier, the first one wins.
+ */
+static void add_identifier(struct context *inc, const char *identifier,
+	unsigned int index)
+{
+	int slot;
+
+	slot = ident_short_slot(identifier, strlen(identifier));
+	if (slot >= 0) {
+		if (inc->ident_short[slot] < 0)
+			inc->ident_short[slot] = index;
+		return;
+	}
+	if (!g_hash_table_contains(inc->ident_long, identifier))
+		g_hash_table_insert(inc->ident_long, (gpointer)identifier,
+			GUINT_TO_POINTER(index + 1));
+}
+
+/* Find the channel index for an identifier, or -1 if unknown. */
+static int find_identifier(const struct context *inc,
+	const char *identifier, size_t len)
+{
+	int slot;
+
+	slot = ident_short_slot(identifier, len);
+	if (slot >= 0)
+		return inc->ident_short[slot];
+
+	return (int)GPOINTER_TO_UINT(g_hash_table_lookup(inc->ident_long,
+		identifier)) - 1;
+}
+
+static void free_identifiers(struct context *inc)
+{
+	g_free(inc->ident_short);
+	inc->ident_short = NULL;
+	if (inc->ident_long)
+		g_hash_table_destroy(inc->ident_long);
+	inc->ident_long = NULL;
+}
+
+/* The groups of vector bits get created again from the channel list. */
+static void free_channel_groups(struct sr_dev_inst *sdi)
+{
+	struct sr_channel_group *cg;
+	GSList *l;
+
+	for (l = sdi->channel_groups; l; l = l->next) {
+		cg = l->data;
+		g_free(cg->name);
+		g_slist_free(cg->channels);
+		g_free(cg);
+	}
+	g_slist_free(sdi->channel_groups);
+	sdi->channel_groups = NULL;
+}
+
 /*
  * Keep track of a previously created channel list, in preparation of
  * re-reading the input file. Gets called from reset()/cleanup() paths.
@@ -185,6 +356,7 @@ static void keep_header_for_reread(const struct sr_input *in)
 	struct context *inc;
 
 	inc = in->priv;
+	free_channel_groups(in->sdi);
 	g_slist_free_full(inc->prev_sr_channels, sr_channel_free_cb);
 	inc->prev_sr_channels = in->sdi->channels;
 	in->sdi->channels = NULL;
@@ -226,13 +398,186 @@ static int check_header_in_reread(const struct sr_input *in)
 	return TRUE;
 }
 
+/*
+ * Get the bit numbers of a vector from its "[msb:lsb]" index, which is
+ * either separate or appended to the reference. Without a matching
+ * range, the bits get numbered from 0.
+ */
+static void parse_var_range(struct vcd_channel *vcd_ch,
+	const char *ref, const char *index)
+{
+	const char *range;
+	int msb, lsb;
+
+	vcd_ch->lsb = 0;
+	vcd_ch->step = 1;
+	range = index ? index : strrchr(ref, '[');
+	if (range && sscanf(range, "[%d:%d]", &msb, &lsb) == 2
+			&& (size_t)ABS(msb - lsb) + 1 == vcd_ch->size) {
+		vcd_ch->lsb = lsb;
+		vcd_ch->step = (msb >= lsb) ? 1 : -1;
+		if (index)
+			vcd_ch->base_name = g_strdup(ref);
+		else
+			vcd_ch->base_name = g_strndup(ref, range - ref);
+	} else {
+		vcd_ch->base_name = g_strdup(ref);
+	}
+}
+
+/* Add a variable from a $var section, which got split into parts. */
+static void add_variable(struct context *inc, gchar **parts,
+	unsigned int length)
+{
+	struct vcd_channel *vcd_ch;
+	enum sr_channeltype type;
+	long size;
+
+	if (!strcmp(parts[0], "event") || !strcmp(parts[0], "string")) {
+		sr_info("Unsupported signal type: '%s'", parts[0]);
+		return;
+	}
+	size = strtol(parts[1], NULL, 10);
+	if (size < 1) {
+		sr_info("Unsupported signal size: '%s'", parts[1]);
+		return;
+	}
+
+	/* Reals get an analog channel, other types a logic channel per bit. */
+	if (!strcmp(parts[0], "real") || !strcmp(parts[0], "realtime")) {
+		type = SR_CHANNEL_ANALOG;
+		size = 1;
+	} else {
+		type = SR_CHANNEL_LOGIC;
+	}
+
+	if (inc->maxchannels && inc->channelcount + size > inc->maxchannels) {
+		sr_warn("Skipping '%s%s' because only %d channels requested.",
+			parts[3], parts[4] ? : "", inc->maxchannels);
+		return;
+	}
+
+	vcd_ch = g_malloc0(sizeof(struct vcd_channel));
+	vcd_ch->identifier = g_strdup(parts[2]);
+	if (length == 4)
+		vcd_ch->name = g_strdup(parts[3]);
+	else
+		vcd_ch->name = g_strconcat(parts[3], parts[4], NULL);
+	vcd_ch->type = type;
+	vcd_ch->size = size;
+	parse_var_range(vcd_ch, parts[3], parts[4]);
+
+	add_identifier(inc, vcd_ch->identifier, inc->channels->len);
+	g_ptr_array_add(inc->channels, vcd_ch);
+	inc->channelcount += size;
+}
+
+/*
+ * Create the sigrok channels. Logic channels come first, so that their
+ * index is their bit number in a sample. The analog channels follow.
+ */
+static void create_channels(const struct sr_input *in)
+{
+	struct context *inc;
+	struct vcd_channel *vcd_ch;
+	unsigned int index, i;
+	size_t bit;
+	char *name;
+
+	inc = in->priv;
+	index = 0;
+	for (i = 0; i < inc->channels->len; i++) {
+		vcd_ch = g_ptr_array_index(inc->channels, i);
+		if (vcd_ch->type != SR_CHANNEL_LOGIC)
+			continue;
+		vcd_ch->array_index = index;
+		if (vcd_ch->size == 1) {
+			sr_info("Channel %u is '%s' identified by '%s'.",
+				index, vcd_ch->name, vcd_ch->identifier);
+			sr_channel_new(in->sdi, index++, SR_CHANNEL_LOGIC,
+				TRUE, vcd_ch->name);
+			continue;
+		}
+		sr_info("Channels %u-%u are '%s' identified by '%s'.", index,
+			index + (unsigned int)vcd_ch->size - 1, vcd_ch->name,
+			vcd_ch->identifier);
+		for (bit = 0; bit < vcd_ch->size; bit++) {
+			name = g_strdup_printf("%s[%d]", vcd_ch->base_name,
+				vcd_ch->lsb + vcd_ch->step * (int)bit);
+			sr_channel_new(in->sdi, index++, SR_CHANNEL_LOGIC,
+				TRUE, name);
+			g_free(name);
+		}
+	}
+	inc->logic_count = index;
+
+	inc->analog_count = 0;
+	for (i = 0; i < inc->channels->len; i++) {
+		vcd_ch = g_ptr_array_index(inc->channels, i);
+		if (vcd_ch->type != SR_CHANNEL_ANALOG)
+			continue;
+		vcd_ch->array_index = inc->analog_count++;
+		sr_info("Channel %u is analog '%s' identified by '%s'.",
+			index, vcd_ch->name, vcd_ch->identifier);
+		sr_channel_new(in->sdi, index++, SR_CHANNEL_ANALOG,
+			TRUE, vcd_ch->name);
+	}
+}
+
+/*
+ * Group the bits of vectors, and prepare the analog values. Gets called
+ * when the final channel list is known.
+ */
+static void setup_channels(const struct sr_input *in)
+{
+	struct context *inc;
+	struct vcd_channel *vcd_ch;
+	struct vcd_analog *analog;
+	struct sr_channel_group *cg;
+	struct sr_channel **channels, *ch;
+	GSList *l;
+	unsigned int i;
+	size_t bit;
+
+	inc = in->priv;
+	channels = g_malloc0(inc->channelcount * sizeof(*channels));
+	for (l = in->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->index >= 0 && (unsigned int)ch->index < inc->channelcount)
+			channels[ch->index] = ch;
+	}
+
+	inc->analogs = g_malloc0(inc->analog_count * sizeof(*inc->analogs));
+	for (i = 0; i < inc->channels->len; i++) {
+		vcd_ch = g_ptr_array_index(inc->channels, i);
+		if (vcd_ch->type == SR_CHANNEL_ANALOG) {
+			analog = &inc->analogs[vcd_ch->array_index];
+			analog->channels = g_slist_append(NULL,
+				channels[inc->logic_count + vcd_ch->array_index]);
+			analog->buffer = g_malloc(inc->samples_per_chunk *
+				sizeof(float));
+			continue;
+		}
+		if (vcd_ch->size == 1)
+			continue;
+		cg = g_malloc0(sizeof(struct sr_channel_group));
+		cg->name = g_strdup(vcd_ch->name);
+		for (bit = 0; bit < vcd_ch->size; bit++)
+			cg->channels = g_slist_append(cg->channels,
+				channels[vcd_ch->array_index + bit]);
+		in->sdi->channel_groups = g_slist_append(
+			in->sdi->channel_groups, cg);
+	}
+
+	g_free(channels);
+}
+
 /*
  * Parse VCD header to get values for context structure.
  * The context structure should be zeroed before calling this.
  */
 static gboolean parse_header(const struct sr_input *in, GString *buf)
 {
-	struct vcd_channel *vcd_ch;
 	uint64_t p, q;
 	struct context *inc;
 	gboolean status;
@@ -241,6 +586,15 @@ static gboolean parse_header(const struct sr_input *in, GString *buf)
 	inc = in->priv;
 	name = contents = NULL;
 	status = FALSE;
+
+	/* Identifier strings are owned by the channel list. */
+	if (!inc->channels)
+		inc->channels = g_ptr_array_new_with_free_func(free_channel);
+	free_identifiers(inc);
+	inc->ident_short = g_malloc(IDENT_SHORT_SLOTS * sizeof(int));
+	memset(inc->ident_short, 0xff, IDENT_SHORT_SLOTS * sizeof(int));
+	inc->ident_long = g_hash_table_new(g_str_hash, g_str_equal);
+
 	while (parse_section(buf, &name, &contents)) {
 		sr_dbg("Section '%s', contents '%s'.", name, contents);
 
@@ -274,27 +628,8 @@ static gboolean parse_header(const struct sr_input *in, GString *buf)
 
 			if (length != 4 && length != 5)
 				sr_warn("$var section should have 4 or 5 items");
-			else if (g_strcmp0(parts[0], "reg") != 0 && g_strcmp0(parts[0], "wire") != 0)
-				sr_info("Unsupported signal type: '%s'", parts[0]);
-			else if (strtol(parts[1], NULL, 10) != 1)
-				sr_info("Unsupported signal size: '%s'", parts[1]);
-			else if (inc->maxchannels && inc->channelcount >= inc->maxchannels)
-				sr_warn("Skipping '%s%s' because only %d channels requested.",
-					parts[3], parts[4] ? : "", inc->maxchannels);
-			else {
-				vcd_ch = g_malloc(sizeof(struct vcd_channel));
-				vcd_ch->identifier = g_strdup(parts[2]);
-				if (length == 4)
-					vcd_ch->name = g_strdup(parts[3]);
-				else
-					vcd_ch->name = g_strconcat(parts[3], parts[4], NULL);
-
-				sr_info("Channel %d is '%s' identified by '%s'.",
-						inc->channelcount, vcd_ch->name, vcd_ch->identifier);
-
-				sr_channel_new(in->sdi, inc->channelcount++, SR_CHANNEL_LOGIC, TRUE, vcd_ch->name);
-				inc->channels = g_slist_append(inc->channels, vcd_ch);
-			}
+			else
+				add_variable(inc, parts, length);
 
 			g_strfreev(parts);
 		}
@@ -307,17 +642,23 @@ static gboolean parse_header(const struct sr_input *in, GString *buf)
 	g_free(name);
 	g_free(contents);
 
+	create_channels(in);
+
 	/*
 	 * Compute how many bytes each sample will have and initialize the
 	 * current levels. The current levels will be updated whenever VCD
 	 * has changes.
 	 */
-	inc->bytes_per_sample = (inc->channelcount + 7) / 8;
+	inc->bytes_per_sample = (inc->logic_count + 7) / 8;
 	inc->current_levels = g_malloc0(inc->bytes_per_sample);
+	inc->samples_per_chunk = CHUNK_SIZE /
+		MAX(inc->bytes_per_sample, sizeof(float));
 
 	inc->got_header = status;
 	if (status)
 		status = check_header_in_reread(in);
+	if (status)
+		setup_channels(in);
 
 	return status;
 }
@@ -327,9 +668,26 @@ static int format_match(GHashTable *metadata, unsigned int *confidence)
 	GString *buf, *tmpbuf;
 	gboolean status;
 	gchar *name, *contents;
+	const char *p, *end;
 
 	buf = g_hash_table_lookup(metadata, GINT_TO_POINTER(SR_INPUT_META_HEADER));
-	tmpbuf = g_string_new_len(buf->str, buf->len);
+
+	/*
+	 * Only copy the first section, up to the "$end" after its tag,
+	 * plus one more character which the parser wants to see.
+	 */
+	p = buf->str;
+	end = buf->str + buf->len;
+	if (buf->len >= 3 && !strncmp(p, "\xef\xbb\xbf", 3))
+		p += 3;
+	while (p < end && g_ascii_isspace(*p))
+		p++;
+	while (p < end && !g_ascii_isspace(*p))
+		p++;
+	p = g_strstr_len(p, end - p, "$end");
+	if (!p)
+		return SR_ERR;
+	tmpbuf = g_string_new_len(buf->str, MIN(buf->len, (size_t)(p - buf->str) + 5));
 
 	/*
 	 * If we can parse the first section correctly,
@@ -347,27 +705,72 @@ static int format_match(GHashTable *metadata, unsigned int *confidence)
 	return SR_OK;
 }
 
-/* Send all accumulated bytes from inc->buffer. */
+/* Send all accumulated samples from inc->buffer and the analog buffers. */
 static void send_buffer(const struct sr_input *in)
 {
 	struct context *inc;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	size_t i;
 
 	inc = in->priv;
 
 	if (inc->samples_in_buffer == 0)
 		return;
 
-	packet.type = SR_DF_LOGIC;
-	packet.payload = &logic;
-	logic.unitsize = inc->bytes_per_sample;
-	logic.data = inc->buffer;
-	logic.length = inc->bytes_per_sample * inc->samples_in_buffer;
-	sr_session_send(in->sdi, &packet);
+	if (inc->bytes_per_sample) {
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		logic.unitsize = inc->bytes_per_sample;
+		logic.data = inc->buffer;
+		logic.length = inc->bytes_per_sample * inc->samples_in_buffer;
+		sr_session_send(in->sdi, &packet);
+	}
+
+	for (i = 0; i < inc->analog_count; i++) {
+		sr_analog_init(&analog, &encoding, &meaning, &spec, ANALOG_DIGITS);
+		packet.type = SR_DF_ANALOG;
+		packet.payload = &analog;
+		analog.num_samples = inc->samples_in_buffer;
+		analog.data = inc->analogs[i].buffer;
+		analog.meaning->channels = inc->analogs[i].channels;
+		analog.meaning->mq = 0;
+		analog.meaning->mqflags = 0;
+		analog.meaning->unit = 0;
+		sr_session_send(in->sdi, &packet);
+	}
+
 	inc->samples_in_buffer = 0;
 }
 
+/* Write count copies of a sample, doubling the already written range. */
+static void fill_samples(uint8_t *p, const uint8_t *sample,
+	size_t unitsize, size_t count)
+{
+	size_t filled, total, chunk;
+
+	if (!count)
+		return;
+
+	if (unitsize == 1) {
+		memset(p, sample[0], count);
+		return;
+	}
+
+	memcpy(p, sample, unitsize);
+	filled = unitsize;
+	total = count * unitsize;
+	while (filled < total) {
+		chunk = MIN(filled, total - filled);
+		memcpy(p + filled, p, chunk);
+		filled += chunk;
+	}
+}
+
 /*
  * Add N copies of the current sample to buffer.
  * When the buffer fills up, automatically send it.
@@ -375,12 +778,14 @@ static void send_buffer(const struct sr_input *in)
 static void add_samples(const struct sr_input *in, size_t count)
 {
 	struct context *inc;
+	struct vcd_analog *analog;
 	size_t samples_per_chunk;
 	size_t space_left, i;
+	gboolean uniform;
 	uint8_t *p;
 
 	inc = in->priv;
-	samples_per_chunk = CHUNK_SIZE / inc->bytes_per_sample;
+	samples_per_chunk = inc->samples_per_chunk;
 
 	while (count) {
 		space_left = samples_per_chunk - inc->samples_in_buffer;
@@ -388,161 +793,436 @@ static void add_samples(const struct sr_input *in, size_t count)
 		if (space_left > count)
 			space_left = count;
 
-		p = inc->buffer + inc->samples_in_buffer * inc->bytes_per_sample;
-		for (i = 0; i < space_left; i++) {
-			memcpy(p, inc->current_levels, inc->bytes_per_sample);
-			p += inc->bytes_per_sample;
-			inc->samples_in_buffer++;
-			count--;
+		if (inc->bytes_per_sample) {
+			p = inc->buffer + inc->samples_in_buffer * inc->bytes_per_sample;
+			fill_samples(p, inc->current_levels,
+				inc->bytes_per_sample, space_left);
 		}
-
-		if (inc->samples_in_buffer == samples_per_chunk)
+		for (i = 0; i < inc->analog_count; i++) {
+			analog = &inc->analogs[i];
+			fill_samples((uint8_t *)(analog->buffer + inc->samples_in_buffer),
+				(const uint8_t *)&analog->value, sizeof(float),
+				space_left);
+		}
+		inc->samples_in_buffer += space_left;
+		count -= space_left;
+
+		if (inc->samples_in_buffer < samples_per_chunk)
+			continue;
+
+		uniform = (space_left == samples_per_chunk);
+		send_buffer(in);
+
+		/*
+		 * A buffer which holds nothing but the current levels
+		 * can be sent again as is for the rest of a long idle
+		 * period, without filling it over and over.
+		 */
+		while (uniform && count >= samples_per_chunk) {
+			inc->samples_in_buffer = samples_per_chunk;
 			send_buffer(in);
+			count -= samples_per_chunk;
+		}
 	}
 }
 
-/* Set the channel level depending on the identifier and parsed value. */
-static void process_bit(struct context *inc, char *identifier, unsigned int bit)
+/* Set count logic channels from first on to the LSB first bits. */
+static void set_logic_bits(struct context *inc, size_t first, size_t count,
+	uint64_t bits)
 {
-	GSList *l;
-	struct vcd_channel *vcd_ch;
-	unsigned int j;
-
-	for (j = 0, l = inc->channels; j < inc->channelcount && l; j++, l = l->next) {
-		vcd_ch = l->data;
-		if (g_strcmp0(identifier, vcd_ch->identifier) == 0) {
-			/* Found our channel. */
-			size_t byte_idx = (j / 8);
-			size_t bit_idx = j - 8 * byte_idx;
-			if (bit)
-				inc->current_levels[byte_idx] |= (uint8_t)1 << bit_idx;
-			else
-				inc->current_levels[byte_idx] &= ~((uint8_t)1 << bit_idx);
-			break;
+	size_t idx;
+
+	for (idx = first; idx < first + count; idx++, bits >>= 1) {
+		if (bits & 1)
+			inc->current_levels[idx / 8] |= (uint8_t)1 << (idx % 8);
+		else
+			inc->current_levels[idx / 8] &= ~((uint8_t)1 << (idx % 8));
+	}
+}
+
+/*
+ * Set a vector from its value text, MSB first. Shorter values get
+ * extended with zeros, 'x' and 'z' states are taken as low.
+ */
+static void set_logic_text(struct context *inc, size_t first, size_t count,
+	const char *text)
+{
+	const char *p;
+	size_t bit;
+
+	p = text + strlen(text);
+	for (bit = 0; bit < count; bit++)
+		set_logic_bits(inc, first + bit, 1, p > text && *--p == '1');
+}
+
+/* Get a vector value of up to 64 bits from its text, MSB first. */
+static uint64_t parse_bits(const char *text, size_t len)
+{
+	uint64_t bits;
+
+	bits = 0;
+	while (len--)
+		bits = (bits << 1) | (*text++ == '1');
+
+	return bits;
+}
+
+/*
+ * Get the next space-delimited token from the data section. The token
+ * gets terminated in place, so that no copies need to be made. Already
+ * tokenized data can be tokenized again.
+ */
+static char *next_token(char **pos, const char *end, size_t *len)
+{
+	char *p, *token;
+
+	p = *pos;
+	while (p < end && IS_DELIM(*p))
+		p++;
+	if (p >= end) {
+		*pos = p;
+		return NULL;
+	}
+
+	token = p;
+	while (p < end && !IS_DELIM(*p))
+		p++;
+	*len = p - token;
+	if (p < end)
+		*p++ = '\0';
+	*pos = p;
+
+	return token;
+}
+
+/* Parse a timestamp's decimal digits, without the leading '#'. */
+static uint64_t parse_timestamp(const char *digits)
+{
+	uint64_t value;
+
+	value = 0;
+	while (g_ascii_isdigit(*digits))
+		value = value * 10 + (*digits++ - '0');
+
+	return value;
+}
+
+/* Handle a new timestamp, and generate the samples up to it. */
+static void process_timestamp(const struct sr_input *in, uint64_t timestamp)
+{
+	struct context *inc;
+
+	inc = in->priv;
+
+	if (inc->downsample > 1)
+		timestamp /= inc->downsample;
+
+	/*
+	 * Skip < 0 => skip until first timestamp.
+	 * Skip = 0 => don't skip
+	 * Skip > 0 => skip until timestamp >= skip.
+	 */
+	if (inc->skip < 0) {
+		inc->skip = timestamp;
+		inc->prev_timestamp = timestamp;
+	} else if (inc->skip > 0 && timestamp < (uint64_t)inc->skip) {
+		inc->prev_timestamp = inc->skip;
+	} else if (timestamp == inc->prev_timestamp) {
+		/* Ignore repeated timestamps (e.g. sigrok outputs these) */
+	} else if (timestamp < inc->prev_timestamp) {
+		sr_err("Invalid timestamp: %" PRIu64 " (smaller than previous timestamp).", timestamp);
+		inc->ignore_until_end = TRUE;
+	} else {
+		if (inc->compress != 0 && timestamp - inc->prev_timestamp > inc->compress) {
+			/* Compress long idle periods */
+			inc->prev_timestamp = timestamp - inc->compress;
 		}
+
+		sr_dbg("New timestamp: %" PRIu64, timestamp);
+
+		/* Generate samples from prev_timestamp up to timestamp - 1. */
+		add_samples(in, timestamp - inc->prev_timestamp);
+		inc->prev_timestamp = timestamp;
 	}
-	if (j == inc->channelcount)
-		sr_dbg("Did not find channel for identifier '%s'.", identifier);
 }
 
-/* Parse a set of lines from the data section. */
-static void parse_contents(const struct sr_input *in, char *data)
+/* Apply an event to the current levels, or generate samples. */
+static void apply_event(const struct sr_input *in,
+	const struct vcd_event *event)
 {
 	struct context *inc;
-	uint64_t timestamp;
-	unsigned int bit, i;
-	char **tokens;
+	const struct vcd_channel *vcd_ch;
+	size_t size;
 
 	inc = in->priv;
 
-	/* Read one space-delimited token at a time. */
-	tokens = g_strsplit_set(data, " \t\r\n", 0);
-	remove_empty_parts(tokens);
-	for (i = 0; tokens[i]; i++) {
-		if (inc->skip_until_end) {
-			if (!strcmp(tokens[i], "$end")) {
-				/* Done with unhandled/unknown section. */
-				inc->skip_until_end = FALSE;
-				break;
-			}
+	if (inc->ignore_until_end) {
+		if (event->type == EVENT_END)
+			inc->ignore_until_end = FALSE;
+		return;
+	}
+	if (event->type == EVENT_TIMESTAMP) {
+		process_timestamp(in, event->value.timestamp);
+		return;
+	}
+	if (event->type == EVENT_END)
+		return;
+
+	vcd_ch = g_ptr_array_index(inc->channels, event->index);
+	if (event->type == EVENT_REAL) {
+		if (vcd_ch->type != SR_CHANNEL_ANALOG) {
+			sr_dbg("Real value for logic channel '%s'.", vcd_ch->name);
+			return;
 		}
-		if (tokens[i][0] == '#' && g_ascii_isdigit(tokens[i][1])) {
-			/* Numeric value beginning with # is a new timestamp value */
-			timestamp = strtoull(tokens[i] + 1, NULL, 10);
+		inc->analogs[vcd_ch->array_index].value = event->value.real;
+		return;
+	}
+	if (vcd_ch->type != SR_CHANNEL_LOGIC) {
+		sr_dbg("Bit value for analog channel '%s'.", vcd_ch->name);
+		return;
+	}
+	if (event->type == EVENT_WIDE_BITS) {
+		set_logic_text(inc, vcd_ch->array_index, vcd_ch->size,
+			event->value.wide_bits);
+		return;
+	}
+	size = MIN(vcd_ch->size, 64);
+	set_logic_bits(inc, vcd_ch->array_index, size, event->value.bits);
+	if (vcd_ch->size > size)
+		set_logic_bits(inc, vcd_ch->array_index + size,
+			vcd_ch->size - size, 0);
+}
 
-			if (inc->downsample > 1)
-				timestamp /= inc->downsample;
+/*
+ * Apply an event right away when tokenizing on the input's thread,
+ * otherwise queue it.
+ */
+static void emit_event(struct vcd_segment *seg, const struct vcd_event *event)
+{
+	if (seg->in)
+		apply_event(seg->in, event);
+	else
+		g_array_append_val(seg->events, *event);
+}
 
-			/*
-			 * Skip < 0 => skip until first timestamp.
-			 * Skip = 0 => don't skip
-			 * Skip > 0 => skip until timestamp >= skip.
-			 */
-			if (inc->skip < 0) {
-				inc->skip = timestamp;
-				inc->prev_timestamp = timestamp;
-			} else if (inc->skip > 0 && timestamp < (uint64_t)inc->skip) {
-				inc->prev_timestamp = inc->skip;
-			} else if (timestamp == inc->prev_timestamp) {
-				/* Ignore repeated timestamps (e.g. sigrok outputs these) */
-			} else if (timestamp < inc->prev_timestamp) {
-				sr_err("Invalid timestamp: %" PRIu64 " (smaller than previous timestamp).", timestamp);
-				inc->skip_until_end = TRUE;
-				break;
-			} else {
-				if (inc->compress != 0 && timestamp - inc->prev_timestamp > inc->compress) {
-					/* Compress long idle periods */
-					inc->prev_timestamp = timestamp - inc->compress;
-				}
+/* Emit a value change for the variable with the given identifier. */
+static void emit_value_event(struct vcd_segment *seg,
+	struct vcd_event *event, const char *identifier, size_t len)
+{
+	int index;
 
-				sr_dbg("New timestamp: %" PRIu64, timestamp);
+	index = find_identifier(seg->inc, identifier, len);
+	if (index < 0) {
+		sr_dbg("Did not find channel for identifier '%s'.", identifier);
+		return;
+	}
+	event->index = index;
+	emit_event(seg, event);
+}
 
-				/* Generate samples from prev_timestamp up to timestamp - 1. */
-				add_samples(in, timestamp - inc->prev_timestamp);
-				inc->prev_timestamp = timestamp;
-			}
-		} else if (tokens[i][0] == '$' && tokens[i][1] != '\0') {
+/*
+ * Tokenize a segment of the data section. Without an input to apply the
+ * events to, they get queued. This only reads the identifier tables of
+ * the context then, and can run for several segments at the same time.
+ * The segment's data gets modified.
+ */
+static void parse_segment(struct vcd_segment *seg)
+{
+	struct vcd_event event;
+	gboolean skip;
+	char *pos, *end, *token, *identifier;
+	size_t token_len, id_len;
+
+	if (seg->events)
+		g_array_set_size(seg->events, 0);
+	skip = seg->skip_at_start;
+
+	pos = seg->data;
+	end = seg->data + seg->len;
+	while ((token = next_token(&pos, end, &token_len))) {
+		if (skip) {
+			/* Ignore unhandled/unknown sections up to their $end. */
+			if (!strcmp(token, "$end"))
+				skip = FALSE;
+			continue;
+		}
+		if (token[0] == '#' && g_ascii_isdigit(token[1])) {
+			/* Numeric value beginning with # is a new timestamp value */
+			event.type = EVENT_TIMESTAMP;
+			event.value.timestamp = parse_timestamp(token + 1);
+			emit_event(seg, &event);
+		} else if (token[0] == '$' && token[1] != '\0') {
 			/*
 			 * This is probably a $dumpvars, $comment or similar.
 			 * $dump* contain useful data.
 			 */
-			if (g_strcmp0(tokens[i], "$dumpvars") == 0
-					|| g_strcmp0(tokens[i], "$dumpon") == 0
-					|| g_strcmp0(tokens[i], "$dumpoff") == 0
-					|| g_strcmp0(tokens[i], "$end") == 0) {
+			if (!strcmp(token, "$end")) {
+				event.type = EVENT_END;
+				emit_event(seg, &event);
+			} else if (!strcmp(token, "$dumpvars")
+					|| !strcmp(token, "$dumpon")
+					|| !strcmp(token, "$dumpoff")
+					|| !strcmp(token, "$dumpall")) {
 				/* Ignore, parse contents as normally. */
 			} else {
 				/* Ignore this and future lines until $end. */
-				inc->skip_until_end = TRUE;
-				break;
+				skip = TRUE;
 			}
-		} else if (strchr("rR", tokens[i][0]) != NULL) {
-			sr_dbg("Real type vector values not supported yet!");
-			if (!tokens[++i])
-				/* No tokens left, bail out */
-				break;
-			else
-				/* Process next token */
+		} else if (token[0] == 'r' || token[0] == 'R') {
+			identifier = next_token(&pos, end, &id_len);
+			if (token_len < 2 || !identifier) {
+				sr_dbg("Unexpected real format!");
 				continue;
-		} else if (strchr("bB", tokens[i][0]) != NULL) {
-			bit = (tokens[i][1] == '1');
+			}
+			event.type = EVENT_REAL;
+			event.value.real = g_ascii_strtod(token + 1, NULL);
+			emit_value_event(seg, &event, identifier, id_len);
+		} else if (token[0] == 'b' || token[0] == 'B') {
+			identifier = next_token(&pos, end, &id_len);
 
 			/*
-			 * Bail out if a) char after 'b' is NUL, or b) there is
-			 * a second character after 'b', or c) there is no
-			 * identifier.
+			 * Skip the value if a) char after 'b' is NUL, or
+			 * b) there is no identifier.
 			 */
-			if (!tokens[i][1] || tokens[i][2] || !tokens[++i]) {
+			if (token_len < 2 || !identifier) {
 				sr_dbg("Unexpected vector format!");
-				break;
+				continue;
 			}
 
-			process_bit(inc, tokens[i], bit);
-		} else if (strchr("01xXzZ", tokens[i][0]) != NULL) {
-			char *identifier;
-
+			if (token_len - 1 <= 64) {
+				event.type = EVENT_BITS;
+				event.value.bits = parse_bits(token + 1, token_len - 1);
+			} else {
+				event.type = EVENT_WIDE_BITS;
+				event.value.wide_bits = token + 1;
+			}
+			emit_value_event(seg, &event, identifier, id_len);
+		} else if (strchr("01xXzZ", token[0]) != NULL) {
 			/* A new 1-bit sample value */
-			bit = (tokens[i][0] == '1');
+			event.type = EVENT_BITS;
+			event.value.bits = (token[0] == '1');
 
 			/*
 			 * The identifier is either the next character, or, if
 			 * there was whitespace after the bit, the next token.
 			 */
-			if (tokens[i][1] == '\0') {
-				if (!tokens[++i]) {
+			if (token_len == 1) {
+				identifier = next_token(&pos, end, &id_len);
+				if (!identifier) {
 					sr_dbg("Identifier missing!");
 					break;
 				}
-				identifier = tokens[i];
 			} else {
-				identifier = tokens[i] + 1;
+				identifier = token + 1;
+				id_len = token_len - 1;
 			}
-			process_bit(inc, identifier, bit);
+			emit_value_event(seg, &event, identifier, id_len);
 		} else {
-			sr_warn("Skipping unknown token '%s'.", tokens[i]);
+			sr_warn("Skipping unknown token '%s'.", token);
+		}
+	}
+
+	seg->skip_at_end = skip;
+}
+
+static gpointer parse_segment_thread(gpointer data)
+{
+	parse_segment(data);
+
+	return NULL;
+}
+
+/* Find the start of the next timestamp line at or after p. */
+static char *find_timestamp_line(char *p, const char *end)
+{
+	while (p + 2 < end) {
+		p = memchr(p, '\n', end - p - 2);
+		if (!p)
+			break;
+		p++;
+		if (p[0] == '#' && g_ascii_isdigit(p[1]))
+			return p;
+	}
+
+	return NULL;
+}
+
+/*
+ * Parse a set of lines from the data section. The data must be NUL
+ * terminated at data + len, and gets modified during tokenization.
+ *
+ * Large blocks get split into segments at timestamp lines. These are
+ * tokenized in parallel, assuming that they don't start within a
+ * skipped section, and the queued events are applied in order. A
+ * segment that turns out to start within a skipped section gets
+ * tokenized again.
+ */
+static void parse_contents(const struct sr_input *in, char *data, size_t len)
+{
+	struct context *inc;
+	struct vcd_segment *seg;
+	unsigned int count, i;
+	size_t n;
+	char *start, *end;
+
+	inc = in->priv;
+	end = data + len;
+
+	count = MIN(inc->max_threads, len / PARSE_SEGMENT_MIN);
+	if (count <= 1) {
+		seg = &inc->segments[0];
+		seg->inc = inc;
+		seg->in = in;
+		seg->data = data;
+		seg->len = len;
+		seg->skip_at_start = inc->skip_until_end;
+		parse_segment(seg);
+		inc->skip_until_end = seg->skip_at_end;
+		return;
+	}
+
+	start = data;
+	for (i = 0; i < count && start; i++) {
+		seg = &inc->segments[i];
+		seg->inc = inc;
+		seg->in = NULL;
+		seg->data = start;
+		seg->skip_at_start = (i == 0) ? inc->skip_until_end : FALSE;
+		if (!seg->events)
+			seg->events = g_array_new(FALSE, FALSE,
+				sizeof(struct vcd_event));
+		start = NULL;
+		if (i + 1 < count)
+			start = find_timestamp_line(MAX(seg->data,
+				data + len / count * (i + 1)), end);
+		seg->len = (start ? start : end) - seg->data;
+	}
+	count = i;
+
+	for (i = 1; i < count; i++) {
+		seg = &inc->segments[i];
+		seg->thread = g_thread_try_new("vcd-parse",
+			parse_segment_thread, seg, NULL);
+		if (!seg->thread)
+			parse_segment(seg);
+	}
+	parse_segment(&inc->segments[0]);
+
+	for (i = 0; i < count; i++) {
+		seg = &inc->segments[i];
+		if (seg->thread)
+			g_thread_join(seg->thread);
+		seg->thread = NULL;
+		if (i > 0 && seg->skip_at_start != seg[-1].skip_at_end) {
+			seg->skip_at_start = seg[-1].skip_at_end;
+			parse_segment(seg);
 		}
+		for (n = 0; n < seg->events->len; n++)
+			apply_event(in, &g_array_index(seg->events,
+				struct vcd_event, n));
 	}
-	g_strfreev(tokens);
+
+	inc->skip_until_end = inc->segments[count - 1].skip_at_end;
 }
 
 static int init(struct sr_input *in, GHashTable *options)
@@ -560,6 +1240,12 @@ static int init(struct sr_input *in, GHashTable *options)
 	inc->skip = g_variant_get_int32(g_hash_table_lookup(options, "skip"));
 	inc->skip /= inc->downsample;
 
+#if GLIB_CHECK_VERSION(2, 36, 0)
+	inc->max_threads = MIN(g_get_num_processors(), MAX_PARSE_THREADS);
+#else
+	inc->max_threads = 1;
+#endif
+
 	in->sdi = g_malloc0(sizeof(struct sr_dev_inst));
 	in->priv = inc;
 
@@ -609,11 +1295,10 @@ static int process_buffer(struct sr_input *in)
 		inc->started = TRUE;
 	}
 
-	while ((p = g_strrstr_len(in->buf->str, in->buf->len, "\n"))) {
+	/* Process all complete lines in one go. */
+	if ((p = g_strrstr_len(in->buf->str, in->buf->len, "\n"))) {
 		*p = '\0';
-		g_strstrip(in->buf->str);
-		if (in->buf->str[0] != '\0')
-			parse_contents(in, in->buf->str);
+		parse_contents(in, in->buf->str, p - in->buf->str);
 		g_string_erase(in->buf, 0, p - in->buf->str + 1);
 	}
 
@@ -669,16 +1354,33 @@ static int end(struct sr_input *in)
 static void cleanup(struct sr_input *in)
 {
 	struct context *inc;
+	size_t i;
 
 	inc = in->priv;
 	keep_header_for_reread(in);
-	g_slist_free_full(inc->channels, free_channel);
+	free_identifiers(inc);
+	if (inc->channels)
+		g_ptr_array_free(inc->channels, TRUE);
 	inc->channels = NULL;
 
 	g_free(inc->buffer);
 	inc->buffer = NULL;
 	g_free(inc->current_levels);
 	inc->current_levels = NULL;
+
+	for (i = 0; i < inc->analog_count; i++) {
+		g_slist_free(inc->analogs[i].channels);
+		g_free(inc->analogs[i].buffer);
+	}
+	g_free(inc->analogs);
+	inc->analogs = NULL;
+	inc->analog_count = 0;
+
+	for (i = 0; i < MAX_PARSE_THREADS; i++) {
+		if (inc->segments[i].events)
+			g_array_free(inc->segments[i].events, TRUE);
+		inc->segments[i].events = NULL;
+	}
 }
 
 static int reset(struct sr_input *in)
@@ -692,6 +1394,7 @@ static int reset(struct sr_input *in)
 	inc->got_header = FALSE;
 	inc->prev_timestamp = 0;
 	inc->skip_until_end = FALSE;
+	inc->ignore_until_end = FALSE;
 	inc->channelcount = 0;
 	/* The inc->channels list was released in cleanup() above. */
 	inc->buffer = g_malloc(CHUNK_SIZE);
@@ -720,12 +1423,18 @@ static const struct sr_option *get_options(void)
 	return options;
 }
 
+static const struct sr_input_magic magic[] = {
+	{ 0, "$", TRUE },
+	ALL_ZERO
+};
+
 SR_PRIV struct sr_input_module input_vcd = {
 	.id = "vcd",
 	.name = "VCD",
 	.desc = "Value Change Dump data",
 	.exts = (const char*[]){"vcd", NULL},
 	.metadata = { SR_INPUT_META_HEADER | SR_INPUT_META_REQUIRED },
+	.magic = magic,
 	.options = get_options,
 	.format_match = format_match,
 	.init = init,
@@ -43,6 +43,9 @@
 #define WAVE_FORMAT_IEEE_FLOAT_  0x0003
 #define WAVE_FORMAT_EXTENSIBLE_  0xfffe
 
+/* Full scale of 24-bit PCM samples. */
+#define PCM24_MAX                0x7fffff
+
 struct context {
 	gboolean started;
 	int fmt_code;
@@ -54,24 +57,24 @@ struct context {
 	gboolean create_channels;
 };
 
-static int parse_wav_header(GString *buf, struct context *inc)
+static int parse_wav_header(const char *buf, gsize len, struct context *inc)
 {
 	uint64_t samplerate;
 	unsigned int fmt_code, samplesize, num_channels, unitsize;
 
-	if (buf->len < MIN_DATA_CHUNK_OFFSET)
+	if (len < MIN_DATA_CHUNK_OFFSET)
 		return SR_ERR_NA;
 
-	fmt_code = RL16(buf->str + 20);
-	samplerate = RL32(buf->str + 24);
+	fmt_code = RL16(buf + 20);
+	samplerate = RL32(buf + 24);
 
-	samplesize = RL16(buf->str + 32);
-	num_channels = RL16(buf->str + 22);
+	samplesize = RL16(buf + 32);
+	num_channels = RL16(buf + 22);
 	if (num_channels == 0)
 		return SR_ERR;
 	unitsize = samplesize / num_channels;
-	if (unitsize != 1 && unitsize != 2 && unitsize != 4) {
-		sr_err("Only 8, 16 or 32 bits per sample supported.");
+	if (unitsize < 1 || unitsize > 4) {
+		sr_err("Only 8, 16, 24 or 32 bits per sample supported.");
 		return SR_ERR_DATA;
 	}
 
@@ -82,24 +85,24 @@ static int parse_wav_header(GString *buf, struct context *inc)
 			return SR_ERR_DATA;
 		}
 	} else if (fmt_code == WAVE_FORMAT_EXTENSIBLE_) {
-		if (buf->len < 70)
+		if (len < 70)
 			/* Not enough for extensible header and next chunk. */
 			return SR_ERR_NA;
 
-		if (RL16(buf->str + 16) != 40) {
+		if (RL16(buf + 16) != 40) {
 			sr_err("WAV extensible format chunk must be 40 bytes.");
 			return SR_ERR;
 		}
-		if (RL16(buf->str + 36) != 22) {
+		if (RL16(buf + 36) != 22) {
 			sr_err("WAV extension must be 22 bytes.");
 			return SR_ERR;
 		}
-		if (RL16(buf->str + 34) != RL16(buf->str + 38)) {
+		if (RL16(buf + 34) != RL16(buf + 38)) {
 			sr_err("Reduced valid bits per sample not supported.");
 			return SR_ERR_DATA;
 		}
 		/* Real format code is the first two bytes of the GUID. */
-		fmt_code = RL16(buf->str + 44);
+		fmt_code = RL16(buf + 44);
 		if (fmt_code != WAVE_FORMAT_PCM_ && fmt_code != WAVE_FORMAT_IEEE_FLOAT_) {
 			sr_err("Only PCM and floating point samples are supported.");
 			return SR_ERR_DATA;
@@ -141,7 +144,7 @@ static int format_match(GHashTable *metadata, unsigned int *confidence)
 	 * Only gets called when we already know this is a WAV file, so
 	 * this parser can log error messages.
 	 */
-	if ((ret = parse_wav_header(buf, NULL)) != SR_OK)
+	if ((ret = parse_wav_header(buf->str, buf->len, NULL)) != SR_OK)
 		return ret;
 
 	*confidence = 1;
@@ -164,23 +167,23 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int find_data_chunk(GString *buf, int initial_offset)
+static int find_data_chunk(const char *buf, gsize len, int initial_offset)
 {
 	unsigned int offset, i;
 
 	offset = initial_offset;
-	while (offset < MIN(MAX_DATA_CHUNK_OFFSET, buf->len)) {
-		if (!memcmp(buf->str + offset, "data", 4))
+	while (offset < MIN(MAX_DATA_CHUNK_OFFSET, len)) {
+		if (!memcmp(buf + offset, "data", 4))
 			/* Skip into the samples. */
 			return offset + 8;
 		for (i = 0; i < 4; i++) {
-			if (!isalnum(buf->str[offset + i])
-					&& !isblank(buf->str[offset + i]))
+			if (!isalnum(buf[offset + i])
+					&& !isblank(buf[offset + i]))
 				/* Doesn't look like a chunk ID. */
 				return -1;
 		}
 		/* Skip past this chunk. */
-		offset += 8 + RL32(buf->str + offset + 4);
+		offset += 8 + RL32(buf + offset + 4);
 	}
 
 	if (offset > MAX_DATA_CHUNK_OFFSET)
@@ -189,23 +192,27 @@ static int find_data_chunk(GString *buf, int initial_offset)
 	return offset;
 }
 
-static void send_chunk(const struct sr_input *in, int offset, int num_samples)
+/* Convert a chunk of samples to floats, runs in a pipeline worker thread. */
+static int convert_chunk(struct std_pipeline *pl, const uint8_t *data,
+	size_t length, unsigned int slot)
 {
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog analog;
-	struct sr_analog_encoding encoding;
-	struct sr_analog_meaning meaning;
-	struct sr_analog_spec spec;
+	struct sr_input *in;
 	struct context *inc;
 	float *fdata;
 	int total_samples, samplenum;
-	char *s, *d;
+	int32_t pcm;
+	const char *s;
+	char *d;
 
+	in = pl->cb_data;
 	inc = in->priv;
 
-	total_samples = num_samples * inc->num_channels;
-	fdata = g_malloc0(total_samples * sizeof(float));
-	s = in->buf->str + offset;
+	if (!pl->slot_data[slot])
+		pl->slot_data[slot] = g_malloc(pl->chunk_size / inc->unitsize * sizeof(float));
+	fdata = pl->slot_data[slot];
+
+	total_samples = length / inc->unitsize;
+	s = (const char *)data;
 	d = (char *)fdata;
 
 	for (samplenum = 0; samplenum < total_samples; samplenum++) {
@@ -218,6 +225,13 @@ static void send_chunk(const struct sr_input *in, int offset, int num_samples)
 			case 2:
 				fdata[samplenum] = RL16S(s) / (float)INT16_MAX;
 				break;
+			case 3:
+				pcm = RL16(s) | (uint8_t)s[2] << 16;
+				/* Sign extend the 24-bit sample. */
+				if (pcm & 0x800000)
+					pcm -= 0x1000000;
+				fdata[samplenum] = pcm / (float)PCM24_MAX;
+				break;
 			case 4:
 				fdata[samplenum] = RL32S(s) / (float)INT32_MAX;
 				break;
@@ -236,28 +250,55 @@ static void send_chunk(const struct sr_input *in, int offset, int num_samples)
 		d += inc->unitsize;
 	}
 
+	return SR_OK;
+}
+
+/*
+ * Send a chunk of converted samples. Without a conversion, the samples
+ * are sent as is.
+ */
+static int send_chunk(struct std_pipeline *pl, const uint8_t *data,
+	size_t length, unsigned int slot)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	struct sr_input *in;
+	struct context *inc;
+
+	in = pl->cb_data;
+	inc = in->priv;
+
 	/* TODO: Use proper 'digits' value for this device (and its modes). */
 	sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
 	packet.type = SR_DF_ANALOG;
 	packet.payload = &analog;
-	analog.num_samples = num_samples;
-	analog.data = fdata;
+	analog.num_samples = length / inc->samplesize;
+	analog.data = pl->prepare ? pl->slot_data[slot] : (void *)data;
 	analog.meaning->channels = in->sdi->channels;
 	analog.meaning->mq = 0;
 	analog.meaning->mqflags = 0;
 	analog.meaning->unit = 0;
-	sr_session_send(in->sdi, &packet);
-	g_free(fdata);
+
+	return sr_session_send(in->sdi, &packet);
 }
 
-static int process_buffer(struct sr_input *in)
+/*
+ * Send the samples in the data, and return the number of bytes consumed.
+ * Chunks get converted in worker threads while previous chunks are sent.
+ */
+static int process_data(struct sr_input *in, const char *data, gsize length,
+	gboolean mapped, gsize *used)
 {
 	struct context *inc;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
 	struct sr_config *src;
-	int offset, chunk_samples, total_samples, processed, max_chunk_samples;
-	int num_samples, i;
+	struct std_pipeline pl;
+	int offset, num_samples, i;
+	unsigned int slot;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -276,10 +317,10 @@ static int process_buffer(struct sr_input *in)
 
 	if (!inc->found_data) {
 		/* Skip past size of 'fmt ' chunk. */
-		i = 20 + RL32(in->buf->str + 16);
-		offset = find_data_chunk(in->buf, i);
+		i = 20 + RL32(data + 16);
+		offset = find_data_chunk(data, length, i);
 		if (offset < 0) {
-			if (in->buf->len > MAX_DATA_CHUNK_OFFSET) {
+			if (length > MAX_DATA_CHUNK_OFFSET) {
 				sr_err("Couldn't find data chunk.");
 				return SR_ERR;
 			}
@@ -289,39 +330,77 @@ static int process_buffer(struct sr_input *in)
 		offset = 0;
 
 	/* Round off up to the last channels * unitsize boundary. */
-	chunk_samples = (in->buf->len - offset) / inc->samplesize;
-	max_chunk_samples = CHUNK_SIZE / inc->samplesize;
-	processed = 0;
-	total_samples = chunk_samples;
-	while (processed < total_samples) {
-		if (chunk_samples > max_chunk_samples)
-			num_samples = max_chunk_samples;
-		else
-			num_samples = chunk_samples;
-		send_chunk(in, offset, num_samples);
-		offset += num_samples * inc->samplesize;
-		chunk_samples -= num_samples;
-		processed += num_samples;
-	}
+	num_samples = (length - offset) / inc->samplesize;
+
+	std_pipeline_init(&pl, (const uint8_t *)data + offset,
+		num_samples * inc->samplesize,
+		CHUNK_SIZE / inc->samplesize * inc->samplesize);
+	pl.prepare = convert_chunk;
+	pl.send = send_chunk;
+	pl.cb_data = in;
+	pl.mapped = mapped;
+#ifndef WORDS_BIGENDIAN
+	/* Aligned float data can be sent as is. */
+	if (inc->fmt_code == WAVE_FORMAT_IEEE_FLOAT_
+			&& !((uintptr_t)(data + offset) % sizeof(float)))
+		pl.prepare = NULL;
+#endif
+	std_pipeline_run(&pl);
+	for (slot = 0; slot < STD_PIPELINE_MAX_SLOTS; slot++)
+		g_free(pl.slot_data[slot]);
 
-	if ((unsigned int)offset < in->buf->len) {
-		/*
-		 * The incoming buffer wasn't processed completely. Stash
-		 * the leftover data for next time.
-		 */
-		g_string_erase(in->buf, 0, offset);
-	} else
-		g_string_truncate(in->buf, 0);
+	*used = offset + num_samples * inc->samplesize;
 
 	return SR_OK;
 }
 
-static int receive(struct sr_input *in, GString *buf)
+static int process_buffer(struct sr_input *in)
+{
+	gsize used;
+	int ret;
+
+	/*
+	 * The incoming buffer may not get processed completely. Stash
+	 * the leftover data for next time.
+	 */
+	ret = process_data(in, in->buf->str, in->buf->len, FALSE, &used);
+	if (ret != SR_OK)
+		return ret;
+	g_string_erase(in->buf, 0, used);
+
+	return SR_OK;
+}
+
+/* Parse the header, create channels and notify the frontend. */
+static int check_header(struct sr_input *in, const char *data, gsize length)
 {
 	struct context *inc;
 	int ret;
 	char channelname[16];
 
+	inc = in->priv;
+	if ((ret = parse_wav_header(data, length, inc)) == SR_ERR_NA)
+		/* Not enough data yet. */
+		return SR_OK;
+	else if (ret != SR_OK)
+		return ret;
+
+	if (inc->create_channels) {
+		for (int i = 0; i < inc->num_channels; i++) {
+			snprintf(channelname, sizeof(channelname), "CH%d", i + 1);
+			sr_channel_new(in->sdi, i, SR_CHANNEL_ANALOG, TRUE, channelname);
+		}
+	}
+
+	inc->create_channels = FALSE;
+
+	/* sdi is ready, notify frontend. */
+	in->sdi_ready = TRUE;
+	return SR_OK;
+}
+
+static int receive(struct sr_input *in, GString *buf)
+{
 	g_string_append_len(in->buf, buf->str, buf->len);
 
 	if (in->buf->len < MIN_DATA_CHUNK_OFFSET) {
@@ -332,31 +411,26 @@ static int receive(struct sr_input *in, GString *buf)
 		return SR_OK;
 	}
 
-	inc = in->priv;
-	if (!in->sdi_ready) {
-		if ((ret = parse_wav_header(in->buf, inc)) == SR_ERR_NA)
-			/* Not enough data yet. */
-			return SR_OK;
-		else if (ret != SR_OK)
-			return ret;
-
-		if (inc->create_channels) {
-			for (int i = 0; i < inc->num_channels; i++) {
-				snprintf(channelname, sizeof(channelname), "CH%d", i + 1);
-				sr_channel_new(in->sdi, i, SR_CHANNEL_ANALOG, TRUE, channelname);
-			}
-		}
+	if (!in->sdi_ready)
+		return check_header(in, in->buf->str, in->buf->len);
 
-		inc->create_channels = FALSE;
+	return process_buffer(in);
+}
 
-		/* sdi is ready, notify frontend. */
-		in->sdi_ready = TRUE;
+/*
+ * Samples get converted straight from the mapped file, float samples
+ * are sent without a copy.
+ */
+static int receive_mapped(struct sr_input *in, const uint8_t *data,
+	size_t length, size_t *used)
+{
+	if (length < MIN_DATA_CHUNK_OFFSET)
 		return SR_OK;
-	}
 
-	ret = process_buffer(in);
+	if (!in->sdi_ready)
+		return check_header(in, (const char *)data, length);
 
-	return ret;
+	return process_data(in, (const char *)data, length, TRUE, used);
 }
 
 static int end(struct sr_input *in)
@@ -390,15 +464,24 @@ static int reset(struct sr_input *in)
 	return SR_OK;
 }
 
+static const struct sr_input_magic magic[] = {
+	{ 0, "RIFF", FALSE },
+	{ 8, "WAVE", FALSE },
+	{ 12, "fmt ", FALSE },
+	ALL_ZERO
+};
+
 SR_PRIV struct sr_input_module input_wav = {
 	.id = "wav",
 	.name = "WAV",
 	.desc = "Microsoft WAV file format data",
 	.exts = (const char*[]){"wav", NULL},
 	.metadata = { SR_INPUT_META_HEADER | SR_INPUT_META_REQUIRED },
+	.magic = magic,
 	.format_match = format_match,
 	.init = init,
 	.receive = receive,
+	.receive_mapped = receive_mapped,
 	.end = end,
 	.reset = reset,
 };
@@ -370,6 +370,19 @@ struct sr_input {
 	struct sr_dev_inst *sdi;
 	gboolean sdi_ready;
 	void *priv;
+	/** Input file mapping of sr_input_send_file(), and the read position. */
+	GMappedFile *mapping;
+	size_t mapping_pos;
+};
+
+/** Signature of an input file format, see sr_input_module. */
+struct sr_input_magic {
+	/** Position of the signature, in bytes from the start. */
+	size_t offset;
+	/** The signature text. */
+	const char *text;
+	/** Whether the position is after leading whitespace (and BOM). */
+	gboolean after_space;
 };
 
 /** Input (file) module driver. */
@@ -416,6 +429,18 @@ struct sr_input_module {
 	 */
 	const uint8_t metadata[8];
 
+	/**
+	 * Signatures which the start of an input stream must contain, for
+	 * the stream to be worth a format_match() call. Terminated by an
+	 * item with NULL text. Can be NULL, then format_match() always
+	 * gets called. All items must match.
+	 *
+	 * This allows scanning large numbers of files without running
+	 * the (potentially expensive) format_match() routines of modules
+	 * which cannot handle the file anyway.
+	 */
+	const struct sr_input_magic *magic;
+
 	/**
 	 * Returns a NULL-terminated list of options this module can take.
 	 * Can be NULL, if the module has no options.
@@ -471,6 +496,27 @@ struct sr_input_module {
 	 */
 	int (*receive) (struct sr_input *in, GString *buf);
 
+	/**
+	 * Send a read-only view of input data to the specified input instance.
+	 *
+	 * This is an optional alternative to receive(), which gets used by
+	 * sr_input_send_file() for memory mapped input files. The module
+	 * processes data in place, and may send packets which point into
+	 * the view. The view stays valid until the input instance gets
+	 * reset or freed. The number of bytes which were consumed gets
+	 * returned in 'used', the remainder is offered again in the next
+	 * call. Not consuming anything when the device instance is ready
+	 * means that the module waits for end().
+	 *
+	 * Like receive(), this returns the moment the device instance
+	 * becomes ready.
+	 *
+	 * @retval SR_OK Success
+	 * @retval other Negative error code.
+	 */
+	int (*receive_mapped) (struct sr_input *in, const uint8_t *data,
+		size_t length, size_t *used);
+
 	/**
 	 * Signal the input module no more data will come.
 	 *
@@ -528,6 +574,12 @@ struct sr_output {
 	 * there, and only flush it when it reaches a certain size.
 	 */
 	void *priv;
+
+	/**
+	 * State which the outputs of a fan-out share, see
+	 * sr_output_fanout_new(). NULL for outputs on their own.
+	 */
+	struct sr_output_shared *shared;
 };
 
 /** Output module driver. */
@@ -610,6 +662,30 @@ struct sr_output_module {
 	int (*receive) (const struct sr_output *o,
 			const struct sr_datafeed_packet *packet, GString **out);
 
+	/**
+	 * This function is passed a copy of every packet in the data feed,
+	 * like receive(). It's an optional alternative to receive(), and
+	 * writes the output to the sink instead of returning it.
+	 *
+	 * Text output gets appended to the buffer which
+	 * sr_output_sink_text() returns. That buffer is reused across
+	 * packets. Larger blocks of data, like the packet's samples, can
+	 * be passed to sr_output_sink_write() without a copy.
+	 *
+	 * Modules which implement this function don't need to implement
+	 * receive(), sr_output_send() collects their output in a GString.
+	 *
+	 * @param o Pointer to the respective 'struct sr_output'.
+	 * @param packet The complete packet.
+	 * @param sink The sink to write the output to.
+	 *
+	 * @retval SR_OK Success
+	 * @retval other Negative error code.
+	 */
+	int (*receive_sink) (const struct sr_output *o,
+			const struct sr_datafeed_packet *packet,
+			struct sr_output_sink *sink);
+
 	/**
 	 * This function is called after the caller is finished using
 	 * the output module, and can be used to free any internal
@@ -924,6 +1000,10 @@ SR_PRIV void sr_zip_discard(struct zip *archive);
 
 SR_PRIV GKeyFile *sr_sessionfile_read_metadata(struct zip *archive,
 			const struct zip_stat *entry);
+SR_PRIV void sr_sessionfile_filter_logic(const uint8_t *data, size_t length,
+		size_t unitsize, uint8_t *out);
+SR_PRIV void sr_sessionfile_unfilter_logic(const uint8_t *data, size_t length,
+		size_t unitsize, uint8_t *out);
 
 /*--- analog.c --------------------------------------------------------------*/
 
@@ -938,6 +1018,50 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
 typedef int (*dev_close_callback)(struct sr_dev_inst *sdi);
 typedef void (*std_dev_clear_callback)(void *priv);
 
+/** State of a chunked logic data feed, see std_logic_feed_init(). */
+struct std_logic_feed {
+	const struct sr_dev_inst *sdi;
+	size_t unitsize;
+	/** Maximum logic packet payload size in bytes. */
+	size_t chunk_size;
+	/** Sample index of the pending trigger, or -1. */
+	int64_t trigger_at;
+	/** Number of samples sent so far. */
+	uint64_t samples_sent;
+	/** Collects data passed to std_logic_feed_append(). */
+	uint8_t *buffer;
+	/** Number of bytes in the buffer. */
+	size_t fill;
+};
+
+/** Maximum number of chunks in flight in a std_pipeline. */
+#define STD_PIPELINE_MAX_SLOTS	8
+
+struct std_pipeline;
+
+/** Per-chunk callback of a std_pipeline, see std_pipeline_run(). */
+typedef int (*std_pipeline_callback)(struct std_pipeline *pl,
+	const uint8_t *data, size_t length, unsigned int slot);
+
+/** State of an ordered chunk pipeline, see std_pipeline_init(). */
+struct std_pipeline {
+	/** The input data, and the size of the chunks it gets split into. */
+	const uint8_t *data;
+	size_t length;
+	size_t chunk_size;
+	/** Number of chunks in flight, 1 disables worker threads. */
+	unsigned int num_slots;
+	/** The data is mapped from a file, its pages get read ahead. */
+	gboolean mapped;
+	/** Prepares a chunk in a worker thread, or NULL. */
+	std_pipeline_callback prepare;
+	/** Sends a chunk from the calling thread, in order. */
+	std_pipeline_callback send;
+	/** Per-slot results of prepare(), for use by the callbacks. */
+	void *slot_data[STD_PIPELINE_MAX_SLOTS];
+	void *cb_data;
+};
+
 SR_PRIV int std_init(struct sr_dev_driver *di, struct sr_context *sr_ctx);
 SR_PRIV int std_cleanup(const struct sr_dev_driver *di);
 SR_PRIV int std_dummy_dev_open(struct sr_dev_inst *sdi);
@@ -952,6 +1076,18 @@ SR_PRIV int std_session_send_df_header(const struct sr_dev_inst *sdi);
 SR_PRIV int std_session_send_df_end(const struct sr_dev_inst *sdi);
 SR_PRIV int std_session_send_frame_begin(const struct sr_dev_inst *sdi);
 SR_PRIV int std_session_send_frame_end(const struct sr_dev_inst *sdi);
+SR_PRIV int std_logic_feed_init(struct std_logic_feed *feed,
+	const struct sr_dev_inst *sdi, size_t unitsize,
+	size_t chunk_size, int64_t trigger_at);
+SR_PRIV int std_logic_feed_send(struct std_logic_feed *feed,
+	const uint8_t *data, size_t length);
+SR_PRIV int std_logic_feed_append(struct std_logic_feed *feed,
+	const uint8_t *data, size_t length);
+SR_PRIV int std_logic_feed_flush(struct std_logic_feed *feed);
+SR_PRIV void std_logic_feed_free(struct std_logic_feed *feed);
+SR_PRIV void std_pipeline_init(struct std_pipeline *pl, const uint8_t *data,
+	size_t length, size_t chunk_size);
+SR_PRIV int std_pipeline_run(struct std_pipeline *pl);
 SR_PRIV int std_dev_clear_with_callback(const struct sr_dev_driver *driver,
 		std_dev_clear_callback clear_private);
 SR_PRIV int std_dev_clear(const struct sr_dev_driver *driver);
@@ -1017,6 +1153,33 @@ SR_PRIV void *sr_resource_load(struct sr_context *ctx, int type,
 		const char *name, size_t *size, size_t max_size)
 		G_GNUC_MALLOC G_GNUC_WARN_UNUSED_RESULT;
 
+/*--- lz4.c -----------------------------------------------------------------*/
+
+SR_PRIV size_t sr_lz4_compress_bound(size_t length);
+SR_PRIV size_t sr_lz4_compress(const uint8_t *src, size_t length,
+		uint8_t *dst, size_t size);
+SR_PRIV int sr_lz4_decompress(const uint8_t *src, size_t length,
+		uint8_t *dst, size_t size, size_t *written);
+
+/*--- output/output.c -------------------------------------------------------*/
+
+SR_PRIV void sr_output_transpose_logic(const uint8_t *data, size_t unitsize,
+		size_t count, uint8_t *bits, size_t columns);
+
+/*--- output/sink.c ---------------------------------------------------------*/
+
+SR_PRIV struct sr_output_sink *sr_output_sink_new_string(GString *string);
+SR_PRIV GString *sr_output_sink_text(struct sr_output_sink *sink);
+SR_PRIV int sr_output_sink_write(struct sr_output_sink *sink,
+		const void *data, size_t len);
+SR_PRIV int sr_output_sink_packet_done(struct sr_output_sink *sink);
+
+/*--- output/fanout.c -------------------------------------------------------*/
+
+SR_PRIV int sr_output_analog_to_float(const struct sr_output *o,
+		const struct sr_datafeed_analog *analog, float **buf,
+		size_t *buf_size, const float **values);
+
 /*--- strutil.c -------------------------------------------------------------*/
 
 SR_PRIV int sr_atol(const char *str, long *ret);
@@ -1031,6 +1194,17 @@ SR_PRIV void sr_hexdump_free(GString *s);
 
 /*--- soft-trigger.c --------------------------------------------------------*/
 
+/*
+ * A trigger stage compiled into channel bit masks, so that all matches of
+ * the stage can be checked against a sample with a few word operations.
+ */
+struct soft_trigger_stage_masks {
+	uint64_t one_mask;
+	uint64_t zero_mask;
+	uint64_t change_mask;
+	gboolean empty;
+};
+
 struct soft_trigger_logic {
 	const struct sr_dev_inst *sdi;
 	const struct sr_trigger *trigger;
@@ -1042,6 +1216,9 @@ struct soft_trigger_logic {
 	uint8_t *pre_trigger_head;
 	int pre_trigger_size;
 	int pre_trigger_fill;
+	/* NULL if the trigger can't be checked word-parallel. */
+	struct soft_trigger_stage_masks *stage_masks;
+	uint64_t prev_word;
 };
 
 SR_PRIV int logic_channel_unitsize(GSList *channels);
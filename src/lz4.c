@@ -0,0 +1,324 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ *
+ * Compression of sample data in the LZ4 block format.
+ *
+ * Blocks are a sequence of literal runs and back references into the
+ * previous 64 KiB of the block, which makes compression and especially
+ * decompression fast. Logic data with its long runs of repeated samples
+ * compresses well with it. Blocks are independent, containers keep the
+ * uncompressed size of each block.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "lz4"
+
+#define MIN_MATCH	4
+#define MAX_OFFSET	65535
+/* The block format requires literals at the end of the data. */
+#define LAST_LITERALS	5
+#define MATCH_LIMIT	12
+#define HASH_BITS	12
+/* Searches without a match before the step size grows. */
+#define SKIP_SHIFT	6
+
+static inline uint32_t load32(const uint8_t *p)
+{
+	uint32_t value;
+
+	memcpy(&value, p, sizeof(value));
+
+	return value;
+}
+
+/* Hash of the five bytes at p. */
+static inline uint32_t hash5(const uint8_t *p)
+{
+	return ((RL64(p) << 24) * 889523592379ULL) >> (64 - HASH_BITS);
+}
+
+/* Number of equal bytes at a and b, up to the limit. */
+static inline size_t match_length(const uint8_t *a, const uint8_t *b,
+		const uint8_t *limit)
+{
+	const uint8_t *start;
+	uint64_t diff;
+
+	start = a;
+	while (a + 8 <= limit) {
+		diff = RL64(a) ^ RL64(b);
+		if (diff) {
+#ifdef __GNUC__
+			return a - start + __builtin_ctzll(diff) / 8;
+#else
+			while (!(diff & 0xff)) {
+				diff >>= 8;
+				a++;
+			}
+			return a - start;
+#endif
+		}
+		a += 8;
+		b += 8;
+	}
+	while (a < limit && *a == *b) {
+		a++;
+		b++;
+	}
+
+	return a - start;
+}
+
+static inline uint8_t *put_length(uint8_t *op, size_t len)
+{
+	while (len >= 255) {
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = len;
+
+	return op;
+}
+
+static inline uint8_t *put_literals(uint8_t *op, uint8_t *token,
+		const uint8_t *src, size_t len)
+{
+	if (len >= 15) {
+		*token = 15 << 4;
+		op = put_length(op, len - 15);
+	} else {
+		*token = len << 4;
+	}
+	memcpy(op, src, len);
+
+	return op + len;
+}
+
+/**
+ * Get the largest possible size of compressed data.
+ *
+ * @param length The size of the uncompressed data.
+ *
+ * @return The size of the buffer sr_lz4_compress() needs.
+ *
+ * @private
+ */
+SR_PRIV size_t sr_lz4_compress_bound(size_t length)
+{
+	return length + length / 255 + 16;
+}
+
+/**
+ * Compress a block of data.
+ *
+ * @param src The data to compress.
+ * @param length The size of the data.
+ * @param dst The buffer for the compressed data.
+ * @param size The size of the buffer, at least
+ *             sr_lz4_compress_bound(length).
+ *
+ * @return The size of the compressed data, or 0 if the buffer is too
+ *         small.
+ *
+ * @private
+ */
+SR_PRIV size_t sr_lz4_compress(const uint8_t *src, size_t length,
+		uint8_t *dst, size_t size)
+{
+	uint32_t table[1 << HASH_BITS];
+	const uint8_t *ip, *anchor, *match, *end, *mflimit, *mlimit;
+	uint8_t *op, *token;
+	size_t len;
+	uint32_t h, misses;
+
+	if (size < sr_lz4_compress_bound(length))
+		return 0;
+
+	ip = anchor = src;
+	end = src + length;
+	op = dst;
+
+	if (length > MATCH_LIMIT) {
+		/* Positions start out at 0, the match check rejects them. */
+		memset(table, 0, sizeof(table));
+		mflimit = end - MATCH_LIMIT;
+		mlimit = end - LAST_LITERALS;
+		ip++;
+		for (;;) {
+			/* Look for a match, faster through data without any. */
+			misses = 1 << SKIP_SHIFT;
+			for (;;) {
+				if (ip > mflimit)
+					goto last_literals;
+				h = hash5(ip);
+				match = src + table[h];
+				table[h] = ip - src;
+				if (ip - match <= MAX_OFFSET && match < ip
+						&& load32(match) == load32(ip))
+					break;
+				ip += misses++ >> SKIP_SHIFT;
+			}
+found:
+
+			while (ip > anchor && match > src && ip[-1] == match[-1]) {
+				ip--;
+				match--;
+			}
+			len = MIN_MATCH + match_length(ip + MIN_MATCH,
+				match + MIN_MATCH, mlimit);
+
+			token = op++;
+			op = put_literals(op, token, anchor, ip - anchor);
+			WL16(op, ip - match);
+			op += 2;
+			if (len - MIN_MATCH >= 15) {
+				*token |= 15;
+				op = put_length(op, len - MIN_MATCH - 15);
+			} else {
+				*token |= len - MIN_MATCH;
+			}
+
+			ip += len;
+			anchor = ip;
+			if (ip > mflimit)
+				break;
+			h = hash5(ip - 2);
+			table[h] = ip - 2 - src;
+
+			/* Runs of matches without literals are common. */
+			h = hash5(ip);
+			match = src + table[h];
+			table[h] = ip - src;
+			if (ip - match <= MAX_OFFSET && match < ip
+					&& load32(match) == load32(ip))
+				goto found;
+			ip++;
+		}
+	}
+
+last_literals:
+	token = op++;
+	op = put_literals(op, token, anchor, end - anchor);
+
+	return op - dst;
+}
+
+/**
+ * Decompress a block of data.
+ *
+ * The data is checked, corrupt data never gets read or written outside
+ * of the buffers.
+ *
+ * @param src The compressed data.
+ * @param length The size of the compressed data.
+ * @param dst The buffer for the uncompressed data.
+ * @param size The size of the buffer.
+ * @param written The size of the uncompressed data is stored here.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_DATA The data is corrupt, or does not fit the buffer.
+ *
+ * @private
+ */
+SR_PRIV int sr_lz4_decompress(const uint8_t *src, size_t length,
+		uint8_t *dst, size_t size, size_t *written)
+{
+	const uint8_t *ip, *end, *match;
+	uint8_t *op, *op_end;
+	size_t len, offset;
+	uint8_t token, b;
+
+	ip = src;
+	end = src + length;
+	op = dst;
+	op_end = dst + size;
+
+	while (ip < end) {
+		token = *ip++;
+
+		len = token >> 4;
+		if (len == 15) {
+			do {
+				if (ip == end)
+					goto corrupt;
+				b = *ip++;
+				len += b;
+			} while (b == 255);
+		}
+		if (len > (size_t)(end - ip) || len > (size_t)(op_end - op))
+			goto corrupt;
+		memcpy(op, ip, len);
+		ip += len;
+		op += len;
+
+		/* The last sequence has no match. */
+		if (ip == end)
+			break;
+
+		if (end - ip < 2)
+			goto corrupt;
+		offset = RL16(ip);
+		ip += 2;
+		if (!offset || offset > (size_t)(op - dst))
+			goto corrupt;
+
+		len = token & 15;
+		if (len == 15) {
+			do {
+				if (ip == end)
+					goto corrupt;
+				b = *ip++;
+				len += b;
+			} while (b == 255);
+		}
+		len += MIN_MATCH;
+		if (len > (size_t)(op_end - op))
+			goto corrupt;
+
+		/*
+		 * A match can overlap the output, repeating a short pattern.
+		 * Copy whole repetitions, their number doubles every time.
+		 */
+		match = op - offset;
+		while (len > (size_t)(op - match)) {
+			offset = op - match;
+			memcpy(op, match, offset);
+			op += offset;
+			len -= offset;
+		}
+		memcpy(op, match, len);
+		op += len;
+	}
+
+	*written = op - dst;
+
+	return SR_OK;
+
+corrupt:
+	sr_err("Corrupt compressed data.");
+
+	return SR_ERR_DATA;
+}
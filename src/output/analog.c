@@ -29,11 +29,28 @@
 
 #define BIN_TO_DEC_DIGITS (log(2) / log(10))
 
+/* Samples per block of lines, for which the text buffer is presized. */
+#define SAMPLES_PER_BLOCK 256
+
+/* Room for a number, beyond the digits after the decimal point. */
+#define NUMBER_SIZE 48
+
+/* Number of SI prefixes below unity, as in sr_analog_si_prefix(). */
+#define NEG_PREFIX_COUNT 5
+#define POS_PREFIX_COUNT 4
+
 struct context {
 	int num_enabled_channels;
 	GPtrArray *channellist;
 	int digits;
+	gboolean columns;
 	float *fdata;
+	size_t fdata_size;
+	/* Scale factors for each SI prefix, as sr_analog_si_prefix() uses. */
+	float si_scale[NEG_PREFIX_COUNT + POS_PREFIX_COUNT + 1];
+	/* Column heading of the last analog packet, in columns mode. */
+	GString *heading;
+	GString *prev_heading;
 };
 
 enum {
@@ -47,6 +64,7 @@ static int init(struct sr_output *o, GHashTable *options)
 	struct sr_channel *ch;
 	GSList *l;
 	const char *s;
+	int prefix;
 
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
@@ -57,6 +75,8 @@ static int init(struct sr_output *o, GHashTable *options)
 		ctx->digits = DIGITS_ALL;
 	else
 		ctx->digits = DIGITS_SPEC;
+	s = g_variant_get_string(g_hash_table_lookup(options, "layout"), NULL);
+	ctx->columns = !strcmp(s, "columns");
 
 	/* Get the number of channels and their names. */
 	ctx->channellist = g_ptr_array_new();
@@ -69,35 +89,382 @@ static int init(struct sr_output *o, GHashTable *options)
 	}
 	ctx->fdata = NULL;
 
+	for (prefix = -NEG_PREFIX_COUNT; prefix <= POS_PREFIX_COUNT; prefix++)
+		ctx->si_scale[prefix + NEG_PREFIX_COUNT] = powf(10, -3 * prefix);
+	ctx->heading = g_string_sized_new(128);
+	ctx->prev_heading = g_string_sized_new(128);
+
 	return SR_OK;
 }
 
-static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
-		GString **out)
+/*
+ * Same as sr_analog_si_prefix(), but compares the value against the
+ * prefixes' ranges instead of taking its logarithm. Values which are
+ * close to a range's limit, where rounding of the logarithm matters,
+ * take the regular path.
+ */
+static const char *si_prefix(const struct context *ctx, float *value,
+		int *digits)
+{
+	static const char *prefixes[] = { "f", "p", "n", "µ", "m", "", "k", "M", "G", "T" };
+	/* Limits of the prefixes' ranges, "f" down to below 1e-15. */
+	static const double limits[] = {
+		1e-15, 1e-12, 1e-9, 1e-6, 1e-3, 1, 1e3, 1e6, 1e9, 1e12,
+	};
+	double mag;
+	int prefix, i;
+
+	mag = fabsf(*value);
+	if (!(mag > 0) || isinf(mag))
+		return sr_analog_si_prefix(value, digits);
+
+	for (i = 0; i < (int)ARRAY_SIZE(limits); i++) {
+		if (fabs(mag - limits[i]) < limits[i] * 1e-5)
+			return sr_analog_si_prefix(value, digits);
+		if (mag < limits[i])
+			break;
+	}
+	prefix = i - 6;
+
+	if (prefix < -NEG_PREFIX_COUNT)
+		prefix = -NEG_PREFIX_COUNT;
+	if (3 * prefix < -*digits)
+		prefix = (-*digits + 2 * (*digits < 0)) / 3;
+	if (prefix > POS_PREFIX_COUNT)
+		prefix = POS_PREFIX_COUNT;
+
+	*value *= ctx->si_scale[prefix + NEG_PREFIX_COUNT];
+	*digits += 3 * prefix;
+
+	return prefixes[prefix + NEG_PREFIX_COUNT];
+}
+
+/* Powers of ten which are exact as doubles. */
+static const double powers[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static char *format_uint(char *p, uint64_t n, int min_digits)
+{
+	char text[24];
+	int pos;
+
+	pos = sizeof(text);
+	do {
+		text[--pos] = '0' + n % 10;
+		n /= 10;
+	} while (n || (int)sizeof(text) - pos < min_digits);
+	memcpy(p, text + pos, sizeof(text) - pos);
+
+	return p + sizeof(text) - pos;
+}
+
+/*
+ * Print a value with a fixed number of decimals, like "%.*f" does, but
+ * always with a decimal point. The buffer holds at least NUMBER_SIZE +
+ * decimals bytes.
+ */
+static size_t format_fixed(char *buf, float value, int decimals)
+{
+	char format[16], *p;
+	double v, scaled, frac;
+	uint64_t n;
+
+	v = fabs(value);
+	if (!isfinite(v) || decimals >= (int)ARRAY_SIZE(powers))
+		goto slow;
+	scaled = v * powers[decimals];
+	/* Scaling is exact enough, unless the result is close to a tie. */
+	if (scaled >= 4e15)
+		goto slow;
+	n = scaled;
+	frac = scaled - n;
+	if (fabs(frac - 0.5) <= scaled * 2.5e-16)
+		goto slow;
+	if (frac > 0.5)
+		n++;
+
+	p = buf;
+	if (signbit(value))
+		*p++ = '-';
+	p = format_uint(p, n, decimals + 1);
+	if (decimals) {
+		/* Move the decimals over, to make room for the point. */
+		memmove(p - decimals + 1, p - decimals, decimals);
+		p[-decimals] = '.';
+		p++;
+	}
+
+	return p - buf;
+
+slow:
+	snprintf(format, sizeof(format), "%%.%df", decimals);
+	g_ascii_formatd(buf, NUMBER_SIZE + decimals, format, value);
+
+	return strlen(buf);
+}
+
+static double power_of_ten(int exp)
+{
+	double power;
+	int i;
+
+	power = 1;
+	for (i = abs(exp); i > 22; i -= 22)
+		power *= powers[22];
+	power *= powers[i];
+
+	return exp < 0 ? 1 / power : power;
+}
+
+/*
+ * Print the shortest decimal number which reads back as the same float.
+ * The buffer holds at least NUMBER_SIZE bytes.
+ */
+static size_t format_shortest(char *buf, float value)
+{
+	char digits[24], *p;
+	double v, lower, upper, decimal;
+	uint64_t n;
+	uint32_t bits;
+	int exp, precision, num_digits, i;
+	gboolean even;
+
+	p = buf;
+	if (isnan(value)) {
+		strcpy(buf, "nan");
+		return 3;
+	}
+	if (signbit(value))
+		*p++ = '-';
+	v = fabsf(value);
+	if (isinf(v)) {
+		strcpy(p, "inf");
+		return p + 3 - buf;
+	}
+	if (v == 0) {
+		*p++ = '0';
+		return p - buf;
+	}
+
+	/*
+	 * Decimals between the midpoints to the neighbouring floats read
+	 * back as this value, and so do the midpoints themselves when the
+	 * value is even. The midpoints are exact as doubles.
+	 */
+	lower = (v + nextafterf(v, 0)) / 2;
+	upper = (v + nextafterf(v, INFINITY)) / 2;
+	memcpy(&bits, &value, sizeof(bits));
+	even = !(bits & 1);
+
+	frexp(v, &exp);
+	exp = floor((exp - 1) * 0.30103);
+	if (v >= power_of_ten(exp + 1))
+		exp++;
+	for (precision = 1; precision <= 9; precision++) {
+		n = v * power_of_ten(precision - 1 - exp) + 0.5;
+		decimal = n * power_of_ten(exp - precision + 1);
+		/* Leave a margin for the rounding of the double math. */
+		if (decimal > lower + lower * 1e-15
+				&& decimal < upper - upper * 1e-15)
+			break;
+		/* Whole numbers below 2^53 are exact, ties can be told. */
+		if (even && exp >= precision - 1 && decimal < 0x1p53
+				&& (decimal == lower || decimal == upper))
+			break;
+	}
+	if (precision > 9) {
+		g_ascii_formatd(buf, NUMBER_SIZE, "%.9g", value);
+		return strlen(buf);
+	}
+
+	/* Get the digits without trailing zeros, and the exponent. */
+	num_digits = format_uint(digits, n, 1) - digits;
+	exp += num_digits - precision;
+	while (num_digits > 1 && digits[num_digits - 1] == '0')
+		num_digits--;
+
+	if (exp < -4 || exp >= 9) {
+		*p++ = digits[0];
+		if (num_digits > 1) {
+			*p++ = '.';
+			memcpy(p, digits + 1, num_digits - 1);
+			p += num_digits - 1;
+		}
+		*p++ = 'e';
+		*p++ = exp < 0 ? '-' : '+';
+		p = format_uint(p, abs(exp), 2);
+	} else if (exp < 0) {
+		*p++ = '0';
+		*p++ = '.';
+		for (i = exp + 1; i < 0; i++)
+			*p++ = '0';
+		memcpy(p, digits, num_digits);
+		p += num_digits;
+	} else {
+		for (i = 0; i <= exp; i++)
+			*p++ = i < num_digits ? digits[i] : '0';
+		if (num_digits > exp + 1) {
+			*p++ = '.';
+			memcpy(p, digits + exp + 1, num_digits - exp - 1);
+			p += num_digits - exp - 1;
+		}
+	}
+
+	return p - buf;
+}
+
+/* Comment lines in columns mode, to keep the columns easy to parse. */
+static void append_note(const struct context *ctx, GString *out,
+		const char *text)
+{
+	if (ctx->columns)
+		g_string_append(out, "# ");
+	g_string_append(out, text);
+}
+
+/* One line per channel and sample: name, value, prefix and unit. */
+static void process_lines(const struct context *ctx, GString *out,
+		const struct sr_datafeed_analog *analog, const float *fdata,
+		int digits)
+{
+	struct sr_channel *ch;
+	GSList *l;
+	gboolean si_friendly;
+	char *suffix, *p;
+	size_t name_size, suffix_len, line_size, pos;
+	unsigned int i, end, num_channels, c;
+	int actual_digits;
+	const char *prefix;
+	float value;
+
+	num_channels = g_slist_length(analog->meaning->channels);
+	si_friendly = sr_analog_si_prefix_friendly(analog->meaning->unit);
+	sr_analog_unit_to_string(analog, &suffix);
+	suffix_len = strlen(suffix);
+
+	name_size = 0;
+	for (l = analog->meaning->channels; l; l = l->next) {
+		ch = l->data;
+		name_size = MAX(name_size, strlen(ch->name));
+	}
+	/*
+	 * Name, ": ", number, " ", prefix, unit and newline. The prefix
+	 * adds up to three digits per step.
+	 */
+	line_size = name_size + 2 + NUMBER_SIZE
+		+ MAX(digits + 3 * POS_PREFIX_COUNT, 0)
+		+ 1 + strlen("µ") + suffix_len + 1;
+
+	for (i = 0; i < analog->num_samples; i = end) {
+		end = MIN(analog->num_samples, i + SAMPLES_PER_BLOCK);
+		pos = out->len;
+		g_string_set_size(out, pos + (end - i) * num_channels * line_size);
+		p = out->str + pos;
+		for (; i < end; i++) {
+			for (l = analog->meaning->channels, c = 0; l; l = l->next, c++) {
+				value = fdata[i * num_channels + c];
+				prefix = "";
+				actual_digits = digits;
+				if (si_friendly)
+					prefix = si_prefix(ctx, &value, &actual_digits);
+				ch = l->data;
+				pos = strlen(ch->name);
+				memcpy(p, ch->name, pos);
+				p += pos;
+				*p++ = ':';
+				*p++ = ' ';
+				p += format_fixed(p, value, MAX(actual_digits, 0));
+				*p++ = ' ';
+				pos = strlen(prefix);
+				memcpy(p, prefix, pos);
+				p += pos;
+				memcpy(p, suffix, suffix_len);
+				p += suffix_len;
+				*p++ = '\n';
+			}
+		}
+		g_string_truncate(out, p - out->str);
+	}
+	g_free(suffix);
+}
+
+/*
+ * One line per sample, with a column per channel. The values are
+ * printed without SI prefix, and with as many digits as it takes to
+ * read them back exactly. A heading names the columns and their unit
+ * whenever they change.
+ */
+static void process_columns(struct context *ctx, GString *out,
+		const struct sr_datafeed_analog *analog, const float *fdata)
+{
+	struct sr_channel *ch;
+	GSList *l;
+	GString *heading;
+	char *suffix, *p;
+	size_t pos;
+	unsigned int i, end, num_channels, c;
+
+	num_channels = g_slist_length(analog->meaning->channels);
+	sr_analog_unit_to_string(analog, &suffix);
+	g_string_assign(ctx->heading, "#");
+	for (l = analog->meaning->channels; l; l = l->next) {
+		ch = l->data;
+		g_string_append_printf(ctx->heading, "%c%s [%s]",
+			l == analog->meaning->channels ? ' ' : '\t',
+			ch->name, suffix);
+	}
+	g_string_append_c(ctx->heading, '\n');
+	g_free(suffix);
+	if (!g_string_equal(ctx->heading, ctx->prev_heading)) {
+		g_string_append_len(out, ctx->heading->str, ctx->heading->len);
+		heading = ctx->prev_heading;
+		ctx->prev_heading = ctx->heading;
+		ctx->heading = heading;
+	}
+
+	for (i = 0; i < analog->num_samples; i = end) {
+		end = MIN(analog->num_samples, i + SAMPLES_PER_BLOCK);
+		pos = out->len;
+		g_string_set_size(out, pos + (end - i) * num_channels * NUMBER_SIZE);
+		p = out->str + pos;
+		for (; i < end; i++) {
+			for (c = 0; c < num_channels; c++) {
+				if (c)
+					*p++ = '\t';
+				p += format_shortest(p, fdata[i * num_channels + c]);
+			}
+			*p++ = '\n';
+		}
+		g_string_truncate(out, p - out->str);
+	}
+}
+
+static int receive_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, struct sr_output_sink *sink)
 {
 	struct context *ctx;
 	const struct sr_datafeed_analog *analog;
 	const struct sr_datafeed_meta *meta;
 	const struct sr_config *src;
 	const struct sr_key_info *srci;
-	struct sr_channel *ch;
 	GSList *l;
-	float *fdata;
-	unsigned int i;
-	int num_channels, c, ret, digits, actual_digits;
-	char *number, *suffix;
+	GString *out;
+	const float *fdata;
+	int ret, digits;
 
-	*out = NULL;
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 	ctx = o->priv;
+	out = sr_output_sink_text(sink);
 
 	switch (packet->type) {
 	case SR_DF_FRAME_BEGIN:
-		*out = g_string_new("FRAME-BEGIN\n");
+		append_note(ctx, out, "FRAME-BEGIN\n");
 		break;
 	case SR_DF_FRAME_END:
-		*out = g_string_new("FRAME-END\n");
+		append_note(ctx, out, "FRAME-END\n");
 		break;
 	case SR_DF_META:
 		meta = packet->payload;
@@ -105,60 +472,39 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			src = l->data;
 			if (!(srci = sr_key_info_get(SR_KEY_CONFIG, src->key)))
 				return SR_ERR;
-			*out = g_string_sized_new(512);
-			g_string_append(*out, "META ");
-			g_string_append_printf(*out, "%s: ", srci->id);
+			append_note(ctx, out, "META ");
+			g_string_append_printf(out, "%s: ", srci->id);
 			if (srci->datatype == SR_T_BOOL) {
-				g_string_append_printf(*out, "%u",
+				g_string_append_printf(out, "%u",
 					g_variant_get_boolean(src->data));
 			} else if (srci->datatype == SR_T_FLOAT) {
-				g_string_append_printf(*out, "%f",
+				g_string_append_printf(out, "%f",
 					g_variant_get_double(src->data));
 			} else if (srci->datatype == SR_T_UINT64) {
-				g_string_append_printf(*out, "%"
+				g_string_append_printf(out, "%"
 					G_GUINT64_FORMAT,
 					g_variant_get_uint64(src->data));
 			}
-			g_string_append(*out, "\n");
+			g_string_append(out, "\n");
 		}
 		break;
 	case SR_DF_ANALOG:
 		analog = packet->payload;
-		num_channels = g_slist_length(analog->meaning->channels);
-		if (!(fdata = g_try_realloc(ctx->fdata,
-						analog->num_samples * num_channels * sizeof(float))))
-			return SR_ERR_MALLOC;
-		ctx->fdata = fdata;
-		if ((ret = sr_analog_to_float(analog, fdata)) != SR_OK)
+		ret = sr_output_analog_to_float(o, analog, &ctx->fdata,
+			&ctx->fdata_size, &fdata);
+		if (ret != SR_OK)
 			return ret;
-		*out = g_string_sized_new(512);
+		if (ctx->columns) {
+			process_columns(ctx, out, analog, fdata);
+			break;
+		}
 		if (ctx->digits == DIGITS_ALL)
 			digits = analog->encoding->digits;
 		else
 			digits = analog->spec->spec_digits;
 		if (!analog->encoding->is_digits_decimal)
 			digits = copysign(ceil(abs(digits) * BIN_TO_DEC_DIGITS), digits);
-		gboolean si_friendly = sr_analog_si_prefix_friendly(analog->meaning->unit);
-		sr_analog_unit_to_string(analog, &suffix);
-		for (i = 0; i < analog->num_samples; i++) {
-			for (l = analog->meaning->channels, c = 0; l; l = l->next, c++) {
-				float value = fdata[i * num_channels + c];
-				const char *prefix = "";
-				actual_digits = digits;
-				if (si_friendly)
-					prefix = sr_analog_si_prefix(&value, &actual_digits);
-				ch = l->data;
-				g_string_append_printf(*out, "%s: ", ch->name);
-				number = g_strdup_printf("%.*f", MAX(actual_digits, 0), value);
-				g_string_append(*out, number);
-				g_free(number);
-				g_string_append(*out, " ");
-				g_string_append(*out, prefix);
-				g_string_append(*out, suffix);
-				g_string_append(*out, "\n");
-			}
-		}
-		g_free(suffix);
+		process_lines(ctx, out, analog, fdata, digits);
 		break;
 	}
 
@@ -167,6 +513,7 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 
 static struct sr_option options[] = {
 	{ "digits", "Digits", "Digits to show", NULL, NULL },
+	{ "layout", "Layout", "One line per value, or one column per channel", NULL, NULL },
 	ALL_ZERO
 };
 
@@ -178,6 +525,11 @@ static const struct sr_option *get_options(void)
 				g_variant_ref_sink(g_variant_new_string("all")));
 		options[0].values = g_slist_append(options[0].values,
 				g_variant_ref_sink(g_variant_new_string("spec")));
+		options[1].def = g_variant_ref_sink(g_variant_new_string("lines"));
+		options[1].values = g_slist_append(options[1].values,
+				g_variant_ref_sink(g_variant_new_string("lines")));
+		options[1].values = g_slist_append(options[1].values,
+				g_variant_ref_sink(g_variant_new_string("columns")));
 	}
 
 	return options;
@@ -192,8 +544,8 @@ static int cleanup(struct sr_output *o)
 	ctx = o->priv;
 
 	g_ptr_array_free(ctx->channellist, 1);
-	g_variant_unref(options[0].def);
-	g_slist_free_full(options[0].values, (GDestroyNotify)g_variant_unref);
+	g_string_free(ctx->heading, TRUE);
+	g_string_free(ctx->prev_heading, TRUE);
 	g_free(ctx->fdata);
 	g_free(ctx);
 	o->priv = NULL;
@@ -209,6 +561,6 @@ SR_PRIV struct sr_output_module output_analog = {
 	.flags = 0,
 	.options = get_options,
 	.init = init,
-	.receive = receive,
+	.receive_sink = receive_sink,
 	.cleanup = cleanup
 };
@@ -46,12 +46,20 @@ struct context {
 	int *channel_index;
 	char **channel_names;
 	char **line_values;
-	uint8_t *prev_sample;
 	gboolean header_done;
 	GString **lines;
 	GString *header;
 	const char *charset;
 	gboolean edges;
+	/* Bits of up to 8 samples per channel, see sr_output_transpose_logic(). */
+	size_t num_columns;
+	uint8_t *channel_bits;
+	uint8_t *prev_bit;
+	/*
+	 * Text for 8 samples of a channel, the first sample in bit 0,
+	 * indexed by the previous sample's bit and the 8 bits.
+	 */
+	char bit_text[2][256][8];
 };
 
 static int init(struct sr_output *o, GHashTable *options)
@@ -59,7 +67,7 @@ static int init(struct sr_output *o, GHashTable *options)
 	struct context *ctx;
 	struct sr_channel *ch;
 	GSList *l;
-	unsigned int i, j;
+	unsigned int i, j, curbit, prevbit, charidx;
 
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
@@ -87,7 +95,7 @@ static int init(struct sr_output *o, GHashTable *options)
 	ctx->channel_index = g_malloc(sizeof(int) * ctx->num_enabled_channels);
 	ctx->channel_names = g_malloc(sizeof(char *) * ctx->num_enabled_channels);
 	ctx->lines = g_malloc(sizeof(GString *) * ctx->num_enabled_channels);
-	ctx->prev_sample = g_malloc(g_slist_length(o->sdi->channels));
+	ctx->prev_bit = g_malloc0(ctx->num_enabled_channels);
 
 	j = 0;
 	for (i = 0, l = o->sdi->channels; l; l = l->next, i++) {
@@ -98,19 +106,33 @@ static int init(struct sr_output *o, GHashTable *options)
 			continue;
 		ctx->channel_index[j] = ch->index;
 		ctx->channel_names[j] = ch->name;
-		ctx->lines[j] = g_string_sized_new(80);
+		ctx->lines[j] = g_string_sized_new(strlen(ch->name) + 2
+			+ (ctx->spl ? ctx->spl : 80));
 		g_string_printf(ctx->lines[j], "%s:", ch->name);
+		ctx->num_columns = MAX(ctx->num_columns, (size_t)ch->index / 8 + 1);
 		j++;
 	}
+	ctx->channel_bits = g_malloc0(ctx->num_columns * 8);
+
+	for (i = 0; i < 2 * 256; i++) {
+		prevbit = i >> 8;
+		for (j = 0; j < 8; j++) {
+			curbit = (i >> j) & 1;
+			charidx = curbit;
+			if (ctx->edges && curbit != prevbit)
+				charidx += 2;
+			ctx->bit_text[i >> 8][i & 0xff][j] = ctx->charset[charidx];
+			prevbit = curbit;
+		}
+	}
 
 	return SR_OK;
 }
 
-static GString *gen_header(const struct sr_output *o)
+static void gen_header(const struct sr_output *o, GString *header)
 {
 	struct context *ctx;
 	GVariant *gvar;
-	GString *header;
 	int num_channels;
 	char *samplerate_s;
 
@@ -123,8 +145,7 @@ static GString *gen_header(const struct sr_output *o)
 		}
 	}
 
-	header = g_string_sized_new(512);
-	g_string_printf(header, "%s %s\n", PACKAGE_NAME, SR_PACKAGE_VERSION_STRING);
+	g_string_append_printf(header, "%s %s\n", PACKAGE_NAME, SR_PACKAGE_VERSION_STRING);
 	num_channels = g_slist_length(o->sdi->channels);
 	g_string_append_printf(header, "Acquisition with %d/%d channels",
 			ctx->num_enabled_channels, num_channels);
@@ -134,24 +155,81 @@ static GString *gen_header(const struct sr_output *o)
 		g_free(samplerate_s);
 	}
 	g_string_append_printf(header, "\n");
+}
+
+/* Write out the complete lines of all channels. */
+static void flush_lines(struct context *ctx, GString *out)
+{
+	unsigned int j;
+	int offset;
+
+	for (j = 0; j < ctx->num_enabled_channels; j++) {
+		g_string_append_len(out, ctx->lines[j]->str, ctx->lines[j]->len);
+		g_string_append_c(out, '\n');
+		g_string_truncate(ctx->lines[j], strlen(ctx->channel_names[j]) + 1);
+	}
+	if (ctx->num_enabled_channels && ctx->trigger > -1) {
+		/*
+		 * Sample data lines have one character per bit and
+		 * no separator between bytes. Align trigger marker
+		 * to this layout.
+		 */
+		offset = ctx->trigger;
+		g_string_append_printf(out, "T:%*s^ %d\n", offset, "", ctx->trigger);
+		ctx->trigger = -1;
+	}
+}
+
+static void process_logic(struct context *ctx, GString *out,
+		const struct sr_datafeed_logic *logic)
+{
+	const uint8_t *data;
+	size_t count, chunk;
+	unsigned int j;
+	uint8_t bits, prevbit;
+
+	if (!logic->unitsize)
+		return;
+	data = logic->data;
+	count = logic->length / logic->unitsize;
+	while (count) {
+		/* Take up to 8 samples, up to the end of the line. */
+		chunk = 8;
+		if (ctx->spl)
+			chunk = MIN(chunk, (size_t)(ctx->spl - ctx->spl_cnt));
+		chunk = MIN(chunk, count);
+		sr_output_transpose_logic(data, logic->unitsize, chunk,
+			ctx->channel_bits, ctx->num_columns);
+
+		for (j = 0; j < ctx->num_enabled_channels; j++) {
+			bits = ctx->channel_bits[ctx->channel_index[j]];
+			/* Lines don't start with an edge. */
+			prevbit = ctx->spl_cnt ? ctx->prev_bit[j] : (bits & 1);
+			g_string_append_len(ctx->lines[j],
+				ctx->bit_text[prevbit][bits], chunk);
+			ctx->prev_bit[j] = (bits >> (chunk - 1)) & 1;
+		}
+		ctx->spl_cnt += chunk;
 
-	return header;
+		if (ctx->spl_cnt == ctx->spl) {
+			flush_lines(ctx, out);
+			ctx->spl_cnt = 0;
+		}
+		data += chunk * logic->unitsize;
+		count -= chunk;
+	}
 }
 
-static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
-		GString **out)
+static int receive_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, struct sr_output_sink *sink)
 {
 	const struct sr_datafeed_meta *meta;
-	const struct sr_datafeed_logic *logic;
 	const struct sr_config *src;
 	GSList *l;
 	struct context *ctx;
-	int idx, offset, curbit, prevbit;
-	uint64_t i, j;
-	gchar *p, c;
-	size_t charidx;
+	GString *out;
+	unsigned int i;
 
-	*out = NULL;
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 	if (!(ctx = o->priv))
@@ -171,59 +249,20 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		ctx->trigger = ctx->spl_cnt;
 		break;
 	case SR_DF_LOGIC:
+		out = sr_output_sink_text(sink);
 		if (!ctx->header_done) {
-			*out = gen_header(o);
+			gen_header(o, out);
 			ctx->header_done = TRUE;
-		} else
-			*out = g_string_sized_new(512);
-
-		logic = packet->payload;
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			ctx->spl_cnt++;
-			for (j = 0; j < ctx->num_enabled_channels; j++) {
-				idx = ctx->channel_index[j];
-				p = logic->data + i + idx / 8;
-				curbit = *p & (1 << (idx % 8));
-				prevbit = (ctx->prev_sample[idx / 8] & ((uint8_t) 1 << (idx % 8)));
-
-				charidx = curbit ? 1 : 0;
-				if (ctx->edges && ctx->spl_cnt > 1) {
-					if (curbit != prevbit)
-						charidx += 2;
-				}
-				c = ctx->charset[charidx];
-				g_string_append_c(ctx->lines[j], c);
-
-				if (ctx->spl_cnt == ctx->spl) {
-					/* Flush line buffers. */
-					g_string_append_len(*out, ctx->lines[j]->str, ctx->lines[j]->len);
-					g_string_append_c(*out, '\n');
-					if (j == ctx->num_enabled_channels - 1 && ctx->trigger > -1) {
-						/*
-						 * Sample data lines have one character per bit and
-						 * no separator between bytes. Align trigger marker
-						 * to this layout.
-						 */
-						offset = ctx->trigger;
-						g_string_append_printf(*out, "T:%*s^ %d\n", offset, "", ctx->trigger);
-						ctx->trigger = -1;
-					}
-					g_string_printf(ctx->lines[j], "%s:", ctx->channel_names[j]);
-				}
-			}
-			if (ctx->spl_cnt == ctx->spl)
-				/* Line buffers were already flushed. */
-				ctx->spl_cnt = 0;
-			memcpy(ctx->prev_sample, logic->data + i, logic->unitsize);
 		}
+		process_logic(ctx, out, packet->payload);
 		break;
 	case SR_DF_END:
 		if (ctx->spl_cnt) {
 			/* Line buffers need flushing. */
-			*out = g_string_sized_new(512);
+			out = sr_output_sink_text(sink);
 			for (i = 0; i < ctx->num_enabled_channels; i++) {
-				g_string_append_len(*out, ctx->lines[i]->str, ctx->lines[i]->len);
-				g_string_append_c(*out, '\n');
+				g_string_append_len(out, ctx->lines[i]->str, ctx->lines[i]->len);
+				g_string_append_c(out, '\n');
 			}
 		}
 		break;
@@ -244,7 +283,8 @@ static int cleanup(struct sr_output *o)
 		return SR_OK;
 
 	g_free(ctx->channel_index);
-	g_free(ctx->prev_sample);
+	g_free(ctx->prev_bit);
+	g_free(ctx->channel_bits);
 	g_free(ctx->channel_names);
 	for (i = 0; i < ctx->num_enabled_channels; i++)
 		g_string_free(ctx->lines[i], TRUE);
@@ -282,6 +322,6 @@ SR_PRIV struct sr_output_module output_ascii = {
 	.flags = 0,
 	.options = get_options,
 	.init = init,
-	.receive = receive,
+	.receive_sink = receive_sink,
 	.cleanup = cleanup,
 };
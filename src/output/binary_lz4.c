@@ -0,0 +1,289 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compressed binary logic data, fast enough to stream captures to disk.
+ *
+ * The raw samples are cut into blocks, which get compressed separately
+ * in the LZ4 block format. All numbers are little endian. The stream
+ * starts with a header:
+ *
+ *   char magic[8]    "SRBINLZ4"
+ *   uint32 version   1
+ *   uint32 unitsize  bytes per sample
+ *   uint64 samplerate, 0 if unknown
+ *   uint32 channel count, then per channel:
+ *     uint32 index   bit number in the samples
+ *     uint32 length, and the name
+ *
+ * Blocks follow, each a whole number of samples:
+ *
+ *   uint32 size      size of the data, the top bit is set when the data
+ *                    is stored uncompressed
+ *   uint32 samples   size of the uncompressed data in bytes
+ *   the data
+ *
+ * The stream ends with a size of 0.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "output/binary-lz4"
+
+#define BINARY_LZ4_MAGIC	"SRBINLZ4"
+#define BINARY_LZ4_VERSION	1
+
+/* Uncompressed size of a block. */
+#define BLOCK_SIZE		(1024 * 1024)
+#define BLOCK_STORED		(1U << 31)
+
+struct context {
+	uint64_t samplerate;
+	gboolean header_done;
+	gboolean done;
+	size_t unitsize;
+	size_t block_size;
+	/* Samples which do not fill a block yet. */
+	GByteArray *pending;
+};
+
+static int init(struct sr_output *o, GHashTable *options)
+{
+	struct context *ctx;
+
+	(void)options;
+
+	if (!o || !o->sdi)
+		return SR_ERR_ARG;
+
+	o->priv = ctx = g_malloc0(sizeof(struct context));
+	ctx->pending = g_byte_array_sized_new(BLOCK_SIZE);
+
+	return SR_OK;
+}
+
+static size_t logic_unitsize(const struct sr_dev_inst *sdi)
+{
+	const struct sr_channel *ch;
+	const GSList *l;
+	size_t bits;
+
+	bits = 0;
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type == SR_CHANNEL_LOGIC)
+			bits = MAX(bits, (size_t)ch->index + 1);
+	}
+
+	return MAX((bits + 7) / 8, 1);
+}
+
+static void append_u32(GString *out, uint32_t value)
+{
+	uint8_t tmp[4];
+
+	WL32(tmp, value);
+	g_string_append_len(out, (const char *)tmp, sizeof(tmp));
+}
+
+static void write_header(const struct sr_output *o, GString *out)
+{
+	struct context *ctx;
+	struct sr_channel *ch;
+	GVariant *gvar;
+	GSList *l;
+	uint32_t count;
+
+	ctx = o->priv;
+	if (ctx->samplerate == 0 && sr_config_get(o->sdi->driver, o->sdi,
+			NULL, SR_CONF_SAMPLERATE, &gvar) == SR_OK) {
+		ctx->samplerate = g_variant_get_uint64(gvar);
+		g_variant_unref(gvar);
+	}
+
+	g_string_append_len(out, BINARY_LZ4_MAGIC, 8);
+	append_u32(out, BINARY_LZ4_VERSION);
+	append_u32(out, ctx->unitsize);
+	append_u32(out, ctx->samplerate);
+	append_u32(out, ctx->samplerate >> 32);
+
+	count = 0;
+	for (l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type == SR_CHANNEL_LOGIC && ch->enabled)
+			count++;
+	}
+	append_u32(out, count);
+	for (l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type != SR_CHANNEL_LOGIC || !ch->enabled)
+			continue;
+		append_u32(out, ch->index);
+		append_u32(out, strlen(ch->name));
+		g_string_append(out, ch->name);
+	}
+}
+
+/* Compress a block straight into the output buffer. */
+static void write_block(GString *out, const uint8_t *data, size_t length)
+{
+	size_t pos, bound, size;
+	uint8_t *dst;
+
+	pos = out->len;
+	bound = sr_lz4_compress_bound(length);
+	g_string_set_size(out, pos + 8 + bound);
+	dst = (uint8_t *)out->str + pos;
+
+	size = sr_lz4_compress(data, length, dst + 8, bound);
+	if (!size || size >= length) {
+		/* Incompressible, keep it as it is. */
+		memcpy(dst + 8, data, length);
+		size = length;
+		WL32(dst, size | BLOCK_STORED);
+	} else {
+		WL32(dst, size);
+	}
+	WL32(dst + 4, length);
+	g_string_truncate(out, pos + 8 + size);
+}
+
+static int process_logic(struct context *ctx, GString *out,
+		const struct sr_datafeed_logic *logic)
+{
+	const uint8_t *data;
+	size_t length, count;
+
+	if (logic->unitsize != ctx->unitsize) {
+		sr_err("Unit size changed from %zu to %u.", ctx->unitsize,
+			logic->unitsize);
+		return SR_ERR_DATA;
+	}
+
+	data = logic->data;
+	length = logic->length / ctx->unitsize * ctx->unitsize;
+
+	/* Fill up the pending block first. */
+	if (ctx->pending->len) {
+		count = MIN(length, ctx->block_size - ctx->pending->len);
+		g_byte_array_append(ctx->pending, data, count);
+		data += count;
+		length -= count;
+		if (ctx->pending->len < ctx->block_size)
+			return SR_OK;
+		write_block(out, ctx->pending->data, ctx->pending->len);
+		g_byte_array_set_size(ctx->pending, 0);
+	}
+
+	/* Whole blocks get compressed without a copy. */
+	while (length >= ctx->block_size) {
+		write_block(out, data, ctx->block_size);
+		data += ctx->block_size;
+		length -= ctx->block_size;
+	}
+	g_byte_array_append(ctx->pending, data, length);
+
+	return SR_OK;
+}
+
+static int receive_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, struct sr_output_sink *sink)
+{
+	struct context *ctx;
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_config *src;
+	GSList *l;
+	GString *out;
+
+	if (!o || !o->sdi || !(ctx = o->priv))
+		return SR_ERR_ARG;
+	if (ctx->done)
+		return SR_OK;
+	out = sr_output_sink_text(sink);
+
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				ctx->samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		if (!ctx->header_done) {
+			if (!logic->unitsize)
+				return SR_ERR_DATA;
+			ctx->unitsize = logic->unitsize;
+			ctx->block_size = BLOCK_SIZE / ctx->unitsize * ctx->unitsize;
+			write_header(o, out);
+			ctx->header_done = TRUE;
+		}
+		return process_logic(ctx, out, logic);
+	case SR_DF_END:
+		if (!ctx->header_done) {
+			/* No samples, the header still describes the channels. */
+			ctx->unitsize = logic_unitsize(o->sdi);
+			write_header(o, out);
+			ctx->header_done = TRUE;
+		}
+		if (ctx->pending->len)
+			write_block(out, ctx->pending->data, ctx->pending->len);
+		g_byte_array_set_size(ctx->pending, 0);
+		append_u32(out, 0);
+		ctx->done = TRUE;
+		break;
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_output *o)
+{
+	struct context *ctx;
+
+	if (!o || !o->sdi)
+		return SR_ERR_ARG;
+	if (!(ctx = o->priv))
+		return SR_OK;
+
+	g_byte_array_free(ctx->pending, TRUE);
+	g_free(ctx);
+	o->priv = NULL;
+
+	return SR_OK;
+}
+
+SR_PRIV struct sr_output_module output_binary_lz4 = {
+	.id = "binary-lz4",
+	.name = "Binary (LZ4)",
+	.desc = "LZ4 compressed binary logic data, with samplerate and channel names",
+	.exts = (const char*[]){"srlz4", NULL},
+	.flags = 0,
+	.options = NULL,
+	.init = init,
+	.receive_sink = receive_sink,
+	.cleanup = cleanup,
+};
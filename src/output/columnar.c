@@ -0,0 +1,709 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Columnar output, for analytics tools which load one channel at a time.
+ *
+ * The samples are split into row groups of a fixed number of samples.
+ * Each row group holds one chunk per channel: logic channels are packed
+ * eight samples to a byte, first sample in the least significant bit,
+ * analog channels are 32-bit floats. Chunks start at multiples of eight
+ * bytes. A footer at the end of the file describes the columns and has
+ * an index of the row groups, so that readers can seek to the samples
+ * and skip the channels they don't need.
+ *
+ * All numbers are little endian. The file starts with a header:
+ *
+ *   char magic[8]    "SRCOLUMN"
+ *   uint32 version   1
+ *   uint32 flags     0
+ *
+ * The row groups follow, then the footer:
+ *
+ *   uint32 count, then count strings of uint32 length and bytes
+ *   uint64 samplerate
+ *   uint32 rows per row group
+ *   uint32 column count, then per column:
+ *     uint32 type      0 = logic, 1 = float
+ *     uint32 index     channel index
+ *     uint32 name      string number
+ *     uint32 unit      string number
+ *   uint32 row group count, then per row group:
+ *     uint64 first sample
+ *     uint64 file offset
+ *     uint32 rows
+ *     uint32 reserved
+ *     and per column:
+ *       uint64 file offset of the chunk
+ *       uint64 first sample of the chunk
+ *       uint32 sample count
+ *       uint32 size in bytes
+ *       float minimum, float maximum
+ *   uint32 meta count, then per entry:
+ *     uint64 sample
+ *     uint32 key       string number
+ *     uint32 value     string number
+ *
+ * The file ends with the footer's file offset as uint64, and the magic.
+ *
+ * A chunk normally covers the row group's samples. When channels arrive
+ * at different rates, the last row group, and row groups which get
+ * written while a channel lags far behind, can have chunks with fewer
+ * samples.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "output/columnar"
+
+#define COLUMNAR_MAGIC		"SRCOLUMN"
+#define COLUMNAR_VERSION	1
+
+#define DEFAULT_ROWS		65536
+#define MAX_ROWS		(1 << 28)
+
+/* Chunks start at multiples of this size. */
+#define CHUNK_ALIGN		8
+
+/* Row groups a channel may run ahead, before lagging ones get cut short. */
+#define MAX_PENDING_GROUPS	16
+
+enum column_type {
+	COLUMN_LOGIC,
+	COLUMN_FLOAT,
+};
+
+struct column {
+	struct sr_channel *ch;
+	enum column_type type;
+	uint32_t name;
+	uint32_t unit;
+	gboolean unit_known;
+	uint64_t written;
+	/* Analog samples which are not written yet. */
+	GArray *pending;
+};
+
+struct context {
+	uint32_t rows;
+	uint64_t samplerate;
+	gboolean header_done;
+	gboolean done;
+	uint64_t offset;
+	uint64_t rows_written;
+	GPtrArray *columns;
+	/* Logic samples which are not written yet, of all logic columns. */
+	GByteArray *logic_pending;
+	size_t logic_unitsize;
+	unsigned int num_logic;
+	uint8_t *transposed;
+	uint8_t *bits;
+	float *fdata;
+	size_t fdata_size;
+	/* String dictionary, for names, units and meta. */
+	GPtrArray *strings;
+	GHashTable *string_index;
+	GByteArray *groups;
+	uint32_t num_groups;
+	GByteArray *meta;
+	uint32_t num_meta;
+	gboolean warned_lag;
+};
+
+static uint32_t dict_add(struct context *ctx, const char *s)
+{
+	gpointer value;
+	char *copy;
+
+	if (g_hash_table_lookup_extended(ctx->string_index, s, NULL, &value))
+		return GPOINTER_TO_UINT(value);
+
+	copy = g_strdup(s);
+	g_ptr_array_add(ctx->strings, copy);
+	g_hash_table_insert(ctx->string_index, copy,
+		GUINT_TO_POINTER(ctx->strings->len - 1));
+
+	return ctx->strings->len - 1;
+}
+
+static void append_u32(GByteArray *buf, uint32_t value)
+{
+	uint8_t tmp[4];
+
+	WL32(tmp, value);
+	g_byte_array_append(buf, tmp, sizeof(tmp));
+}
+
+static void append_u64(GByteArray *buf, uint64_t value)
+{
+	append_u32(buf, value);
+	append_u32(buf, value >> 32);
+}
+
+static void append_float(GByteArray *buf, float value)
+{
+	uint32_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	append_u32(buf, bits);
+}
+
+static void column_free(struct column *col)
+{
+	if (col->pending)
+		g_array_free(col->pending, TRUE);
+	g_free(col);
+}
+
+static int init(struct sr_output *o, GHashTable *options)
+{
+	struct context *ctx;
+	struct sr_channel *ch;
+	struct column *col;
+	GSList *l;
+	uint32_t rows;
+
+	if (!o || !o->sdi)
+		return SR_ERR_ARG;
+
+	rows = g_variant_get_uint32(g_hash_table_lookup(options, "rows"));
+	if (rows == 0 || rows > MAX_ROWS) {
+		sr_err("Invalid row group size %u.", rows);
+		return SR_ERR_ARG;
+	}
+
+	o->priv = ctx = g_malloc0(sizeof(struct context));
+	/* Whole bytes of logic samples per chunk. */
+	ctx->rows = (rows + 7) & ~7;
+	ctx->strings = g_ptr_array_new_with_free_func(g_free);
+	ctx->string_index = g_hash_table_new(g_str_hash, g_str_equal);
+	dict_add(ctx, "");
+	ctx->groups = g_byte_array_new();
+	ctx->meta = g_byte_array_new();
+	ctx->logic_pending = g_byte_array_new();
+
+	ctx->columns = g_ptr_array_new_with_free_func(
+		(GDestroyNotify)column_free);
+	for (l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (!ch->enabled)
+			continue;
+		if (ch->type != SR_CHANNEL_LOGIC && ch->type != SR_CHANNEL_ANALOG)
+			continue;
+		col = g_malloc0(sizeof(*col));
+		col->ch = ch;
+		col->name = dict_add(ctx, ch->name);
+		if (ch->type == SR_CHANNEL_LOGIC) {
+			col->type = COLUMN_LOGIC;
+			col->unit_known = TRUE;
+			ctx->num_logic++;
+		} else {
+			col->type = COLUMN_FLOAT;
+			col->pending = g_array_new(FALSE, FALSE, sizeof(float));
+		}
+		g_ptr_array_add(ctx->columns, col);
+	}
+
+	return SR_OK;
+}
+
+/* Number of samples of a column which are not written yet. */
+static size_t pending_samples(const struct context *ctx,
+		const struct column *col)
+{
+	if (col->type == COLUMN_LOGIC)
+		return ctx->logic_unitsize ?
+			ctx->logic_pending->len / ctx->logic_unitsize : 0;
+
+	return col->pending->len;
+}
+
+static void pending_range(const struct context *ctx, size_t *min, size_t *max)
+{
+	size_t i, count;
+
+	*min = *max = 0;
+	for (i = 0; i < ctx->columns->len; i++) {
+		count = pending_samples(ctx, ctx->columns->pdata[i]);
+		*min = i ? MIN(*min, count) : count;
+		*max = MAX(*max, count);
+	}
+}
+
+/* Sample number which the next sample of the leading channel gets. */
+static uint64_t current_sample(const struct context *ctx)
+{
+	const struct column *col;
+	uint64_t sample;
+	size_t i;
+
+	sample = 0;
+	for (i = 0; i < ctx->columns->len; i++) {
+		col = ctx->columns->pdata[i];
+		sample = MAX(sample, col->written + pending_samples(ctx, col));
+	}
+
+	return sample;
+}
+
+static void add_meta(struct context *ctx, const char *key, const char *value)
+{
+	append_u64(ctx->meta, current_sample(ctx));
+	append_u32(ctx->meta, dict_add(ctx, key));
+	append_u32(ctx->meta, dict_add(ctx, value));
+	ctx->num_meta++;
+}
+
+/*
+ * Pack the logic samples of all logic columns, a chunk for each after
+ * the other in the bits buffer.
+ */
+static void pack_logic(struct context *ctx, size_t count)
+{
+	const struct column *col;
+	uint8_t *dst;
+	size_t chunk_size, unitsize, i, k, bit;
+
+	unitsize = ctx->logic_unitsize;
+	chunk_size = (count + 7) / 8;
+	for (i = 0; i * 8 < count; i++) {
+		sr_output_transpose_logic(ctx->logic_pending->data + i * 8 * unitsize,
+			unitsize, MIN(8, count - i * 8), ctx->transposed, unitsize);
+		dst = ctx->bits + i;
+		for (k = 0; k < ctx->columns->len; k++) {
+			col = ctx->columns->pdata[k];
+			if (col->type != COLUMN_LOGIC)
+				continue;
+			bit = col->ch->index;
+			*dst = bit < unitsize * 8 ? ctx->transposed[bit] : 0;
+			dst += chunk_size;
+		}
+	}
+}
+
+static void logic_stats(const uint8_t *bits, size_t count, float *min,
+		float *max)
+{
+	uint8_t any_set, all_set, mask;
+	size_t i;
+
+	any_set = 0;
+	all_set = 0xff;
+	for (i = 0; i < count / 8; i++) {
+		any_set |= bits[i];
+		all_set &= bits[i];
+	}
+	if (count % 8) {
+		mask = (1 << (count % 8)) - 1;
+		any_set |= bits[i] & mask;
+		all_set &= bits[i] | ~mask;
+	}
+	*min = all_set == 0xff ? 1 : 0;
+	*max = any_set ? 1 : 0;
+}
+
+static void float_stats(const float *values, size_t count, float *min,
+		float *max)
+{
+	size_t i;
+
+	*min = INFINITY;
+	*max = -INFINITY;
+	for (i = 0; i < count; i++) {
+		if (values[i] < *min)
+			*min = values[i];
+		if (values[i] > *max)
+			*max = values[i];
+	}
+	/* No samples, or only NaN. */
+	if (*min > *max)
+		*min = *max = NAN;
+}
+
+static void append_chunk(struct context *ctx, GString *out,
+		const void *data, size_t size, gboolean is_float)
+{
+	size_t padding;
+#ifdef WORDS_BIGENDIAN
+	uint32_t value;
+	size_t i;
+
+	if (is_float) {
+		for (i = 0; i < size / 4; i++) {
+			memcpy(&value, (const uint8_t *)data + i * 4, 4);
+			value = GUINT32_TO_LE(value);
+			g_string_append_len(out, (const char *)&value, 4);
+		}
+	} else {
+		g_string_append_len(out, data, size);
+	}
+#else
+	(void)is_float;
+	g_string_append_len(out, data, size);
+#endif
+
+	padding = (CHUNK_ALIGN - size % CHUNK_ALIGN) % CHUNK_ALIGN;
+	ctx->offset += size + padding;
+	while (padding--)
+		g_string_append_c(out, 0);
+}
+
+/*
+ * Write a row group, with up to the given number of samples of each
+ * column, and add it to the index.
+ */
+static void write_group(struct context *ctx, GString *out, size_t rows)
+{
+	struct column *col;
+	const void *data;
+	size_t i, count, logic_count, chunk_size, logic_chunk, size;
+	float min, max;
+
+	logic_count = 0;
+	logic_chunk = 0;
+	for (i = 0; i < ctx->columns->len; i++) {
+		col = ctx->columns->pdata[i];
+		if (col->type == COLUMN_LOGIC) {
+			logic_count = MIN(rows, pending_samples(ctx, col));
+			break;
+		}
+	}
+	if (logic_count)
+		pack_logic(ctx, logic_count);
+	chunk_size = (logic_count + 7) / 8;
+
+	append_u64(ctx->groups, ctx->rows_written);
+	append_u64(ctx->groups, ctx->offset);
+	append_u32(ctx->groups, rows);
+	append_u32(ctx->groups, 0);
+
+	for (i = 0; i < ctx->columns->len; i++) {
+		col = ctx->columns->pdata[i];
+		if (col->type == COLUMN_LOGIC) {
+			count = logic_count;
+			data = ctx->bits + logic_chunk++ * chunk_size;
+			size = chunk_size;
+			logic_stats(data, count, &min, &max);
+		} else {
+			count = MIN(rows, col->pending->len);
+			data = col->pending->data;
+			size = count * sizeof(float);
+			float_stats(data, count, &min, &max);
+		}
+		append_u64(ctx->groups, ctx->offset);
+		append_u64(ctx->groups, col->written);
+		append_u32(ctx->groups, count);
+		append_u32(ctx->groups, size);
+		append_float(ctx->groups, min);
+		append_float(ctx->groups, max);
+		append_chunk(ctx, out, data, size, col->type == COLUMN_FLOAT);
+		if (col->type == COLUMN_FLOAT && count)
+			g_array_remove_range(col->pending, 0, count);
+		col->written += count;
+	}
+	if (logic_count)
+		g_byte_array_remove_range(ctx->logic_pending, 0,
+			logic_count * ctx->logic_unitsize);
+
+	ctx->rows_written += rows;
+	ctx->num_groups++;
+}
+
+/*
+ * Write the row groups which all channels have samples for. Channels
+ * which lag far behind get short chunks, rather than the others piling
+ * up. At the end of the stream, the remaining samples get written.
+ */
+static void write_groups(struct context *ctx, GString *out, gboolean last)
+{
+	size_t min, max;
+
+	for (;;) {
+		pending_range(ctx, &min, &max);
+		if (min >= ctx->rows) {
+			write_group(ctx, out, ctx->rows);
+		} else if (max >= (size_t)MAX_PENDING_GROUPS * ctx->rows) {
+			if (!ctx->warned_lag) {
+				sr_warn("Channels arrive at different rates, "
+					"writing short chunks.");
+				ctx->warned_lag = TRUE;
+			}
+			write_group(ctx, out, ctx->rows);
+		} else if (last && max) {
+			write_group(ctx, out, MIN(max, ctx->rows));
+		} else {
+			break;
+		}
+	}
+}
+
+static void write_header(const struct sr_output *o, GString *out)
+{
+	struct context *ctx;
+	GVariant *gvar;
+	uint8_t tmp[4];
+
+	ctx = o->priv;
+	if (ctx->samplerate == 0 && sr_config_get(o->sdi->driver, o->sdi,
+			NULL, SR_CONF_SAMPLERATE, &gvar) == SR_OK) {
+		ctx->samplerate = g_variant_get_uint64(gvar);
+		g_variant_unref(gvar);
+	}
+
+	g_string_append_len(out, COLUMNAR_MAGIC, 8);
+	WL32(tmp, COLUMNAR_VERSION);
+	g_string_append_len(out, (const char *)tmp, 4);
+	WL32(tmp, 0);
+	g_string_append_len(out, (const char *)tmp, 4);
+	ctx->offset = 16;
+}
+
+static void write_footer(struct context *ctx, GString *out)
+{
+	const struct column *col;
+	GByteArray *footer;
+	const char *s;
+	size_t i;
+
+	footer = g_byte_array_new();
+	append_u32(footer, ctx->strings->len);
+	for (i = 0; i < ctx->strings->len; i++) {
+		s = ctx->strings->pdata[i];
+		append_u32(footer, strlen(s));
+		g_byte_array_append(footer, (const uint8_t *)s, strlen(s));
+	}
+
+	append_u64(footer, ctx->samplerate);
+	append_u32(footer, ctx->rows);
+	append_u32(footer, ctx->columns->len);
+	for (i = 0; i < ctx->columns->len; i++) {
+		col = ctx->columns->pdata[i];
+		append_u32(footer, col->type);
+		append_u32(footer, col->ch->index);
+		append_u32(footer, col->name);
+		append_u32(footer, col->unit);
+	}
+
+	append_u32(footer, ctx->num_groups);
+	g_byte_array_append(footer, ctx->groups->data, ctx->groups->len);
+	append_u32(footer, ctx->num_meta);
+	g_byte_array_append(footer, ctx->meta->data, ctx->meta->len);
+
+	append_u64(footer, ctx->offset);
+	g_byte_array_append(footer, (const uint8_t *)COLUMNAR_MAGIC, 8);
+
+	g_string_append_len(out, (const char *)footer->data, footer->len);
+	ctx->offset += footer->len;
+	g_byte_array_free(footer, TRUE);
+}
+
+static int process_logic(struct context *ctx,
+		const struct sr_datafeed_logic *logic)
+{
+	if (!ctx->num_logic || !logic->unitsize)
+		return SR_OK;
+
+	if (!ctx->logic_unitsize) {
+		ctx->logic_unitsize = logic->unitsize;
+		ctx->transposed = g_malloc(logic->unitsize * 8);
+		/* Room for all logic chunks of a row group. */
+		ctx->bits = g_try_malloc(ctx->rows / 8 * ctx->num_logic);
+		if (!ctx->bits)
+			return SR_ERR_MALLOC;
+	} else if (logic->unitsize != ctx->logic_unitsize) {
+		sr_err("Logic unit size changed from %zu to %u.",
+			ctx->logic_unitsize, logic->unitsize);
+		return SR_ERR_DATA;
+	}
+	g_byte_array_append(ctx->logic_pending, logic->data,
+		logic->length - logic->length % logic->unitsize);
+
+	return SR_OK;
+}
+
+static struct column *find_column(const struct context *ctx,
+		const struct sr_channel *ch)
+{
+	struct column *col;
+	size_t i;
+
+	for (i = 0; i < ctx->columns->len; i++) {
+		col = ctx->columns->pdata[i];
+		if (col->ch == ch)
+			return col;
+	}
+
+	return NULL;
+}
+
+static int process_analog(const struct sr_output *o, struct context *ctx,
+		const struct sr_datafeed_analog *analog)
+{
+	struct column *col;
+	GSList *l;
+	const float *fdata;
+	char *unit;
+	size_t num_channels, i, c;
+	int ret;
+
+	num_channels = g_slist_length(analog->meaning->channels);
+	ret = sr_output_analog_to_float(o, analog, &ctx->fdata,
+		&ctx->fdata_size, &fdata);
+	if (ret != SR_OK)
+		return ret;
+
+	for (l = analog->meaning->channels, c = 0; l; l = l->next, c++) {
+		if (!(col = find_column(ctx, l->data)) || col->type != COLUMN_FLOAT)
+			continue;
+		if (!col->unit_known) {
+			sr_analog_unit_to_string(analog, &unit);
+			col->unit = dict_add(ctx, unit);
+			col->unit_known = TRUE;
+			g_free(unit);
+		}
+		if (num_channels == 1) {
+			g_array_append_vals(col->pending, fdata, analog->num_samples);
+			continue;
+		}
+		for (i = 0; i < analog->num_samples; i++)
+			g_array_append_val(col->pending, fdata[i * num_channels + c]);
+	}
+
+	return SR_OK;
+}
+
+static int receive_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, struct sr_output_sink *sink)
+{
+	struct context *ctx;
+	const struct sr_datafeed_meta *meta;
+	const struct sr_config *src;
+	const struct sr_key_info *srci;
+	GSList *l;
+	GString *out;
+	char *value;
+	int ret;
+
+	if (!o || !o->sdi || !(ctx = o->priv))
+		return SR_ERR_ARG;
+	if (ctx->done)
+		return SR_OK;
+	out = sr_output_sink_text(sink);
+
+	if (!ctx->header_done) {
+		write_header(o, out);
+		ctx->header_done = TRUE;
+	}
+
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				ctx->samplerate = g_variant_get_uint64(src->data);
+			if (!(srci = sr_key_info_get(SR_KEY_CONFIG, src->key)))
+				continue;
+			value = g_variant_print(src->data, FALSE);
+			add_meta(ctx, srci->id, value);
+			g_free(value);
+		}
+		break;
+	case SR_DF_TRIGGER:
+		add_meta(ctx, "trigger", "");
+		break;
+	case SR_DF_FRAME_BEGIN:
+		add_meta(ctx, "frame-begin", "");
+		break;
+	case SR_DF_FRAME_END:
+		add_meta(ctx, "frame-end", "");
+		break;
+	case SR_DF_LOGIC:
+		if ((ret = process_logic(ctx, packet->payload)) != SR_OK)
+			return ret;
+		write_groups(ctx, out, FALSE);
+		break;
+	case SR_DF_ANALOG:
+		if ((ret = process_analog(o, ctx, packet->payload)) != SR_OK)
+			return ret;
+		write_groups(ctx, out, FALSE);
+		break;
+	case SR_DF_END:
+		write_groups(ctx, out, TRUE);
+		write_footer(ctx, out);
+		ctx->done = TRUE;
+		break;
+	}
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{ "rows", "Row group size", "Number of samples per row group", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def)
+		options[0].def = g_variant_ref_sink(g_variant_new_uint32(DEFAULT_ROWS));
+
+	return options;
+}
+
+static int cleanup(struct sr_output *o)
+{
+	struct context *ctx;
+
+	if (!o || !o->sdi)
+		return SR_ERR_ARG;
+	if (!(ctx = o->priv))
+		return SR_OK;
+
+	g_ptr_array_free(ctx->columns, TRUE);
+	g_byte_array_free(ctx->logic_pending, TRUE);
+	g_byte_array_free(ctx->groups, TRUE);
+	g_byte_array_free(ctx->meta, TRUE);
+	g_hash_table_destroy(ctx->string_index);
+	g_ptr_array_free(ctx->strings, TRUE);
+	g_free(ctx->transposed);
+	g_free(ctx->bits);
+	g_free(ctx->fdata);
+	g_free(ctx);
+	o->priv = NULL;
+
+	return SR_OK;
+}
+
+SR_PRIV struct sr_output_module output_columnar = {
+	.id = "columnar",
+	.name = "Columnar",
+	.desc = "Columnar format for analytics, channels stored separately",
+	.exts = (const char*[]){"srcol", NULL},
+	.flags = 0,
+	.options = get_options,
+	.init = init,
+	.receive_sink = receive_sink,
+	.cleanup = cleanup,
+};
@@ -63,10 +63,33 @@
 
 #define LOG_PREFIX "output/csv"
 
+/* Rows are written in blocks, for which the text buffer is presized. */
+#define ROWS_PER_BLOCK	1024
+
+/*
+ * Samples which wait for the other channels' data of the same rows.
+ * Beyond this, rows get written with empty fields for the channels
+ * which lag behind, so that memory use stays bounded.
+ */
+#define MAX_PENDING	(1024 * 1024)
+
+/* Text of long packets gets written when it reaches this size. */
+#define FLUSH_SIZE	(1024 * 1024)
+
+/* Room for a value, as printed by format_value(). */
+#define VALUE_SIZE	16
+
+/* Room for the time column. */
+#define TIME_SIZE	20
+
 struct ctx_channel {
 	struct sr_channel *ch;
 	char *label;
 	float min, max;
+	/* Analog samples of rows which are not written yet. */
+	GArray *pending;
+	/* Number of samples received in the current frame. */
+	uint64_t received;
 };
 
 struct context {
@@ -82,22 +105,37 @@ struct context {
 	gboolean time;
 	gboolean do_trigger;
 	gboolean dedup;
+	size_t value_len, record_len;
 
 	/* Plot data */
 	unsigned int num_analog_channels;
 	unsigned int num_logic_channels;
 	struct ctx_channel *channels;
 
+	/*
+	 * Logic samples of rows which are not written yet. All logic
+	 * channels arrive in the same packets.
+	 */
+	GByteArray *logic_pending;
+	uint64_t logic_received;
+	unsigned int logic_unitsize;
+
+	/* Rows of the current frame which have been written. */
+	uint64_t rows_done;
+	size_t row_size;
+	float *row_values;
+	gboolean *row_present;
+	float *previous_values;
+	float *fdata;
+	size_t fdata_size;
+	gboolean warned_pending;
+
 	/* Metadata */
 	gboolean trigger;
-	uint32_t num_samples;
+	uint64_t trigger_row;
 	uint32_t channel_count, logic_channel_count;
-	uint32_t channels_seen;
 	uint64_t period;
 	uint64_t sample_time;
-	uint8_t *previous_sample;
-	float *analog_samples;
-	uint8_t *logic_samples;
 	const char *xlabel;	/* Don't free: will point to a static string. */
 	const char *title;	/* Don't free: will point into the driver struct. */
 };
@@ -110,7 +148,7 @@ struct context {
 
 static int init(struct sr_output *o, GHashTable *options)
 {
-	unsigned int i, analog_channels, logic_channels;
+	unsigned int i, analog_channels, logic_channels, num_channels;
 	struct context *ctx;
 	struct sr_channel *ch;
 	const char *label_string;
@@ -141,6 +179,8 @@ static int init(struct sr_output *o, GHashTable *options)
 		g_hash_table_lookup(options, "label"), NULL);
 	ctx->dedup = g_variant_get_boolean(g_hash_table_lookup(options, "dedup"));
 	ctx->dedup &= ctx->time;
+	ctx->value_len = strlen(ctx->value);
+	ctx->record_len = strlen(ctx->record);
 
 	if (*ctx->gnuplot && g_strcmp0(ctx->record, "\n"))
 		sr_warn("gnuplot record separator must be newline.");
@@ -177,30 +217,43 @@ static int init(struct sr_output *o, GHashTable *options)
 	if (logic_channels) {
 		sr_info("Outputting %d logic values", logic_channels);
 		ctx->num_logic_channels = logic_channels;
+		ctx->logic_pending = g_byte_array_new();
 	}
-	ctx->channels = g_malloc(sizeof(struct ctx_channel)
-		* (ctx->num_analog_channels + ctx->num_logic_channels));
+	num_channels = ctx->num_analog_channels + ctx->num_logic_channels;
+	ctx->channels = g_malloc0(sizeof(struct ctx_channel) * num_channels);
+	ctx->row_values = g_malloc0(sizeof(float) * num_channels);
+	ctx->row_present = g_malloc0(sizeof(gboolean) * num_channels);
+	ctx->previous_values = g_malloc0(sizeof(float) * num_channels);
 
 	/* Once more to map the enabled channels. */
 	ctx->channel_count = g_slist_length(o->sdi->channels);
-	for (i = 0, l = o->sdi->channels; l; l = l->next) {
+	for (i = 0, l = o->sdi->channels; l && i < num_channels; l = l->next) {
 		ch = l->data;
-		if (ch->enabled) {
-			if (ch->type == SR_CHANNEL_ANALOG) {
-				ctx->channels[i].min = FLT_MAX;
-				ctx->channels[i].max = FLT_MIN;
-			} else if (ch->type == SR_CHANNEL_LOGIC) {
-				ctx->channels[i].min = 0;
-				ctx->channels[i].max = 1;
-			} else {
-				sr_warn("Unknown channel type %d.", ch->type);
-			}
-			if (ctx->label_do && ctx->label_names)
-				ctx->channels[i].label = ch->name;
-			ctx->channels[i++].ch = ch;
+		if (!ch->enabled)
+			continue;
+		if (ch->type == SR_CHANNEL_ANALOG) {
+			ctx->channels[i].min = FLT_MAX;
+			ctx->channels[i].max = FLT_MIN;
+			ctx->channels[i].pending = g_array_new(FALSE, FALSE,
+				sizeof(float));
+		} else if (ch->type == SR_CHANNEL_LOGIC) {
+			ctx->channels[i].min = 0;
+			ctx->channels[i].max = 1;
+			if (ctx->label_do && !ctx->label_names)
+				ctx->channels[i].label = "logic";
+		} else {
+			sr_warn("Unknown channel type %d.", ch->type);
+			continue;
 		}
+		if (ctx->label_do && ctx->label_names)
+			ctx->channels[i].label = ch->name;
+		ctx->channels[i++].ch = ch;
 	}
 
+	/* The longest row: time, values and trigger, with separators. */
+	ctx->row_size = TIME_SIZE + num_channels * VALUE_SIZE + 1;
+	ctx->row_size += (num_channels + 2) * ctx->value_len + ctx->record_len;
+
 	return SR_OK;
 }
 
@@ -209,20 +262,18 @@ static const char *xlabels[] = {
 	"femtoseconds", "attoseconds",
 };
 
-static GString *gen_header(const struct sr_output *o,
-			   const struct sr_datafeed_header *hdr)
+static void gen_header(const struct sr_output *o,
+			const struct sr_datafeed_header *hdr, GString *header)
 {
 	struct context *ctx;
 	struct sr_channel *ch;
 	GVariant *gvar;
-	GString *header;
 	GSList *channels, *l;
 	unsigned int num_channels, i;
 	uint64_t samplerate = 0, sr;
 	char *samplerate_s;
 
 	ctx = o->priv;
-	header = g_string_sized_new(512);
 
 	if (ctx->period == 0) {
 		if (sr_config_get(o->sdi->driver, o->sdi, NULL,
@@ -279,8 +330,6 @@ static GString *gen_header(const struct sr_output *o,
 		}
 		ctx->did_header = TRUE;
 	}
-
-	return header;
 }
 
 /*
@@ -290,221 +339,469 @@ static GString *gen_header(const struct sr_output *o,
  * To further complicate things, they can send multiple samples in a
  * single packet.
  *
- * So we need to pull any channels of interest out of a packet and save
- * them until we have complete samples to output. Some devices make this
- * simple by sending DF_FRAME_BEGIN/DF_FRAME_END packets, the latter of which
- * signals the end of a set of samples, so we can dump things there.
+ * So the samples of each channel are queued until all channels have
+ * data for a row, and rows are written as soon as they are complete.
+ * Samples are numbered from the start of the frame, which aligns the
+ * channels no matter how the device cuts its data into packets. Some
+ * devices send DF_FRAME_BEGIN/DF_FRAME_END packets around a set of
+ * samples; rows which are still incomplete at the end of a frame get
+ * written with empty fields for the missing channels.
  *
  * At least one driver (the demo driver) sends packets that contain parts of
  * multiple samples without wrapping them in DF_FRAME. Possibly this driver
  * is buggy, but it's also the standard for testing, so it has to be supported
  * as is.
- *
- * Many assumptions about the "shape" of the data here:
- *
- * All of the data for a channel is assumed to be in one frame;
- * otherwise the data in the second packet will overwrite the data in
- * the first packet.
  */
-static void process_analog(struct context *ctx,
-			   const struct sr_datafeed_analog *analog)
+
+/* Number of rows in the current frame which some channel has data for. */
+static uint64_t rows_received(const struct context *ctx, gboolean partial)
+{
+	uint64_t rows;
+	unsigned int i;
+	gboolean first;
+
+	rows = 0;
+	first = TRUE;
+	for (i = 0; i < ctx->num_analog_channels + ctx->num_logic_channels; i++) {
+		if (ctx->channels[i].ch->type != SR_CHANNEL_ANALOG)
+			continue;
+		if (first || (partial ? ctx->channels[i].received > rows
+				: ctx->channels[i].received < rows))
+			rows = ctx->channels[i].received;
+		first = FALSE;
+	}
+	if (ctx->num_logic_channels) {
+		if (first || (partial ? ctx->logic_received > rows
+				: ctx->logic_received < rows))
+			rows = ctx->logic_received;
+	}
+
+	return rows;
+}
+
+/*
+ * Decide how many of the new samples to queue. Samples of rows which
+ * were already written without them are dropped.
+ */
+static uint64_t samples_to_skip(const struct context *ctx, uint64_t received)
+{
+	return received < ctx->rows_done ? ctx->rows_done - received : 0;
+}
+
+static int process_analog(const struct sr_output *o, struct context *ctx,
+			  const struct sr_datafeed_analog *analog)
 {
-	int ret;
 	size_t num_rcvd_ch, num_have_ch;
 	size_t idx_have, idx_smpl, idx_rcvd;
-	size_t idx_send;
+	uint64_t skip;
 	struct sr_analog_meaning *meaning;
+	struct ctx_channel *channel;
 	GSList *l;
-	float *fdata = NULL;
-	struct sr_channel *ch;
-
-	if (!ctx->analog_samples) {
-		ctx->analog_samples = g_malloc(analog->num_samples
-			* sizeof(float) * ctx->num_analog_channels);
-		if (!ctx->num_samples)
-			ctx->num_samples = analog->num_samples;
-	}
-	if (ctx->num_samples != analog->num_samples)
-		sr_warn("Expecting %u analog samples, got %u.",
-			ctx->num_samples, analog->num_samples);
+	const float *fdata;
+	int ret;
 
 	meaning = analog->meaning;
 	num_rcvd_ch = g_slist_length(meaning->channels);
-	ctx->channels_seen += num_rcvd_ch;
 	sr_dbg("Processing packet of %zu analog channels", num_rcvd_ch);
-	fdata = g_malloc(analog->num_samples * num_rcvd_ch * sizeof(float));
-	if ((ret = sr_analog_to_float(analog, fdata)) != SR_OK)
+	if (!analog->num_samples || !num_rcvd_ch)
+		return SR_OK;
+
+	ret = sr_output_analog_to_float(o, analog, &ctx->fdata,
+		&ctx->fdata_size, &fdata);
+	if (ret == SR_ERR_MALLOC)
+		return ret;
+	if (ret != SR_OK)
 		sr_warn("Problems converting data to floating point values.");
 
 	num_have_ch = ctx->num_analog_channels + ctx->num_logic_channels;
-	idx_send = 0;
 	for (idx_have = 0; idx_have < num_have_ch; idx_have++) {
-		if (ctx->channels[idx_have].ch->type != SR_CHANNEL_ANALOG)
+		channel = &ctx->channels[idx_have];
+		if (channel->ch->type != SR_CHANNEL_ANALOG)
 			continue;
-		sr_dbg("Looking for channel %s",
-		       ctx->channels[idx_have].ch->name);
 		for (l = meaning->channels, idx_rcvd = 0; l; l = l->next, idx_rcvd++) {
-			ch = l->data;
-			sr_dbg("Checking %s", ch->name);
-			if (ctx->channels[idx_have].ch != ch)
-				continue;
-			if (ctx->label_do && !ctx->label_names) {
-				sr_analog_unit_to_string(analog,
-					&ctx->channels[idx_have].label);
-			}
-			for (idx_smpl = 0; idx_smpl < analog->num_samples; idx_smpl++)
-				ctx->analog_samples[idx_smpl * ctx->num_analog_channels + idx_send] = fdata[idx_smpl * num_rcvd_ch + idx_rcvd];
-			break;
+			if (channel->ch == l->data)
+				break;
 		}
-		idx_send++;
+		if (!l)
+			continue;
+		if (ctx->label_do && !ctx->label_names && !channel->label)
+			sr_analog_unit_to_string(analog, &channel->label);
+		skip = samples_to_skip(ctx, channel->received);
+		if (num_rcvd_ch == 1 && skip < analog->num_samples) {
+			g_array_append_vals(channel->pending, fdata + skip,
+				analog->num_samples - skip);
+		} else {
+			for (idx_smpl = skip; idx_smpl < analog->num_samples; idx_smpl++)
+				g_array_append_val(channel->pending,
+					fdata[idx_smpl * num_rcvd_ch + idx_rcvd]);
+		}
+		channel->received += analog->num_samples;
 	}
-	g_free(fdata);
+
+	return SR_OK;
 }
 
-/*
- * We treat logic packets the same as analog packets, though it's not
- * strictly required. This allows us to process mixed signals properly.
- */
 static void process_logic(struct context *ctx,
 			  const struct sr_datafeed_logic *logic)
 {
-	unsigned int i, j, ch, num_samples;
-	int idx;
-	uint8_t *sample;
+	uint64_t num_samples, skip;
+
+	if (!ctx->num_logic_channels || !logic->unitsize)
+		return;
 
 	num_samples = logic->length / logic->unitsize;
-	ctx->channels_seen += ctx->logic_channel_count;
 	sr_dbg("Logic packet had %d channels", logic->unitsize * 8);
-	if (!ctx->logic_samples) {
-		ctx->logic_samples = g_malloc(num_samples * ctx->num_logic_channels);
-		if (!ctx->num_samples)
-			ctx->num_samples = num_samples;
-	}
-	if (ctx->num_samples != num_samples)
-		sr_warn("Expecting %u samples, got %u",
-			ctx->num_samples, num_samples);
-
-	for (j = ch = 0; ch < ctx->num_logic_channels; j++) {
-		if (ctx->channels[j].ch->type == SR_CHANNEL_LOGIC) {
-			for (i = 0; i < num_samples; i++) {
-				sample = logic->data + i * logic->unitsize;
-				idx = ctx->channels[j].ch->index;
-				if (ctx->label_do && !ctx->label_names)
-					ctx->channels[j].label = "logic";
-				ctx->logic_samples[i * ctx->num_logic_channels + ch] = sample[idx / 8] & (1 << (idx % 8));
-			}
-			ch++;
-		}
+	if (ctx->logic_unitsize != logic->unitsize) {
+		if (ctx->logic_pending->len)
+			sr_warn("Unit size changed from %u to %u.",
+				ctx->logic_unitsize, logic->unitsize);
+		g_byte_array_set_size(ctx->logic_pending, 0);
+		ctx->logic_unitsize = logic->unitsize;
 	}
+
+	skip = samples_to_skip(ctx, ctx->logic_received);
+	if (skip < num_samples)
+		g_byte_array_append(ctx->logic_pending,
+			(const uint8_t *)logic->data + skip * logic->unitsize,
+			(num_samples - skip) * logic->unitsize);
+	ctx->logic_received += num_samples;
 }
 
-static void dump_saved_values(struct context *ctx, GString **out)
+/* Print a value like "%g" does, without the overhead of printf. */
+static size_t format_value(char *buf, float value)
 {
-	unsigned int i, j, analog_size, num_channels;
-	float *analog_sample, value;
-	uint8_t *logic_sample;
-
-	/* If we haven't seen samples we're expecting, skip them. */
-	if ((ctx->num_analog_channels && !ctx->analog_samples) ||
-	    (ctx->num_logic_channels && !ctx->logic_samples)) {
-		sr_warn("Discarding partial packet");
+	static const double powers[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+	};
+	char digits[6], *p;
+	double v, scaled, frac;
+	uint32_t n;
+	int exp, shift, num_digits, i;
+
+	v = value;
+	if (!isfinite(v))
+		return snprintf(buf, VALUE_SIZE, "%g", v);
+
+	p = buf;
+	if (signbit(v)) {
+		*p++ = '-';
+		v = -v;
+	}
+	if (v == 0) {
+		*p++ = '0';
+		return p - buf;
+	}
+
+	/* Get the six significant digits, as an integer. */
+	frexp(v, &exp);
+	exp = floor((exp - 1) * 0.30103);
+	for (;;) {
+		shift = 5 - exp;
+		if (shift > 22 || shift < -22)
+			return snprintf(buf, VALUE_SIZE, "%g", value);
+		scaled = shift >= 0 ? v * powers[shift] : v / powers[-shift];
+		n = scaled;
+		frac = scaled - n;
+		/* The scaling is exact enough, unless it's (close to) a tie. */
+		if (fabs(frac - 0.5) < 1e-6)
+			return snprintf(buf, VALUE_SIZE, "%g", value);
+		if (frac > 0.5)
+			n++;
+		if (n >= 1000000)
+			exp++;
+		else if (n < 100000)
+			exp--;
+		else
+			break;
+	}
+	for (i = 5; i >= 0; i--) {
+		digits[i] = '0' + n % 10;
+		n /= 10;
+	}
+	num_digits = 6;
+	while (num_digits > 1 && digits[num_digits - 1] == '0')
+		num_digits--;
+
+	if (exp < -4 || exp >= 6) {
+		*p++ = digits[0];
+		if (num_digits > 1) {
+			*p++ = '.';
+			memcpy(p, digits + 1, num_digits - 1);
+			p += num_digits - 1;
+		}
+		*p++ = 'e';
+		*p++ = exp < 0 ? '-' : '+';
+		exp = abs(exp);
+		if (exp >= 100)
+			*p++ = '0' + exp / 100;
+		*p++ = '0' + exp / 10 % 10;
+		*p++ = '0' + exp % 10;
+	} else if (exp >= 0) {
+		memcpy(p, digits, exp + 1);
+		p += exp + 1;
+		if (num_digits > exp + 1) {
+			*p++ = '.';
+			memcpy(p, digits + exp + 1, num_digits - exp - 1);
+			p += num_digits - exp - 1;
+		}
 	} else {
-		sr_info("Dumping %u samples", ctx->num_samples);
-
-		*out = g_string_sized_new(512);
-		num_channels =
-		    ctx->num_logic_channels + ctx->num_analog_channels;
-
-		if (ctx->label_do) {
-			if (ctx->time)
-				g_string_append_printf(*out, "%s%s",
-					ctx->label_names ? "Time" :
-					ctx->xlabel, ctx->value);
-			for (i = 0; i < num_channels; i++) {
-				g_string_append_printf(*out, "%s%s",
-					ctx->channels[i].label, ctx->value);
-				if (ctx->channels[i].ch->type == SR_CHANNEL_ANALOG
-						&& ctx->label_names)
-					g_free(ctx->channels[i].label);
+		*p++ = '0';
+		*p++ = '.';
+		for (i = exp + 1; i < 0; i++)
+			*p++ = '0';
+		memcpy(p, digits, num_digits);
+		p += num_digits;
+	}
+
+	return p - buf;
+}
+
+static char *format_time(char *p, uint64_t time)
+{
+	char text[TIME_SIZE];
+	size_t pos;
+
+	pos = sizeof(text);
+	do {
+		text[--pos] = '0' + time % 10;
+		time /= 10;
+	} while (time);
+	memcpy(p, text + pos, sizeof(text) - pos);
+
+	return p + sizeof(text) - pos;
+}
+
+static void write_labels(struct context *ctx, GString *out)
+{
+	unsigned int i, num_channels;
+
+	num_channels = ctx->num_logic_channels + ctx->num_analog_channels;
+
+	if (ctx->time) {
+		if (ctx->label_names || ctx->xlabel)
+			g_string_append(out, ctx->label_names ? "Time" : ctx->xlabel);
+		g_string_append(out, ctx->value);
+	}
+	for (i = 0; i < num_channels; i++) {
+		if (ctx->channels[i].label)
+			g_string_append(out, ctx->channels[i].label);
+		g_string_append(out, ctx->value);
+	}
+	if (ctx->do_trigger) {
+		g_string_append(out, "Trigger");
+		g_string_append(out, ctx->value);
+	}
+	/* Drop last separator. */
+	g_string_truncate(out, out->len - ctx->value_len);
+	g_string_append(out, ctx->record);
+
+	ctx->label_do = FALSE;
+}
+
+/*
+ * Get the values of a row into row_values[]. Returns FALSE when some
+ * channel has no data for it.
+ */
+static gboolean get_row(struct context *ctx, uint64_t row)
+{
+	struct ctx_channel *channel;
+	uint64_t first;
+	unsigned int i, idx;
+	gboolean complete;
+	const uint8_t *sample;
+
+	complete = TRUE;
+	for (i = 0; i < ctx->num_analog_channels + ctx->num_logic_channels; i++) {
+		channel = &ctx->channels[i];
+		ctx->row_present[i] = FALSE;
+		if (channel->ch->type == SR_CHANNEL_ANALOG) {
+			first = channel->received - channel->pending->len;
+			if (row >= first && row < channel->received) {
+				ctx->row_values[i] = g_array_index(channel->pending,
+					float, row - first);
+				ctx->row_present[i] = TRUE;
 			}
-			if (ctx->do_trigger)
-				g_string_append_printf(*out, "Trigger%s",
-						       ctx->value);
-			/* Drop last separator. */
-			g_string_truncate(*out, (*out)->len - 1);
-			g_string_append(*out, ctx->record);
+		} else if (ctx->logic_unitsize) {
+			first = ctx->logic_received
+				- ctx->logic_pending->len / ctx->logic_unitsize;
+			idx = channel->ch->index;
+			if (row >= first && row < ctx->logic_received
+					&& idx / 8 < ctx->logic_unitsize) {
+				sample = ctx->logic_pending->data
+					+ (row - first) * ctx->logic_unitsize;
+				ctx->row_values[i] = (sample[idx / 8] >> (idx % 8)) & 1;
+				ctx->row_present[i] = TRUE;
+			}
+		}
+		complete &= ctx->row_present[i];
+	}
+
+	return complete;
+}
+
+static char *write_row(struct context *ctx, char *p, uint64_t row)
+{
+	struct ctx_channel *channel;
+	unsigned int i, num_channels;
+	float value;
+	char *start;
+
+	start = p;
+	if (ctx->time) {
+		p = format_time(p, ctx->sample_time);
+		memcpy(p, ctx->value, ctx->value_len);
+		p += ctx->value_len;
+	}
+
+	num_channels = ctx->num_logic_channels + ctx->num_analog_channels;
+	for (i = 0; i < num_channels; i++) {
+		channel = &ctx->channels[i];
+		value = ctx->row_values[i];
+		if (!ctx->row_present[i]) {
+			/* No data for this channel, leave the field empty. */
+		} else if (channel->ch->type == SR_CHANNEL_ANALOG) {
+			channel->max = fmax(value, channel->max);
+			channel->min = fmin(value, channel->min);
+			p += format_value(p, value);
+		} else {
+			*p++ = value ? '1' : '0';
+		}
+		memcpy(p, ctx->value, ctx->value_len);
+		p += ctx->value_len;
+	}
+
+	if (ctx->do_trigger) {
+		if (ctx->trigger && row >= ctx->trigger_row) {
+			*p++ = '1';
+			ctx->trigger = FALSE;
+		} else {
+			*p++ = '0';
+		}
+		memcpy(p, ctx->value, ctx->value_len);
+		p += ctx->value_len;
+	}
+
+	/* Drop last separator. */
+	if (p > start)
+		p -= ctx->value_len;
+	memcpy(p, ctx->record, ctx->record_len);
+
+	return p + ctx->record_len;
+}
 
-			ctx->label_do = FALSE;
+/* Drop the queued samples of rows which were written. */
+static void drop_rows(struct context *ctx)
+{
+	struct ctx_channel *channel;
+	uint64_t first, count;
+	unsigned int i;
+
+	for (i = 0; i < ctx->num_analog_channels + ctx->num_logic_channels; i++) {
+		channel = &ctx->channels[i];
+		if (channel->ch->type != SR_CHANNEL_ANALOG)
+			continue;
+		first = channel->received - channel->pending->len;
+		if (ctx->rows_done <= first)
+			continue;
+		count = MIN(ctx->rows_done - first, channel->pending->len);
+		g_array_remove_range(channel->pending, 0, count);
+	}
+	if (ctx->num_logic_channels && ctx->logic_unitsize) {
+		first = ctx->logic_received
+			- ctx->logic_pending->len / ctx->logic_unitsize;
+		if (ctx->rows_done > first) {
+			count = MIN(ctx->rows_done - first,
+				ctx->logic_pending->len / ctx->logic_unitsize);
+			g_byte_array_remove_range(ctx->logic_pending, 0,
+				count * ctx->logic_unitsize);
 		}
+	}
+}
 
-		analog_size = ctx->num_analog_channels * sizeof(float);
-		if (ctx->dedup && !ctx->previous_sample)
-			ctx->previous_sample = g_malloc0(analog_size + ctx->num_logic_channels);
+/*
+ * Write the rows which all channels have data for. With 'partial' set,
+ * also write the rows which some channels lack data for.
+ */
+static int write_rows(struct context *ctx, struct sr_output_sink *sink,
+		gboolean partial)
+{
+	GString *out;
+	uint64_t first, end, block_end, row;
+	gboolean complete;
+	size_t pos;
+	char *p;
+	int ret;
 
-		for (i = 0; i < ctx->num_samples; i++) {
+	end = rows_received(ctx, partial);
+	if (end <= ctx->rows_done)
+		return SR_OK;
+
+	out = sr_output_sink_text(sink);
+	if (ctx->label_do)
+		write_labels(ctx, out);
+
+	/* Duplicates get dropped among the rows of one batch. */
+	ret = SR_OK;
+	first = ctx->rows_done;
+	while (ctx->rows_done < end) {
+		block_end = MIN(end, ctx->rows_done + ROWS_PER_BLOCK);
+		pos = out->len;
+		g_string_set_size(out,
+			pos + (block_end - ctx->rows_done) * ctx->row_size);
+		p = out->str + pos;
+		for (row = ctx->rows_done; row < block_end; row++) {
 			ctx->sample_time += ctx->period;
-			analog_sample =
-			    &ctx->analog_samples[i * ctx->num_analog_channels];
-			logic_sample =
-			    &ctx->logic_samples[i * ctx->num_logic_channels];
-
-			if (ctx->dedup) {
-				if (i > 0 && i < ctx->num_samples - 1 &&
-				    !memcmp(logic_sample, ctx->previous_sample,
-					    ctx->num_logic_channels) &&
-				    !memcmp(analog_sample,
-					    ctx->previous_sample +
-					    ctx->num_logic_channels,
-					    analog_size))
+			complete = get_row(ctx, row);
+			if (ctx->dedup && complete) {
+				if (row > first && row < end - 1
+						&& !memcmp(ctx->row_values,
+						ctx->previous_values,
+						sizeof(float) * (ctx->num_analog_channels
+						+ ctx->num_logic_channels)))
 					continue;
-				memcpy(ctx->previous_sample, logic_sample,
-				       ctx->num_logic_channels);
-				memcpy(ctx->previous_sample
-				       + ctx->num_logic_channels,
-				       analog_sample, analog_size);
+				memcpy(ctx->previous_values, ctx->row_values,
+					sizeof(float) * (ctx->num_analog_channels
+					+ ctx->num_logic_channels));
 			}
+			p = write_row(ctx, p, row);
+		}
+		g_string_truncate(out, p - out->str);
+		ctx->rows_done = block_end;
+
+		/* Keep the text of long packets from piling up. */
+		if (out->len >= FLUSH_SIZE) {
+			if ((ret = sr_output_sink_flush(sink)) != SR_OK)
+				break;
+			out = sr_output_sink_text(sink);
+		}
+	}
+	drop_rows(ctx);
 
-			if (ctx->time)
-				g_string_append_printf(*out, "%" PRIu64 "%s",
-					ctx->sample_time, ctx->value);
-
-			for (j = 0; j < num_channels; j++) {
-				if (ctx->channels[j].ch->type == SR_CHANNEL_ANALOG) {
-					value = ctx->analog_samples[i * ctx->num_analog_channels + j];
-					ctx->channels[j].max =
-					    fmax(value, ctx->channels[j].max);
-					ctx->channels[j].min =
-					    fmin(value, ctx->channels[j].min);
-					g_string_append_printf(*out, "%g%s",
-						value, ctx->value);
-				} else if (ctx->channels[j].ch->type == SR_CHANNEL_LOGIC) {
-					g_string_append_printf(*out, "%c%s",
-							       ctx->logic_samples[i * ctx->num_logic_channels + j] ? '1' : '0', ctx->value);
-				} else {
-					sr_warn("Unexpected channel type: %d",
-						ctx->channels[i].ch->type);
-				}
-			}
+	return ret;
+}
 
-			if (ctx->do_trigger) {
-				g_string_append_printf(*out, "%d%s",
-					ctx->trigger, ctx->value);
-				ctx->trigger = FALSE;
-			}
-			g_string_truncate(*out, (*out)->len - 1);
-			g_string_append(*out, ctx->record);
-		}
+/* Write what is left of the frame, and start counting rows anew. */
+static int end_frame(struct context *ctx, struct sr_output_sink *sink)
+{
+	unsigned int i;
+	int ret;
+
+	ret = write_rows(ctx, sink, TRUE);
+
+	for (i = 0; i < ctx->num_analog_channels + ctx->num_logic_channels; i++) {
+		if (ctx->channels[i].ch->type != SR_CHANNEL_ANALOG)
+			continue;
+		g_array_set_size(ctx->channels[i].pending, 0);
+		ctx->channels[i].received = 0;
 	}
+	if (ctx->num_logic_channels)
+		g_byte_array_set_size(ctx->logic_pending, 0);
+	ctx->logic_received = 0;
+	ctx->rows_done = 0;
+	ctx->trigger_row = 0;
 
-	/* Discard all of the working space. */
-	g_free(ctx->previous_sample);
-	g_free(ctx->analog_samples);
-	g_free(ctx->logic_samples);
-	ctx->channels_seen = 0;
-	ctx->num_samples = 0;
-	ctx->previous_sample = NULL;
-	ctx->analog_samples = NULL;
-	ctx->logic_samples = NULL;
+	return ret;
 }
 
 static void save_gnuplot(struct context *ctx)
@@ -559,53 +856,67 @@ static void save_gnuplot(struct context *ctx)
 	g_string_free(script, TRUE);
 }
 
-static int receive(const struct sr_output *o,
-		   const struct sr_datafeed_packet *packet, GString **out)
+static int receive_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, struct sr_output_sink *sink)
 {
 	struct context *ctx;
+	int ret;
 
-	*out = NULL;
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 	if (!(ctx = o->priv))
 		return SR_ERR_ARG;
 
 	sr_dbg("Got packet of type %d", packet->type);
+	ret = SR_OK;
 	switch (packet->type) {
 	case SR_DF_HEADER:
-		*out = gen_header(o, packet->payload);
+		gen_header(o, packet->payload, sr_output_sink_text(sink));
 		break;
 	case SR_DF_TRIGGER:
 		ctx->trigger = TRUE;
+		ctx->trigger_row = rows_received(ctx, TRUE);
 		break;
 	case SR_DF_LOGIC:
 		process_logic(ctx, packet->payload);
+		ret = write_rows(ctx, sink, FALSE);
 		break;
 	case SR_DF_ANALOG:
-		process_analog(ctx, packet->payload);
+		ret = process_analog(o, ctx, packet->payload);
+		if (ret == SR_OK)
+			ret = write_rows(ctx, sink, FALSE);
 		break;
 	case SR_DF_FRAME_BEGIN:
-		*out = g_string_new(ctx->frame);
-		/* Fallthrough */
+		ret = end_frame(ctx, sink);
+		g_string_append(sr_output_sink_text(sink), ctx->frame);
+		if (*ctx->gnuplot)
+			save_gnuplot(ctx);
+		break;
+	case SR_DF_FRAME_END:
+		ret = end_frame(ctx, sink);
+		break;
 	case SR_DF_END:
-		/* Got to end of frame/session with part of the data. */
-		if (ctx->channels_seen)
-			ctx->channels_seen = ctx->channel_count;
+		ret = end_frame(ctx, sink);
 		if (*ctx->gnuplot)
 			save_gnuplot(ctx);
 		break;
 	}
 
-	/* If we've got them all, dump the values. */
-	if (ctx->channels_seen >= ctx->channel_count)
-		dump_saved_values(ctx, out);
+	/* Don't let channels which lag behind hold up the others forever. */
+	if (ret == SR_OK && rows_received(ctx, TRUE) - ctx->rows_done > MAX_PENDING) {
+		if (!ctx->warned_pending)
+			sr_warn("Some channels lag behind, writing rows without them.");
+		ctx->warned_pending = TRUE;
+		ret = write_rows(ctx, sink, TRUE);
+	}
 
-	return SR_OK;
+	return ret;
 }
 
 static int cleanup(struct sr_output *o)
 {
 	struct context *ctx;
+	unsigned int i;
 
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
@@ -617,7 +928,21 @@ static int cleanup(struct sr_output *o)
 		g_free((gpointer)ctx->comment);
 		g_free((gpointer)ctx->gnuplot);
 		g_free((gpointer)ctx->value);
-		g_free(ctx->previous_sample);
+		for (i = 0; i < ctx->num_analog_channels + ctx->num_logic_channels; i++) {
+			if (!ctx->channels[i].ch)
+				continue;
+			if (ctx->channels[i].ch->type != SR_CHANNEL_ANALOG)
+				continue;
+			if (!ctx->label_names)
+				g_free(ctx->channels[i].label);
+			g_array_free(ctx->channels[i].pending, TRUE);
+		}
+		if (ctx->logic_pending)
+			g_byte_array_free(ctx->logic_pending, TRUE);
+		g_free(ctx->row_values);
+		g_free(ctx->row_present);
+		g_free(ctx->previous_values);
+		g_free(ctx->fdata);
 		g_free(ctx->channels);
 		g_free(o->priv);
 		o->priv = NULL;
@@ -674,6 +999,6 @@ SR_PRIV struct sr_output_module output_csv = {
 	.flags = 0,
 	.options = get_options,
 	.init = init,
-	.receive = receive,
+	.receive_sink = receive_sink,
 	.cleanup = cleanup,
 };
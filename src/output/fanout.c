@@ -0,0 +1,424 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "output"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Sending packets to several output instances at once.
+ */
+
+/**
+ * @addtogroup grp_output
+ *
+ * @{
+ */
+
+/** @cond PRIVATE */
+
+/* Smaller data packets are not worth handing to the worker threads. */
+#define FANOUT_PARALLEL_SIZE	(64 * 1024)
+
+/* Conversions of the current packet, done once for all outputs. */
+struct sr_output_shared {
+	GMutex mutex;
+	const struct sr_datafeed_analog *analog;
+	gboolean floats_done;
+	int floats_ret;
+	float *floats;
+	size_t floats_size;
+};
+
+/* Outputs which write to the same sink, they run one after another. */
+struct fanout_group {
+	struct sr_output_fanout *fo;
+	struct sr_output_sink *sink;
+	GPtrArray *outputs;
+	int ret;
+};
+
+struct sr_output_fanout {
+	GPtrArray *groups;
+	GThreadPool *pool;
+	unsigned int num_threads;
+	const struct sr_datafeed_packet *packet;
+	struct sr_output_shared shared;
+	gboolean logic_seen;
+	gboolean analog_seen;
+	/* Number of groups the workers have not finished yet. */
+	GMutex mutex;
+	GCond done;
+	unsigned int pending;
+};
+
+/** @endcond */
+
+static int convert_floats(const struct sr_datafeed_analog *analog,
+		float **buf, size_t *buf_size)
+{
+	float *fdata;
+	size_t count;
+
+	count = analog->num_samples * g_slist_length(analog->meaning->channels);
+	if (*buf_size < count) {
+		if (!(fdata = g_try_realloc(*buf, count * sizeof(float))))
+			return SR_ERR_MALLOC;
+		*buf = fdata;
+		*buf_size = count;
+	}
+
+	return sr_analog_to_float(analog, *buf);
+}
+
+/**
+ * Get the values of an analog packet as floats.
+ *
+ * Outputs of a fan-out share the conversion, the values are converted
+ * once and are only valid during the packet. Other outputs get the
+ * values in their buffer, which grows as needed.
+ *
+ * @param o The output instance.
+ * @param analog The analog packet.
+ * @param buf The output's buffer, which may be reallocated.
+ * @param buf_size The number of floats the buffer holds.
+ * @param values Receives the values.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_MALLOC The buffer could not be allocated.
+ * @retval other Error of sr_analog_to_float().
+ *
+ * @private
+ */
+SR_PRIV int sr_output_analog_to_float(const struct sr_output *o,
+		const struct sr_datafeed_analog *analog, float **buf,
+		size_t *buf_size, const float **values)
+{
+	struct sr_output_shared *shared;
+	int ret;
+
+	shared = o->shared;
+	if (!shared || shared->analog != analog) {
+		ret = convert_floats(analog, buf, buf_size);
+		*values = *buf;
+		return ret;
+	}
+
+	g_mutex_lock(&shared->mutex);
+	if (!shared->floats_done) {
+		shared->floats_ret = convert_floats(analog, &shared->floats,
+			&shared->floats_size);
+		shared->floats_done = TRUE;
+	}
+	g_mutex_unlock(&shared->mutex);
+	*values = shared->floats;
+
+	return shared->floats_ret;
+}
+
+static int run_group(struct fanout_group *group,
+		const struct sr_datafeed_packet *packet)
+{
+	const struct sr_output *o;
+	unsigned int i;
+	int ret;
+
+	/* Outputs sharing the sink get the packet in the order they were added. */
+	group->ret = SR_OK;
+	for (i = 0; i < group->outputs->len; i++) {
+		o = g_ptr_array_index(group->outputs, i);
+		ret = sr_output_send_sink(o, packet, group->sink);
+		if (group->ret == SR_OK)
+			group->ret = ret;
+	}
+
+	return group->ret;
+}
+
+static void fanout_worker(gpointer data, gpointer user_data)
+{
+	struct fanout_group *group;
+	struct sr_output_fanout *fo;
+
+	(void)user_data;
+
+	group = data;
+	fo = group->fo;
+	run_group(group, fo->packet);
+
+	g_mutex_lock(&fo->mutex);
+	if (!--fo->pending)
+		g_cond_signal(&fo->done);
+	g_mutex_unlock(&fo->mutex);
+}
+
+/**
+ * Create a fan-out, which sends packets to several output instances.
+ *
+ * Frontends which write several formats at once pass each packet to
+ * the fan-out instead of to each output instance. Conversions which
+ * several output modules need, like the conversion of analog values
+ * to floats, are done once for all of them. Outputs with their own
+ * sink run in parallel on a pool of worker threads.
+ *
+ * @param num_threads The maximum number of worker threads, or 0 for
+ *                    one per processor.
+ *
+ * @return The new fan-out.
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_output_fanout *sr_output_fanout_new(unsigned int num_threads)
+{
+	struct sr_output_fanout *fo;
+
+	if (!num_threads) {
+#if GLIB_CHECK_VERSION(2, 36, 0)
+		num_threads = g_get_num_processors();
+#else
+		num_threads = 2;
+#endif
+	}
+
+	fo = g_malloc0(sizeof(*fo));
+	fo->groups = g_ptr_array_new();
+	fo->num_threads = num_threads;
+	g_mutex_init(&fo->mutex);
+	g_cond_init(&fo->done);
+	g_mutex_init(&fo->shared.mutex);
+
+	return fo;
+}
+
+/**
+ * Add an output instance to a fan-out.
+ *
+ * The output instance and the sink remain owned by the caller, and
+ * must remain valid until the fan-out is freed. An output instance can
+ * only be part of one fan-out, and must not get packets otherwise
+ * while it is part of it. Outputs which share a sink get each packet
+ * one after another, in the order in which they were added, so that
+ * their output does not mix.
+ *
+ * @param fo The fan-out.
+ * @param o The output instance to add.
+ * @param sink The sink to write the instance's output to.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or the output instance is
+ *         already part of a fan-out.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_fanout_add(struct sr_output_fanout *fo,
+		const struct sr_output *o, struct sr_output_sink *sink)
+{
+	struct fanout_group *group;
+	unsigned int i;
+
+	if (!fo || !o || !sink)
+		return SR_ERR_ARG;
+	if (o->shared) {
+		sr_err("Output is already part of a fan-out.");
+		return SR_ERR_ARG;
+	}
+
+	group = NULL;
+	for (i = 0; i < fo->groups->len; i++) {
+		group = g_ptr_array_index(fo->groups, i);
+		if (group->sink == sink)
+			break;
+		group = NULL;
+	}
+	if (!group) {
+		group = g_malloc0(sizeof(*group));
+		group->fo = fo;
+		group->sink = sink;
+		group->outputs = g_ptr_array_new();
+		g_ptr_array_add(fo->groups, group);
+		if (fo->pool)
+			g_thread_pool_set_max_threads(fo->pool,
+				MIN(fo->num_threads, fo->groups->len) - 1, NULL);
+	}
+	g_ptr_array_add(group->outputs, (gpointer)o);
+	((struct sr_output *)o)->shared = &fo->shared;
+
+	return SR_OK;
+}
+
+/*
+ * Check whether the packet is worth running the outputs in parallel.
+ * The first data packets go one output after another, outputs set up
+ * their state then and may query the device.
+ */
+static gboolean run_parallel(struct sr_output_fanout *fo,
+		const struct sr_datafeed_packet *packet)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	gboolean seen;
+
+	if (fo->groups->len < 2 || fo->num_threads < 2)
+		return FALSE;
+
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		seen = fo->logic_seen;
+		fo->logic_seen = TRUE;
+		return seen && logic->length >= FANOUT_PARALLEL_SIZE;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		seen = fo->analog_seen;
+		fo->analog_seen = TRUE;
+		return seen && analog->num_samples * sizeof(float)
+			* g_slist_length(analog->meaning->channels)
+			>= FANOUT_PARALLEL_SIZE;
+	default:
+		return FALSE;
+	}
+}
+
+/**
+ * Send a packet to all output instances of a fan-out.
+ *
+ * Returns when all outputs have processed the packet, so the packet
+ * needs to be valid only during the call. Each output gets the packets
+ * in the order in which they were sent.
+ *
+ * @param fo The fan-out.
+ * @param packet The packet to send.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval other The first error of an output, in the order in which
+ *         the outputs were added. All outputs get the packet regardless.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_fanout_send(struct sr_output_fanout *fo,
+		const struct sr_datafeed_packet *packet)
+{
+	struct fanout_group *group;
+	unsigned int i;
+	gboolean parallel;
+	int ret;
+
+	if (!fo || !packet)
+		return SR_ERR_ARG;
+
+	fo->shared.analog = NULL;
+	if (packet->type == SR_DF_ANALOG)
+		fo->shared.analog = packet->payload;
+	fo->shared.floats_done = FALSE;
+
+	parallel = run_parallel(fo, packet);
+	if (parallel && !fo->pool) {
+		fo->pool = g_thread_pool_new(fanout_worker, NULL,
+			MIN(fo->num_threads, fo->groups->len) - 1, FALSE, NULL);
+		if (!fo->pool) {
+			sr_warn("No worker threads, outputs run one by one.");
+			fo->num_threads = 1;
+			parallel = FALSE;
+		}
+	}
+
+	if (parallel) {
+		/* The calling thread takes care of the first group. */
+		fo->packet = packet;
+		fo->pending = fo->groups->len - 1;
+		for (i = 1; i < fo->groups->len; i++)
+			g_thread_pool_push(fo->pool,
+				g_ptr_array_index(fo->groups, i), NULL);
+		run_group(g_ptr_array_index(fo->groups, 0), packet);
+		g_mutex_lock(&fo->mutex);
+		while (fo->pending)
+			g_cond_wait(&fo->done, &fo->mutex);
+		g_mutex_unlock(&fo->mutex);
+		fo->packet = NULL;
+	} else {
+		for (i = 0; i < fo->groups->len; i++)
+			run_group(g_ptr_array_index(fo->groups, i), packet);
+	}
+
+	fo->shared.analog = NULL;
+
+	ret = SR_OK;
+	for (i = 0; i < fo->groups->len && ret == SR_OK; i++) {
+		group = g_ptr_array_index(fo->groups, i);
+		ret = group->ret;
+	}
+
+	return ret;
+}
+
+/**
+ * Free a fan-out.
+ *
+ * The output instances and sinks are not freed, they can be used on
+ * their own again.
+ *
+ * @param fo The fan-out.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_fanout_free(struct sr_output_fanout *fo)
+{
+	struct fanout_group *group;
+	struct sr_output *o;
+	unsigned int i, j;
+
+	if (!fo)
+		return SR_ERR_ARG;
+
+	if (fo->pool)
+		g_thread_pool_free(fo->pool, FALSE, TRUE);
+
+	for (i = 0; i < fo->groups->len; i++) {
+		group = g_ptr_array_index(fo->groups, i);
+		for (j = 0; j < group->outputs->len; j++) {
+			o = g_ptr_array_index(group->outputs, j);
+			o->shared = NULL;
+		}
+		g_ptr_array_free(group->outputs, TRUE);
+		g_free(group);
+	}
+	g_ptr_array_free(fo->groups, TRUE);
+
+	g_mutex_clear(&fo->shared.mutex);
+	g_free(fo->shared.floats);
+	g_cond_clear(&fo->done);
+	g_mutex_clear(&fo->mutex);
+	g_free(fo);
+
+	return SR_OK;
+}
+
+/** @} */
@@ -41,6 +41,13 @@ struct context {
 	uint8_t *sample_buf;
 	gboolean header_done;
 	GString **lines;
+	/* Bits of up to 8 samples per channel, see sr_output_transpose_logic(). */
+	size_t num_columns;
+	uint8_t *channel_bits;
+	/* Bit order reversal, to get the first sample in the MSB. */
+	uint8_t reversed[256];
+	/* Two hex digits and a separator for each byte value. */
+	char hex_text[256][3];
 };
 
 static int init(struct sr_output *o, GHashTable *options)
@@ -80,20 +87,33 @@ static int init(struct sr_output *o, GHashTable *options)
 			continue;
 		ctx->channel_index[j] = ch->index;
 		ctx->channel_names[j] = ch->name;
-		ctx->lines[j] = g_string_sized_new(80);
+		ctx->lines[j] = g_string_sized_new(strlen(ch->name) + 5
+			+ (ctx->spl ? ctx->spl / 8 * 3 : 80));
 		ctx->sample_buf[j] = 0;
 		g_string_printf(ctx->lines[j], "%s:", ch->name);
+		ctx->num_columns = MAX(ctx->num_columns, (size_t)ch->index / 8 + 1);
 		j++;
 	}
+	ctx->channel_bits = g_malloc0(ctx->num_columns * 8);
+
+	for (i = 0; i < 256; i++) {
+		ctx->reversed[i] = 0;
+		for (j = 0; j < 8; j++) {
+			if (i & (1 << j))
+				ctx->reversed[i] |= 0x80 >> j;
+		}
+		ctx->hex_text[i][0] = "0123456789abcdef"[i >> 4];
+		ctx->hex_text[i][1] = "0123456789abcdef"[i & 0xf];
+		ctx->hex_text[i][2] = ' ';
+	}
 
 	return SR_OK;
 }
 
-static GString *gen_header(const struct sr_output *o)
+static void gen_header(const struct sr_output *o, GString *header)
 {
 	struct context *ctx;
 	GVariant *gvar;
-	GString *header;
 	int num_channels;
 	char *samplerate_s;
 
@@ -106,8 +126,7 @@ static GString *gen_header(const struct sr_output *o)
 		}
 	}
 
-	header = g_string_sized_new(512);
-	g_string_printf(header, "%s %s\n", PACKAGE_NAME, SR_PACKAGE_VERSION_STRING);
+	g_string_append_printf(header, "%s %s\n", PACKAGE_NAME, SR_PACKAGE_VERSION_STRING);
 	num_channels = g_slist_length(o->sdi->channels);
 	g_string_append_printf(header, "Acquisition with %d/%d channels",
 			ctx->num_enabled_channels, num_channels);
@@ -117,23 +136,86 @@ static GString *gen_header(const struct sr_output *o)
 		g_free(samplerate_s);
 	}
 	g_string_append_printf(header, "\n");
+}
+
+/* Write out the complete lines of all channels. */
+static void flush_lines(struct context *ctx, GString *out)
+{
+	unsigned int j;
+	int offset;
+
+	for (j = 0; j < ctx->num_enabled_channels; j++) {
+		g_string_append_len(out, ctx->lines[j]->str, ctx->lines[j]->len);
+		g_string_append_c(out, '\n');
+		g_string_truncate(ctx->lines[j], strlen(ctx->channel_names[j]) + 1);
+	}
+	if (ctx->num_enabled_channels && ctx->trigger > -1) {
+		/*
+		 * Sample data lines have one character per nibble,
+		 * plus one separator per byte. Align trigger marker
+		 * to this layout.
+		 */
+		offset = ctx->trigger / 4 + ctx->trigger / 8;
+		g_string_append_printf(out, "T:%*s^ %d\n", offset, "", ctx->trigger);
+		ctx->trigger = -1;
+	}
+}
 
-	return header;
+static void process_logic(struct context *ctx, GString *out,
+		const struct sr_datafeed_logic *logic)
+{
+	const uint8_t *data;
+	size_t count, chunk;
+	unsigned int j;
+	gboolean full;
+	uint8_t bits;
+
+	if (!logic->unitsize)
+		return;
+	data = logic->data;
+	count = logic->length / logic->unitsize;
+	while (count) {
+		/* Take up to 8 samples, up to the next byte or line boundary. */
+		chunk = 8 - (ctx->spl_cnt & 7);
+		if (ctx->spl)
+			chunk = MIN(chunk, (size_t)(ctx->spl - ctx->spl_cnt));
+		chunk = MIN(chunk, count);
+		sr_output_transpose_logic(data, logic->unitsize, chunk,
+			ctx->channel_bits, ctx->num_columns);
+		ctx->spl_cnt += chunk;
+
+		full = !(ctx->spl_cnt & 7);
+		for (j = 0; j < ctx->num_enabled_channels; j++) {
+			bits = ctx->channel_bits[ctx->channel_index[j]];
+			bits = ctx->reversed[bits] >> (8 - chunk);
+			ctx->sample_buf[j] = (ctx->sample_buf[j] << chunk) | bits;
+			if (full) {
+				/* Buffered a byte's worth, output hex. */
+				g_string_append_len(ctx->lines[j],
+					ctx->hex_text[ctx->sample_buf[j]], 3);
+				ctx->sample_buf[j] = 0;
+			}
+		}
+
+		if (ctx->spl_cnt == ctx->spl) {
+			flush_lines(ctx, out);
+			ctx->spl_cnt = 0;
+		}
+		data += chunk * logic->unitsize;
+		count -= chunk;
+	}
 }
 
-static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
-		GString **out)
+static int receive_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, struct sr_output_sink *sink)
 {
 	const struct sr_datafeed_meta *meta;
-	const struct sr_datafeed_logic *logic;
 	const struct sr_config *src;
 	GSList *l;
 	struct context *ctx;
-	int idx, pos, offset;
-	uint64_t i, j;
-	gchar *p;
+	GString *out;
+	unsigned int i;
 
-	*out = NULL;
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 	if (!(ctx = o->priv))
@@ -153,61 +235,23 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		ctx->trigger = ctx->spl_cnt;
 		break;
 	case SR_DF_LOGIC:
+		out = sr_output_sink_text(sink);
 		if (!ctx->header_done) {
-			*out = gen_header(o);
+			gen_header(o, out);
 			ctx->header_done = TRUE;
-		} else
-			*out = g_string_sized_new(512);
-
-		logic = packet->payload;
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			ctx->spl_cnt++;
-			pos = ctx->spl_cnt & 7;
-			for (j = 0; j < ctx->num_enabled_channels; j++) {
-				idx = ctx->channel_index[j];
-				p = logic->data + i + idx / 8;
-				ctx->sample_buf[j] <<= 1;
-				if (*p & (1 << (idx % 8)))
-					ctx->sample_buf[j] |= 1;
-				if (ctx->spl_cnt && pos == 0) {
-					/* Buffered a byte's worth, output hex. */
-					g_string_append_printf(ctx->lines[j], "%.2x ",
-							ctx->sample_buf[j]);
-					ctx->sample_buf[j] = 0;
-				}
-
-				if (ctx->spl_cnt == ctx->spl) {
-					/* Flush line buffers. */
-					g_string_append_len(*out, ctx->lines[j]->str, ctx->lines[j]->len);
-					g_string_append_c(*out, '\n');
-					if (j == ctx->num_enabled_channels - 1 && ctx->trigger > -1) {
-						/*
-						 * Sample data lines have one character per nibble,
-						 * plus one separator per byte. Align trigger marker
-						 * to this layout.
-						 */
-						offset = ctx->trigger / 4 + ctx->trigger / 8;
-						g_string_append_printf(*out, "T:%*s^ %d\n", offset, "", ctx->trigger);
-						ctx->trigger = -1;
-					}
-					g_string_printf(ctx->lines[j], "%s:", ctx->channel_names[j]);
-				}
-			}
-			if (ctx->spl_cnt == ctx->spl)
-				/* Line buffers were already flushed. */
-				ctx->spl_cnt = 0;
 		}
+		process_logic(ctx, out, packet->payload);
 		break;
 	case SR_DF_END:
 		if (ctx->spl_cnt) {
 			/* Line buffers need flushing. */
-			*out = g_string_sized_new(512);
+			out = sr_output_sink_text(sink);
 			for (i = 0; i < ctx->num_enabled_channels; i++) {
 				if (ctx->spl_cnt & 7)
 					g_string_append_printf(ctx->lines[i], "%.2x ",
 							ctx->sample_buf[i] << (8 - (ctx->spl_cnt & 7)));
-				g_string_append_len(*out, ctx->lines[i]->str, ctx->lines[i]->len);
-				g_string_append_c(*out, '\n');
+				g_string_append_len(out, ctx->lines[i]->str, ctx->lines[i]->len);
+				g_string_append_c(out, '\n');
 			}
 		}
 		break;
@@ -229,6 +273,7 @@ static int cleanup(struct sr_output *o)
 
 	g_free(ctx->channel_index);
 	g_free(ctx->sample_buf);
+	g_free(ctx->channel_bits);
 	g_free(ctx->channel_names);
 	for (i = 0; i < ctx->num_enabled_channels; i++)
 		g_string_free(ctx->lines[i], TRUE);
@@ -262,6 +307,6 @@ SR_PRIV struct sr_output_module output_hex = {
 	.flags = 0,
 	.options = get_options,
 	.init = init,
-	.receive = receive,
+	.receive_sink = receive_sink,
 	.cleanup = cleanup,
 };
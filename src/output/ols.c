@@ -33,14 +33,24 @@
 
 #define LOG_PREFIX "output/ols"
 
+/* Room for the decimal digits of a 64 bit sample number. */
+#define COUNT_SIZE 20
+
 struct context {
 	uint64_t samplerate;
 	uint64_t num_samples;
+	gboolean header_done;
+	/* Decimal text of num_samples, at the end of the buffer. */
+	char count_text[COUNT_SIZE];
+	size_t count_len;
+	/* Two hex digits for each byte value. */
+	char hex_text[256][2];
 };
 
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct context *ctx;
+	unsigned int i;
 
 	(void)options;
 
@@ -48,15 +58,22 @@ static int init(struct sr_output *o, GHashTable *options)
 	o->priv = ctx;
 	ctx->samplerate = 0;
 	ctx->num_samples = 0;
+	ctx->count_text[COUNT_SIZE - 1] = '0';
+	ctx->count_len = 1;
+
+	for (i = 0; i < 256; i++) {
+		ctx->hex_text[i][0] = "0123456789abcdef"[i >> 4];
+		ctx->hex_text[i][1] = "0123456789abcdef"[i & 0xf];
+	}
 
 	return SR_OK;
 }
 
-static GString *gen_header(const struct sr_dev_inst *sdi, struct context *ctx)
+static void gen_header(const struct sr_dev_inst *sdi, struct context *ctx,
+		GString *s)
 {
 	struct sr_channel *ch;
 	GSList *l;
-	GString *s;
 	GVariant *gvar;
 	int num_enabled_channels;
 
@@ -76,28 +93,76 @@ static GString *gen_header(const struct sr_dev_inst *sdi, struct context *ctx)
 		num_enabled_channels++;
 	}
 
-	s = g_string_sized_new(512);
 	g_string_append_printf(s, ";Rate: %"PRIu64"\n", ctx->samplerate);
 	g_string_append_printf(s, ";Channels: %d\n", num_enabled_channels);
 	g_string_append_printf(s, ";EnabledChannels: -1\n");
 	g_string_append_printf(s, ";Compressed: true\n");
 	g_string_append_printf(s, ";CursorEnabled: false\n");
+}
+
+/* Advance the sample number, and its decimal text. */
+static void count_sample(struct context *ctx)
+{
+	char *p;
+
+	ctx->num_samples++;
+	p = ctx->count_text + COUNT_SIZE;
+	while (p > ctx->count_text + COUNT_SIZE - ctx->count_len) {
+		if (*--p != '9') {
+			(*p)++;
+			return;
+		}
+		*p = '0';
+	}
+	ctx->count_len++;
+	*--p = '1';
+}
 
-	return s;
+static void process_logic(struct context *ctx, GString *out,
+		const struct sr_datafeed_logic *logic)
+{
+	const uint8_t *sample;
+	size_t count, line_size, pos, i;
+	char *p;
+	int j;
+
+	if (!logic->unitsize)
+		return;
+	count = logic->length / logic->unitsize;
+
+	/* Make room for the longest lines, and fill in the text directly. */
+	line_size = 2 * logic->unitsize + 1 + COUNT_SIZE + 1;
+	pos = out->len;
+	g_string_set_size(out, pos + count * line_size);
+	p = out->str + pos;
+
+	sample = logic->data;
+	for (i = 0; i < count; i++) {
+		/* The OLS format wants the samples presented MSB first. */
+		for (j = logic->unitsize - 1; j >= 0; j--) {
+			memcpy(p, ctx->hex_text[sample[j]], 2);
+			p += 2;
+		}
+		*p++ = '@';
+		memcpy(p, ctx->count_text + COUNT_SIZE - ctx->count_len,
+			ctx->count_len);
+		p += ctx->count_len;
+		*p++ = '\n';
+		count_sample(ctx);
+		sample += logic->unitsize;
+	}
+	g_string_truncate(out, p - out->str);
 }
 
-static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
-		GString **out)
+static int receive_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, struct sr_output_sink *sink)
 {
 	struct context *ctx;
 	const struct sr_datafeed_meta *meta;
-	const struct sr_datafeed_logic *logic;
 	const struct sr_config *src;
 	GSList *l;
-	unsigned int i, j;
-	uint8_t c;
+	GString *out;
 
-	*out = NULL;
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 	ctx = o->priv;
@@ -112,20 +177,13 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		}
 		break;
 	case SR_DF_LOGIC:
-		logic = packet->payload;
-		if (ctx->num_samples == 0) {
+		out = sr_output_sink_text(sink);
+		if (!ctx->header_done) {
 			/* First logic packet in the feed. */
-			*out = gen_header(o->sdi, ctx);
-		} else
-			*out = g_string_sized_new(512);
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			for (j = 0; j < logic->unitsize; j++) {
-				/* The OLS format wants the samples presented MSB first. */
-				c = *((uint8_t *)logic->data + i + logic->unitsize - 1 - j);
-				g_string_append_printf(*out, "%02x", c);
-			}
-			g_string_append_printf(*out, "@%"PRIu64"\n", ctx->num_samples++);
+			gen_header(o->sdi, ctx, out);
+			ctx->header_done = TRUE;
 		}
+		process_logic(ctx, out, packet->payload);
 		break;
 	}
 
@@ -154,6 +212,6 @@ SR_PRIV struct sr_output_module output_ols = {
 	.flags = 0,
 	.options = NULL,
 	.init = init,
-	.receive = receive,
+	.receive_sink = receive_sink,
 	.cleanup = cleanup
 };
@@ -49,6 +49,11 @@
  * Output modules generate a newly allocated GString. The caller is then
  * expected to free this with g_string_free() when finished with it.
  *
+ * Alternatively, output can be written to a sink, see
+ * sr_output_send_sink(). Sinks write to a file descriptor, a stdio
+ * stream, or pass the output to a callback. They avoid the per packet
+ * allocation, and write sample data without copying it where possible.
+ *
  * @{
  */
 
@@ -57,10 +62,12 @@ extern SR_PRIV struct sr_output_module output_bits;
 extern SR_PRIV struct sr_output_module output_hex;
 extern SR_PRIV struct sr_output_module output_ascii;
 extern SR_PRIV struct sr_output_module output_binary;
+extern SR_PRIV struct sr_output_module output_binary_lz4;
 extern SR_PRIV struct sr_output_module output_vcd;
 extern SR_PRIV struct sr_output_module output_ols;
 extern SR_PRIV struct sr_output_module output_chronovu_la8;
 extern SR_PRIV struct sr_output_module output_csv;
+extern SR_PRIV struct sr_output_module output_columnar;
 extern SR_PRIV struct sr_output_module output_analog;
 extern SR_PRIV struct sr_output_module output_srzip;
 extern SR_PRIV struct sr_output_module output_wav;
@@ -70,8 +77,10 @@ extern SR_PRIV struct sr_output_module output_null;
 static const struct sr_output_module *output_module_list[] = {
 	&output_ascii,
 	&output_binary,
+	&output_binary_lz4,
 	&output_bits,
 	&output_csv,
+	&output_columnar,
 	&output_hex,
 	&output_ols,
 	&output_vcd,
@@ -269,7 +278,7 @@ SR_API const struct sr_output *sr_output_new(const struct sr_output_module *omod
 	gpointer key, value;
 	int i;
 
-	op = g_malloc(sizeof(struct sr_output));
+	op = g_malloc0(sizeof(struct sr_output));
 	op->module = omod;
 	op->sdi = sdi;
 	op->filename = g_strdup(filename);
@@ -334,7 +343,72 @@ SR_API const struct sr_output *sr_output_new(const struct sr_output_module *omod
 SR_API int sr_output_send(const struct sr_output *o,
 		const struct sr_datafeed_packet *packet, GString **out)
 {
-	return o->module->receive(o, packet, out);
+	struct sr_output_sink *sink;
+	int ret;
+
+	if (o->module->receive)
+		return o->module->receive(o, packet, out);
+
+	/* Collect the output of sink based modules. */
+	*out = g_string_new(NULL);
+	sink = sr_output_sink_new_string(*out);
+	ret = o->module->receive_sink(o, packet, sink);
+	sr_output_sink_free(sink);
+	if (ret != SR_OK || !(*out)->len) {
+		g_string_free(*out, TRUE);
+		*out = NULL;
+	}
+
+	return ret;
+}
+
+/**
+ * Send a packet to the specified output instance, and write the
+ * instance's output to a sink.
+ *
+ * The sink can be shared by several output instances. Some output may
+ * remain pending in the sink, call sr_output_sink_flush() or
+ * sr_output_sink_free() when done.
+ *
+ * @param o The output instance.
+ * @param packet The packet to send.
+ * @param sink The sink to write the output to.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_IO Output could not be written.
+ * @retval other Error code of the output module.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_send_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet,
+		struct sr_output_sink *sink)
+{
+	GString *out;
+	int ret, done;
+
+	if (!o || !packet || !sink)
+		return SR_ERR_ARG;
+
+	if (o->module->receive_sink) {
+		ret = o->module->receive_sink(o, packet, sink);
+		/* References into the packet must not outlive this call. */
+		done = sr_output_sink_packet_done(sink);
+		return (ret != SR_OK) ? ret : done;
+	}
+
+	/* Modules which return a GString. */
+	out = NULL;
+	ret = o->module->receive(o, packet, &out);
+	if (ret == SR_OK && out)
+		ret = sr_output_sink_write(sink, out->str, out->len);
+	if (ret == SR_OK)
+		ret = sr_output_sink_packet_done(sink);
+	if (out)
+		g_string_free(out, TRUE);
+
+	return ret;
 }
 
 /**
@@ -358,4 +432,46 @@ SR_API int sr_output_free(const struct sr_output *o)
 	return ret;
 }
 
+/**
+ * Transpose up to 8 samples of logic data, to get at the bits of each
+ * channel at once.
+ *
+ * Byte n of 'bits' receives the bits of channel n, with the first sample
+ * in the least significant bit. Channels beyond the unit size read as low.
+ *
+ * @param data The samples.
+ * @param unitsize The size of a sample in bytes.
+ * @param count The number of samples, at most 8.
+ * @param bits Receives 8 bytes for each column.
+ * @param columns The number of bytes worth of channels to transpose.
+ *
+ * @private
+ */
+SR_PRIV void sr_output_transpose_logic(const uint8_t *data, size_t unitsize,
+		size_t count, uint8_t *bits, size_t columns)
+{
+	uint64_t x, t;
+	size_t col, k;
+
+	for (col = 0; col < columns; col++) {
+		/* Byte k holds the column of sample k. */
+		x = 0;
+		if (col < unitsize) {
+			for (k = 0; k < count; k++)
+				x |= (uint64_t)data[k * unitsize + col] << (8 * k);
+		}
+
+		/* Transpose the 8x8 bit matrix, see Hacker's Delight 7-3. */
+		t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaULL;
+		x ^= t ^ (t << 7);
+		t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+		x ^= t ^ (t << 14);
+		t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+		x ^= t ^ (t << 28);
+
+		for (k = 0; k < 8; k++)
+			bits[col * 8 + k] = x >> (8 * k);
+	}
+}
+
 /** @} */
@@ -0,0 +1,456 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "output"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Output sinks, which receive the output of output modules.
+ */
+
+/**
+ * @addtogroup grp_output
+ *
+ * @{
+ */
+
+/** @cond PRIVATE */
+
+/* Maximum number of pieces of output which are queued for one write. */
+#define SINK_MAX_SEGMENTS	16
+
+/* Referenced data up to this size gets copied to the text buffer. */
+#define SINK_COPY_SIZE		512
+
+/* Text accumulates across packets until it reaches this size. */
+#define SINK_FLUSH_SIZE		(64 * 1024)
+
+enum sink_type {
+	SINK_FD,
+	SINK_FILE,
+	SINK_CALLBACK,
+	SINK_STRING,
+};
+
+/*
+ * A piece of pending output. Text lives in the sink's buffer, which
+ * can move when it grows, so text is kept as an offset into it.
+ */
+struct sink_segment {
+	const uint8_t *data;
+	size_t offset;
+	size_t len;
+};
+
+struct sr_output_sink {
+	enum sink_type type;
+	int fd;
+	FILE *file;
+	sr_output_sink_callback cb;
+	void *cb_data;
+	GString *text;
+	size_t text_mark;
+	struct sink_segment segs[SINK_MAX_SEGMENTS];
+	size_t seg_count;
+	gboolean have_refs;
+};
+
+/** @endcond */
+
+static struct sr_output_sink *sink_new(enum sink_type type)
+{
+	struct sr_output_sink *sink;
+
+	sink = g_malloc0(sizeof(*sink));
+	sink->type = type;
+	sink->fd = -1;
+	if (type != SINK_STRING)
+		sink->text = g_string_sized_new(SINK_FLUSH_SIZE);
+
+	return sink;
+}
+
+/**
+ * Create an output sink which writes to a file descriptor.
+ *
+ * Several pieces of output get written with one writev() call where the
+ * platform supports it. The file descriptor is not closed when the sink
+ * is freed.
+ *
+ * @param fd The file descriptor to write to.
+ *
+ * @return The new sink, or NULL upon error.
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_output_sink *sr_output_sink_new_fd(int fd)
+{
+	struct sr_output_sink *sink;
+
+	if (fd < 0) {
+		sr_err("Invalid file descriptor %d.", fd);
+		return NULL;
+	}
+
+	sink = sink_new(SINK_FD);
+	sink->fd = fd;
+
+	return sink;
+}
+
+/**
+ * Create an output sink which writes to a stdio stream.
+ *
+ * The stream is not closed when the sink is freed.
+ *
+ * @param file The stream to write to.
+ *
+ * @return The new sink, or NULL upon error.
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_output_sink *sr_output_sink_new_file(FILE *file)
+{
+	struct sr_output_sink *sink;
+
+	if (!file) {
+		sr_err("Invalid stream NULL.");
+		return NULL;
+	}
+
+	sink = sink_new(SINK_FILE);
+	sink->file = file;
+
+	return sink;
+}
+
+/**
+ * Create an output sink which passes output to a callback.
+ *
+ * The callback gets called for each piece of output. The data is only
+ * valid during the call. The callback returns SR_OK, or an error code
+ * which the sink passes on to its caller.
+ *
+ * @param cb The callback to pass the output to.
+ * @param cb_data Opaque pointer passed to the callback.
+ *
+ * @return The new sink, or NULL upon error.
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_output_sink *sr_output_sink_new_callback(
+		sr_output_sink_callback cb, void *cb_data)
+{
+	struct sr_output_sink *sink;
+
+	if (!cb) {
+		sr_err("Invalid callback NULL.");
+		return NULL;
+	}
+
+	sink = sink_new(SINK_CALLBACK);
+	sink->cb = cb;
+	sink->cb_data = cb_data;
+
+	return sink;
+}
+
+/**
+ * Create an output sink which appends output to a GString.
+ *
+ * Output is appended immediately, nothing is queued.
+ *
+ * @param string The GString to append to. Owned by the caller.
+ *
+ * @private
+ */
+SR_PRIV struct sr_output_sink *sr_output_sink_new_string(GString *string)
+{
+	struct sr_output_sink *sink;
+
+	sink = sink_new(SINK_STRING);
+	sink->text = string;
+
+	return sink;
+}
+
+/* Queue the text which was added to the buffer since the last call. */
+static void queue_text(struct sr_output_sink *sink)
+{
+	struct sink_segment *seg;
+
+	if (sink->text->len == sink->text_mark)
+		return;
+
+	seg = sink->seg_count ? &sink->segs[sink->seg_count - 1] : NULL;
+	if (seg && !seg->data && seg->offset + seg->len == sink->text_mark) {
+		seg->len += sink->text->len - sink->text_mark;
+	} else {
+		seg = &sink->segs[sink->seg_count++];
+		seg->data = NULL;
+		seg->offset = sink->text_mark;
+		seg->len = sink->text->len - sink->text_mark;
+	}
+	sink->text_mark = sink->text->len;
+}
+
+static const uint8_t *segment_data(struct sr_output_sink *sink,
+		const struct sink_segment *seg)
+{
+	if (seg->data)
+		return seg->data;
+
+	return (const uint8_t *)sink->text->str + seg->offset;
+}
+
+#ifdef HAVE_SYS_UIO_H
+static int write_fd(struct sr_output_sink *sink)
+{
+	struct iovec iov[SINK_MAX_SEGMENTS];
+	size_t idx, count, len;
+	ssize_t ret;
+
+	for (idx = 0; idx < sink->seg_count; idx++) {
+		iov[idx].iov_base = (void *)segment_data(sink, &sink->segs[idx]);
+		iov[idx].iov_len = sink->segs[idx].len;
+	}
+	idx = 0;
+	count = sink->seg_count;
+	while (idx < count) {
+		ret = writev(sink->fd, &iov[idx], count - idx);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0) {
+			sr_err("Cannot write output: %s.", g_strerror(errno));
+			return SR_ERR_IO;
+		}
+		/* Skip what was written, continue after a short write. */
+		len = ret;
+		while (idx < count && len >= iov[idx].iov_len)
+			len -= iov[idx++].iov_len;
+		if (idx < count) {
+			iov[idx].iov_base = (uint8_t *)iov[idx].iov_base + len;
+			iov[idx].iov_len -= len;
+		}
+	}
+
+	return SR_OK;
+}
+#else
+static int write_fd(struct sr_output_sink *sink)
+{
+	const uint8_t *data;
+	size_t idx, pos, len;
+	ssize_t ret;
+
+	for (idx = 0; idx < sink->seg_count; idx++) {
+		data = segment_data(sink, &sink->segs[idx]);
+		len = sink->segs[idx].len;
+		pos = 0;
+		while (pos < len) {
+			ret = write(sink->fd, data + pos, len - pos);
+			if (ret < 0 && errno == EINTR)
+				continue;
+			if (ret < 0) {
+				sr_err("Cannot write output: %s.",
+					g_strerror(errno));
+				return SR_ERR_IO;
+			}
+			pos += ret;
+		}
+	}
+
+	return SR_OK;
+}
+#endif
+
+/**
+ * Write all pending output of the sink.
+ *
+ * Sinks keep small amounts of text output across packets, so that it
+ * can be written in larger blocks. Call this routine to get all output
+ * written, for example before closing the file descriptor or stream.
+ *
+ * @param sink The sink to flush.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_IO Output could not be written.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_sink_flush(struct sr_output_sink *sink)
+{
+	const struct sink_segment *seg;
+	size_t idx;
+	int ret;
+
+	if (!sink)
+		return SR_ERR_ARG;
+	if (sink->type == SINK_STRING)
+		return SR_OK;
+
+	queue_text(sink);
+
+	ret = SR_OK;
+	switch (sink->type) {
+	case SINK_FD:
+		ret = write_fd(sink);
+		break;
+	case SINK_FILE:
+		for (idx = 0; idx < sink->seg_count; idx++) {
+			seg = &sink->segs[idx];
+			if (fwrite(segment_data(sink, seg), 1, seg->len,
+					sink->file) != seg->len) {
+				sr_err("Cannot write output: %s.",
+					g_strerror(errno));
+				ret = SR_ERR_IO;
+				break;
+			}
+		}
+		break;
+	case SINK_CALLBACK:
+		for (idx = 0; idx < sink->seg_count; idx++) {
+			seg = &sink->segs[idx];
+			ret = sink->cb(segment_data(sink, seg), seg->len,
+				sink->cb_data);
+			if (ret != SR_OK)
+				break;
+		}
+		break;
+	default:
+		break;
+	}
+
+	/* The pending output is gone, also when writing it failed. */
+	sink->seg_count = 0;
+	sink->have_refs = FALSE;
+	g_string_truncate(sink->text, 0);
+	sink->text_mark = 0;
+
+	return ret;
+}
+
+/**
+ * Flush a sink and free it.
+ *
+ * @param sink The sink to free.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_IO Pending output could not be written.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_sink_free(struct sr_output_sink *sink)
+{
+	int ret;
+
+	if (!sink)
+		return SR_ERR_ARG;
+
+	ret = sr_output_sink_flush(sink);
+	if (sink->type != SINK_STRING)
+		g_string_free(sink->text, TRUE);
+	g_free(sink);
+
+	return ret;
+}
+
+/**
+ * Get the sink's text buffer.
+ *
+ * Output modules append their text output to this buffer. They must
+ * not modify or remove text which is already in it, and must get the
+ * buffer again after calling sr_output_sink_write().
+ *
+ * @private
+ */
+SR_PRIV GString *sr_output_sink_text(struct sr_output_sink *sink)
+{
+	return sink->text;
+}
+
+/**
+ * Write a block of data to the sink.
+ *
+ * Larger blocks are not copied, the sink keeps a reference. The data
+ * must remain valid until the output module's receive_sink() routine
+ * returns.
+ *
+ * @private
+ */
+SR_PRIV int sr_output_sink_write(struct sr_output_sink *sink,
+		const void *data, size_t len)
+{
+	struct sink_segment *seg;
+
+	if (!len)
+		return SR_OK;
+	if (sink->type == SINK_STRING || len <= SINK_COPY_SIZE) {
+		g_string_append_len(sink->text, data, len);
+		return SR_OK;
+	}
+
+	queue_text(sink);
+	seg = &sink->segs[sink->seg_count++];
+	seg->data = data;
+	seg->offset = 0;
+	seg->len = len;
+	sink->have_refs = TRUE;
+
+	/* Leave room for the text which follows the block. */
+	if (sink->seg_count >= SINK_MAX_SEGMENTS - 1)
+		return sr_output_sink_flush(sink);
+
+	return SR_OK;
+}
+
+/**
+ * Finish the output for one packet.
+ *
+ * Referenced blocks are only valid during the packet, so they get
+ * written now. Text is kept until enough of it has accumulated.
+ *
+ * @private
+ */
+SR_PRIV int sr_output_sink_packet_done(struct sr_output_sink *sink)
+{
+	if (sink->type == SINK_STRING)
+		return SR_OK;
+	if (!sink->have_refs && sink->text->len < SINK_FLUSH_SIZE)
+		return SR_OK;
+
+	return sr_output_sink_flush(sink);
+}
+
+/** @} */
@@ -35,21 +35,28 @@ struct out_context {
 	char *filename;
 	gint first_analog_index;
 	gint *analog_index_map;
+	gboolean logic_filter;
 };
 
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct out_context *outc;
-
-	(void)options;
+	const char *filter;
 
 	if (!o->filename || o->filename[0] == '\0') {
 		sr_info("srzip output module requires a file name, cannot save.");
 		return SR_ERR_ARG;
 	}
 
+	filter = g_variant_get_string(g_hash_table_lookup(options, "filter"), NULL);
+	if (strcmp(filter, "none") && strcmp(filter, "xor-bitplane")) {
+		sr_err("Unsupported logic filter '%s'.", filter);
+		return SR_ERR_ARG;
+	}
+
 	outc = g_malloc0(sizeof(struct out_context));
 	outc->filename = g_strdup(o->filename);
+	outc->logic_filter = !strcmp(filter, "xor-bitplane");
 	o->priv = outc;
 
 	return SR_OK;
@@ -85,8 +92,9 @@ static int zip_create(const struct sr_output *o)
 	if (!zipfile)
 		return SR_ERR;
 
-	/* "version" */
-	versrc = zip_source_buffer(zipfile, "2", 1, FALSE);
+	/* "version", older versions cannot read filtered logic data. */
+	versrc = zip_source_buffer(zipfile, outc->logic_filter ? "3" : "2",
+		1, FALSE);
 	if (zip_add(zipfile, "version", versrc) < 0) {
 		sr_err("Error saving version into zipfile: %s",
 			zip_strerror(zipfile));
@@ -131,6 +139,9 @@ static int zip_create(const struct sr_output *o)
 	if (enabled_logic_channels > 0) {
 		g_key_file_set_string(meta, devgroup, "capturefile", "logic-1");
 		g_key_file_set_integer(meta, devgroup, "total probes", logic_channels);
+		if (outc->logic_filter)
+			g_key_file_set_string(meta, devgroup, "logic filter",
+				"xor-bitplane");
 	}
 
 	s = sr_samplerate_string(outc->samplerate);
@@ -191,7 +202,7 @@ static int zip_create(const struct sr_output *o)
 	return SR_OK;
 }
 
-static int zip_append(const struct sr_output *o, unsigned char *buf,
+static int zip_append(const struct sr_output *o, const unsigned char *buf,
 		int unitsize, int length)
 {
 	struct out_context *outc;
@@ -208,6 +219,7 @@ static int zip_append(const struct sr_output *o, unsigned char *buf,
 	gsize metalen;
 	char *chunkname;
 	unsigned int next_chunk_num;
+	unsigned char *filtered;
 
 	outc = o->priv;
 	if (!(archive = zip_open(outc->filename, 0, NULL)))
@@ -288,6 +300,13 @@ static int zip_append(const struct sr_output *o, unsigned char *buf,
 		sr_warn("Chunk size %d not a multiple of the"
 			" unit size %d.", length, unitsize);
 	}
+	/* The buffer must remain valid until the archive is closed. */
+	filtered = NULL;
+	if (outc->logic_filter) {
+		filtered = g_malloc(length);
+		sr_sessionfile_filter_logic(buf, length, unitsize, filtered);
+		buf = filtered;
+	}
 	logicsrc = zip_source_buffer(archive, buf, length, FALSE);
 	chunkname = g_strdup_printf("logic-1-%u", next_chunk_num);
 	i = zip_add(archive, chunkname, logicsrc);
@@ -297,15 +316,18 @@ static int zip_append(const struct sr_output *o, unsigned char *buf,
 			next_chunk_num, zip_strerror(archive));
 		zip_source_free(logicsrc);
 		zip_discard(archive);
+		g_free(filtered);
 		g_free(metabuf);
 		return SR_ERR;
 	}
 	if (zip_close(archive) < 0) {
 		sr_err("Error saving session file: %s", zip_strerror(archive));
 		zip_discard(archive);
+		g_free(filtered);
 		g_free(metabuf);
 		return SR_ERR;
 	}
+	g_free(filtered);
 	g_free(metabuf);
 
 	return SR_OK;
@@ -463,11 +485,20 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 }
 
 static struct sr_option options[] = {
+	{ "filter", "Logic filter", "Reversible filter of logic data, for better compression", NULL, NULL },
 	ALL_ZERO
 };
 
 static const struct sr_option *get_options(void)
 {
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_string("none"));
+		options[0].values = g_slist_append(options[0].values,
+				g_variant_ref_sink(g_variant_new_string("none")));
+		options[0].values = g_slist_append(options[0].values,
+				g_variant_ref_sink(g_variant_new_string("xor-bitplane")));
+	}
+
 	return options;
 }
 
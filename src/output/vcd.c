@@ -27,14 +27,28 @@
 
 #define LOG_PREFIX "output/vcd"
 
+/* Channels are handled in words of 64 bits, VCD supports up to 94 of them. */
+#define MAX_WORDS	2
+
+/* Room for one line of changes: timestamp, 3 chars per channel, newline. */
+#define LINE_SIZE	(24 + 3 * 94 + 1)
+
 struct context {
 	int num_enabled_channels;
-	uint8_t *prevsample;
 	gboolean header_done;
 	int period;
 	int *channel_index;
 	uint64_t samplerate;
 	uint64_t samplecount;
+	/* Layout of the sample bits, set up with the first logic packet. */
+	gboolean have_layout;
+	size_t num_words;
+	size_t word_bytes[MAX_WORDS];
+	uint64_t word_mask[MAX_WORDS];
+	uint64_t prevsample[MAX_WORDS];
+	/* Replicates a sample across 64 bits, zero if samples don't fit. */
+	uint64_t repeat;
+	uint64_t repeat_mask;
 };
 
 static int init(struct sr_output *o, GHashTable *options)
@@ -78,26 +92,24 @@ static int init(struct sr_output *o, GHashTable *options)
 	return SR_OK;
 }
 
-static GString *gen_header(const struct sr_output *o)
+static void gen_header(const struct sr_output *o, GString *header)
 {
 	struct context *ctx;
 	struct sr_channel *ch;
 	GVariant *gvar;
-	GString *header;
 	GSList *l;
 	time_t t;
 	int num_channels, i;
 	char *samplerate_s, *frequency_s, *timestamp;
 
 	ctx = o->priv;
-	header = g_string_sized_new(512);
 	num_channels = g_slist_length(o->sdi->channels);
 
 	/* timestamp */
 	t = time(NULL);
 	timestamp = g_strdup(ctime(&t));
 	timestamp[strlen(timestamp) - 1] = 0;
-	g_string_printf(header, "$date %s $end\n", timestamp);
+	g_string_append_printf(header, "$date %s $end\n", timestamp);
 	g_free(timestamp);
 
 	/* generator */
@@ -148,24 +160,199 @@ static GString *gen_header(const struct sr_output *o)
 	}
 
 	g_string_append(header, "$upscope $end\n$enddefinitions $end\n");
+}
+
+/*
+ * The data image is dense, it packs the bits of enabled channels and
+ * leaves no room for disabled channels. Split the bits of the enabled
+ * channels into words, which get compared against the previous sample.
+ */
+static void setup_layout(struct context *ctx, size_t unitsize)
+{
+	size_t bits, bytes, w;
+
+	bits = MIN((size_t)ctx->num_enabled_channels, unitsize * 8);
+	bytes = (bits + 7) / 8;
+	ctx->num_words = (bits + 63) / 64;
+	for (w = 0; w < ctx->num_words; w++) {
+		ctx->word_bytes[w] = MIN(bytes - w * 8, 8);
+		if (bits - w * 64 >= 64)
+			ctx->word_mask[w] = ~(uint64_t)0;
+		else
+			ctx->word_mask[w] = ((uint64_t)1 << (bits - w * 64)) - 1;
+		ctx->prevsample[w] = 0;
+	}
+
+	ctx->repeat = 0;
+	if (ctx->num_words == 1 && 8 % unitsize == 0) {
+		for (w = 0; w < 8; w += unitsize)
+			ctx->repeat |= (uint64_t)1 << (w * 8);
+		ctx->repeat_mask = ctx->word_mask[0] * ctx->repeat;
+	}
+
+	ctx->have_layout = TRUE;
+}
+
+static inline uint64_t load_word(const uint8_t *p, size_t bytes)
+{
+	uint64_t value;
+
+	switch (bytes) {
+	case 1:
+		return p[0];
+	case 2:
+		return RL16(p);
+	case 4:
+		return RL32(p);
+	case 8:
+		return RL64(p);
+	}
+	value = 0;
+	while (bytes--)
+		value = (value << 8) | p[bytes];
+
+	return value;
+}
+
+static inline unsigned int lowest_bit(uint64_t value)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll(value);
+#else
+	unsigned int bit;
+
+	for (bit = 0; !(value & 1); bit++)
+		value >>= 1;
+
+	return bit;
+#endif
+}
+
+/* Count the samples which don't change any channel. */
+static size_t count_unchanged(const struct context *ctx,
+		const uint8_t *data, size_t count, size_t unitsize)
+{
+	size_t idx, w, step;
+	uint64_t pattern;
+
+	idx = 0;
+	if (ctx->repeat) {
+		/* Compare 8 bytes worth of samples at once. */
+		step = 8 / unitsize;
+		pattern = ctx->prevsample[0] * ctx->repeat;
+		while (idx + step <= count
+				&& !((RL64(data) ^ pattern) & ctx->repeat_mask)) {
+			idx += step;
+			data += 8;
+		}
+	}
+
+	if (ctx->num_words == 1) {
+		for (; idx < count; idx++, data += unitsize) {
+			if ((load_word(data, ctx->word_bytes[0]) ^
+					ctx->prevsample[0]) & ctx->word_mask[0])
+				break;
+		}
+		return idx;
+	}
+
+	for (; idx < count; idx++, data += unitsize) {
+		for (w = 0; w < ctx->num_words; w++) {
+			if ((load_word(data + w * 8, ctx->word_bytes[w]) ^
+					ctx->prevsample[w]) & ctx->word_mask[w])
+				return idx;
+		}
+	}
+
+	return idx;
+}
+
+/*
+ * Convert the sample count to a timestamp in units of the timescale.
+ * Integer math keeps long captures exact. Timestamps get rounded to
+ * the nearest unit, ties to even.
+ */
+static uint64_t get_timestamp(const struct context *ctx)
+{
+	uint64_t seconds, fraction, timestamp, rest;
+
+	if (!ctx->samplerate)
+		return ctx->samplecount;
+
+	seconds = ctx->samplecount / ctx->samplerate;
+	fraction = ctx->samplecount % ctx->samplerate * ctx->period;
+	timestamp = seconds * ctx->period + fraction / ctx->samplerate;
+	rest = fraction % ctx->samplerate;
+	if (2 * rest > ctx->samplerate
+			|| (2 * rest == ctx->samplerate && (timestamp & 1)))
+		timestamp++;
+
+	return timestamp;
+}
 
-	return header;
+/* Write "#<timestamp>" to the end of the buffer, return its start. */
+static char *format_timestamp(char *end, uint64_t timestamp)
+{
+	do {
+		*--end = '0' + timestamp % 10;
+		timestamp /= 10;
+	} while (timestamp);
+	*--end = '#';
+
+	return end;
+}
+
+static void append_timestamp(GString *out, uint64_t timestamp)
+{
+	char buf[24], *p;
+
+	p = format_timestamp(buf + sizeof(buf), timestamp);
+	g_string_append_len(out, p, buf + sizeof(buf) - p);
+}
+
+/* Write one line with the timestamp and the channels which changed. */
+static void append_changes(struct context *ctx, GString *out,
+		const uint8_t *sample)
+{
+	char line[LINE_SIZE], *ts, *p;
+	uint64_t value, changed;
+	unsigned int bit, index;
+	size_t w;
+
+	ts = format_timestamp(line + 24, get_timestamp(ctx));
+	p = line + 24;
+	for (w = 0; w < ctx->num_words; w++) {
+		value = load_word(sample + w * 8, ctx->word_bytes[w]);
+		value &= ctx->word_mask[w];
+		/* The first sample has all channels. */
+		changed = ctx->samplecount ? value ^ ctx->prevsample[w]
+			: ctx->word_mask[w];
+		ctx->prevsample[w] = value;
+		while (changed) {
+			bit = lowest_bit(changed);
+			changed &= changed - 1;
+			index = w * 64 + bit;
+			*p++ = ' ';
+			*p++ = '0' + ((value >> bit) & 1);
+			*p++ = '!' + index;
+		}
+	}
+	*p++ = '\n';
+	g_string_append_len(out, ts, p - ts);
 }
 
-static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
-		GString **out)
+static int receive_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, struct sr_output_sink *sink)
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
 	const struct sr_config *src;
 	GSList *l;
 	struct context *ctx;
-	unsigned int i;
-	int p, curbit, prevbit, index;
-	uint8_t *sample;
-	gboolean timestamp_written;
+	GString *out;
+	const uint8_t *sample;
+	size_t count, idx, skip;
 
-	*out = NULL;
 	if (!o || !o->priv)
 		return SR_ERR_BUG;
 	ctx = o->priv;
@@ -182,70 +369,49 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		break;
 	case SR_DF_LOGIC:
 		logic = packet->payload;
+		out = sr_output_sink_text(sink);
 
 		if (!ctx->header_done) {
-			*out = gen_header(o);
+			gen_header(o, out);
 			ctx->header_done = TRUE;
-		} else {
-			*out = g_string_sized_new(512);
 		}
 
-		if (!ctx->prevsample) {
-			/* Can't allocate this until we know the stream's unitsize. */
-			ctx->prevsample = g_malloc0(logic->unitsize);
+		if (!ctx->have_layout) {
+			/* Can't set this up until we know the stream's unitsize. */
+			setup_layout(ctx, logic->unitsize);
 		}
-
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			sample = logic->data + i;
-			timestamp_written = FALSE;
-
-			for (p = 0; p < ctx->num_enabled_channels; p++) {
-				/*
-				 * TODO Check whether the mapping from
-				 * data image positions to channel numbers
-				 * is required. Experiments suggest that
-				 * the data image "is dense", and packs
-				 * bits of enabled channels, and leaves no
-				 * room for positions of disabled channels.
-				 */
-				/* index = ctx->channel_index[p]; */
-				index = p;
-
-				curbit = ((unsigned)sample[index / 8]
-						>> (index % 8)) & 1;
-				prevbit = ((unsigned)ctx->prevsample[index / 8]
-						>> (index % 8)) & 1;
-
-				/* VCD only contains deltas/changes of signals. */
-				if (prevbit == curbit && ctx->samplecount > 0)
-					continue;
-
-				/* Output timestamp of subsequent signal changes. */
-				if (!timestamp_written)
-					g_string_append_printf(*out, "#%.0f",
-						(double)ctx->samplecount /
-							ctx->samplerate * ctx->period);
-
-				/* Output which signal changed to which value. */
-				g_string_append_c(*out, ' ');
-				g_string_append_c(*out, '0' + curbit);
-				g_string_append_c(*out, '!' + p);
-
-				timestamp_written = TRUE;
+		if (!ctx->num_words || !logic->unitsize)
+			break;
+
+		/*
+		 * VCD only contains deltas/changes of signals. Skip the
+		 * samples which don't change, and only look at the bits
+		 * of the samples which do.
+		 */
+		sample = logic->data;
+		count = logic->length / logic->unitsize;
+		idx = 0;
+		while (idx < count) {
+			if (ctx->samplecount) {
+				skip = count_unchanged(ctx, sample,
+					count - idx, logic->unitsize);
+				ctx->samplecount += skip;
+				sample += skip * logic->unitsize;
+				idx += skip;
+				if (idx == count)
+					break;
 			}
-
-			if (timestamp_written)
-				g_string_append_c(*out, '\n');
-
+			append_changes(ctx, out, sample);
 			ctx->samplecount++;
-			memcpy(ctx->prevsample, sample, logic->unitsize);
+			sample += logic->unitsize;
+			idx++;
 		}
 		break;
 	case SR_DF_END:
 		/* Write final timestamp as length indicator. */
-		*out = g_string_sized_new(512);
-		g_string_printf(*out, "#%.0f\n",
-				(double)ctx->samplecount / ctx->samplerate * ctx->period);
+		out = sr_output_sink_text(sink);
+		append_timestamp(out, get_timestamp(ctx));
+		g_string_append_c(out, '\n');
 		break;
 	}
 
@@ -260,7 +426,6 @@ static int cleanup(struct sr_output *o)
 		return SR_ERR_ARG;
 
 	ctx = o->priv;
-	g_free(ctx->prevsample);
 	g_free(ctx->channel_index);
 	g_free(ctx);
 
@@ -275,6 +440,6 @@ struct sr_output_module output_vcd = {
 	.flags = 0,
 	.options = NULL,
 	.init = init,
-	.receive = receive,
+	.receive_sink = receive_sink,
 	.cleanup = cleanup,
 };
@@ -18,6 +18,7 @@
  */
 
 #include <config.h>
+#include <math.h>
 #include <string.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
@@ -27,79 +28,70 @@
 /* Minimum/maximum number of samples per channel to put in a data chunk */
 #define MIN_DATA_CHUNK_SAMPLES 10
 
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+
+#define PCM24_MAX 0x7fffff
+
+enum sample_format {
+	FORMAT_FLOAT,
+	FORMAT_PCM16,
+	FORMAT_PCM24,
+};
+
 struct out_context {
 	double scale;
+	enum sample_format format;
+	int sample_size;
+	int block_align;
 	gboolean header_done;
 	uint64_t samplerate;
 	int num_channels;
 	GSList *channels;
-	int chanbuf_size;
-	int *chanbuf_used;
-	uint8_t **chanbuf;
+	/* Output column of each channel index, -1 for channels not written. */
+	int *column;
+	int num_columns;
+	/* Output columns of the current packet's channels. */
+	int *packet_column;
+	/* Samples of channels which arrive in separate packets. */
+	size_t chanbuf_size;
+	size_t *chanbuf_used;
+	float **chanbuf;
 	float *fdata;
+	size_t fdata_size;
 };
 
-static int realloc_chanbufs(const struct sr_output *o, int size)
-{
-	struct out_context *outc;
-	int i;
-
-	outc = o->priv;
-	for (i = 0; i < outc->num_channels; i++) {
-		if (!(outc->chanbuf[i] = g_try_realloc(outc->chanbuf[i], sizeof(float) * size))) {
-			sr_err("Unable to allocate enough output buffer memory.");
-			return SR_ERR;
-		}
-		outc->chanbuf_used[i] = 0;
-	}
-	outc->chanbuf_size = size;
-
-	return SR_OK;
-}
-
-static int flush_chanbufs(const struct sr_output *o, GString *out)
-{
-	struct out_context *outc;
-	int num_samples, i, j;
-	char *buf, *bufp;
-
-	outc = o->priv;
-
-	/* Any one of them will do. */
-	num_samples = outc->chanbuf_used[0];
-	if (!(buf = g_try_malloc(4 * num_samples * outc->num_channels))) {
-		sr_err("Unable to allocate enough interleaved output buffer memory.");
-		return SR_ERR;
-	}
-
-	bufp = buf;
-	for (i = 0; i < num_samples; i++) {
-		for (j = 0; j < outc->num_channels; j++) {
-			memcpy(bufp, outc->chanbuf[j] + i * 4, 4);
-			bufp += 4;
-		}
-	}
-	g_string_append_len(out, buf, 4 * num_samples * outc->num_channels);
-	g_free(buf);
-
-	for (i = 0; i < outc->num_channels; i++)
-		outc->chanbuf_used[i] = 0;
-
-	return SR_OK;
-}
-
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct out_context *outc;
 	struct sr_channel *ch;
 	GSList *l;
+	const char *s;
+	int i;
 
 	outc = g_malloc0(sizeof(struct out_context));
 	o->priv = outc;
 	outc->scale = g_variant_get_double(g_hash_table_lookup(options, "scale"));
+	s = g_variant_get_string(g_hash_table_lookup(options, "format"), NULL);
+	if (!strcmp(s, "pcm16")) {
+		outc->format = FORMAT_PCM16;
+		outc->sample_size = 2;
+	} else if (!strcmp(s, "pcm24")) {
+		outc->format = FORMAT_PCM24;
+		outc->sample_size = 3;
+	} else if (!strcmp(s, "float")) {
+		outc->format = FORMAT_FLOAT;
+		outc->sample_size = 4;
+	} else {
+		sr_err("Unsupported sample format '%s'.", s);
+		g_free(outc);
+		o->priv = NULL;
+		return SR_ERR_ARG;
+	}
 
 	for (l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
+		outc->num_columns = MAX(outc->num_columns, ch->index + 1);
 		if (ch->type != SR_CHANNEL_ANALOG)
 			continue;
 		if (!ch->enabled)
@@ -107,12 +99,20 @@ static int init(struct sr_output *o, GHashTable *options)
 		outc->channels = g_slist_append(outc->channels, ch);
 		outc->num_channels++;
 	}
+	outc->block_align = outc->num_channels * outc->sample_size;
 
-	outc->chanbuf = g_malloc0(sizeof(float *) * outc->num_channels);
-	outc->chanbuf_used = g_malloc0(sizeof(int) * outc->num_channels);
+	/* Map channels to output columns once, not for every packet. */
+	outc->column = g_malloc(sizeof(int) * outc->num_columns);
+	for (i = 0; i < outc->num_columns; i++)
+		outc->column[i] = -1;
+	for (l = outc->channels, i = 0; l; l = l->next, i++) {
+		ch = l->data;
+		outc->column[ch->index] = i;
+	}
+	outc->packet_column = g_malloc0(sizeof(int) * outc->num_channels);
 
-	/* Start off the interleaved buffer with 100 samples/channel. */
-	realloc_chanbufs(o, 100);
+	outc->chanbuf = g_malloc0(sizeof(float *) * outc->num_channels);
+	outc->chanbuf_used = g_malloc0(sizeof(size_t) * outc->num_channels);
 
 	return SR_OK;
 }
@@ -127,8 +127,11 @@ static void add_data_chunk(const struct sr_output *o, GString *gs)
 	/* Remaining chunk size */
 	WL32(tmp, 0x12);
 	g_string_append_len(gs, tmp, 4);
-	/* Format code 3 = IEEE float */
-	WL16(tmp, 0x0003);
+	/* Format code 1 = PCM, 3 = IEEE float */
+	if (outc->format == FORMAT_FLOAT)
+		WL16(tmp, WAVE_FORMAT_IEEE_FLOAT);
+	else
+		WL16(tmp, WAVE_FORMAT_PCM);
 	g_string_append_len(gs, tmp, 2);
 	/* Number of channels */
 	WL16(tmp, outc->num_channels);
@@ -136,14 +139,14 @@ static void add_data_chunk(const struct sr_output *o, GString *gs)
 	/* Samplerate */
 	WL32(tmp, outc->samplerate);
 	g_string_append_len(gs, tmp, 4);
-	/* Byterate, using 32-bit floats. */
-	WL32(tmp, outc->samplerate * outc->num_channels * 4);
+	/* Byterate */
+	WL32(tmp, outc->samplerate * outc->block_align);
 	g_string_append_len(gs, tmp, 4);
 	/* Blockalign */
-	WL16(tmp, outc->num_channels * 4);
+	WL16(tmp, outc->block_align);
 	g_string_append_len(gs, tmp, 2);
 	/* Bits per sample */
-	WL16(tmp, 32);
+	WL16(tmp, outc->sample_size * 8);
 	g_string_append_len(gs, tmp, 2);
 	WL16(tmp, 0);
 	g_string_append_len(gs, tmp, 2);
@@ -154,11 +157,10 @@ static void add_data_chunk(const struct sr_output *o, GString *gs)
 	g_string_append_len(gs, tmp, 4);
 }
 
-static GString *gen_header(const struct sr_output *o)
+static void gen_header(const struct sr_output *o, GString *header)
 {
 	struct out_context *outc;
 	GVariant *gvar;
-	GString *header;
 	char tmp[4];
 
 	outc = o->priv;
@@ -170,87 +172,236 @@ static GString *gen_header(const struct sr_output *o)
 		}
 	}
 
-	header = g_string_sized_new(512);
 	g_string_append(header, "RIFF");
 	/* Total size. Max out the field. */
 	WL32(tmp, 0xffffffff);
 	g_string_append_len(header, tmp, 4);
 	g_string_append(header, "WAVE");
 	add_data_chunk(o, header);
+}
 
-	return header;
+/* Scale to the PCM sample range, where [-1, 1] is full scale. */
+static inline int32_t to_pcm(float value, float gain, float max)
+{
+	value *= gain;
+	if (value > max)
+		value = max;
+	else if (value < -max)
+		value = -max;
+	else if (isnan(value))
+		value = 0;
+
+	return lrintf(value);
 }
 
 /*
- * Stores the float in little-endian BINARY32 IEEE-754 2008 format.
+ * Convert samples to the output format, and store them in little
+ * endian byte order. The output samples are stride bytes apart, so
+ * this interleaves one channel when given the block size, and converts
+ * samples which are interleaved already when given the sample size.
+ * The loops are kept simple, so that the compiler can vectorize them.
  */
-static void float_to_le(uint8_t *buf, float value)
+static void convert_samples(const struct out_context *outc, uint8_t *dst,
+		size_t stride, const float *src, size_t count)
 {
-	uint8_t *old;
-
-	old = (uint8_t *)&value;
-#ifdef WORDS_BIGENDIAN
-	buf[0] = old[3];
-	buf[1] = old[2];
-	buf[2] = old[1];
-	buf[3] = old[0];
-#else
-	buf[0] = old[0];
-	buf[1] = old[1];
-	buf[2] = old[2];
-	buf[3] = old[3];
+	double scale;
+	uint32_t bits;
+	int32_t pcm;
+	float value, gain;
+	size_t i;
+
+	scale = outc->scale;
+	switch (outc->format) {
+	case FORMAT_FLOAT:
+#ifndef WORDS_BIGENDIAN
+		if (scale == 1.0 && stride == sizeof(float)) {
+			memcpy(dst, src, count * sizeof(float));
+			break;
+		}
 #endif
+		for (i = 0; i < count; i++) {
+			value = src[i];
+			if (scale != 1.0)
+				value /= scale;
+			memcpy(&bits, &value, sizeof(bits));
+			bits = GUINT32_TO_LE(bits);
+			memcpy(dst + i * stride, &bits, sizeof(bits));
+		}
+		break;
+	case FORMAT_PCM16:
+		gain = INT16_MAX / scale;
+		for (i = 0; i < count; i++) {
+			pcm = to_pcm(src[i], gain, INT16_MAX);
+			WL16(dst + i * stride, pcm);
+		}
+		break;
+	case FORMAT_PCM24:
+		gain = PCM24_MAX / scale;
+		for (i = 0; i < count; i++) {
+			pcm = to_pcm(src[i], gain, PCM24_MAX);
+			dst[i * stride + 0] = pcm;
+			dst[i * stride + 1] = pcm >> 8;
+			dst[i * stride + 2] = pcm >> 16;
+		}
+		break;
+	}
 }
 
-/*
- * Returns the number of samples used in the current channel buffers,
- * or -1 if they're not all the same.
- */
-static int check_chanbuf_size(const struct sr_output *o)
+/* Append the given number of samples of all channel buffers. */
+static void flush_chanbufs(const struct sr_output *o, GString *out,
+		size_t count)
 {
 	struct out_context *outc;
-	int size, i;
+	size_t pos;
+	uint8_t *dst;
+	int i;
 
 	outc = o->priv;
-	size = 0;
+	pos = out->len;
+	g_string_set_size(out, pos + count * outc->block_align);
+	dst = (uint8_t *)out->str + pos;
 	for (i = 0; i < outc->num_channels; i++) {
-		if (size == 0) {
-			if (outc->chanbuf_used[i] == 0) {
-				/* Nothing in all the buffers yet. */
-				size = -1;
-				break;
-			} else {
-				/* New high water mark. */
-				size = outc->chanbuf_used[i];
-			}
-		} else if (outc->chanbuf_used[i] != size) {
-			/* All channel buffers are not equally full yet. */
-			size = -1;
-			break;
+		convert_samples(outc, dst + i * outc->sample_size,
+			outc->block_align, outc->chanbuf[i], count);
+		/* Keep what arrived ahead of the other channels. */
+		outc->chanbuf_used[i] -= count;
+		memmove(outc->chanbuf[i], outc->chanbuf[i] + count,
+			outc->chanbuf_used[i] * sizeof(float));
+	}
+}
+
+/* Number of samples which all channel buffers have. */
+static size_t chanbufs_filled(const struct out_context *outc)
+{
+	size_t count;
+	int i;
+
+	count = outc->num_channels ? outc->chanbuf_used[0] : 0;
+	for (i = 1; i < outc->num_channels; i++)
+		count = MIN(count, outc->chanbuf_used[i]);
+
+	return count;
+}
+
+static int chanbufs_reserve(struct out_context *outc, size_t count)
+{
+	size_t size;
+	float *buf;
+	int i;
+
+	size = MAX(outc->chanbuf_size, 100);
+	while (size < count)
+		size *= 2;
+	if (size == outc->chanbuf_size)
+		return SR_OK;
+
+	for (i = 0; i < outc->num_channels; i++) {
+		if (!(buf = g_try_realloc(outc->chanbuf[i], sizeof(float) * size))) {
+			sr_err("Unable to allocate enough output buffer memory.");
+			return SR_ERR_MALLOC;
 		}
+		outc->chanbuf[i] = buf;
 	}
+	outc->chanbuf_size = size;
 
-	return size;
+	return SR_OK;
 }
 
-static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
-		GString **out)
+static int process_analog(const struct sr_output *o,
+		const struct sr_datafeed_analog *analog, GString *out)
+{
+	struct out_context *outc;
+	struct sr_channel *ch;
+	GSList *l;
+	size_t num_samples, count, pos;
+	const float *data;
+	int num_channels, column, i, ret;
+	gboolean in_order;
+
+	outc = o->priv;
+	num_samples = analog->num_samples;
+	num_channels = g_slist_length(analog->meaning->channels);
+	count = num_samples * num_channels;
+	ret = sr_output_analog_to_float(o, analog, &outc->fdata,
+		&outc->fdata_size, &data);
+	if (ret != SR_OK)
+		return ret;
+
+	if (num_samples == 0)
+		return SR_OK;
+
+	if (num_channels > outc->num_channels) {
+		sr_err("Packet has %d channels, but only %d were enabled.",
+				num_channels, outc->num_channels);
+		return SR_ERR;
+	}
+
+	/* Look up the output column of each of the packet's channels. */
+	in_order = num_channels == outc->num_channels;
+	for (l = analog->meaning->channels, i = 0; l; l = l->next, i++) {
+		ch = l->data;
+		column = -1;
+		if (ch->index >= 0 && ch->index < outc->num_columns)
+			column = outc->column[ch->index];
+		if (column < 0) {
+			sr_err("Packet has channel %s, which is not enabled.",
+				ch->name);
+			return SR_ERR;
+		}
+		outc->packet_column[i] = column;
+		in_order = in_order && column == i;
+	}
+
+	/*
+	 * Packets which have all channels, in the output's order, are
+	 * interleaved already. Convert them in one go, unless other
+	 * channels' samples are pending.
+	 */
+	for (i = 0; i < outc->num_channels && in_order; i++)
+		in_order = !outc->chanbuf_used[i];
+	if (in_order) {
+		pos = out->len;
+		g_string_set_size(out, pos + num_samples * outc->block_align);
+		convert_samples(outc, (uint8_t *)out->str + pos,
+			outc->sample_size, data, count);
+		return SR_OK;
+	}
+
+	/* Collect the samples of each channel until all channels have some. */
+	count = 0;
+	for (i = 0; i < num_channels; i++)
+		count = MAX(count, outc->chanbuf_used[outc->packet_column[i]]);
+	if ((ret = chanbufs_reserve(outc, count + num_samples)) != SR_OK)
+		return ret;
+	for (i = 0; i < num_channels; i++) {
+		column = outc->packet_column[i];
+		for (pos = 0; pos < num_samples; pos++)
+			outc->chanbuf[column][outc->chanbuf_used[column] + pos] =
+				data[pos * num_channels + i];
+		outc->chanbuf_used[column] += num_samples;
+	}
+
+	count = chanbufs_filled(outc);
+	if (count > MIN_DATA_CHUNK_SAMPLES)
+		flush_chanbufs(o, out, count);
+
+	return SR_OK;
+}
+
+static int receive_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, struct sr_output_sink *sink)
 {
 	struct out_context *outc;
 	const struct sr_datafeed_meta *meta;
-	const struct sr_datafeed_analog *analog;
 	const struct sr_config *src;
-	struct sr_channel *ch;
 	GSList *l;
-	const GSList *channels;
-	float f;
-	int num_channels, num_samples, size, *chan_idx, idx, i, j, ret;
-	float *data;
-	uint8_t *buf;
+	GString *out;
+	size_t count, dropped;
+	int i;
 
-	*out = NULL;
 	if (!o || !o->sdi || !(outc = o->priv))
 		return SR_ERR_ARG;
+	out = sr_output_sink_text(sink);
 
 	switch (packet->type) {
 	case SR_DF_META:
@@ -264,68 +415,22 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		break;
 	case SR_DF_ANALOG:
 		if (!outc->header_done) {
-			*out = gen_header(o);
+			gen_header(o, out);
 			outc->header_done = TRUE;
-		} else {
-			*out = g_string_sized_new(512);
-		}
-
-		analog = packet->payload;
-		num_samples = analog->num_samples;
-		channels = analog->meaning->channels;
-		num_channels = g_slist_length(analog->meaning->channels);
-		if (!(data = g_try_realloc(outc->fdata, sizeof(float) * num_samples * num_channels)))
-			return SR_ERR_MALLOC;
-		outc->fdata = data;
-		ret = sr_analog_to_float(analog, data);
-		if (ret != SR_OK)
-			return ret;
-
-		if (num_samples == 0)
-			return SR_OK;
-
-		if (num_channels > outc->num_channels) {
-			sr_err("Packet has %d channels, but only %d were enabled.",
-					num_channels, outc->num_channels);
-			return SR_ERR;
-		}
-
-		if (num_samples > outc->chanbuf_size) {
-			if (realloc_chanbufs(o, analog->num_samples) != SR_OK)
-				return SR_ERR_MALLOC;
 		}
-
-		/* Index the channels in this packet, so we can interleave quicker. */
-		chan_idx = g_malloc(sizeof(int) * outc->num_channels);
-		for (i = 0; i < num_channels; i++) {
-			ch = g_slist_nth_data((GSList *) channels, i);
-			chan_idx[i] = g_slist_index(outc->channels, ch);
-		}
-
-		for (i = 0; i < num_samples; i++) {
-			for (j = 0; j < num_channels; j++) {
-				idx = chan_idx[j];
-				buf = outc->chanbuf[idx] + outc->chanbuf_used[idx]++ * 4;
-				f = data[i * num_channels + j];
-				if (outc->scale != 1.0)
-					f /= outc->scale;
-				float_to_le(buf, f);
-			}
-		}
-		g_free(chan_idx);
-
-		size = check_chanbuf_size(o);
-		if (size > MIN_DATA_CHUNK_SAMPLES)
-			if (flush_chanbufs(o, *out) != SR_OK)
-				return SR_ERR;
-		break;
+		return process_analog(o, packet->payload, out);
 	case SR_DF_END:
-		size = check_chanbuf_size(o);
-		if (size > 0) {
-			*out = g_string_sized_new(4 * size * outc->num_channels);
-			if (flush_chanbufs(o, *out) != SR_OK)
-				return SR_ERR;
+		count = chanbufs_filled(outc);
+		if (count > 0)
+			flush_chanbufs(o, out, count);
+		dropped = 0;
+		for (i = 0; i < outc->num_channels; i++) {
+			dropped += outc->chanbuf_used[i];
+			outc->chanbuf_used[i] = 0;
 		}
+		if (dropped)
+			sr_warn("Dropping %zu samples of channels which got "
+				"more samples than others.", dropped);
 		break;
 	}
 
@@ -334,13 +439,22 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 
 static struct sr_option options[] = {
 	{ "scale", "Scale", "Scale values by factor", NULL, NULL },
+	{ "format", "Format", "Sample format, PCM covers -1 to 1 after scaling", NULL, NULL },
 	ALL_ZERO
 };
 
 static const struct sr_option *get_options(void)
 {
-	if (!options[0].def)
+	if (!options[0].def) {
 		options[0].def = g_variant_ref_sink(g_variant_new_double(1.0));
+		options[1].def = g_variant_ref_sink(g_variant_new_string("float"));
+		options[1].values = g_slist_append(options[1].values,
+				g_variant_ref_sink(g_variant_new_string("float")));
+		options[1].values = g_slist_append(options[1].values,
+				g_variant_ref_sink(g_variant_new_string("pcm16")));
+		options[1].values = g_slist_append(options[1].values,
+				g_variant_ref_sink(g_variant_new_string("pcm24")));
+	}
 
 	return options;
 }
@@ -351,8 +465,11 @@ static int cleanup(struct sr_output *o)
 	int i;
 
 	outc = o->priv;
+	if (!outc)
+		return SR_OK;
 	g_slist_free(outc->channels);
-	g_variant_unref(options[0].def);
+	g_free(outc->column);
+	g_free(outc->packet_column);
 	for (i = 0; i < outc->num_channels; i++)
 		g_free(outc->chanbuf[i]);
 	g_free(outc->chanbuf_used);
@@ -372,6 +489,6 @@ SR_PRIV struct sr_output_module output_wav = {
 	.flags = 0,
 	.options = get_options,
 	.init = init,
-	.receive = receive,
+	.receive_sink = receive_sink,
 	.cleanup = cleanup,
 };
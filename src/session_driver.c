@@ -23,6 +23,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <string.h>
 #include <zip.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
@@ -50,6 +51,11 @@ struct session_vdev {
 	GArray *analog_channels;
 	int cur_chunk;
 	gboolean finished;
+	gboolean logic_filter;
+	/* Logic data of a filtered capture file, with the filter undone. */
+	uint8_t *chunk;
+	size_t chunk_len;
+	size_t chunk_pos;
 };
 
 static const uint32_t devopts[] = {
@@ -59,8 +65,76 @@ static const uint32_t devopts[] = {
 	SR_CONF_NUM_ANALOG_CHANNELS | SR_CONF_SET,
 	SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_SESSIONFILE | SR_CONF_SET,
+	SR_CONF_CAPTURE_FILTER | SR_CONF_SET,
 };
 
+/*
+ * Filtered capture files get read completely, the filter works on whole
+ * capture files.
+ */
+static int load_filtered(struct session_vdev *vdev, const struct zip_stat *zs)
+{
+	uint8_t *raw;
+	zip_int64_t ret;
+	zip_uint64_t len;
+
+	if (!vdev->unitsize) {
+		sr_err("Filtered capture file without a unit size.");
+		return SR_ERR_DATA;
+	}
+	/* Empty capture files need a buffer, too. */
+	raw = NULL;
+	if (zs->size > G_MAXSIZE || !(raw = g_try_malloc(zs->size + 1))
+			|| !(vdev->chunk = g_try_malloc(zs->size + 1))) {
+		g_free(raw);
+		sr_err("Capture file buffer allocation failed.");
+		return SR_ERR_MALLOC;
+	}
+
+	len = 0;
+	while (len < zs->size) {
+		ret = zip_fread(vdev->capfile, raw + len, zs->size - len);
+		if (ret <= 0)
+			break;
+		len += ret;
+	}
+	if (len != zs->size) {
+		sr_err("Failed to read capture file: %s",
+			zip_file_strerror(vdev->capfile));
+		g_free(raw);
+		g_free(vdev->chunk);
+		vdev->chunk = NULL;
+		return SR_ERR;
+	}
+
+	sr_sessionfile_unfilter_logic(raw, len, vdev->unitsize, vdev->chunk);
+	g_free(raw);
+	vdev->chunk_len = len;
+	vdev->chunk_pos = 0;
+
+	return SR_OK;
+}
+
+static int capture_read(struct session_vdev *vdev, void *buf, size_t len)
+{
+	if (!vdev->chunk)
+		return zip_fread(vdev->capfile, buf, len);
+
+	len = MIN(len, vdev->chunk_len - vdev->chunk_pos);
+	memcpy(buf, vdev->chunk + vdev->chunk_pos, len);
+	vdev->chunk_pos += len;
+
+	return len;
+}
+
+static void capture_close(struct session_vdev *vdev)
+{
+	zip_fclose(vdev->capfile);
+	vdev->capfile = NULL;
+	g_free(vdev->chunk);
+	vdev->chunk = NULL;
+}
+
 static gboolean stream_session_data(struct sr_dev_inst *sdi)
 {
 	struct session_vdev *vdev;
@@ -73,9 +147,11 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 	struct zip_stat zs;
 	int ret, got_data;
 	char capturefile[128];
+	gboolean opened;
 	void *buf;
 
 	got_data = FALSE;
+	opened = FALSE;
 	vdev = sdi->priv;
 
 	if (!vdev->capfile) {
@@ -90,6 +166,7 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 						vdev->capturefile, 0)))
 					return FALSE;
 				sr_dbg("Opened %s.", vdev->capturefile);
+				opened = TRUE;
 			} else {
 				/* Try as first chunk filename. */
 				snprintf(capturefile, sizeof(capturefile) - 1, "%s-1", vdev->capturefile);
@@ -99,6 +176,7 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 							capturefile, 0)))
 						return FALSE;
 					sr_dbg("Opened %s.", capturefile);
+					opened = TRUE;
 				} else {
 					sr_err("No capture file '%s' in " "session file '%s'.",
 							vdev->capturefile, vdev->sessionfile);
@@ -115,6 +193,7 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 						capturefile, 0)))
 					return FALSE;
 				sr_dbg("Opened %s.", capturefile);
+				opened = TRUE;
 			} else if (vdev->cur_analog_channel < vdev->num_analog_channels) {
 				vdev->capturefile = g_strdup_printf("analog-1-%d",
 						vdev->num_logic_channels + vdev->cur_analog_channel + 1);
@@ -140,14 +219,18 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 		}
 	}
 
+	if (opened && vdev->logic_filter && vdev->cur_analog_channel == 0
+			&& load_filtered(vdev, &zs) != SR_OK)
+		return FALSE;
+
 	buf = g_malloc(CHUNKSIZE);
 
 	/* unitsize is not defined for purely analog session files. */
 	if (vdev->unitsize)
-		ret = zip_fread(vdev->capfile, buf,
+		ret = capture_read(vdev, buf,
 				CHUNKSIZE / vdev->unitsize * vdev->unitsize);
 	else
-		ret = zip_fread(vdev->capfile, buf, CHUNKSIZE);
+		ret = capture_read(vdev, buf, CHUNKSIZE);
 
 	if (ret > 0) {
 		if (vdev->cur_analog_channel != 0) {
@@ -187,8 +270,7 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 		}
 	} else {
 		/* done with this capture file */
-		zip_fclose(vdev->capfile);
-		vdev->capfile = NULL;
+		capture_close(vdev);
 		if (vdev->cur_chunk != 0) {
 			/* There might be more chunks, so don't fall through
 			 * to the SR_DF_END here. */
@@ -216,10 +298,8 @@ static int receive_data(int fd, int revents, void *cb_data)
 	if (!vdev->finished)
 		return G_SOURCE_CONTINUE;
 
-	if (vdev->capfile) {
-		zip_fclose(vdev->capfile);
-		vdev->capfile = NULL;
-	}
+	if (vdev->capfile)
+		capture_close(vdev);
 	if (vdev->archive) {
 		zip_discard(vdev->archive);
 		vdev->archive = NULL;
@@ -318,6 +398,14 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_NUM_ANALOG_CHANNELS:
 		vdev->num_analog_channels = g_variant_get_int32(data);
 		break;
+	case SR_CONF_CAPTURE_FILTER:
+		if (strcmp(g_variant_get_string(data, NULL), "xor-bitplane")) {
+			sr_err("Unknown capture filter '%s'.",
+				g_variant_get_string(data, NULL));
+			return SR_ERR_ARG;
+		}
+		vdev->logic_filter = TRUE;
+		break;
 	default:
 		return SR_ERR_NA;
 	}
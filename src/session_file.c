@@ -109,6 +109,102 @@ SR_PRIV GKeyFile *sr_sessionfile_read_metadata(struct zip *archive,
 	return keyfile;
 }
 
+/* Transpose an 8x8 bit matrix, see Hacker's Delight 7-3. */
+static inline uint64_t transpose8(uint64_t x)
+{
+	uint64_t t;
+
+	t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaULL;
+	x ^= t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+	x ^= t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+	x ^= t ^ (t << 28);
+
+	return x;
+}
+
+/**
+ * Apply the "xor-bitplane" filter to a chunk of logic data.
+ *
+ * Each sample gets XORed with the previous one, so that only the changes
+ * of the channels remain. The result is split into one plane per channel,
+ * eight samples to a byte, first sample in the least significant bit.
+ * Clock and bus signals turn into long runs of equal bytes, which deflate
+ * compresses better and faster. Samples after the last multiple of eight
+ * samples, and a partial sample at the end, are kept as they are, so the
+ * output has the size of the input.
+ *
+ * @param[in] data The samples.
+ * @param[in] length The size of the data in bytes.
+ * @param[in] unitsize The size of a sample in bytes.
+ * @param[out] out Receives length bytes of filtered data.
+ *
+ * @private
+ */
+SR_PRIV void sr_sessionfile_filter_logic(const uint8_t *data, size_t length,
+		size_t unitsize, uint8_t *out)
+{
+	size_t blocks, blk, col, k, b, pos;
+	uint64_t x;
+	uint8_t prev, cur;
+
+	blocks = length / unitsize / 8;
+	for (blk = 0; blk < blocks; blk++) {
+		for (col = 0; col < unitsize; col++) {
+			pos = blk * 8 * unitsize + col;
+			prev = blk ? data[pos - unitsize] : 0;
+			x = 0;
+			for (k = 0; k < 8; k++) {
+				cur = data[pos + k * unitsize];
+				x |= (uint64_t)(cur ^ prev) << (8 * k);
+				prev = cur;
+			}
+			x = transpose8(x);
+			for (b = 0; b < 8; b++)
+				out[(col * 8 + b) * blocks + blk] = x >> (8 * b);
+		}
+	}
+	pos = blocks * 8 * unitsize;
+	memcpy(out + pos, data + pos, length - pos);
+}
+
+/**
+ * Undo the "xor-bitplane" filter, see sr_sessionfile_filter_logic().
+ *
+ * @param[in] data The filtered data.
+ * @param[in] length The size of the data in bytes.
+ * @param[in] unitsize The size of a sample in bytes.
+ * @param[out] out Receives length bytes of samples.
+ *
+ * @private
+ */
+SR_PRIV void sr_sessionfile_unfilter_logic(const uint8_t *data, size_t length,
+		size_t unitsize, uint8_t *out)
+{
+	size_t blocks, blk, col, k, b, pos;
+	uint64_t x;
+	uint8_t prev;
+
+	blocks = length / unitsize / 8;
+	for (blk = 0; blk < blocks; blk++) {
+		for (col = 0; col < unitsize; col++) {
+			x = 0;
+			for (b = 0; b < 8; b++)
+				x |= (uint64_t)data[(col * 8 + b) * blocks + blk] << (8 * b);
+			x = transpose8(x);
+			pos = blk * 8 * unitsize + col;
+			prev = blk ? out[pos - unitsize] : 0;
+			for (k = 0; k < 8; k++) {
+				prev ^= x >> (8 * k);
+				out[pos + k * unitsize] = prev;
+			}
+		}
+	}
+	pos = blocks * 8 * unitsize;
+	memcpy(out + pos, data + pos, length - pos);
+}
+
 /** @private */
 SR_PRIV int sr_sessionfile_check(const char *filename)
 {
@@ -149,7 +245,7 @@ SR_PRIV int sr_sessionfile_check(const char *filename)
 	zip_fclose(zf);
 	s[ret] = '\0';
 	version = g_ascii_strtoull(s, NULL, 10);
-	if (version == 0 || version > 2) {
+	if (version == 0 || version > 3) {
 		sr_dbg("Cannot handle sigrok session file version %" PRIu64 ".",
 			version);
 		zip_discard(archive);
@@ -297,6 +393,17 @@ SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 					}
 					sr_config_set(sdi, NULL, SR_CONF_CAPTURE_UNITSIZE,
 							g_variant_new_uint64(unitsize));
+				} else if (!strcmp(keys[j], "logic filter") && file_has_logic) {
+					val = g_key_file_get_string(kf, sections[i],
+							keys[j], &error);
+					if (!sdi || !val || sr_config_set(sdi, NULL,
+							SR_CONF_CAPTURE_FILTER,
+							g_variant_new_string(val)) != SR_OK) {
+						g_free(val);
+						ret = SR_ERR_DATA;
+						break;
+					}
+					g_free(val);
 				} else if (!strcmp(keys[j], "total probes")) {
 					total_channels = g_key_file_get_integer(kf,
 							sections[i], keys[j], &error);
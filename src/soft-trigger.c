@@ -41,6 +41,66 @@ SR_PRIV int logic_channel_unitsize(GSList *channels)
 	return (number + 7) / 8;
 }
 
+/*
+ * Compile the trigger stages into bit masks. This is only possible when a
+ * sample fits into a 64-bit word and all matches are logic matches, the
+ * caller falls back to checking the matches one by one otherwise.
+ */
+static struct soft_trigger_stage_masks *compile_stage_masks(
+		struct soft_trigger_logic *stl)
+{
+	struct soft_trigger_stage_masks *masks, *m;
+	struct sr_trigger_stage *stage;
+	struct sr_trigger_match *match;
+	GSList *l_stage, *l;
+	uint64_t bit;
+
+	if (stl->unitsize > (int)sizeof(uint64_t))
+		return NULL;
+
+	masks = g_malloc0(sizeof(*masks) * g_slist_length(stl->trigger->stages));
+	for (l_stage = stl->trigger->stages, m = masks; l_stage;
+			l_stage = l_stage->next, m++) {
+		stage = l_stage->data;
+		m->empty = !stage->matches;
+		for (l = stage->matches; l; l = l->next) {
+			match = l->data;
+			if (!match->channel->enabled)
+				/* Ignore disabled channels with a trigger. */
+				continue;
+			if (match->channel->index >= stl->unitsize * 8) {
+				g_free(masks);
+				return NULL;
+			}
+			bit = UINT64_C(1) << match->channel->index;
+			switch (match->match) {
+			case SR_TRIGGER_ZERO:
+				m->zero_mask |= bit;
+				break;
+			case SR_TRIGGER_ONE:
+				m->one_mask |= bit;
+				break;
+			case SR_TRIGGER_RISING:
+				m->change_mask |= bit;
+				m->one_mask |= bit;
+				break;
+			case SR_TRIGGER_FALLING:
+				m->change_mask |= bit;
+				m->zero_mask |= bit;
+				break;
+			case SR_TRIGGER_EDGE:
+				m->change_mask |= bit;
+				break;
+			default:
+				g_free(masks);
+				return NULL;
+			}
+		}
+	}
+
+	return masks;
+}
+
 SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
 		int pre_trigger_samples)
@@ -64,6 +124,7 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		return NULL;
 	}
 	stl->pre_trigger_head = stl->pre_trigger_buffer;
+	stl->stage_masks = compile_stage_masks(stl);
 
 	if (stl->pre_trigger_size > 0 && !stl->pre_trigger_buffer) {
 		soft_trigger_logic_free(stl);
@@ -75,6 +136,7 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 
 SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *stl)
 {
+	g_free(stl->stage_masks);
 	g_free(stl->pre_trigger_buffer);
 	g_free(stl->prev_sample);
 	g_free(stl);
@@ -170,12 +232,123 @@ static gboolean logic_check_match(struct soft_trigger_logic *stl,
 	return result;
 }
 
+static inline uint64_t sample_to_word(const uint8_t *sample, int unitsize)
+{
+	uint64_t word;
+	int i;
+
+	switch (unitsize) {
+	case 1:
+		return R8(sample);
+	case 2:
+		return RL16(sample);
+	case 4:
+		return RL32(sample);
+	case 8:
+		return RL64(sample);
+	}
+
+	word = 0;
+	for (i = unitsize - 1; i >= 0; i--)
+		word = (word << 8) | sample[i];
+
+	return word;
+}
+
+/*
+ * Check all matches of a stage at once: the sample must have all bits of
+ * one_mask set and all bits of zero_mask cleared (rising and falling edges
+ * contribute their final level here), and all bits of change_mask must
+ * differ from the previous sample.
+ */
+static inline gboolean stage_masks_match(const struct soft_trigger_stage_masks *m,
+		uint64_t sample, uint64_t prev, gboolean have_prev)
+{
+	if ((sample & m->one_mask) != m->one_mask || (sample & m->zero_mask))
+		return FALSE;
+	if (!m->change_mask)
+		return TRUE;
+	if (!have_prev)
+		/* First sample, don't have enough for an edge match yet. */
+		return FALSE;
+
+	return ((sample ^ prev) & m->change_mask) == m->change_mask;
+}
+
+static void fire_trigger(struct soft_trigger_logic *stl,
+		uint8_t *buf, int i, int *pre_trigger_samples)
+{
+	struct sr_datafeed_packet packet;
+
+	/* Matched on last stage, send pre-trigger data. */
+	pre_trigger_append(stl, buf, i);
+	pre_trigger_send(stl, pre_trigger_samples);
+
+	packet.type = SR_DF_TRIGGER;
+	packet.payload = NULL;
+	sr_session_send(stl->sdi, &packet);
+}
+
+static int soft_trigger_logic_check_words(struct soft_trigger_logic *stl,
+		uint8_t *buf, int len, int *pre_trigger_samples)
+{
+	const struct soft_trigger_stage_masks *m;
+	int num_stages, unitsize, i;
+	uint64_t sample, prev, entry_prev;
+	gboolean have_prev, entry_have_prev;
+
+	num_stages = g_slist_length(stl->trigger->stages);
+	unitsize = stl->unitsize;
+	prev = entry_prev = stl->prev_word;
+	have_prev = entry_have_prev = stl->count > 0;
+
+	for (i = 0; i < len; i += unitsize) {
+		m = &stl->stage_masks[stl->cur_stage];
+		if (m->empty)
+			/* No matches supplied, client error. */
+			return SR_ERR_ARG;
+
+		sample = sample_to_word(buf + i, unitsize);
+		if (stage_masks_match(m, sample, prev, have_prev)) {
+			if (stl->cur_stage + 1 < num_stages) {
+				/* Advance to next stage. */
+				stl->cur_stage++;
+			} else {
+				stl->prev_word = sample;
+				stl->count++;
+				fire_trigger(stl, buf, i, pre_trigger_samples);
+				return i / unitsize;
+			}
+		} else if (stl->cur_stage > 0) {
+			/* See soft_trigger_logic_check() on backtracking. */
+			i -= stl->cur_stage * unitsize;
+			if (i < 0) {
+				/* Oops, went back past this buffer. */
+				i = -unitsize;
+				prev = entry_prev;
+				have_prev = entry_have_prev;
+			} else {
+				prev = sample_to_word(buf + i, unitsize);
+			}
+			stl->cur_stage = 0;
+			continue;
+		}
+		prev = sample;
+		have_prev = TRUE;
+		stl->count++;
+	}
+
+	stl->prev_word = prev;
+	pre_trigger_append(stl, buf, len);
+
+	return -1;
+}
+
 /* Returns the offset (in samples) within buf of where the trigger
  * occurred, or -1 if not triggered. */
 SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 		uint8_t *buf, int len, int *pre_trigger_samples)
 {
-	struct sr_datafeed_packet packet;
 	struct sr_trigger_stage *stage;
 	struct sr_trigger_match *match;
 	GSList *l, *l_stage;
@@ -183,6 +356,10 @@ SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 	int i;
 	gboolean match_found;
 
+	if (stl->stage_masks)
+		return soft_trigger_logic_check_words(stl, buf, len,
+				pre_trigger_samples);
+
 	offset = -1;
 	for (i = 0; i < len; i += stl->unitsize) {
 		l_stage = g_slist_nth(stl->trigger->stages, stl->cur_stage);
@@ -209,16 +386,9 @@ SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 				/* Advance to next stage. */
 				stl->cur_stage++;
 			} else {
-				/* Matched on last stage, send pre-trigger data. */
-				pre_trigger_append(stl, buf, i);
-				pre_trigger_send(stl, pre_trigger_samples);
-
 				/* Fire trigger. */
+				fire_trigger(stl, buf, i, pre_trigger_samples);
 				offset = i / stl->unitsize;
-
-				packet.type = SR_DF_TRIGGER;
-				packet.payload = NULL;
-				sr_session_send(stl->sdi, &packet);
 				break;
 			}
 		} else if (stl->cur_stage > 0) {
@@ -232,8 +402,9 @@ SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 			 * takes care of.
 			 */
 			i -= stl->cur_stage * stl->unitsize;
-			if (i < -1)
-				i = -1; /* Oops, went back past this buffer. */
+			if (i < 0)
+				/* Went back past this buffer, restart at its first sample. */
+				i = -stl->unitsize;
 			/* Reset trigger stage. */
 			stl->cur_stage = 0;
 		}
@@ -32,6 +32,10 @@
 #include <string.h>
 #include <math.h>
 #include <sys/time.h>
+#ifdef HAVE_POSIX_MADVISE
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 #include <glib.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
@@ -305,6 +309,403 @@ SR_PRIV int std_session_send_frame_end(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
+/**
+ * Standard helper for chunked delivery of logic data.
+ *
+ * Drivers which download a capture from the device can use this to
+ * forward the samples in packets of bounded size while the download is
+ * still in progress, instead of accumulating the complete capture. An
+ * SR_DF_TRIGGER packet is inserted in front of the sample at the trigger
+ * position, regardless of how the data is split up into chunks.
+ *
+ * @param[out] feed The feed state to initialize. Must not be NULL.
+ * @param[in] sdi The device instance to use. Must not be NULL.
+ * @param[in] unitsize The logic unit size in bytes. Must not be 0.
+ * @param[in] chunk_size Maximum logic packet payload size in bytes.
+ *                       Rounded down to a multiple of the unit size.
+ * @param[in] trigger_at Sample index of the trigger, or -1 if none.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ */
+SR_PRIV int std_logic_feed_init(struct std_logic_feed *feed,
+		const struct sr_dev_inst *sdi, size_t unitsize,
+		size_t chunk_size, int64_t trigger_at)
+{
+	if (!feed || !sdi || !unitsize) {
+		sr_err("%s: Invalid argument.", __func__);
+		return SR_ERR_ARG;
+	}
+
+	feed->sdi = sdi;
+	feed->unitsize = unitsize;
+	feed->chunk_size = MAX(chunk_size / unitsize, 1) * unitsize;
+	feed->trigger_at = trigger_at;
+	feed->samples_sent = 0;
+	feed->buffer = NULL;
+	feed->fill = 0;
+
+	return SR_OK;
+}
+
+/* Send the trigger packet if the feed has arrived at its position. */
+static int logic_feed_check_trigger(struct std_logic_feed *feed)
+{
+	struct sr_datafeed_packet packet;
+
+	if (feed->trigger_at < 0)
+		return SR_OK;
+	if (feed->samples_sent != (uint64_t)feed->trigger_at)
+		return SR_OK;
+
+	feed->trigger_at = -1;
+
+	packet.type = SR_DF_TRIGGER;
+	packet.payload = NULL;
+
+	return sr_session_send(feed->sdi, &packet);
+}
+
+/**
+ * Send logic data through a chunked feed.
+ *
+ * The data is passed on without copying, split into packets of at most
+ * the feed's chunk size, and split at the trigger position.
+ *
+ * @param[in] feed The feed state. Must not be NULL.
+ * @param[in] data The sample data.
+ * @param[in] length Data length in bytes. Must be a multiple of the unit
+ *                   size.
+ *
+ * @retval SR_OK Success.
+ * @retval other Error returned by sr_session_send().
+ */
+SR_PRIV int std_logic_feed_send(struct std_logic_feed *feed,
+		const uint8_t *data, size_t length)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	uint64_t samples;
+	size_t chunk;
+	int ret;
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = feed->unitsize;
+
+	while (length > 0) {
+		if ((ret = logic_feed_check_trigger(feed)) != SR_OK)
+			return ret;
+
+		chunk = MIN(length, feed->chunk_size);
+		if (feed->trigger_at >= 0) {
+			samples = feed->trigger_at - feed->samples_sent;
+			chunk = MIN(chunk, samples * feed->unitsize);
+		}
+
+		logic.length = chunk;
+		logic.data = (uint8_t *)data;
+		if ((ret = sr_session_send(feed->sdi, &packet)) != SR_OK)
+			return ret;
+
+		feed->samples_sent += chunk / feed->unitsize;
+		data += chunk;
+		length -= chunk;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Append logic data to a chunked feed.
+ *
+ * This is for drivers which receive the sample data in small pieces.
+ * Bytes are collected in the feed's buffer, which gets sent whenever it
+ * holds a complete chunk. Data need not be aligned to the unit size.
+ * The buffer is allocated on the first call.
+ *
+ * @param[in] feed The feed state. Must not be NULL.
+ * @param[in] data The sample data.
+ * @param[in] length Data length in bytes.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_MALLOC Memory allocation failure.
+ * @retval other Error returned by sr_session_send().
+ */
+SR_PRIV int std_logic_feed_append(struct std_logic_feed *feed,
+		const uint8_t *data, size_t length)
+{
+	size_t count;
+	int ret;
+
+	if (!feed->buffer && length > 0) {
+		feed->buffer = g_try_malloc(feed->chunk_size);
+		if (!feed->buffer) {
+			sr_err("%s: Chunk buffer malloc failed.", __func__);
+			return SR_ERR_MALLOC;
+		}
+	}
+
+	while (length > 0) {
+		count = MIN(length, feed->chunk_size - feed->fill);
+		memcpy(feed->buffer + feed->fill, data, count);
+		feed->fill += count;
+		data += count;
+		length -= count;
+
+		if (feed->fill < feed->chunk_size)
+			break;
+
+		ret = std_logic_feed_send(feed, feed->buffer, feed->fill);
+		feed->fill = 0;
+		if (ret != SR_OK)
+			return ret;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Send any data remaining in a chunked feed.
+ *
+ * Complete samples which were collected by std_logic_feed_append() are
+ * sent, and a trigger positioned right after the last sample is
+ * delivered as well. A trailing partial sample is discarded.
+ *
+ * @param[in] feed The feed state. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval other Error returned by sr_session_send().
+ */
+SR_PRIV int std_logic_feed_flush(struct std_logic_feed *feed)
+{
+	size_t length;
+	int ret;
+
+	length = feed->fill - feed->fill % feed->unitsize;
+	feed->fill = 0;
+
+	if ((ret = std_logic_feed_send(feed, feed->buffer, length)) != SR_OK)
+		return ret;
+
+	return logic_feed_check_trigger(feed);
+}
+
+/**
+ * Release the resources of a chunked feed.
+ *
+ * Data which has not been flushed is dropped.
+ *
+ * @param[in] feed The feed state. May be NULL.
+ */
+SR_PRIV void std_logic_feed_free(struct std_logic_feed *feed)
+{
+	if (!feed)
+		return;
+
+	g_free(feed->buffer);
+	feed->buffer = NULL;
+	feed->fill = 0;
+}
+
+/**
+ * Initialize an ordered chunk pipeline.
+ *
+ * The pipeline splits the data into chunks. Worker threads run the
+ * optional prepare() callback (e.g. a sample format conversion) for the
+ * next chunks, while the calling thread sends the current chunk. Input
+ * which is mapped from a file gets read ahead as well. This way I/O,
+ * the conversion and the session feed overlap, and the order of chunks
+ * is kept. The caller sets the callbacks, and 'mapped' for mapped
+ * input, before std_pipeline_run().
+ *
+ * @param[out] pl The pipeline state. Must not be NULL.
+ * @param[in] data The input data.
+ * @param[in] length Data length in bytes.
+ * @param[in] chunk_size Chunk size in bytes, a multiple of the unit size.
+ */
+SR_PRIV void std_pipeline_init(struct std_pipeline *pl, const uint8_t *data,
+		size_t length, size_t chunk_size)
+{
+	memset(pl, 0, sizeof(*pl));
+	pl->data = data;
+	pl->length = length;
+	pl->chunk_size = MAX(chunk_size, 1);
+#if GLIB_CHECK_VERSION(2, 36, 0)
+	pl->num_slots = MIN(g_get_num_processors(), 4) + 1;
+#else
+	pl->num_slots = 2;
+#endif
+}
+
+/* Chunks being prepared, and the workers which prepare them. */
+struct pipeline_state {
+	GThreadPool *pool;
+	GMutex mutex;
+	GCond done;
+};
+
+struct pipeline_job {
+	struct std_pipeline *pl;
+	struct pipeline_state *state;
+	const uint8_t *data;
+	size_t length;
+	unsigned int slot;
+	gboolean pending;
+	int ret;
+};
+
+/* Get the pages of a chunk of mapped input read in the background. */
+static void pipeline_read_ahead(struct pipeline_job *job)
+{
+#ifdef HAVE_POSIX_MADVISE
+	uintptr_t start, end, page;
+
+	page = sysconf(_SC_PAGESIZE);
+	start = (uintptr_t)job->data / page * page;
+	end = (uintptr_t)job->data + job->length;
+	posix_madvise((void *)start, end - start, POSIX_MADV_WILLNEED);
+#else
+	const volatile uint8_t *p;
+	size_t i;
+	uint8_t sum;
+
+	/* Touch the pages, this runs in a worker thread. */
+	p = job->data;
+	sum = 0;
+	for (i = 0; i < job->length; i += 4096)
+		sum += p[i];
+	(void)sum;
+#endif
+}
+
+static void pipeline_prepare(struct pipeline_job *job)
+{
+#ifndef HAVE_POSIX_MADVISE
+	if (job->pl->mapped)
+		pipeline_read_ahead(job);
+#endif
+
+	job->ret = SR_OK;
+	if (job->pl->prepare)
+		job->ret = job->pl->prepare(job->pl, job->data, job->length,
+			job->slot);
+}
+
+static void pipeline_worker(gpointer data, gpointer user_data)
+{
+	struct pipeline_job *job;
+
+	(void)user_data;
+
+	job = data;
+	pipeline_prepare(job);
+
+	g_mutex_lock(&job->state->mutex);
+	job->pending = FALSE;
+	g_cond_broadcast(&job->state->done);
+	g_mutex_unlock(&job->state->mutex);
+}
+
+static void pipeline_start(struct std_pipeline *pl, struct pipeline_job *job,
+		size_t chunk)
+{
+	job->pl = pl;
+	job->data = pl->data + chunk * pl->chunk_size;
+	job->length = MIN(pl->chunk_size, pl->length - chunk * pl->chunk_size);
+#ifdef HAVE_POSIX_MADVISE
+	if (pl->mapped)
+		pipeline_read_ahead(job);
+#endif
+	job->pending = FALSE;
+	if (job->state->pool) {
+		job->pending = TRUE;
+		if (!g_thread_pool_push(job->state->pool, job, NULL))
+			job->pending = FALSE;
+	}
+	if (!job->pending)
+		pipeline_prepare(job);
+}
+
+static int pipeline_finish(struct pipeline_job *job)
+{
+	g_mutex_lock(&job->state->mutex);
+	while (job->pending)
+		g_cond_wait(&job->state->done, &job->state->mutex);
+	g_mutex_unlock(&job->state->mutex);
+
+	return job->ret;
+}
+
+/**
+ * Run an ordered chunk pipeline.
+ *
+ * Calls send() for all chunks in order, each after prepare() for the
+ * chunk has completed. The callbacks receive the chunk's data, and the
+ * slot index which a chunk keeps until it was sent. Slots get reused
+ * for later chunks, the caller releases what prepare() left in
+ * 'slot_data' after the run. Runs without worker threads when they are
+ * not available or not worth it.
+ *
+ * @param[in] pl The pipeline state. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval other Error returned by a callback.
+ */
+SR_PRIV int std_pipeline_run(struct std_pipeline *pl)
+{
+	struct pipeline_job jobs[STD_PIPELINE_MAX_SLOTS];
+	struct pipeline_state state;
+	size_t num_chunks, chunk, next;
+	unsigned int num_slots, slot;
+	gboolean need_workers;
+	int ret, job_ret;
+
+	num_chunks = (pl->length + pl->chunk_size - 1) / pl->chunk_size;
+	num_slots = CLAMP(pl->num_slots, 1, STD_PIPELINE_MAX_SLOTS);
+	if (num_chunks < 2)
+		num_slots = 1;
+	pl->num_slots = num_slots;
+
+	/* Workers are only needed for prepare(), or to read ahead. */
+	need_workers = pl->prepare != NULL;
+#ifndef HAVE_POSIX_MADVISE
+	need_workers = need_workers || pl->mapped;
+#endif
+	state.pool = NULL;
+	if (num_slots > 1 && need_workers)
+		state.pool = g_thread_pool_new(pipeline_worker, NULL,
+			num_slots, FALSE, NULL);
+	g_mutex_init(&state.mutex);
+	g_cond_init(&state.done);
+
+	for (slot = 0; slot < num_slots; slot++) {
+		jobs[slot].slot = slot;
+		jobs[slot].state = &state;
+	}
+
+	ret = SR_OK;
+	for (next = 0; next < MIN(num_chunks, num_slots); next++)
+		pipeline_start(pl, &jobs[next], next);
+	for (chunk = 0; chunk < num_chunks; chunk++) {
+		slot = chunk % num_slots;
+		job_ret = pipeline_finish(&jobs[slot]);
+		if (ret == SR_OK)
+			ret = job_ret;
+		if (ret == SR_OK)
+			ret = pl->send(pl, jobs[slot].data, jobs[slot].length, slot);
+		if (ret == SR_OK && next < num_chunks)
+			pipeline_start(pl, &jobs[slot], next++);
+	}
+
+	if (state.pool)
+		g_thread_pool_free(state.pool, FALSE, TRUE);
+	g_cond_clear(&state.done);
+	g_mutex_clear(&state.mutex);
+
+	return ret;
+}
+
 #ifdef HAVE_LIBSERIALPORT
 
 /**
@@ -0,0 +1,283 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#if defined(HAVE_HW_BEAGLELOGIC) && !defined(_WIN32)
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define NUM_SAMPLES	(3 * 1024 * 1024 + 17)
+/* All 14 channels are enabled, so the driver captures 16-bit samples. */
+#define NUM_BYTES	(NUM_SAMPLES * 2)
+
+/*
+ * A minimal stand-in for the BeagleLogic TCP server: answers the
+ * configuration queries the driver issues, and streams a counting byte
+ * pattern in odd-sized writes after the "get" command. It optionally
+ * pauses after 'pause_at' bytes, in the middle of a sample.
+ */
+struct fake_server {
+	int listen_fd;
+	unsigned short port;
+	GThread *thread;
+	size_t pause_at;
+};
+
+static const char *fake_response(const char *cmd)
+{
+	if (!strcmp(cmd, "version"))
+		return "BeagleLogic 1.0\n";
+	if (!strcmp(cmd, "samplerate"))
+		return "100000000\n";
+	if (!strcmp(cmd, "sampleunit"))
+		return "1\n";
+	if (!strcmp(cmd, "memalloc"))
+		return "33554432\n";
+	if (!strcmp(cmd, "bufunitsize"))
+		return "4194304\n";
+	if (!strcmp(cmd, "triggerflags"))
+		return "1\n";
+
+	return "ok\n";
+}
+
+static void fake_stream(const struct fake_server *srv, int fd)
+{
+	uint8_t buf[7919];
+	size_t sent, len, i;
+
+	for (sent = 0; sent < NUM_BYTES; sent += len) {
+		if (srv->pause_at && sent == srv->pause_at)
+			g_usleep(200 * 1000);
+		len = MIN(sizeof(buf), NUM_BYTES - sent);
+		if (srv->pause_at > sent)
+			len = MIN(len, srv->pause_at - sent);
+		for (i = 0; i < len; i++)
+			buf[i] = (sent + i) & 0xff;
+		if (send(fd, buf, len, 0) != (ssize_t)len)
+			return;
+	}
+}
+
+static void fake_serve_connection(const struct fake_server *srv, int fd)
+{
+	GString *line;
+	char c;
+
+	line = g_string_sized_new(64);
+	while (recv(fd, &c, 1, 0) == 1) {
+		if (c != '\n') {
+			g_string_append_c(line, c);
+			continue;
+		}
+		if (!strcmp(line->str, "get"))
+			fake_stream(srv, fd);
+		else if (strcmp(line->str, "close"))
+			send(fd, fake_response(line->str),
+				strlen(fake_response(line->str)), 0);
+		g_string_truncate(line, 0);
+	}
+	g_string_free(line, TRUE);
+	close(fd);
+}
+
+static gpointer fake_server_thread(gpointer data)
+{
+	struct fake_server *srv;
+	int fd;
+
+	srv = data;
+	while ((fd = accept(srv->listen_fd, NULL, NULL)) >= 0)
+		fake_serve_connection(srv, fd);
+
+	return NULL;
+}
+
+static void fake_server_start(struct fake_server *srv, size_t pause_at)
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen;
+
+	srv->pause_at = pause_at;
+	srv->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	fail_unless(srv->listen_fd >= 0, "socket() failed.");
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	fail_unless(bind(srv->listen_fd, (struct sockaddr *)&addr,
+		sizeof(addr)) == 0, "bind() failed.");
+	fail_unless(listen(srv->listen_fd, 4) == 0, "listen() failed.");
+
+	addrlen = sizeof(addr);
+	getsockname(srv->listen_fd, (struct sockaddr *)&addr, &addrlen);
+	srv->port = ntohs(addr.sin_port);
+
+	srv->thread = g_thread_new("fake-beaglelogic", fake_server_thread, srv);
+}
+
+static void fake_server_stop(struct fake_server *srv)
+{
+	shutdown(srv->listen_fd, SHUT_RDWR);
+	close(srv->listen_fd);
+	g_thread_join(srv->thread);
+}
+
+struct stream_state {
+	uint64_t bytes;
+	gboolean corrupt;
+	gboolean ended;
+};
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct stream_state *state;
+	const struct sr_datafeed_logic *logic;
+	const uint8_t *data;
+	uint64_t i;
+
+	(void)sdi;
+
+	state = cb_data;
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		data = logic->data;
+		for (i = 0; i < logic->length; i++) {
+			if (data[i] != ((state->bytes + i) & 0xff))
+				state->corrupt = TRUE;
+		}
+		state->bytes += logic->length;
+		break;
+	case SR_DF_END:
+		state->ended = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+/* Run a capture from the fake server, and check that it is complete. */
+static void check_stream(size_t pause_at)
+{
+	struct fake_server srv;
+	struct stream_state state;
+	struct sr_dev_driver *driver;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	struct sr_config *src;
+	GSList *options, *devices;
+	char *conn;
+	int ret;
+
+	fake_server_start(&srv, pause_at);
+
+	driver = srtest_driver_get("beaglelogic");
+	srtest_driver_init(srtest_ctx, driver);
+
+	conn = g_strdup_printf("tcp/127.0.0.1/%u", srv.port);
+	src = g_malloc0(sizeof(*src));
+	src->key = SR_CONF_CONN;
+	src->data = g_variant_ref_sink(g_variant_new_string(conn));
+	options = g_slist_append(NULL, src);
+
+	devices = sr_driver_scan(driver, options);
+	fail_unless(devices != NULL, "No device found at %s.", conn);
+	sdi = devices->data;
+
+	ret = sr_session_new(srtest_ctx, &session);
+	fail_unless(ret == SR_OK, "sr_session_new() failed: %d.", ret);
+	ret = sr_dev_open(sdi);
+	fail_unless(ret == SR_OK, "sr_dev_open() failed: %d.", ret);
+	sr_session_dev_add(session, sdi);
+
+	ret = sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		g_variant_new_uint64(NUM_SAMPLES));
+	fail_unless(ret == SR_OK, "Failed to set sample limit: %d.", ret);
+
+	memset(&state, 0, sizeof(state));
+	sr_session_datafeed_callback_add(session, datafeed_in, &state);
+
+	ret = sr_session_start(session);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	sr_session_run(session);
+
+	fail_unless(state.ended, "No end packet received.");
+	fail_unless(state.bytes == NUM_BYTES, "Got %" PRIu64 " of %d bytes.",
+		state.bytes, NUM_BYTES);
+	fail_unless(!state.corrupt, "Sample data was corrupted.");
+
+	sr_dev_close(sdi);
+	sr_session_destroy(session);
+	g_slist_free(devices);
+	g_variant_unref(src->data);
+	g_free(src);
+	g_slist_free(options);
+	g_free(conn);
+
+	fake_server_stop(&srv);
+}
+
+/* Check that a streamed capture arrives complete and in order. */
+START_TEST(test_tcp_stream)
+{
+	check_stream(0);
+}
+END_TEST
+
+/*
+ * Check that the capture continues when the data stops for a while,
+ * with half a sample received.
+ */
+START_TEST(test_tcp_stream_pause)
+{
+	check_stream(NUM_BYTES / 2 + 1);
+}
+END_TEST
+
+#endif
+
+Suite *suite_driver_beaglelogic(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("driver-beaglelogic");
+
+	tc = tcase_create("tcp");
+#if defined(HAVE_HW_BEAGLELOGIC) && !defined(_WIN32)
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_tcp_stream);
+	tcase_add_test(tc, test_tcp_stream_pause);
+#endif
+	suite_add_tcase(s, tc);
+
+	return s;
+}
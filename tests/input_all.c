@@ -19,6 +19,8 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -33,6 +35,170 @@ START_TEST(test_input_available)
 }
 END_TEST
 
+struct corpus_file {
+	const char *name;
+	const char *content;
+	size_t length;
+	const char *module;
+};
+
+static const char wav_file[] =
+	"RIFF\x2e\x00\x00\x00WAVEfmt \x10\x00\x00\x00"
+	"\x01\x00\x01\x00\x40\x1f\x00\x00\x80\x3e\x00\x00"
+	"\x02\x00\x10\x00" "data" "\x02\x00\x00\x00\x34\x12";
+
+static const char vcd_file[] =
+	"\n$timescale 1 ns $end\n"
+	"$scope module top $end\n"
+	"$var wire 1 ! clk $end\n"
+	"$upscope $end\n"
+	"$enddefinitions $end\n"
+	"#0\n1!\n#10\n0!\n";
+
+static const char lpf_file[] =
+	"Version\x11" "1.2\x11" "345\x11"
+	" CAUTION: Do not change the contents of this file.\r\n";
+
+static const char ad_file[80] =
+	"trace32 iprobe data             "
+	"\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0"
+	"\0\0\0\0\0\0\0\0\x0b";
+
+static const char csv_file[] =
+	"0,1,1\n1,0,1\n";
+
+static const struct corpus_file corpus[] = {
+	{ "capture.wav", wav_file, sizeof(wav_file) - 1, "wav" },
+	{ "capture.vcd", vcd_file, sizeof(vcd_file) - 1, "vcd" },
+	{ "vcd-without-extension", vcd_file, sizeof(vcd_file) - 1, "vcd" },
+	{ "capture.lpf", lpf_file, sizeof(lpf_file) - 1, "logicport" },
+	{ "capture.ad", ad_file, sizeof(ad_file), "trace32_ad" },
+	{ "ad-named.vcd", ad_file, sizeof(ad_file), "trace32_ad" },
+	{ "capture.csv", csv_file, sizeof(csv_file) - 1, NULL },
+};
+
+/*
+ * Size of the generated files, a few KiB more than the scans read
+ * first to check for signatures.
+ */
+#define LARGE_FILE_SIZE	(6 * 1024)
+
+enum large_file_kind {
+	/* A VCD file whose first section ends after the first 4KiB. */
+	LARGE_VCD,
+	/* A Trace32 file with zeroed records. */
+	LARGE_AD,
+	/* Random data without a signature. */
+	LARGE_RANDOM,
+};
+
+struct large_file {
+	const char *name;
+	enum large_file_kind kind;
+	const char *module;
+};
+
+static const struct large_file large_files[] = {
+	{ "large.vcd", LARGE_VCD, "vcd" },
+	{ "large-vcd.dat", LARGE_VCD, "vcd" },
+	{ "large.ad", LARGE_AD, "trace32_ad" },
+	{ "large-ad.vcd", LARGE_AD, "trace32_ad" },
+	{ "random.vcd", LARGE_RANDOM, NULL },
+	{ "random.bin", LARGE_RANDOM, NULL },
+};
+
+static GString *large_file_content(enum large_file_kind kind, GRand *rand)
+{
+	GString *s;
+
+	s = g_string_sized_new(LARGE_FILE_SIZE);
+	switch (kind) {
+	case LARGE_VCD:
+		g_string_append(s, "$comment ");
+		while (s->len < LARGE_FILE_SIZE - sizeof(vcd_file) - 6)
+			g_string_append_c(s, 'x');
+		g_string_append(s, " $end\n");
+		g_string_append(s, vcd_file);
+		break;
+	case LARGE_AD:
+		g_string_append_len(s, ad_file, sizeof(ad_file));
+		g_string_set_size(s, LARGE_FILE_SIZE);
+		memset(s->str + sizeof(ad_file), 0,
+			LARGE_FILE_SIZE - sizeof(ad_file));
+		break;
+	case LARGE_RANDOM:
+		while (s->len < LARGE_FILE_SIZE)
+			g_string_append_c(s, g_rand_int_range(rand, 1, 256));
+		/* Not even a VCD file's leading whitespace. */
+		s->str[0] = '\0';
+		break;
+	}
+
+	return s;
+}
+
+static void check_scan(const char *path, const char *module)
+{
+	const struct sr_input *in;
+	int ret;
+
+	ret = sr_input_scan_file(path, &in);
+	if (module) {
+		fail_unless(ret == SR_OK && in != NULL,
+			"No module found for %s.", path);
+		fail_unless(!strcmp(sr_input_id_get(sr_input_module_get(in)),
+			module), "Wrong module %s for %s.",
+			sr_input_id_get(sr_input_module_get(in)), path);
+	} else {
+		fail_unless(ret != SR_OK && in == NULL,
+			"Unexpected module found for %s.", path);
+	}
+	if (in)
+		sr_input_free(in);
+}
+
+/*
+ * Check that file scans find the right module, also when the file name's
+ * extension does not match, or when the module only sees the file's
+ * format past the part which is read first.
+ */
+START_TEST(test_input_scan_file)
+{
+	gchar *dir, *path;
+	GRand *rand;
+	GString *content;
+	unsigned int i;
+
+	dir = g_dir_make_tmp("sr-scan-XXXXXX", NULL);
+	fail_unless(dir != NULL, "Failed to create a directory.");
+
+	for (i = 0; i < G_N_ELEMENTS(corpus); i++) {
+		path = g_build_filename(dir, corpus[i].name, NULL);
+		fail_unless(g_file_set_contents(path, corpus[i].content,
+			corpus[i].length, NULL), "Failed to write %s.", path);
+		check_scan(path, corpus[i].module);
+		g_remove(path);
+		g_free(path);
+	}
+
+	rand = g_rand_new_with_seed(1);
+	for (i = 0; i < G_N_ELEMENTS(large_files); i++) {
+		path = g_build_filename(dir, large_files[i].name, NULL);
+		content = large_file_content(large_files[i].kind, rand);
+		fail_unless(g_file_set_contents(path, content->str,
+			content->len, NULL), "Failed to write %s.", path);
+		g_string_free(content, TRUE);
+		check_scan(path, large_files[i].module);
+		g_remove(path);
+		g_free(path);
+	}
+	g_rand_free(rand);
+
+	g_rmdir(dir);
+	g_free(dir);
+}
+END_TEST
+
 Suite *suite_input_all(void)
 {
 	Suite *s;
@@ -44,5 +210,10 @@ Suite *suite_input_all(void)
 	tcase_add_test(tc, test_input_available);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("scan");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_input_scan_file);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -18,6 +18,7 @@
  */
 
 #include <config.h>
+#include <string.h>
 #include <check.h>
 #include <glib/gstdio.h>
 #include <libsigrok/libsigrok.h>
@@ -308,6 +309,421 @@ START_TEST(test_input_binary_hello_world)
 }
 END_TEST
 
+/* Check that a memory mapped file arrives complete. */
+START_TEST(test_input_binary_mapped_file)
+{
+	const char *text = "Hello world";
+	const struct sr_input_module *imod;
+	struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GError *error;
+	char *filename;
+	int fd, ret;
+
+	error = NULL;
+	fd = g_file_open_tmp("sigrok-test-XXXXXX", &filename, &error);
+	fail_unless(fd >= 0, "Failed to create temporary file.");
+	g_close(fd, NULL);
+	fail_unless(g_file_set_contents(filename, text, strlen(text), NULL));
+
+	df_packet_counter = sample_counter = 0;
+	have_seen_df_end = FALSE;
+	check_to_perform = CHECK_HELLO_WORLD;
+	expected_samples = strlen(text);
+	expected_samplerate = NULL;
+
+	imod = sr_input_find("binary");
+	fail_unless(imod != NULL, "Failed to find input module.");
+	in = sr_input_new(imod, NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	/* The first call returns when the device instance is ready. */
+	ret = sr_input_send_file(in, filename);
+	fail_unless(ret == SR_OK, "sr_input_send_file() error: %d", ret);
+	sdi = sr_input_dev_inst_get(in);
+	fail_unless(sdi != NULL, "Device instance is not ready.");
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+	sr_session_dev_add(session, sdi);
+
+	ret = sr_input_send_file(in, filename);
+	fail_unless(ret == SR_OK, "sr_input_send_file() error: %d", ret);
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+	fail_unless(have_seen_df_end, "No end packet received.");
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+static GByteArray *lz4_samples;
+static uint64_t lz4_samplerate;
+
+static void datafeed_lz4(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	struct sr_config *src;
+	GSList *l;
+
+	(void)sdi;
+	(void)cb_data;
+
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				lz4_samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		fail_unless(logic->unitsize == 1, "Unexpected unit size %u.",
+			logic->unitsize);
+		g_byte_array_append(lz4_samples, logic->data, logic->length);
+		break;
+	case SR_DF_END:
+		have_seen_df_end = TRUE;
+		break;
+	}
+}
+
+static const char *lz4_names[] = { "CLK", "MOSI", "CS" };
+
+/* Clocked data, then noise which does not compress. */
+static uint8_t *lz4_test_samples(size_t len)
+{
+	uint8_t *samples;
+	size_t i;
+
+	samples = g_malloc(len);
+	for (i = 0; i < 2 * len / 3; i++)
+		samples[i] = (i % 8 < 4) | ((i / 56) % 3 == 0) << 1
+			| ((i / 100000) & 1) << 2;
+	for (; i < len; i++)
+		samples[i] = g_random_int();
+
+	return samples;
+}
+
+/* Compress the samples with the output module. */
+static GString *lz4_write(const uint8_t *samples, size_t len)
+{
+	const struct sr_output *o;
+	struct sr_output_sink *sink;
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_datafeed_logic logic;
+	struct sr_config src;
+	GString *text;
+	size_t i, pos;
+	int ret;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < G_N_ELEMENTS(lz4_names); i++)
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, lz4_names[i]);
+
+	text = g_string_new(NULL);
+	sink = sr_output_sink_new_callback(srtest_append_output, text);
+	o = sr_output_new(sr_output_find("binary-lz4"), NULL, sdi, NULL);
+	fail_unless(o != NULL, "Failed to create 'binary-lz4' output.");
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_ref_sink(g_variant_new_uint64(SR_MHZ(24)));
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	ret = sr_output_send_sink(o, &packet, sink);
+	fail_unless(ret == SR_OK, "Failed to send meta packet.");
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+
+	logic.unitsize = 1;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	for (pos = 0; pos < len; pos += logic.length) {
+		logic.data = (uint8_t *)samples + pos;
+		logic.length = MIN(len - pos, 123457);
+		ret = sr_output_send_sink(o, &packet, sink);
+		fail_unless(ret == SR_OK, "Failed to send logic packet.");
+	}
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	ret = sr_output_send_sink(o, &packet, sink);
+	fail_unless(ret == SR_OK, "Failed to send end packet.");
+	sr_output_free(o);
+	sr_output_sink_free(sink);
+
+	return text;
+}
+
+/* Check the channels, samplerate and samples which were read. */
+static void lz4_check_import(struct sr_dev_inst *sdi, const uint8_t *samples,
+	size_t len)
+{
+	struct sr_channel *ch;
+	GSList *l;
+	size_t i;
+
+	fail_unless(have_seen_df_end, "No end packet received.");
+	for (l = sr_dev_inst_channels_get(sdi), i = 0; l; l = l->next, i++) {
+		ch = l->data;
+		fail_unless(i < G_N_ELEMENTS(lz4_names)
+			&& !strcmp(ch->name, lz4_names[i]),
+			"Channel %zu has the wrong name.", i);
+	}
+	fail_unless(lz4_samplerate == SR_MHZ(24), "Wrong samplerate.");
+	fail_unless(lz4_samples->len == len && !memcmp(lz4_samples->data,
+		samples, len), "Samples differ.");
+}
+
+/* Check that compressed data written by the output module reads back. */
+START_TEST(test_input_binary_lz4_roundtrip)
+{
+	const struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GString *text, *chunk;
+	uint8_t *samples;
+	size_t len, pos, count;
+	int ret;
+
+	len = 3 * 1000 * 1000;
+	samples = lz4_test_samples(len);
+	text = lz4_write(samples, len);
+	fail_unless(text->len < len / 2, "Data was not compressed.");
+
+	/* The format gets detected from the header. */
+	chunk = g_string_new_len(text->str, 128);
+	ret = sr_input_scan_buffer(chunk, &in);
+	fail_unless(ret == SR_OK && in != NULL, "Format was not detected.");
+	fail_unless(!strcmp(sr_input_id_get(sr_input_module_get(in)),
+		"binary-lz4"), "Detected the wrong format.");
+	sr_input_free(in);
+	g_string_free(chunk, TRUE);
+
+	in = sr_input_new(sr_input_find("binary-lz4"), NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	lz4_samples = g_byte_array_new();
+	lz4_samplerate = 0;
+	have_seen_df_end = FALSE;
+	session = NULL;
+	sdi = NULL;
+	for (pos = 0; pos < text->len; pos += count) {
+		count = MIN(text->len - pos, 77777);
+		chunk = g_string_new_len(text->str + pos, count);
+		ret = sr_input_send(in, chunk);
+		fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+		if (!session && (sdi = sr_input_dev_inst_get(in))) {
+			sr_session_new(srtest_ctx, &session);
+			sr_session_datafeed_callback_add(session, datafeed_lz4, NULL);
+			sr_session_dev_add(session, sdi);
+		}
+		g_string_free(chunk, TRUE);
+	}
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+	lz4_check_import(sdi, samples, len);
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+	g_byte_array_free(lz4_samples, TRUE);
+	g_string_free(text, TRUE);
+	g_free(samples);
+}
+END_TEST
+
+static uint32_t read_u32(const uint8_t *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void append_u32(GString *s, uint32_t value)
+{
+	char buf[4];
+
+	buf[0] = value;
+	buf[1] = value >> 8;
+	buf[2] = value >> 16;
+	buf[3] = value >> 24;
+	g_string_append_len(s, buf, 4);
+}
+
+/* Returns TRUE if the stream has blocks which are stored uncompressed. */
+static gboolean lz4_has_stored_blocks(const GString *text)
+{
+	const uint8_t *p, *end;
+	uint32_t count, size;
+
+	p = (const uint8_t *)text->str;
+	end = p + text->len;
+	count = read_u32(p + 24);
+	for (p += 28; count; count--)
+		p += 8 + read_u32(p + 4);
+	while (end - p >= 8 && (size = read_u32(p))) {
+		if (size & (1U << 31))
+			return TRUE;
+		p += 8 + (size & ~(1U << 31));
+	}
+
+	return FALSE;
+}
+
+/*
+ * Check that a memory mapped file reads back, its stored blocks get
+ * sent straight from the mapping. Also check the end of an input which
+ * only got the header.
+ */
+START_TEST(test_input_binary_lz4_mapped)
+{
+	const struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GString *text;
+	uint8_t *samples;
+	char *filename;
+	size_t len;
+	int fd, ret, run;
+
+	/* The last block has noise only. */
+	len = 3 * 1000 * 1000;
+	samples = lz4_test_samples(len);
+	text = lz4_write(samples, len);
+	fail_unless(lz4_has_stored_blocks(text), "No stored blocks.");
+
+	fd = g_file_open_tmp("sigrok-test-XXXXXX", &filename, NULL);
+	fail_unless(fd >= 0, "Failed to create temporary file.");
+	g_close(fd, NULL);
+	fail_unless(g_file_set_contents(filename, text->str, text->len, NULL));
+
+	for (run = 0; run < 2; run++) {
+		in = sr_input_new(sr_input_find("binary-lz4"), NULL);
+		fail_unless(in != NULL, "Failed to create input instance.");
+		lz4_samples = g_byte_array_new();
+		lz4_samplerate = 0;
+		have_seen_df_end = FALSE;
+
+		/* The first call returns when the device instance is ready. */
+		ret = sr_input_send_file(in, filename);
+		fail_unless(ret == SR_OK, "sr_input_send_file() error: %d", ret);
+		sdi = sr_input_dev_inst_get(in);
+		fail_unless(sdi != NULL, "Device instance is not ready.");
+
+		sr_session_new(srtest_ctx, &session);
+		sr_session_datafeed_callback_add(session, datafeed_lz4, NULL);
+		sr_session_dev_add(session, sdi);
+
+		if (run == 0) {
+			ret = sr_input_send_file(in, filename);
+			fail_unless(ret == SR_OK,
+				"sr_input_send_file() error: %d", ret);
+		}
+		ret = sr_input_end(in);
+		fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+		if (run == 0)
+			lz4_check_import(sdi, samples, len);
+		else
+			fail_unless(lz4_samples->len == 0,
+				"Samples without data.");
+
+		sr_input_free(in);
+		sr_session_destroy(session);
+		g_byte_array_free(lz4_samples, TRUE);
+	}
+
+	g_unlink(filename);
+	g_free(filename);
+	g_string_free(text, TRUE);
+	g_free(samples);
+}
+END_TEST
+
+/*
+ * Read a stream of one block with the given compressed data, returns
+ * the result of the import.
+ */
+static int lz4_import_block(const uint8_t *data, size_t size,
+	uint32_t samples)
+{
+	static const uint8_t header[] = {
+		'S', 'R', 'B', 'I', 'N', 'L', 'Z', '4',
+		1, 0, 0, 0, 1, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0,
+		1, 0, 0, 0, 0, 0, 0, 0,
+		2, 0, 0, 0, 'D', '0',
+	};
+	const struct sr_input *in;
+	struct sr_session *session;
+	GString *text;
+	int ret;
+
+	text = g_string_new_len((const char *)header, sizeof(header));
+	append_u32(text, size);
+	append_u32(text, samples);
+	g_string_append_len(text, (const char *)data, size);
+	/* The end marker. */
+	append_u32(text, 0);
+
+	in = sr_input_new(sr_input_find("binary-lz4"), NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	lz4_samples = g_byte_array_new();
+
+	/* The header check makes the device instance ready. */
+	ret = sr_input_send(in, text);
+	fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_lz4, NULL);
+	sr_session_dev_add(session, sr_input_dev_inst_get(in));
+	ret = sr_input_end(in);
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+	g_byte_array_free(lz4_samples, TRUE);
+	g_string_free(text, TRUE);
+
+	return ret;
+}
+
+/* Check that corrupt compressed blocks get rejected. */
+START_TEST(test_input_binary_lz4_corrupt)
+{
+	/* A literal 'a', then a match of four at offset 1. */
+	static const uint8_t valid[] = { 0x10, 'a', 0x01, 0x00 };
+	/* Five literals, but only three follow. */
+	static const uint8_t truncated[] = { 0x50, 'a', 'b', 'c' };
+	/* The match offset is cut off. */
+	static const uint8_t truncated_offset[] = { 0x10, 'a', 0x01 };
+	static const uint8_t offset_zero[] = { 0x10, 'a', 0x00, 0x00 };
+	/* The match starts before the start of the block. */
+	static const uint8_t offset_before[] = { 0x10, 'a', 0x02, 0x00 };
+	int ret;
+
+	ret = lz4_import_block(valid, sizeof(valid), 5);
+	fail_unless(ret == SR_OK, "Valid block was rejected: %d.", ret);
+
+	ret = lz4_import_block(truncated, sizeof(truncated), 5);
+	fail_unless(ret == SR_ERR_DATA, "Truncated block: %d.", ret);
+	ret = lz4_import_block(truncated_offset, sizeof(truncated_offset), 5);
+	fail_unless(ret == SR_ERR_DATA, "Truncated match offset: %d.", ret);
+	ret = lz4_import_block(offset_zero, sizeof(offset_zero), 5);
+	fail_unless(ret == SR_ERR_DATA, "Match offset 0: %d.", ret);
+	ret = lz4_import_block(offset_before, sizeof(offset_before), 5);
+	fail_unless(ret == SR_ERR_DATA, "Match before the block: %d.", ret);
+	/* The valid block does not fit four samples. */
+	ret = lz4_import_block(valid, sizeof(valid), 4);
+	fail_unless(ret == SR_ERR_DATA, "Output overflow: %d.", ret);
+}
+END_TEST
+
 Suite *suite_input_binary(void)
 {
 	Suite *s;
@@ -321,6 +737,10 @@ Suite *suite_input_binary(void)
 	tcase_add_test(tc, test_input_binary_all_high);
 	tcase_add_loop_test(tc, test_input_binary_all_high_loop, 1, 10);
 	tcase_add_test(tc, test_input_binary_hello_world);
+	tcase_add_test(tc, test_input_binary_mapped_file);
+	tcase_add_test(tc, test_input_binary_lz4_roundtrip);
+	tcase_add_test(tc, test_input_binary_lz4_mapped);
+	tcase_add_test(tc, test_input_binary_lz4_corrupt);
 	suite_add_tcase(s, tc);
 
 	return s;
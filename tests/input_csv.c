@@ -0,0 +1,372 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/* Number of lines in the generated input. */
+#define BENCH_LINES	200000
+
+/* Size of the pieces the input is fed in, like a frontend reading a file. */
+#define FEED_SIZE	(64 * 1024)
+
+struct csv_result {
+	GByteArray *data;
+	unsigned int unitsize;
+	GArray *analog[2];
+	gboolean ended;
+};
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct csv_result *res;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	struct sr_channel *ch;
+
+	(void)sdi;
+
+	res = cb_data;
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		res->unitsize = logic->unitsize;
+		g_byte_array_append(res->data, logic->data, logic->length);
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		ch = analog->meaning->channels->data;
+		/* The analog channels follow the two logic channels. */
+		if (ch->index >= 2 && ch->index <= 3 && res->analog[ch->index - 2])
+			g_array_append_vals(res->analog[ch->index - 2],
+				analog->data, analog->num_samples);
+		break;
+	case SR_DF_END:
+		res->ended = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+static GHashTable *new_options(void)
+{
+	return g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+}
+
+static void set_option(GHashTable *options, const char *key, GVariant *value)
+{
+	g_hash_table_insert(options, g_strdup(key), g_variant_ref_sink(value));
+}
+
+/* Feed a CSV text to the input module in chunks, then finish it. */
+static int import_csv(const char *text, GHashTable *options,
+	struct csv_result *res)
+{
+	const struct sr_input_module *imod;
+	struct sr_input *in;
+	struct sr_session *session;
+	GString *buf;
+	size_t len, pos, count;
+	int ret;
+
+	imod = sr_input_find("csv");
+	fail_unless(imod != NULL, "Failed to find input module.");
+	in = sr_input_new(imod, options);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, res);
+	sr_session_dev_add(session, sr_input_dev_inst_get(in));
+
+	ret = SR_OK;
+	len = strlen(text);
+	for (pos = 0; pos < len && ret == SR_OK; pos += count) {
+		count = MIN(len - pos, FEED_SIZE);
+		buf = g_string_new_len(text + pos, count);
+		ret = sr_input_send(in, buf);
+		g_string_free(buf, TRUE);
+	}
+	if (ret == SR_OK)
+		ret = sr_input_end(in);
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+
+	return ret;
+}
+
+/* Check multi column input with a header, comments and CRLF lines. */
+START_TEST(test_input_csv_multi_column)
+{
+	static const char csv[] =
+		"a, b, c ; names\r\n"
+		"0, 1, 1\r\n"
+		"; comment\r\n"
+		"\r\n"
+		" 1 ,0,1 ; trailing\r\n"
+		"1,1,0";
+	static const uint8_t expected[] = { 0x06, 0x05, 0x03 };
+	struct csv_result res;
+	GHashTable *options;
+	int ret;
+
+	options = new_options();
+	set_option(options, "header", g_variant_new_boolean(TRUE));
+
+	memset(&res, 0, sizeof(res));
+	res.data = g_byte_array_new();
+
+	ret = import_csv(csv, options, &res);
+
+	fail_unless(ret == SR_OK, "Import failed: %d.", ret);
+	fail_unless(res.ended, "No end packet received.");
+	fail_unless(res.data->len == sizeof(expected),
+		"Expected %zu samples, got %u.", sizeof(expected), res.data->len);
+	fail_unless(!memcmp(res.data->data, expected, sizeof(expected)),
+		"Sample data mismatch.");
+
+	g_byte_array_free(res.data, TRUE);
+	g_hash_table_destroy(options);
+}
+END_TEST
+
+/* Check single column hex input, and that invalid values get rejected. */
+START_TEST(test_input_csv_single_column)
+{
+	static const char csv[] =
+		"0,12a\n"
+		"1,fF0\n"
+		"2,xyz\n";
+	static const uint8_t expected[] = { 0x2a, 0x01, 0xf0, 0x0f };
+	struct csv_result res;
+	GHashTable *options;
+	int ret;
+
+	options = new_options();
+	set_option(options, "single-column", g_variant_new_int32(1));
+	set_option(options, "numchannels", g_variant_new_int32(12));
+	set_option(options, "format", g_variant_new_string("hex"));
+
+	memset(&res, 0, sizeof(res));
+	res.data = g_byte_array_new();
+
+	ret = import_csv(csv, options, &res);
+
+	fail_unless(ret != SR_OK, "Invalid value was accepted.");
+
+	/* Without the invalid line, the samples arrive. */
+	g_byte_array_set_size(res.data, 0);
+	ret = import_csv("0,12a\n1,fF0\n", options, &res);
+
+	fail_unless(ret == SR_OK, "Import failed: %d.", ret);
+	fail_unless(res.unitsize == 2, "Wrong unit size %u.", res.unitsize);
+	fail_unless(res.data->len == sizeof(expected),
+		"Expected %zu bytes, got %u.", sizeof(expected), res.data->len);
+	fail_unless(!memcmp(res.data->data, expected, sizeof(expected)),
+		"Sample data mismatch.");
+
+	g_byte_array_free(res.data, TRUE);
+	g_hash_table_destroy(options);
+}
+END_TEST
+
+/* Check analog columns between and after the logic columns. */
+START_TEST(test_input_csv_analog)
+{
+	static const char csv[] =
+		"clk, vbus, en, ibus\n"
+		"1, 5.0, 0, -3e-3\n"
+		"0, +4.875, 1, 1.5E2\n"
+		"1, 0.000123456789012345678, 1, 1e30\n";
+	static const uint8_t expected[] = { 0x01, 0x02, 0x03 };
+	static const float expected_vbus[] = { 5.0, 4.875, 0.000123456789f };
+	static const float expected_ibus[] = { -3e-3, 150.0, 1e30 };
+	struct csv_result res;
+	GHashTable *options;
+	unsigned int i;
+	int ret;
+
+	options = new_options();
+	set_option(options, "header", g_variant_new_boolean(TRUE));
+	set_option(options, "analog-columns", g_variant_new_string("3,1"));
+
+	memset(&res, 0, sizeof(res));
+	res.data = g_byte_array_new();
+	res.analog[0] = g_array_new(FALSE, FALSE, sizeof(float));
+	res.analog[1] = g_array_new(FALSE, FALSE, sizeof(float));
+
+	ret = import_csv(csv, options, &res);
+
+	fail_unless(ret == SR_OK, "Import failed: %d.", ret);
+	fail_unless(res.data->len == sizeof(expected),
+		"Expected %zu samples, got %u.", sizeof(expected), res.data->len);
+	fail_unless(!memcmp(res.data->data, expected, sizeof(expected)),
+		"Sample data mismatch.");
+	fail_unless(res.analog[0]->len == 3 && res.analog[1]->len == 3,
+		"Expected 3 analog samples per channel.");
+	for (i = 0; i < 3; i++) {
+		fail_unless(g_array_index(res.analog[0], float, i) == expected_vbus[i],
+			"Analog value %u of vbus mismatch.", i);
+		fail_unless(g_array_index(res.analog[1], float, i) == expected_ibus[i],
+			"Analog value %u of ibus mismatch.", i);
+	}
+
+	/* Garbage in an analog column gets rejected. */
+	set_option(options, "header", g_variant_new_boolean(FALSE));
+	ret = import_csv("1, 5.0, 0, 1.2.3\n", options, &res);
+	fail_unless(ret != SR_OK, "Invalid analog value was accepted.");
+
+	g_array_free(res.analog[0], TRUE);
+	g_array_free(res.analog[1], TRUE);
+	g_byte_array_free(res.data, TRUE);
+	g_hash_table_destroy(options);
+}
+END_TEST
+
+/* Check that analog columns are still set up after a reset. */
+START_TEST(test_input_csv_analog_reset)
+{
+	static const char csv[] = "1, 5.0, 0, -3e-3\n0, 4.875, 1, 150\n";
+	static const uint8_t expected[] = { 0x01, 0x02 };
+	struct csv_result res;
+	const struct sr_input *in;
+	struct sr_session *session;
+	GHashTable *options;
+	GString *buf;
+	unsigned int run;
+	int ret;
+
+	options = new_options();
+	set_option(options, "analog-columns", g_variant_new_string("1,3"));
+	in = sr_input_new(sr_input_find("csv"), options);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	memset(&res, 0, sizeof(res));
+	res.data = g_byte_array_new();
+	res.analog[0] = g_array_new(FALSE, FALSE, sizeof(float));
+	res.analog[1] = g_array_new(FALSE, FALSE, sizeof(float));
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, &res);
+	sr_session_dev_add(session, sr_input_dev_inst_get(in));
+
+	for (run = 0; run < 2; run++) {
+		g_byte_array_set_size(res.data, 0);
+		g_array_set_size(res.analog[0], 0);
+		g_array_set_size(res.analog[1], 0);
+
+		buf = g_string_new(csv);
+		ret = sr_input_send(in, buf);
+		g_string_free(buf, TRUE);
+		fail_unless(ret == SR_OK, "Import %u failed: %d.", run, ret);
+		ret = sr_input_end(in);
+		fail_unless(ret == SR_OK, "Import %u failed: %d.", run, ret);
+
+		fail_unless(res.data->len == sizeof(expected)
+			&& !memcmp(res.data->data, expected, sizeof(expected)),
+			"Sample data mismatch in import %u.", run);
+		fail_unless(res.analog[0]->len == 2 && res.analog[1]->len == 2,
+			"Expected 2 analog samples per channel in import %u.", run);
+		fail_unless(g_array_index(res.analog[0], float, 1) == 4.875f
+			&& g_array_index(res.analog[1], float, 1) == 150.0f,
+			"Analog value mismatch in import %u.", run);
+
+		ret = sr_input_reset(in);
+		fail_unless(ret == SR_OK, "Reset failed: %d.", ret);
+	}
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+	g_array_free(res.analog[0], TRUE);
+	g_array_free(res.analog[1], TRUE);
+	g_byte_array_free(res.data, TRUE);
+	g_hash_table_destroy(options);
+}
+END_TEST
+
+/*
+ * Import many lines of multi column input. This also serves as a
+ * throughput benchmark, run with G_MESSAGES_DEBUG=all to see the figures.
+ */
+START_TEST(test_input_csv_many_lines)
+{
+	struct csv_result res;
+	GHashTable *options;
+	GString *csv;
+	unsigned int i, bit;
+	int64_t start, elapsed;
+	int ret;
+
+	csv = g_string_sized_new(20 * BENCH_LINES);
+	for (i = 0; i < BENCH_LINES; i++) {
+		for (bit = 0; bit < 8; bit++)
+			g_string_append(csv, (i >> bit) & 1 ? "1," : "0,");
+		g_string_append(csv, "0\n");
+	}
+
+	options = new_options();
+	memset(&res, 0, sizeof(res));
+	res.data = g_byte_array_sized_new(2 * BENCH_LINES);
+
+	start = g_get_monotonic_time();
+	ret = import_csv(csv->str, options, &res);
+	elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+	g_debug("CSV import: %zu bytes in %" PRId64 " us, %.1f MB/s.",
+		csv->len, elapsed, (double)csv->len / elapsed);
+
+	fail_unless(ret == SR_OK, "Import failed: %d.", ret);
+	fail_unless(res.unitsize == 2, "Wrong unit size %u.", res.unitsize);
+	fail_unless(res.data->len == 2 * BENCH_LINES,
+		"Expected %d samples, got %u.", BENCH_LINES, res.data->len / 2);
+	for (i = 0; i < BENCH_LINES; i++) {
+		if (res.data->data[2 * i] != (i & 0xff)
+				|| res.data->data[2 * i + 1] != 0)
+			fail("Sample data mismatch at sample %u.", i);
+	}
+
+	g_byte_array_free(res.data, TRUE);
+	g_hash_table_destroy(options);
+	g_string_free(csv, TRUE);
+}
+END_TEST
+
+Suite *suite_input_csv(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("input-csv");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_input_csv_multi_column);
+	tcase_add_test(tc, test_input_csv_single_column);
+	tcase_add_test(tc, test_input_csv_analog);
+	tcase_add_test(tc, test_input_csv_analog_reset);
+	tcase_add_test(tc, test_input_csv_many_lines);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
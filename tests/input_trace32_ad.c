@@ -0,0 +1,311 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <string.h>
+#include <check.h>
+#include <glib/gstdio.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/* Duration of a timestamp tick in seconds. */
+#define TICK		0.000000000078125
+
+/* Import at 12.8 GHz, one sample per timestamp tick. */
+#define SAMPLERATE_MHZ	12800
+
+#define HEADER_SIZE	80
+#define RECORD_SIZE	11
+#define NUM_RECORDS	5
+#define FIRST_TIMESTAMP	1000
+#define RECORD_TICKS	10
+#define TRIGGER_RECORD	2
+
+/* Size of the pieces the stream is fed in, not a multiple of records. */
+#define FEED_SIZE	17
+
+struct t32_result {
+	/* The IP0..7 bits of each sample. */
+	GByteArray *data;
+	/* Number of samples before the trigger, or -1. */
+	int trigger_at;
+	gboolean ended;
+};
+
+/* Runs of samples with the same value. */
+struct run {
+	uint8_t value;
+	unsigned int count;
+};
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct t32_result *res;
+	const struct sr_datafeed_logic *logic;
+	const uint8_t *data;
+	size_t i;
+
+	(void)sdi;
+
+	res = cb_data;
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		data = logic->data;
+		fail_unless(logic->unitsize == 3, "Wrong unit size %u.",
+			logic->unitsize);
+		for (i = 0; i < logic->length; i += logic->unitsize)
+			g_byte_array_append(res->data, data + i, 1);
+		break;
+	case SR_DF_TRIGGER:
+		fail_unless(res->trigger_at < 0, "More than one trigger.");
+		res->trigger_at = res->data->len;
+		break;
+	case SR_DF_END:
+		res->ended = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+static void write_le(uint8_t *p, uint64_t value, unsigned int size)
+{
+	unsigned int i;
+
+	for (i = 0; i < size; i++)
+		p[i] = value >> (8 * i);
+}
+
+/*
+ * An iprobe recording of five records, ten ticks apart. The third one
+ * is the trigger record. IP0..7 hold the record number, counting from 1.
+ */
+static GByteArray *new_recording(void)
+{
+	GByteArray *file;
+	uint8_t header[HEADER_SIZE], record[RECORD_SIZE];
+	unsigned int i;
+
+	memset(header, ' ', 32);
+	memcpy(header, "trace32 iprobe data", strlen("trace32 iprobe data"));
+	memset(header + 32, 0, sizeof(header) - 32);
+	write_le(header + 32, FIRST_TIMESTAMP
+		+ TRIGGER_RECORD * RECORD_TICKS, 8);
+	header[56] = RECORD_SIZE;
+	write_le(header + 60, NUM_RECORDS, 4);
+	write_le(header + 64, NUM_RECORDS - 1, 4);
+
+	file = g_byte_array_new();
+	g_byte_array_append(file, header, sizeof(header));
+	for (i = 0; i < NUM_RECORDS; i++) {
+		memset(record, 0, sizeof(record));
+		write_le(record, FIRST_TIMESTAMP + i * RECORD_TICKS, 8);
+		record[8] = i + 1;
+		g_byte_array_append(file, record, sizeof(record));
+	}
+
+	return file;
+}
+
+/* Get a time relative to the trigger, in the middle of a tick. */
+static GVariant *range_time(double ticks)
+{
+	GVariant *time;
+	gchar *text;
+
+	text = g_strdup_printf("%.17g", (ticks + 0.5) * TICK);
+	time = g_variant_new_string(text);
+	g_free(text);
+
+	return time;
+}
+
+/*
+ * Import the recording with the time range, in pieces or from a memory
+ * mapped file.
+ */
+static void import_range(GVariant *start, GVariant *end, gboolean mapped,
+	struct t32_result *res)
+{
+	const struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GHashTable *options;
+	GByteArray *file;
+	GString *chunk;
+	char *filename;
+	size_t pos, count;
+	int fd, ret;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("samplerate"),
+		g_variant_ref_sink(g_variant_new_uint32(SAMPLERATE_MHZ)));
+	g_hash_table_insert(options, g_strdup("start-time"),
+		g_variant_ref_sink(start ? start : g_variant_new_string("")));
+	g_hash_table_insert(options, g_strdup("end-time"),
+		g_variant_ref_sink(end ? end : g_variant_new_string("")));
+	in = sr_input_new(sr_input_find("trace32_ad"), options);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	g_hash_table_destroy(options);
+
+	res->data = g_byte_array_new();
+	res->trigger_at = -1;
+	res->ended = FALSE;
+	file = new_recording();
+	session = NULL;
+	filename = NULL;
+
+	if (mapped) {
+		fd = g_file_open_tmp("sigrok-test-XXXXXX", &filename, NULL);
+		fail_unless(fd >= 0, "Failed to create temporary file.");
+		g_close(fd, NULL);
+		fail_unless(g_file_set_contents(filename,
+			(const char *)file->data, file->len, NULL));
+		/* The first call returns when the device instance is ready. */
+		ret = sr_input_send_file(in, filename);
+		fail_unless(ret == SR_OK, "sr_input_send_file() error: %d", ret);
+	}
+	for (pos = 0; pos < file->len; pos += count) {
+		count = MIN(file->len - pos, FEED_SIZE);
+		if (!session && (sdi = sr_input_dev_inst_get(in))) {
+			sr_session_new(srtest_ctx, &session);
+			sr_session_datafeed_callback_add(session, datafeed_in, res);
+			sr_session_dev_add(session, sdi);
+		}
+		if (mapped) {
+			ret = sr_input_send_file(in, filename);
+			fail_unless(ret == SR_OK, "sr_input_send_file() error: %d",
+				ret);
+			break;
+		}
+		chunk = g_string_new_len((const char *)file->data + pos, count);
+		ret = sr_input_send(in, chunk);
+		fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+		g_string_free(chunk, TRUE);
+	}
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+	fail_unless(res->ended, "No end packet received.");
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+	g_byte_array_free(file, TRUE);
+	if (filename) {
+		g_unlink(filename);
+		g_free(filename);
+	}
+}
+
+static void check_range(double start, double end, const struct run *runs,
+	unsigned int num_runs, int trigger_at)
+{
+	struct t32_result res;
+	GByteArray *expected;
+	unsigned int i, j, mapped;
+
+	expected = g_byte_array_new();
+	for (i = 0; i < num_runs; i++) {
+		for (j = 0; j < runs[i].count; j++)
+			g_byte_array_append(expected, &runs[i].value, 1);
+	}
+
+	for (mapped = 0; mapped < 2; mapped++) {
+		import_range(isnan(start) ? NULL : range_time(start),
+			isnan(end) ? NULL : range_time(end), mapped, &res);
+		fail_unless(res.data->len == expected->len,
+			"Expected %u samples, got %u (mapped %u).",
+			expected->len, res.data->len, mapped);
+		fail_unless(!expected->len || !memcmp(res.data->data,
+			expected->data, expected->len),
+			"Sample data mismatch (mapped %u).", mapped);
+		fail_unless(res.trigger_at == trigger_at,
+			"Expected the trigger at %d, got %d (mapped %u).",
+			trigger_at, res.trigger_at, mapped);
+		g_byte_array_free(res.data, TRUE);
+	}
+
+	g_byte_array_free(expected, TRUE);
+}
+
+/* Check the whole recording, and a range from mid-record to mid-record. */
+START_TEST(test_input_trace32_ad_range)
+{
+	static const struct run all[] = {
+		{ 1, 10 }, { 2, 10 }, { 3, 10 }, { 4, 10 }, { 5, 1 },
+	};
+	static const struct run part[] = {
+		{ 1, 6 }, { 2, 10 }, { 3, 10 }, { 4, 3 },
+	};
+
+	check_range(NAN, NAN, all, G_N_ELEMENTS(all), 20);
+	/* Timestamps 1004 to 1033. */
+	check_range(-16, 13, part, G_N_ELEMENTS(part), 16);
+}
+END_TEST
+
+/* Check ranges outside of the recording. */
+START_TEST(test_input_trace32_ad_range_outside)
+{
+	/* Before the first record. */
+	check_range(-101, -51, NULL, 0, -1);
+	/* After the last record. */
+	check_range(30, NAN, NULL, 0, -1);
+}
+END_TEST
+
+/*
+ * Check a range which starts within the trigger record. The trigger
+ * lies before the range and is not imported.
+ */
+START_TEST(test_input_trace32_ad_range_trigger)
+{
+	static const struct run part[] = {
+		{ 3, 6 }, { 4, 10 }, { 5, 1 },
+	};
+	static const struct run from_trigger[] = {
+		{ 3, 10 }, { 4, 10 }, { 5, 1 },
+	};
+
+	/* Timestamp 1024. */
+	check_range(4, NAN, part, G_N_ELEMENTS(part), -1);
+	/* Timestamp 1020, the trigger is the first sample. */
+	check_range(0, NAN, from_trigger, G_N_ELEMENTS(from_trigger), 0);
+}
+END_TEST
+
+Suite *suite_input_trace32_ad(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("input-trace32_ad");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_input_trace32_ad_range);
+	tcase_add_test(tc, test_input_trace32_ad_range_outside);
+	tcase_add_test(tc, test_input_trace32_ad_range_trigger);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,412 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/* Number of signals and value changes in the generated dump. */
+#define BENCH_SIGNALS	300
+#define BENCH_CHANGES	200000
+
+/* Size of the pieces the input is fed in, like a frontend reading a file. */
+#define FEED_SIZE	(64 * 1024)
+
+struct vcd_result {
+	GByteArray *data;
+	GArray *analog;
+	unsigned int num_groups;
+	unsigned int unitsize;
+	uint64_t samplerate;
+	gboolean ended;
+	/* Expected levels for the generated dump, see check_toggles(). */
+	uint8_t *levels;
+	uint64_t samples;
+	gboolean mismatch;
+};
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct vcd_result *res;
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	struct sr_config *src;
+	GSList *l;
+
+	(void)sdi;
+
+	res = cb_data;
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				res->samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		res->unitsize = logic->unitsize;
+		if (res->data)
+			g_byte_array_append(res->data, logic->data, logic->length);
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		if (res->analog)
+			g_array_append_vals(res->analog, analog->data,
+				analog->num_samples);
+		break;
+	case SR_DF_END:
+		res->ended = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+/* Feed a VCD text to the input module in chunks, then finish it. */
+static void import_vcd(const char *text, size_t len, size_t feed_size,
+	sr_datafeed_callback cb, struct vcd_result *res)
+{
+	const struct sr_input_module *imod;
+	struct sr_input *in;
+	struct sr_session *session;
+	GString *buf;
+	size_t pos, count;
+	int ret;
+
+	imod = sr_input_find("vcd");
+	fail_unless(imod != NULL, "Failed to find input module.");
+	in = sr_input_new(imod, NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, cb, res);
+	sr_session_dev_add(session, sr_input_dev_inst_get(in));
+
+	for (pos = 0; pos < len; pos += count) {
+		count = MIN(len - pos, feed_size);
+		buf = g_string_new_len(text + pos, count);
+		ret = sr_input_send(in, buf);
+		g_string_free(buf, TRUE);
+		fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+	}
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+
+	res->num_groups = g_slist_length(
+		sr_dev_inst_channel_groups_get(sr_input_dev_inst_get(in)));
+	sr_input_free(in);
+	sr_session_destroy(session);
+}
+
+/* Check scalar changes, multi-character identifiers and skipped sections. */
+START_TEST(test_input_vcd_basic)
+{
+	static const char vcd[] =
+		"$timescale 1 us $end\n"
+		"$scope module top $end\n"
+		"$var wire 1 ! a $end\n"
+		"$var wire 1 \"# b $end\n"
+		"$var reg 1 % c $end\n"
+		"$upscope $end\n"
+		"$enddefinitions $end\n"
+		"$comment 1! 1\"# $end\n"
+		"#0\n"
+		"$dumpvars 1! 0\"# 1% $end\n"
+		"#2\n"
+		"0!\n"
+		"1 \"#\n"
+		"#3\n"
+		"b0 %\n"
+		"#5\n";
+	static const uint8_t expected[] = { 0x05, 0x05, 0x06, 0x02, 0x02 };
+	struct vcd_result res;
+
+	memset(&res, 0, sizeof(res));
+	res.data = g_byte_array_new();
+
+	import_vcd(vcd, strlen(vcd), FEED_SIZE, datafeed_in, &res);
+
+	fail_unless(res.ended, "No end packet received.");
+	fail_unless(res.samplerate == SR_MHZ(1), "Wrong samplerate %" PRIu64 ".",
+		res.samplerate);
+	fail_unless(res.unitsize == 1, "Wrong unit size %u.", res.unitsize);
+	fail_unless(res.data->len == sizeof(expected),
+		"Expected %zu samples, got %u.", sizeof(expected), res.data->len);
+	fail_unless(!memcmp(res.data->data, expected, sizeof(expected)),
+		"Sample data mismatch.");
+
+	g_byte_array_free(res.data, TRUE);
+}
+END_TEST
+
+/* Check that vectors become groups of logic bits, and reals analog data. */
+START_TEST(test_input_vcd_vectors)
+{
+	static const char vcd[] =
+		"$timescale 1 us $end\n"
+		"$var wire 4 ! bus [3:0] $end\n"
+		"$var real 64 \" v $end\n"
+		"$var wire 1 # c $end\n"
+		"$enddefinitions $end\n"
+		"#0\n"
+		"$dumpvars b1010 ! r1.5 \" 1# $end\n"
+		"#2\n"
+		"b1 !\n"
+		"r-2.25e1 \"\n"
+		"#3\n"
+		"bx1 !\n"
+		"0#\n"
+		"#4\n";
+	static const uint8_t expected[] = { 0x1a, 0x1a, 0x11, 0x01 };
+	static const float expected_analog[] = { 1.5, 1.5, -22.5, -22.5 };
+	struct vcd_result res;
+
+	memset(&res, 0, sizeof(res));
+	res.data = g_byte_array_new();
+	res.analog = g_array_new(FALSE, FALSE, sizeof(float));
+
+	import_vcd(vcd, strlen(vcd), FEED_SIZE, datafeed_in, &res);
+
+	fail_unless(res.ended, "No end packet received.");
+	fail_unless(res.num_groups == 1, "Expected 1 channel group, got %u.",
+		res.num_groups);
+	fail_unless(res.data->len == sizeof(expected),
+		"Expected %zu samples, got %u.", sizeof(expected), res.data->len);
+	fail_unless(!memcmp(res.data->data, expected, sizeof(expected)),
+		"Sample data mismatch.");
+	fail_unless(res.analog->len == ARRAY_SIZE(expected_analog),
+		"Expected %zu analog samples, got %u.",
+		ARRAY_SIZE(expected_analog), res.analog->len);
+	fail_unless(!memcmp(res.analog->data, expected_analog,
+		sizeof(expected_analog)), "Analog data mismatch.");
+
+	g_array_free(res.analog, TRUE);
+	g_byte_array_free(res.data, TRUE);
+}
+END_TEST
+
+/* Collect the sample data as a list of runs of identical values. */
+static void collect_runs(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct vcd_result *res;
+	const struct sr_datafeed_logic *logic;
+	const uint8_t *data;
+	uint64_t i, *run, new_run[2];
+
+	res = cb_data;
+	if (packet->type != SR_DF_LOGIC) {
+		datafeed_in(sdi, packet, cb_data);
+		return;
+	}
+
+	logic = packet->payload;
+	data = logic->data;
+	for (i = 0; i < logic->length; i++) {
+		run = NULL;
+		if (res->data->len > 0)
+			run = (uint64_t *)(res->data->data + res->data->len) - 2;
+		if (!run || run[0] != data[i]) {
+			new_run[0] = data[i];
+			new_run[1] = 0;
+			g_byte_array_append(res->data,
+				(const guint8 *)new_run, sizeof(new_run));
+			run = (uint64_t *)(res->data->data + res->data->len) - 2;
+		}
+		run[1]++;
+	}
+}
+
+/* Check that long idle periods get expanded to the exact sample count. */
+START_TEST(test_input_vcd_long_gap)
+{
+	static const char vcd[] =
+		"$timescale 1 ps $end\n"
+		"$var wire 1 ! a $end\n"
+		"$var wire 1 \" b $end\n"
+		"$enddefinitions $end\n"
+		"#0\n1!\n0\"\n"
+		"#5\n0!\n"
+		"#30000005\n1\"\n"
+		"#30000007\n";
+	static const uint64_t expected[][2] = {
+		{ 0x01, 5 }, { 0x00, 30000000 }, { 0x02, 2 },
+	};
+	struct vcd_result res;
+
+	memset(&res, 0, sizeof(res));
+	res.data = g_byte_array_new();
+
+	import_vcd(vcd, strlen(vcd), FEED_SIZE, collect_runs, &res);
+
+	fail_unless(res.ended, "No end packet received.");
+	fail_unless(res.data->len == sizeof(expected),
+		"Expected %zu runs, got %zu.", ARRAY_SIZE(expected),
+		res.data->len / sizeof(expected[0]));
+	fail_unless(!memcmp(res.data->data, expected, sizeof(expected)),
+		"Sample data mismatch.");
+
+	g_byte_array_free(res.data, TRUE);
+}
+END_TEST
+
+/* Identifier of the n-th signal, like simulators generate them. */
+static void append_identifier(GString *s, unsigned int n)
+{
+	while (TRUE) {
+		g_string_append_c(s, '!' + n % 94);
+		n /= 94;
+		if (!n)
+			break;
+		n--;
+	}
+}
+
+/*
+ * At each timestamp of the generated dump, one signal toggles. Sample
+ * k therefore has the levels after toggle k was applied.
+ */
+static void check_toggles(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct vcd_result *res;
+	const struct sr_datafeed_logic *logic;
+	const uint8_t *data;
+	uint64_t i;
+	unsigned int sig;
+
+	res = cb_data;
+	if (packet->type != SR_DF_LOGIC) {
+		datafeed_in(sdi, packet, cb_data);
+		return;
+	}
+
+	logic = packet->payload;
+	data = logic->data;
+	for (i = 0; i < logic->length; i += logic->unitsize) {
+		if (res->samples > 0) {
+			sig = res->samples % BENCH_SIGNALS;
+			res->levels[sig / 8] ^= 1 << (sig % 8);
+		}
+		if (memcmp(data + i, res->levels, logic->unitsize))
+			res->mismatch = TRUE;
+		res->samples++;
+	}
+}
+
+/*
+ * Import a dump with many signals and frequent changes, which is what
+ * simulators produce. This also serves as a throughput benchmark, run
+ * with G_MESSAGES_DEBUG=all to see the figures.
+ */
+static void check_many_signals(size_t feed_size)
+{
+	struct vcd_result res;
+	GString *vcd;
+	uint8_t *toggled;
+	unsigned int i, sig;
+	int64_t start, elapsed;
+
+	vcd = g_string_sized_new(32 * BENCH_CHANGES);
+	g_string_append(vcd, "$timescale 1 ns $end\n$scope module top $end\n");
+	for (i = 0; i < BENCH_SIGNALS; i++) {
+		g_string_append(vcd, "$var wire 1 ");
+		append_identifier(vcd, i);
+		g_string_append_printf(vcd, " s%u $end\n", i);
+	}
+	g_string_append(vcd, "$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n");
+	for (i = 0; i < BENCH_SIGNALS; i++) {
+		g_string_append_c(vcd, '0');
+		append_identifier(vcd, i);
+		g_string_append_c(vcd, '\n');
+	}
+	g_string_append(vcd, "$end\n");
+
+	toggled = g_malloc0(BENCH_SIGNALS);
+	for (i = 1; i <= BENCH_CHANGES; i++) {
+		sig = i % BENCH_SIGNALS;
+		toggled[sig] ^= 1;
+		g_string_append_printf(vcd, "#%u\n%c", i, '0' + toggled[sig]);
+		append_identifier(vcd, sig);
+		g_string_append_c(vcd, '\n');
+	}
+	g_string_append_printf(vcd, "#%u\n", BENCH_CHANGES + 1);
+	g_free(toggled);
+
+	memset(&res, 0, sizeof(res));
+	res.levels = g_malloc0((BENCH_SIGNALS + 7) / 8);
+
+	start = g_get_monotonic_time();
+	import_vcd(vcd->str, vcd->len, feed_size, check_toggles, &res);
+	elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+	g_debug("VCD import: %zu bytes in %zu byte pieces in %" PRId64
+		" us, %.1f MB/s.", vcd->len, MIN(feed_size, vcd->len), elapsed,
+		(double)vcd->len / elapsed);
+
+	fail_unless(res.ended, "No end packet received.");
+	fail_unless(res.unitsize == (BENCH_SIGNALS + 7) / 8,
+		"Wrong unit size %u.", res.unitsize);
+	fail_unless(res.samples == BENCH_CHANGES + 1,
+		"Expected %d samples, got %" PRIu64 ".",
+		BENCH_CHANGES + 1, res.samples);
+	fail_unless(!res.mismatch, "Sample data mismatch.");
+
+	g_free(res.levels);
+	g_string_free(vcd, TRUE);
+}
+
+START_TEST(test_input_vcd_many_signals)
+{
+	check_many_signals(FEED_SIZE);
+}
+END_TEST
+
+/* Large blocks of input get split up and tokenized on several threads. */
+START_TEST(test_input_vcd_many_signals_whole)
+{
+	check_many_signals(G_MAXSIZE);
+}
+END_TEST
+
+Suite *suite_input_vcd(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("input-vcd");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_input_vcd_basic);
+	tcase_add_test(tc, test_input_vcd_vectors);
+	tcase_add_test(tc, test_input_vcd_long_gap);
+	tcase_add_test(tc, test_input_vcd_many_signals);
+	tcase_add_test(tc, test_input_vcd_many_signals_whole);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -160,3 +160,53 @@ GArray *srtest_get_enabled_logic_channels(const struct sr_dev_inst *sdi)
 
 	return channels;
 }
+
+/* Output sink callback, appends the output to a GString. */
+int srtest_append_output(const uint8_t *data, size_t len, void *cb_data)
+{
+	g_string_append_len(cb_data, (const char *)data, len);
+
+	return SR_OK;
+}
+
+/* Create a user device with logic channels named D0, D1, ... */
+struct sr_dev_inst *srtest_new_device(unsigned int num_channels)
+{
+	struct sr_dev_inst *sdi;
+	unsigned int i;
+	gchar *name;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < num_channels; i++) {
+		name = g_strdup_printf("D%u", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+		g_free(name);
+	}
+
+	return sdi;
+}
+
+/* Set up a packet of float values in volts for the channels. */
+void srtest_analog_packet_init(struct srtest_analog_packet *ap,
+			       GSList *channels, const float *values,
+			       unsigned int count)
+{
+	memset(ap, 0, sizeof(*ap));
+	ap->encoding.unitsize = sizeof(float);
+	ap->encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	ap->encoding.is_bigendian = TRUE;
+#endif
+	ap->encoding.scale.p = ap->encoding.scale.q = 1;
+	ap->encoding.offset.q = 1;
+	ap->meaning.mq = SR_MQ_VOLTAGE;
+	ap->meaning.unit = SR_UNIT_VOLT;
+	ap->meaning.channels = channels;
+	ap->analog.data = (void *)values;
+	ap->analog.num_samples = count;
+	ap->analog.encoding = &ap->encoding;
+	ap->analog.meaning = &ap->meaning;
+	ap->analog.spec = &ap->spec;
+	ap->packet.type = SR_DF_ANALOG;
+	ap->packet.payload = &ap->analog;
+}
@@ -41,11 +41,37 @@ void srtest_check_samplerate(struct sr_context *sr_ctx, const char *drivername,
 
 GArray *srtest_get_enabled_logic_channels(const struct sr_dev_inst *sdi);
 
+int srtest_append_output(const uint8_t *data, size_t len, void *cb_data);
+struct sr_dev_inst *srtest_new_device(unsigned int num_channels);
+
+/*
+ * An analog packet with float values, and everything it refers to.
+ * The packet takes the list of channels, free it when done.
+ */
+struct srtest_analog_packet {
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+};
+
+void srtest_analog_packet_init(struct srtest_analog_packet *ap,
+			       GSList *channels, const float *values,
+			       unsigned int count);
+
 Suite *suite_core(void);
 Suite *suite_driver_all(void);
+Suite *suite_driver_beaglelogic(void);
 Suite *suite_input_all(void);
 Suite *suite_input_binary(void);
+Suite *suite_input_csv(void);
+Suite *suite_input_trace32_ad(void);
+Suite *suite_input_vcd(void);
 Suite *suite_output_all(void);
+Suite *suite_output_srzip(void);
+Suite *suite_output_text(void);
+Suite *suite_output_wav(void);
 Suite *suite_transform_all(void);
 Suite *suite_session(void);
 Suite *suite_strutil(void);
@@ -35,9 +35,16 @@ int main(void)
 	/* Add all testsuites to the master suite. */
 	srunner_add_suite(srunner, suite_core());
 	srunner_add_suite(srunner, suite_driver_all());
+	srunner_add_suite(srunner, suite_driver_beaglelogic());
 	srunner_add_suite(srunner, suite_input_all());
 	srunner_add_suite(srunner, suite_input_binary());
+	srunner_add_suite(srunner, suite_input_csv());
+	srunner_add_suite(srunner, suite_input_trace32_ad());
+	srunner_add_suite(srunner, suite_input_vcd());
 	srunner_add_suite(srunner, suite_output_all());
+	srunner_add_suite(srunner, suite_output_srzip());
+	srunner_add_suite(srunner, suite_output_text());
+	srunner_add_suite(srunner, suite_output_wav());
 	srunner_add_suite(srunner, suite_transform_all());
 	srunner_add_suite(srunner, suite_session());
 	srunner_add_suite(srunner, suite_strutil());
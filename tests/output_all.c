@@ -19,6 +19,9 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -96,6 +99,322 @@ START_TEST(test_output_options)
 }
 END_TEST
 
+/* Check that sinks receive the same output as sr_output_send() returns. */
+START_TEST(test_output_sink)
+{
+	static const char *ids[] = { "bits", "hex", "ascii", "binary", NULL };
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_output_sink *sink;
+	struct sr_datafeed_packet packets[4];
+	struct sr_datafeed_logic logic;
+	GString *expected, *out, *text;
+	uint8_t data[4096];
+	gchar *path, *contents;
+	gsize len;
+	unsigned int i, p;
+	int fd, ret;
+
+	sdi = srtest_new_device(8);
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = (i * 7) ^ (i >> 5);
+	logic.length = sizeof(data);
+	logic.unitsize = 1;
+	logic.data = data;
+	packets[0].type = SR_DF_LOGIC;
+	packets[0].payload = &logic;
+	packets[1].type = SR_DF_TRIGGER;
+	packets[1].payload = NULL;
+	packets[2].type = SR_DF_LOGIC;
+	packets[2].payload = &logic;
+	packets[3].type = SR_DF_END;
+	packets[3].payload = NULL;
+
+	for (i = 0; ids[i]; i++) {
+		expected = g_string_new(NULL);
+		o = sr_output_new(sr_output_find((char *)ids[i]), NULL, sdi, NULL);
+		fail_unless(o != NULL, "Failed to create '%s' output.", ids[i]);
+		for (p = 0; p < G_N_ELEMENTS(packets); p++) {
+			out = NULL;
+			ret = sr_output_send(o, &packets[p], &out);
+			fail_unless(ret == SR_OK, "Failed to send packet.");
+			if (out) {
+				g_string_append_len(expected, out->str, out->len);
+				g_string_free(out, TRUE);
+			}
+		}
+		sr_output_free(o);
+		fail_unless(expected->len > 0, "No '%s' output.", ids[i]);
+
+		/* Write to a callback. */
+		text = g_string_new(NULL);
+		sink = sr_output_sink_new_callback(srtest_append_output, text);
+		o = sr_output_new(sr_output_find((char *)ids[i]), NULL, sdi, NULL);
+		for (p = 0; p < G_N_ELEMENTS(packets); p++) {
+			ret = sr_output_send_sink(o, &packets[p], sink);
+			fail_unless(ret == SR_OK, "Failed to send packet to sink.");
+		}
+		sr_output_free(o);
+		ret = sr_output_sink_free(sink);
+		fail_unless(ret == SR_OK, "Failed to flush sink.");
+		fail_unless(g_string_equal(expected, text),
+			"Callback sink output of '%s' differs.", ids[i]);
+		g_string_free(text, TRUE);
+
+		/* Write to a file descriptor. */
+		fd = g_file_open_tmp("sigrok-output-XXXXXX", &path, NULL);
+		fail_unless(fd >= 0, "Failed to create temporary file.");
+		sink = sr_output_sink_new_fd(fd);
+		o = sr_output_new(sr_output_find((char *)ids[i]), NULL, sdi, NULL);
+		for (p = 0; p < G_N_ELEMENTS(packets); p++) {
+			ret = sr_output_send_sink(o, &packets[p], sink);
+			fail_unless(ret == SR_OK, "Failed to send packet to sink.");
+		}
+		sr_output_free(o);
+		ret = sr_output_sink_free(sink);
+		fail_unless(ret == SR_OK, "Failed to flush sink.");
+		close(fd);
+		fail_unless(g_file_get_contents(path, &contents, &len, NULL),
+			"Failed to read output file.");
+		fail_unless(len == expected->len
+			&& !memcmp(contents, expected->str, len),
+			"File sink output of '%s' differs.", ids[i]);
+		g_unlink(path);
+		g_free(contents);
+		g_free(path);
+
+		g_string_free(expected, TRUE);
+	}
+}
+END_TEST
+
+/* Check that VCD output only contains the changes of signals. */
+START_TEST(test_output_vcd_changes)
+{
+	static const uint8_t samples[] = { 0x0, 0x0, 0x1, 0x1, 0x3, 0x3, 0x3, 0x2 };
+	static const char expected[] =
+		"#0 0! 0\" 0# 0$\n#2 1!\n#4 1\"\n#7 0!\n#8\n";
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_datafeed_logic logic;
+	struct sr_config src;
+	GString *text, *out;
+	const char *body;
+	unsigned int i;
+
+	sdi = srtest_new_device(4);
+	o = sr_output_new(sr_output_find("vcd"), NULL, sdi, NULL);
+	fail_unless(o != NULL, "Failed to create 'vcd' output.");
+	text = g_string_new(NULL);
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_ref_sink(g_variant_new_uint64(SR_MHZ(1)));
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	sr_output_send(o, &packet, &out);
+
+	/* Split the samples across packets. */
+	logic.unitsize = 1;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	for (i = 0; i < sizeof(samples); i += 3) {
+		logic.data = (void *)&samples[i];
+		logic.length = MIN(sizeof(samples) - i, 3);
+		sr_output_send(o, &packet, &out);
+		if (out) {
+			g_string_append_len(text, out->str, out->len);
+			g_string_free(out, TRUE);
+		}
+	}
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	sr_output_send(o, &packet, &out);
+	fail_unless(out != NULL, "No output for the end packet.");
+	g_string_append_len(text, out->str, out->len);
+	g_string_free(out, TRUE);
+	sr_output_free(o);
+
+	body = strstr(text->str, "$enddefinitions $end\n");
+	fail_unless(body != NULL, "No VCD header found.");
+	body += strlen("$enddefinitions $end\n");
+	fail_unless(!strcmp(body, expected), "Unexpected VCD body '%s'.", body);
+
+	g_string_free(text, TRUE);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+}
+END_TEST
+
+static uint32_t read_u32(const char *p)
+{
+	uint32_t value;
+
+	memcpy(&value, p, sizeof(value));
+
+	return GUINT32_FROM_LE(value);
+}
+
+static uint64_t read_u64(const char *p)
+{
+	return read_u32(p) | (uint64_t)read_u32(p + 4) << 32;
+}
+
+static float read_float(const char *p)
+{
+	uint32_t value;
+	float f;
+
+	value = read_u32(p);
+	memcpy(&f, &value, sizeof(f));
+
+	return f;
+}
+
+/* Check the columnar output's layout, index and meta. */
+START_TEST(test_output_columnar)
+{
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_output_sink *sink;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_datafeed_logic logic;
+	struct srtest_analog_packet ap;
+	struct sr_config src;
+	GHashTable *options;
+	GString *text;
+	uint8_t samples[20];
+	float values[20];
+	const char *p, *group, *chunk;
+	unsigned int i, count, column;
+	int ret;
+
+	sdi = srtest_new_device(4);
+	sr_dev_inst_channel_add(sdi, 4, SR_CHANNEL_ANALOG, "A0");
+	sr_dev_channel_enable(g_slist_nth_data(sr_dev_inst_channels_get(sdi), 1),
+		FALSE);
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("rows"),
+		g_variant_ref_sink(g_variant_new_uint32(8)));
+	text = g_string_new(NULL);
+	sink = sr_output_sink_new_callback(srtest_append_output, text);
+	o = sr_output_new(sr_output_find("columnar"), options, sdi, NULL);
+	fail_unless(o != NULL, "Failed to create 'columnar' output.");
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_ref_sink(g_variant_new_uint64(SR_MHZ(1)));
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	ret = sr_output_send_sink(o, &packet, sink);
+	fail_unless(ret == SR_OK, "Failed to send meta packet.");
+
+	for (i = 0; i < G_N_ELEMENTS(samples); i++) {
+		samples[i] = i;
+		values[i] = i * 0.5;
+	}
+	logic.unitsize = 1;
+	logic.data = samples;
+	logic.length = 12;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	ret = sr_output_send_sink(o, &packet, sink);
+	fail_unless(ret == SR_OK, "Failed to send logic packet.");
+	packet.type = SR_DF_TRIGGER;
+	packet.payload = NULL;
+	ret = sr_output_send_sink(o, &packet, sink);
+	fail_unless(ret == SR_OK, "Failed to send trigger packet.");
+	logic.data = samples + 12;
+	logic.length = 8;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	ret = sr_output_send_sink(o, &packet, sink);
+	fail_unless(ret == SR_OK, "Failed to send logic packet.");
+
+	srtest_analog_packet_init(&ap, g_slist_append(NULL,
+		g_slist_nth_data(sr_dev_inst_channels_get(sdi), 4)),
+		values, G_N_ELEMENTS(values));
+	ret = sr_output_send_sink(o, &ap.packet, sink);
+	fail_unless(ret == SR_OK, "Failed to send analog packet.");
+
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	ret = sr_output_send_sink(o, &packet, sink);
+	fail_unless(ret == SR_OK, "Failed to send end packet.");
+	sr_output_free(o);
+	ret = sr_output_sink_free(sink);
+	fail_unless(ret == SR_OK, "Failed to flush sink.");
+
+	fail_unless(text->len > 32 && !memcmp(text->str, "SRCOLUMN", 8)
+		&& !memcmp(text->str + text->len - 8, "SRCOLUMN", 8),
+		"No columnar header or trailer.");
+	p = text->str + read_u64(text->str + text->len - 16);
+
+	/* String dictionary. */
+	count = read_u32(p);
+	p += 4;
+	for (i = 0; i < count; i++)
+		p += 4 + read_u32(p);
+	fail_unless(read_u64(p) == SR_MHZ(1), "Wrong samplerate.");
+	fail_unless(read_u32(p + 8) == 8, "Wrong row group size.");
+
+	/* D0, D2, D3 and A0. */
+	fail_unless(read_u32(p + 12) == 4, "Wrong number of columns.");
+	fail_unless(read_u32(p + 16 + 3 * 16) == 1, "A0 is not a float column.");
+	p += 16 + 4 * 16;
+
+	fail_unless(read_u32(p) == 3, "Wrong number of row groups.");
+	p += 4;
+	for (i = 0; i < 3; i++) {
+		group = p + i * (24 + 4 * 32);
+		fail_unless(read_u64(group) == i * 8, "Wrong first sample.");
+		fail_unless(read_u32(group + 16) == (i < 2 ? 8 : 4),
+			"Wrong number of rows.");
+		for (column = 0; column < 4; column++) {
+			chunk = group + 24 + column * 32;
+			fail_unless(read_u64(chunk) % 8 == 0, "Unaligned chunk.");
+			fail_unless(read_u32(chunk + 16) == (i < 2 ? 8 : 4),
+				"Wrong chunk sample count.");
+		}
+	}
+
+	/* D2 of the first row group, samples 0 to 7. */
+	chunk = p + 24 + 1 * 32;
+	fail_unless((uint8_t)text->str[read_u64(chunk)] == 0xf0,
+		"Wrong bits of D2.");
+	fail_unless(read_float(chunk + 24) == 0 && read_float(chunk + 28) == 1,
+		"Wrong range of D2.");
+
+	/* A0 of the second row group, samples 8 to 15. */
+	chunk = p + (24 + 4 * 32) + 24 + 3 * 32;
+	fail_unless(read_u32(chunk + 20) == 8 * sizeof(float),
+		"Wrong size of A0.");
+	for (i = 0; i < 8; i++)
+		fail_unless(read_float(text->str + read_u64(chunk) + i * 4)
+			== values[8 + i], "Wrong value of A0.");
+	fail_unless(read_float(chunk + 24) == 4 && read_float(chunk + 28) == 7.5,
+		"Wrong range of A0.");
+	p += 3 * (24 + 4 * 32);
+
+	/* The samplerate, and the trigger after sample 12. */
+	fail_unless(read_u32(p) == 2, "Wrong number of meta entries.");
+	fail_unless(read_u64(p + 4) == 0, "Wrong meta position.");
+	fail_unless(read_u64(p + 4 + 16) == 12, "Wrong trigger position.");
+
+	g_slist_free(ap.meaning.channels);
+	g_string_free(text, TRUE);
+	g_hash_table_destroy(options);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+}
+END_TEST
+
 Suite *suite_output_all(void)
 {
 	Suite *s;
@@ -110,6 +429,9 @@ Suite *suite_output_all(void)
 	tcase_add_test(tc, test_output_desc);
 	tcase_add_test(tc, test_output_find);
 	tcase_add_test(tc, test_output_options);
+	tcase_add_test(tc, test_output_sink);
+	tcase_add_test(tc, test_output_vcd_changes);
+	tcase_add_test(tc, test_output_columnar);
 	suite_add_tcase(s, tc);
 
 	return s;
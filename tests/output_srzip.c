@@ -0,0 +1,250 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <check.h>
+#include <glib/gstdio.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#define SAMPLERATE	SR_MHZ(1)
+
+/*
+ * Sample counts of the saved chunks. None is a multiple of the eight
+ * samples the "xor-bitplane" filter works on, and the last chunk also
+ * ends in a partial sample.
+ */
+static const unsigned int chunk_samples[] = { 1, 8 * 37 + 5, 8 * 1000 + 3 };
+
+struct srzip_result {
+	GByteArray *data;
+	gboolean ended;
+};
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct srzip_result *res;
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+
+	res = cb_data;
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		g_byte_array_append(res->data, logic->data, logic->length);
+		break;
+	case SR_DF_END:
+		res->ended = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+static void send_meta(const struct sr_output *o)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_config src;
+	GString *out;
+	int ret;
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_ref_sink(g_variant_new_uint64(SAMPLERATE));
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	ret = sr_output_send(o, &packet, &out);
+	fail_unless(ret == SR_OK, "Failed to send meta packet.");
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+}
+
+/*
+ * Save the chunks of samples into an srzip file. Each chunk becomes a
+ * capture file of its own, and gets filtered on its own.
+ */
+static GByteArray *save_chunks(const char *filename, const char *filter,
+	unsigned int unitsize, unsigned int partial)
+{
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	GHashTable *options;
+	GByteArray *data;
+	GString *out;
+	size_t pos, length;
+	unsigned int i;
+	int ret;
+
+	sdi = srtest_new_device(8 * unitsize);
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("filter"),
+		g_variant_ref_sink(g_variant_new_string(filter)));
+	o = sr_output_new(sr_output_find("srzip"), options, sdi, filename);
+	fail_unless(o != NULL, "Failed to create '%s' srzip output.", filter);
+	g_hash_table_destroy(options);
+
+	send_meta(o);
+
+	/* Random samples, with runs of equal ones in between. */
+	data = g_byte_array_new();
+	for (i = 0; i < G_N_ELEMENTS(chunk_samples); i++) {
+		length = chunk_samples[i] * unitsize;
+		if (i == G_N_ELEMENTS(chunk_samples) - 1)
+			length += partial;
+		pos = data->len;
+		g_byte_array_set_size(data, pos + length);
+		for (; pos < data->len; pos++) {
+			if (pos >= unitsize && (pos / unitsize / 16) % 2)
+				data->data[pos] = data->data[pos - unitsize];
+			else
+				data->data[pos] = g_random_int();
+		}
+
+		logic.length = length;
+		logic.unitsize = unitsize;
+		logic.data = data->data + data->len - length;
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		ret = sr_output_send(o, &packet, &out);
+		fail_unless(ret == SR_OK, "Failed to save chunk %u.", i);
+	}
+
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	ret = sr_output_send(o, &packet, &out);
+	fail_unless(ret == SR_OK, "Failed to send end packet.");
+
+	sr_output_free(o);
+
+	return data;
+}
+
+static void load_session(const char *filename, struct srzip_result *res)
+{
+	struct sr_session *session;
+	int ret;
+
+	res->data = g_byte_array_new();
+	res->ended = FALSE;
+
+	ret = sr_session_load(srtest_ctx, filename, &session);
+	fail_unless(ret == SR_OK, "sr_session_load() error: %d", ret);
+	sr_session_datafeed_callback_add(session, datafeed_in, res);
+	ret = sr_session_start(session);
+	fail_unless(ret == SR_OK, "sr_session_start() error: %d", ret);
+	ret = sr_session_run(session);
+	fail_unless(ret == SR_OK, "sr_session_run() error: %d", ret);
+	fail_unless(res->ended, "No end packet received.");
+	sr_session_destroy(session);
+}
+
+static void check_roundtrip(const char *filter, unsigned int unitsize,
+	unsigned int partial)
+{
+	struct srzip_result res;
+	GByteArray *data;
+	char *filename;
+	int fd;
+
+	fd = g_file_open_tmp("sigrok-test-XXXXXX.sr", &filename, NULL);
+	fail_unless(fd >= 0, "Failed to create temporary file.");
+	g_close(fd, NULL);
+
+	data = save_chunks(filename, filter, unitsize, partial);
+	load_session(filename, &res);
+	fail_unless(res.data->len == data->len,
+		"Expected %u bytes, got %u (%s, unit size %u, partial %u).",
+		data->len, res.data->len, filter, unitsize, partial);
+	fail_unless(!memcmp(res.data->data, data->data, data->len),
+		"Sample data mismatch (%s, unit size %u, partial %u).",
+		filter, unitsize, partial);
+
+	g_byte_array_free(res.data, TRUE);
+	g_byte_array_free(data, TRUE);
+	g_unlink(filename);
+	g_free(filename);
+}
+
+/* Check that unfiltered data loads back as it was saved. */
+START_TEST(test_output_srzip_roundtrip)
+{
+	unsigned int unitsize;
+
+	for (unitsize = 1; unitsize <= 3; unitsize++)
+		check_roundtrip("none", unitsize, 0);
+}
+END_TEST
+
+/*
+ * Check that the "xor-bitplane" filter gets undone when loading, for
+ * whole and partial blocks of eight samples, and a partial last sample.
+ */
+START_TEST(test_output_srzip_filter)
+{
+	unsigned int unitsize, partial;
+
+	for (unitsize = 1; unitsize <= 3; unitsize++) {
+		for (partial = 0; partial < unitsize; partial++)
+			check_roundtrip("xor-bitplane", unitsize, partial);
+	}
+}
+END_TEST
+
+/* Check that an unknown filter gets rejected. */
+START_TEST(test_output_srzip_filter_unknown)
+{
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	GHashTable *options;
+
+	sdi = srtest_new_device(8);
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("filter"),
+		g_variant_ref_sink(g_variant_new_string("xor")));
+	o = sr_output_new(sr_output_find("srzip"), options, sdi,
+		"sigrok-test.sr");
+	fail_unless(o == NULL, "Unknown filter accepted.");
+	g_hash_table_destroy(options);
+}
+END_TEST
+
+Suite *suite_output_srzip(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("output-srzip");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_output_srzip_roundtrip);
+	tcase_add_test(tc, test_output_srzip_filter);
+	tcase_add_test(tc, test_output_srzip_filter_unknown);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
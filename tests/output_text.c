@@ -0,0 +1,541 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/* Number of samples in the generated capture. */
+#define BENCH_SAMPLES	(1024 * 1024)
+
+/* Size of the logic packets, like a driver sending its transfers. */
+#define PACKET_SIZE	(64 * 1024)
+
+/*
+ * Run the samples through an output module, in packets of the given
+ * size with a trigger before the second packet, and return the text.
+ */
+static GString *format_samples(const char *id, GHashTable *options,
+	struct sr_dev_inst *sdi, const uint8_t *data, size_t length,
+	unsigned int unitsize, size_t packet_size)
+{
+	const struct sr_output *o;
+	struct sr_output_sink *sink;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	GString *text;
+	size_t pos;
+	int ret;
+
+	text = g_string_new(NULL);
+	sink = sr_output_sink_new_callback(srtest_append_output, text);
+	o = sr_output_new(sr_output_find((char *)id), options, sdi, NULL);
+	fail_unless(o != NULL, "Failed to create '%s' output.", id);
+
+	for (pos = 0; pos < length; pos += logic.length) {
+		if (pos == packet_size) {
+			packet.type = SR_DF_TRIGGER;
+			packet.payload = NULL;
+			sr_output_send_sink(o, &packet, sink);
+		}
+		logic.length = MIN(length - pos, packet_size);
+		logic.unitsize = unitsize;
+		logic.data = (uint8_t *)data + pos;
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		ret = sr_output_send_sink(o, &packet, sink);
+		fail_unless(ret == SR_OK, "Failed to send packet to '%s'.", id);
+	}
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	ret = sr_output_send_sink(o, &packet, sink);
+	fail_unless(ret == SR_OK, "Failed to send end packet to '%s'.", id);
+
+	sr_output_free(o);
+	ret = sr_output_sink_free(sink);
+	fail_unless(ret == SR_OK, "Failed to flush sink.");
+
+	return text;
+}
+
+static GHashTable *width_option(uint32_t width)
+{
+	GHashTable *options;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("width"),
+		g_variant_ref_sink(g_variant_new_uint32(width)));
+
+	return options;
+}
+
+/* Skip the header, which starts with the program's version. */
+static const char *skip_lines(const GString *text, unsigned int count)
+{
+	const char *p;
+
+	p = text->str;
+	while (count-- && (p = strchr(p, '\n')))
+		p++;
+	fail_unless(p != NULL, "Output is too short.");
+
+	return p;
+}
+
+/* Check the text of a small capture, with lines and a trigger. */
+START_TEST(test_output_text_lines)
+{
+	static const uint8_t data[] = {
+		0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x00, 0x05, 0x02,
+	};
+	static const struct {
+		const char *id;
+		const char *expected;
+	} checks[] = {
+		{ "bits",
+		"D0:10101010\n"
+		"D1:01100110\n"
+		"D2:00011110\n"
+		"T:    ^ 4\n"
+		"D0:10\n"
+		"D1:01\n"
+		"D2:10\n" },
+		{ "hex",
+		"D0:aa \n"
+		"D1:66 \n"
+		"D2:1e \n"
+		"T: ^ 4\n"
+		"D0:80 \n"
+		"D1:40 \n"
+		"D2:80 \n" },
+		{ "ascii",
+		"D0:\"\\/\\/\\/\\\n"
+		"D1:./\"\\./\"\\\n"
+		"D2:.../\"\"\"\\\n"
+		"T:    ^ 4\n"
+		"D0:\"\\\n"
+		"D1:./\n"
+		"D2:\"\\\n" },
+	};
+	struct sr_dev_inst *sdi;
+	GHashTable *options;
+	GString *text;
+	unsigned int i;
+
+	sdi = srtest_new_device(3);
+	options = width_option(8);
+
+	for (i = 0; i < G_N_ELEMENTS(checks); i++) {
+		text = format_samples(checks[i].id, options, sdi,
+			data, sizeof(data), 1, 4);
+		fail_unless(!strcmp(skip_lines(text, 2), checks[i].expected),
+			"Unexpected '%s' output:\n%s", checks[i].id, text->str);
+		g_string_free(text, TRUE);
+	}
+
+	g_hash_table_destroy(options);
+}
+END_TEST
+
+/* Check the OLS text, which has one line per sample. */
+START_TEST(test_output_text_ols)
+{
+	static const uint8_t data[] = {
+		0x34, 0x12, 0xcd, 0xab, 0x00, 0x00, 0xff, 0x0f,
+	};
+	static const char expected[] =
+		"1234@0\n"
+		"abcd@1\n"
+		"0000@2\n"
+		"0fff@3\n";
+	struct sr_dev_inst *sdi;
+	GString *text;
+	uint8_t *many;
+
+	sdi = srtest_new_device(12);
+
+	text = format_samples("ols", NULL, sdi, data, sizeof(data), 2, 2);
+	fail_unless(g_str_has_prefix(text->str, ";Rate: "),
+		"OLS header is missing.");
+	fail_unless(!strcmp(skip_lines(text, 5), expected),
+		"Unexpected 'ols' output:\n%s", text->str);
+	g_string_free(text, TRUE);
+
+	/* The sample numbers count on across packets and digits. */
+	many = g_malloc0(1001);
+	text = format_samples("ols", NULL, sdi, many, 1001, 1, 7);
+	fail_unless(strstr(text->str, "\n00@9\n00@10\n") != NULL,
+		"Wrong sample numbers 9 and 10.");
+	fail_unless(strstr(text->str, "\n00@99\n00@100\n") != NULL,
+		"Wrong sample numbers 99 and 100.");
+	fail_unless(g_str_has_suffix(text->str, "\n00@999\n00@1000\n"),
+		"Wrong sample numbers 999 and 1000.");
+	g_string_free(text, TRUE);
+	g_free(many);
+}
+END_TEST
+
+static void send_analog(const struct sr_output *o, struct sr_output_sink *sink,
+	struct sr_channel *ch, const float *values, unsigned int count)
+{
+	struct srtest_analog_packet ap;
+	int ret;
+
+	srtest_analog_packet_init(&ap, g_slist_append(NULL, ch), values, count);
+	ret = sr_output_send_sink(o, &ap.packet, sink);
+	fail_unless(ret == SR_OK, "Failed to send analog packet.");
+	g_slist_free(ap.meaning.channels);
+}
+
+static void send_logic(const struct sr_output *o, struct sr_output_sink *sink,
+	const uint8_t *data, unsigned int count)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	int ret;
+
+	logic.length = count;
+	logic.unitsize = 1;
+	logic.data = (void *)data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	ret = sr_output_send_sink(o, &packet, sink);
+	fail_unless(ret == SR_OK, "Failed to send logic packet.");
+}
+
+/* Check that CSV rows line up channels which arrive in different packets. */
+START_TEST(test_output_text_csv_mixed)
+{
+	static const uint8_t logic1[] = { 1, 0, 1 };
+	static const uint8_t logic2[] = { 0, 1, 1 };
+	static const float analog1[] = { 0.5, -1.25 };
+	static const float analog2[] = { 2e-5, 1234567, 100 };
+	static const char expected[] =
+		"1,0.5\n"
+		"0,-1.25\n"
+		"1,2e-05\n"
+		"0,1.23457e+06\n"
+		"1,100\n"
+		"1,\n";
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_output_sink *sink;
+	struct sr_datafeed_packet packet;
+	GHashTable *options;
+	GString *text;
+	int ret;
+
+	sdi = srtest_new_device(1);
+	sr_dev_inst_channel_add(sdi, 1, SR_CHANNEL_ANALOG, "A0");
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("header"),
+		g_variant_ref_sink(g_variant_new_boolean(FALSE)));
+	g_hash_table_insert(options, g_strdup("label"),
+		g_variant_ref_sink(g_variant_new_string("off")));
+	g_hash_table_insert(options, g_strdup("time"),
+		g_variant_ref_sink(g_variant_new_boolean(FALSE)));
+
+	text = g_string_new(NULL);
+	sink = sr_output_sink_new_callback(srtest_append_output, text);
+	o = sr_output_new(sr_output_find("csv"), options, sdi, NULL);
+	fail_unless(o != NULL, "Failed to create 'csv' output.");
+
+	send_logic(o, sink, logic1, G_N_ELEMENTS(logic1));
+	send_analog(o, sink, g_slist_nth_data(sr_dev_inst_channels_get(sdi), 1),
+		analog1, G_N_ELEMENTS(analog1));
+	send_logic(o, sink, logic2, G_N_ELEMENTS(logic2));
+	send_analog(o, sink, g_slist_nth_data(sr_dev_inst_channels_get(sdi), 1),
+		analog2, G_N_ELEMENTS(analog2));
+	/* The last logic sample has no analog value, it's written at the end. */
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	ret = sr_output_send_sink(o, &packet, sink);
+	fail_unless(ret == SR_OK, "Failed to send end packet.");
+
+	sr_output_free(o);
+	ret = sr_output_sink_free(sink);
+	fail_unless(ret == SR_OK, "Failed to flush sink.");
+	fail_unless(!strcmp(text->str, expected),
+		"Unexpected 'csv' output:\n%s", text->str);
+
+	g_string_free(text, TRUE);
+	g_hash_table_destroy(options);
+}
+END_TEST
+
+/* Check the analog output, with one line per value and in columns. */
+START_TEST(test_output_text_analog)
+{
+	static const float values[] = { 0.5, -1.25, 2e-5, 1234567, 100 };
+	static const char *layouts[] = { "lines", "columns", NULL };
+	static const char *expected[] = {
+		"A0: 0 V\n"
+		"A0: -1 V\n"
+		"A0: 0 V\n"
+		"A0: 1.234567 MV\n"
+		"A0: 100 V\n",
+		"# A0 [V]\n"
+		"0.5\n"
+		"-1.25\n"
+		"2e-05\n"
+		"1234567\n"
+		"100\n",
+	};
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_output_sink *sink;
+	GHashTable *options;
+	GString *text;
+	unsigned int i;
+	int ret;
+
+	sdi = srtest_new_device(0);
+	sr_dev_inst_channel_add(sdi, 0, SR_CHANNEL_ANALOG, "A0");
+
+	for (i = 0; layouts[i]; i++) {
+		options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+		g_hash_table_insert(options, g_strdup("layout"),
+			g_variant_ref_sink(g_variant_new_string(layouts[i])));
+
+		text = g_string_new(NULL);
+		sink = sr_output_sink_new_callback(srtest_append_output, text);
+		o = sr_output_new(sr_output_find("analog"), options, sdi, NULL);
+		fail_unless(o != NULL, "Failed to create 'analog' output.");
+
+		/* The column heading is only repeated when it changes. */
+		send_analog(o, sink, sr_dev_inst_channels_get(sdi)->data,
+			values, 2);
+		send_analog(o, sink, sr_dev_inst_channels_get(sdi)->data,
+			values + 2, G_N_ELEMENTS(values) - 2);
+
+		sr_output_free(o);
+		ret = sr_output_sink_free(sink);
+		fail_unless(ret == SR_OK, "Failed to flush sink.");
+		fail_unless(!strcmp(text->str, expected[i]),
+			"Unexpected '%s' analog output:\n%s", layouts[i],
+			text->str);
+
+		g_string_free(text, TRUE);
+		g_hash_table_destroy(options);
+	}
+}
+END_TEST
+
+/*
+ * Format many samples of 16 channels. This also serves as a throughput
+ * benchmark, run with G_MESSAGES_DEBUG=all to see the figures.
+ */
+START_TEST(test_output_text_many_samples)
+{
+	static const char *ids[] = { "bits", "hex", "ascii", "ols", "csv", NULL };
+	struct sr_dev_inst *sdi;
+	GHashTable *options;
+	GString *text;
+	uint8_t *data;
+	unsigned int i;
+	int64_t start, elapsed;
+
+	sdi = srtest_new_device(16);
+	options = width_option(64);
+
+	data = g_malloc(2 * BENCH_SAMPLES);
+	for (i = 0; i < 2 * BENCH_SAMPLES; i++)
+		data[i] = (i * 7) ^ (i >> 5);
+
+	for (i = 0; ids[i]; i++) {
+		start = g_get_monotonic_time();
+		text = format_samples(ids[i], i < 3 ? options : NULL, sdi,
+			data, 2 * BENCH_SAMPLES, 2, PACKET_SIZE);
+		elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+		g_debug("Output '%s': %d samples in %" PRId64 " us, "
+			"%.1f Msamples/s, %.1f MB/s.", ids[i], BENCH_SAMPLES,
+			elapsed, (double)BENCH_SAMPLES / elapsed,
+			(double)text->len / elapsed);
+
+		fail_unless(text->len > 2 * BENCH_SAMPLES,
+			"Too little '%s' output.", ids[i]);
+		g_string_free(text, TRUE);
+	}
+
+	g_free(data);
+	g_hash_table_destroy(options);
+}
+END_TEST
+
+/* Outputs of the fan-out test, the first two share a sink. */
+static const char *fanout_ids[] = { "csv", "analog", "bits", "hex", NULL };
+#define FANOUT_SINKS	3
+
+/*
+ * Send the packets to the outputs, through a fan-out or one output
+ * after another, and return the text of each sink.
+ */
+static void fanout_run(struct sr_dev_inst *sdi, gboolean fanout,
+	struct sr_datafeed_packet **packets, GString **texts)
+{
+	const struct sr_output *o[G_N_ELEMENTS(fanout_ids)];
+	struct sr_output_sink *sinks[FANOUT_SINKS];
+	struct sr_output_sink *sink_of[G_N_ELEMENTS(fanout_ids)];
+	struct sr_output_fanout *fo;
+	GHashTable *options;
+	unsigned int i, n;
+	int ret;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("header"),
+		g_variant_ref_sink(g_variant_new_boolean(FALSE)));
+
+	for (i = 0; i < FANOUT_SINKS; i++) {
+		texts[i] = g_string_new(NULL);
+		sinks[i] = sr_output_sink_new_callback(srtest_append_output,
+			texts[i]);
+	}
+
+	/* Worker threads also on machines with a single processor. */
+	fo = fanout ? sr_output_fanout_new(4) : NULL;
+	for (i = 0; fanout_ids[i]; i++) {
+		o[i] = sr_output_new(sr_output_find((char *)fanout_ids[i]),
+			i == 0 ? options : NULL, sdi, NULL);
+		fail_unless(o[i] != NULL, "Failed to create '%s' output.",
+			fanout_ids[i]);
+		sink_of[i] = sinks[MAX(i, 1) - 1];
+		if (fo) {
+			ret = sr_output_fanout_add(fo, o[i], sink_of[i]);
+			fail_unless(ret == SR_OK, "Failed to add '%s' output.",
+				fanout_ids[i]);
+		}
+	}
+
+	for (n = 0; packets[n]; n++) {
+		if (fo) {
+			ret = sr_output_fanout_send(fo, packets[n]);
+			fail_unless(ret == SR_OK, "Failed to send packet %u.", n);
+			continue;
+		}
+		for (i = 0; fanout_ids[i]; i++) {
+			ret = sr_output_send_sink(o[i], packets[n], sink_of[i]);
+			fail_unless(ret == SR_OK, "Failed to send packet %u.", n);
+		}
+	}
+
+	if (fo) {
+		ret = sr_output_fanout_free(fo);
+		fail_unless(ret == SR_OK, "Failed to free fan-out.");
+	}
+	for (i = 0; fanout_ids[i]; i++)
+		sr_output_free(o[i]);
+	for (i = 0; i < FANOUT_SINKS; i++) {
+		ret = sr_output_sink_free(sinks[i]);
+		fail_unless(ret == SR_OK, "Failed to flush sink.");
+	}
+	g_hash_table_destroy(options);
+}
+
+/*
+ * Check that outputs in a fan-out write what they write on their own,
+ * also with packets which are large enough to run them in parallel.
+ */
+START_TEST(test_output_text_fanout)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet *packets[10], logic_packets[4], end;
+	struct sr_datafeed_logic logic[4];
+	struct srtest_analog_packet ap[4];
+	GSList *analog_channels;
+	GString *expected[FANOUT_SINKS], *texts[FANOUT_SINKS];
+	uint8_t *data;
+	float *values;
+	unsigned int i, n;
+
+	sdi = srtest_new_device(8);
+	sr_dev_inst_channel_add(sdi, 8, SR_CHANNEL_ANALOG, "A0");
+	sr_dev_inst_channel_add(sdi, 9, SR_CHANNEL_ANALOG, "A1");
+	analog_channels = g_slist_nth(sr_dev_inst_channels_get(sdi), 8);
+
+	data = g_malloc(4 * PACKET_SIZE);
+	for (i = 0; i < 4 * PACKET_SIZE; i++)
+		data[i] = (i * 7) ^ (i >> 5);
+	values = g_malloc(4 * PACKET_SIZE * sizeof(float));
+	for (i = 0; i < 4 * PACKET_SIZE; i++)
+		values[i] = (float)((int)(i % 1000) - 500) / 8;
+
+	/* Alternate logic and two channel analog packets of the same length. */
+	n = 0;
+	for (i = 0; i < 4; i++) {
+		logic[i].length = PACKET_SIZE;
+		logic[i].unitsize = 1;
+		logic[i].data = data + i * PACKET_SIZE;
+		logic_packets[i].type = SR_DF_LOGIC;
+		logic_packets[i].payload = &logic[i];
+		packets[n++] = &logic_packets[i];
+		srtest_analog_packet_init(&ap[i], g_slist_copy(analog_channels),
+			values + i * PACKET_SIZE, PACKET_SIZE / 2);
+		packets[n++] = &ap[i].packet;
+	}
+	end.type = SR_DF_END;
+	end.payload = NULL;
+	packets[n++] = &end;
+	packets[n] = NULL;
+
+	fanout_run(sdi, FALSE, packets, expected);
+	fanout_run(sdi, TRUE, packets, texts);
+	for (i = 0; i < FANOUT_SINKS; i++) {
+		fail_unless(expected[i]->len > PACKET_SIZE,
+			"Too little output on sink %u.", i);
+		fail_unless(texts[i]->len == expected[i]->len
+			&& !memcmp(texts[i]->str, expected[i]->str, texts[i]->len),
+			"Fan-out output differs on sink %u.", i);
+		g_string_free(expected[i], TRUE);
+		g_string_free(texts[i], TRUE);
+	}
+
+	for (i = 0; i < 4; i++)
+		g_slist_free(ap[i].meaning.channels);
+	g_free(values);
+	g_free(data);
+}
+END_TEST
+
+Suite *suite_output_text(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("output-text");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_output_text_lines);
+	tcase_add_test(tc, test_output_text_ols);
+	tcase_add_test(tc, test_output_text_csv_mixed);
+	tcase_add_test(tc, test_output_text_analog);
+	tcase_add_test(tc, test_output_text_many_samples);
+	tcase_add_test(tc, test_output_text_fanout);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,441 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/* Offset of the samples, after the RIFF, fmt and data chunk headers. */
+#define DATA_OFFSET	46
+
+#define SAMPLERATE	48000
+
+#define PCM16_MAX	0x7fff
+#define PCM24_MAX	0x7fffff
+
+/* Size of the pieces the file is fed to the wav input in. */
+#define FEED_SIZE	64
+
+struct wav_format {
+	const char *name;
+	unsigned int code;
+	unsigned int bits;
+};
+
+static const struct wav_format formats[] = {
+	{ "float", 3, 32 },
+	{ "pcm16", 1, 16 },
+	{ "pcm24", 1, 24 },
+};
+
+struct wav_result {
+	GArray *values;
+	unsigned int num_channels;
+	gboolean ended;
+};
+
+static uint32_t read_le(const char *p, unsigned int size)
+{
+	uint32_t value;
+	unsigned int i;
+
+	value = 0;
+	for (i = 0; i < size; i++)
+		value |= (uint32_t)(uint8_t)p[i] << (8 * i);
+
+	return value;
+}
+
+/* Read a PCM sample, and sign extend it. */
+static int32_t read_pcm(const char *p, unsigned int size)
+{
+	uint32_t value, sign;
+
+	value = read_le(p, size);
+	sign = 1U << (8 * size - 1);
+
+	return (int32_t)(value ^ sign) - (int32_t)sign;
+}
+
+static float read_float(const char *p)
+{
+	uint32_t value;
+	float f;
+
+	value = read_le(p, 4);
+	memcpy(&f, &value, sizeof(f));
+
+	return f;
+}
+
+/* Create a device with the given number of analog channels. */
+static struct sr_dev_inst *new_analog_device(unsigned int num_channels)
+{
+	struct sr_dev_inst *sdi;
+	unsigned int i;
+	gchar *name;
+
+	sdi = srtest_new_device(0);
+	for (i = 0; i < num_channels; i++) {
+		name = g_strdup_printf("A%u", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_ANALOG, name);
+		g_free(name);
+	}
+
+	return sdi;
+}
+
+static const struct sr_output *new_wav_output(struct sr_dev_inst *sdi,
+	const char *format)
+{
+	const struct sr_output *o;
+	GHashTable *options;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("format"),
+		g_variant_ref_sink(g_variant_new_string(format)));
+	o = sr_output_new(sr_output_find("wav"), options, sdi, NULL);
+	fail_unless(o != NULL, "Failed to create '%s' wav output.", format);
+	g_hash_table_destroy(options);
+
+	return o;
+}
+
+static void send_meta(const struct sr_output *o, struct sr_output_sink *sink)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_config src;
+	int ret;
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_ref_sink(g_variant_new_uint64(SAMPLERATE));
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	ret = sr_output_send_sink(o, &packet, sink);
+	fail_unless(ret == SR_OK, "Failed to send meta packet.");
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+}
+
+static void send_analog(const struct sr_output *o, struct sr_output_sink *sink,
+	GSList *channels, const float *values, unsigned int count)
+{
+	struct srtest_analog_packet ap;
+	int ret;
+
+	srtest_analog_packet_init(&ap, g_slist_copy(channels), values, count);
+	ret = sr_output_send_sink(o, &ap.packet, sink);
+	fail_unless(ret == SR_OK, "Failed to send analog packet.");
+	g_slist_free(ap.meaning.channels);
+}
+
+static void send_end(const struct sr_output *o, struct sr_output_sink *sink)
+{
+	struct sr_datafeed_packet packet;
+	int ret;
+
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	ret = sr_output_send_sink(o, &packet, sink);
+	fail_unless(ret == SR_OK, "Failed to send end packet.");
+}
+
+/*
+ * Write samples of all the device's channels, interleaved in one packet,
+ * and return the file's content.
+ */
+static GString *write_wav(struct sr_dev_inst *sdi, const char *format,
+	const float *values, unsigned int count)
+{
+	const struct sr_output *o;
+	struct sr_output_sink *sink;
+	GString *text;
+	int ret;
+
+	text = g_string_new(NULL);
+	sink = sr_output_sink_new_callback(srtest_append_output, text);
+	o = new_wav_output(sdi, format);
+	send_meta(o, sink);
+	send_analog(o, sink, sr_dev_inst_channels_get(sdi), values, count);
+	send_end(o, sink);
+	sr_output_free(o);
+	ret = sr_output_sink_free(sink);
+	fail_unless(ret == SR_OK, "Failed to flush sink.");
+
+	return text;
+}
+
+/* Check the RIFF and fmt chunk headers of each sample format. */
+START_TEST(test_output_wav_header)
+{
+	static const float values[] = { 0.25, -0.25 };
+	struct sr_dev_inst *sdi;
+	GString *text;
+	unsigned int i, block_align;
+
+	sdi = new_analog_device(2);
+	for (i = 0; i < G_N_ELEMENTS(formats); i++) {
+		text = write_wav(sdi, formats[i].name, values, 1);
+		block_align = 2 * formats[i].bits / 8;
+		fail_unless(text->len == DATA_OFFSET + block_align,
+			"Wrong '%s' file size %zu.", formats[i].name, text->len);
+		fail_unless(!memcmp(text->str, "RIFF", 4)
+			&& !memcmp(text->str + 8, "WAVE", 4)
+			&& !memcmp(text->str + 12, "fmt ", 4)
+			&& !memcmp(text->str + 38, "data", 4),
+			"Wrong '%s' chunk IDs.", formats[i].name);
+		fail_unless(read_le(text->str + 16, 4) == 18,
+			"Wrong '%s' fmt chunk size.", formats[i].name);
+		fail_unless(read_le(text->str + 20, 2) == formats[i].code,
+			"Wrong '%s' format code.", formats[i].name);
+		fail_unless(read_le(text->str + 22, 2) == 2,
+			"Wrong '%s' number of channels.", formats[i].name);
+		fail_unless(read_le(text->str + 24, 4) == SAMPLERATE,
+			"Wrong '%s' samplerate.", formats[i].name);
+		fail_unless(read_le(text->str + 28, 4) == SAMPLERATE * block_align,
+			"Wrong '%s' byte rate.", formats[i].name);
+		fail_unless(read_le(text->str + 32, 2) == block_align,
+			"Wrong '%s' block align.", formats[i].name);
+		fail_unless(read_le(text->str + 34, 2) == formats[i].bits,
+			"Wrong '%s' bits per sample.", formats[i].name);
+		g_string_free(text, TRUE);
+	}
+}
+END_TEST
+
+/* Check that PCM samples get rounded, and clamped to full scale. */
+START_TEST(test_output_wav_pcm)
+{
+	static const float values[] = {
+		0, 1, -1, 0.5, -0.5, 1.5, -2, INFINITY, -INFINITY,
+	};
+	static const int32_t pcm16[] = {
+		0, PCM16_MAX, -PCM16_MAX, 16384, -16384,
+		PCM16_MAX, -PCM16_MAX, PCM16_MAX, -PCM16_MAX,
+	};
+	static const int32_t pcm24[] = {
+		0, PCM24_MAX, -PCM24_MAX, 4194304, -4194304,
+		PCM24_MAX, -PCM24_MAX, PCM24_MAX, -PCM24_MAX,
+	};
+	struct sr_dev_inst *sdi;
+	GString *text;
+	unsigned int i;
+
+	sdi = new_analog_device(1);
+
+	/* 0.5 is half way between two PCM values, it rounds to even. */
+	text = write_wav(sdi, "pcm16", values, G_N_ELEMENTS(values));
+	fail_unless(text->len == DATA_OFFSET + 2 * G_N_ELEMENTS(values),
+		"Wrong 'pcm16' file size %zu.", text->len);
+	for (i = 0; i < G_N_ELEMENTS(values); i++)
+		fail_unless(read_pcm(text->str + DATA_OFFSET + 2 * i, 2)
+			== pcm16[i], "Wrong 'pcm16' sample %u.", i);
+	g_string_free(text, TRUE);
+
+	text = write_wav(sdi, "pcm24", values, G_N_ELEMENTS(values));
+	fail_unless(text->len == DATA_OFFSET + 3 * G_N_ELEMENTS(values),
+		"Wrong 'pcm24' file size %zu.", text->len);
+	for (i = 0; i < G_N_ELEMENTS(values); i++)
+		fail_unless(read_pcm(text->str + DATA_OFFSET + 3 * i, 3)
+			== pcm24[i], "Wrong 'pcm24' sample %u.", i);
+	g_string_free(text, TRUE);
+}
+END_TEST
+
+/* Check that channels which arrive in separate packets get interleaved. */
+START_TEST(test_output_wav_interleave)
+{
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_output_sink *sink;
+	GSList *channels, *a0, *a1;
+	GString *text;
+	float values[2][40];
+	const char *p;
+	unsigned int i;
+	int ret;
+
+	sdi = new_analog_device(2);
+	channels = sr_dev_inst_channels_get(sdi);
+	a0 = g_slist_append(NULL, channels->data);
+	a1 = g_slist_append(NULL, channels->next->data);
+	for (i = 0; i < G_N_ELEMENTS(values[0]); i++) {
+		values[0][i] = i * 0.25;
+		values[1][i] = -(float)i;
+	}
+
+	text = g_string_new(NULL);
+	sink = sr_output_sink_new_callback(srtest_append_output, text);
+	o = new_wav_output(sdi, "float");
+	send_meta(o, sink);
+
+	/* The channels get ahead of each other, by more than a packet. */
+	send_analog(o, sink, a0, values[0], 5);
+	send_analog(o, sink, a0, values[0] + 5, 25);
+	send_analog(o, sink, a1, values[1], 12);
+	send_analog(o, sink, a1, values[1] + 12, 28);
+	send_analog(o, sink, a0, values[0] + 30, 10);
+	send_end(o, sink);
+
+	sr_output_free(o);
+	ret = sr_output_sink_free(sink);
+	fail_unless(ret == SR_OK, "Failed to flush sink.");
+
+	fail_unless(text->len == DATA_OFFSET + 40 * 2 * sizeof(float),
+		"Wrong file size %zu.", text->len);
+	p = text->str + DATA_OFFSET;
+	for (i = 0; i < G_N_ELEMENTS(values[0]); i++) {
+		fail_unless(read_float(p + 8 * i) == values[0][i],
+			"Wrong A0 sample %u.", i);
+		fail_unless(read_float(p + 8 * i + 4) == values[1][i],
+			"Wrong A1 sample %u.", i);
+	}
+
+	g_string_free(text, TRUE);
+	g_slist_free(a0);
+	g_slist_free(a1);
+}
+END_TEST
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct wav_result *res;
+	const struct sr_datafeed_analog *analog;
+	unsigned int count, pos;
+	int ret;
+
+	(void)sdi;
+
+	res = cb_data;
+	switch (packet->type) {
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		res->num_channels = g_slist_length(analog->meaning->channels);
+		count = analog->num_samples * res->num_channels;
+		pos = res->values->len;
+		g_array_set_size(res->values, pos + count);
+		ret = sr_analog_to_float(analog,
+			&g_array_index(res->values, float, pos));
+		fail_unless(ret == SR_OK, "Failed to convert samples.");
+		break;
+	case SR_DF_END:
+		res->ended = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+/* Import a wav file in pieces. */
+static void read_wav(const GString *file, struct wav_result *res)
+{
+	struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GString *chunk;
+	size_t pos, count;
+	int ret;
+
+	in = sr_input_new(sr_input_find("wav"), NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	res->values = g_array_new(FALSE, FALSE, sizeof(float));
+	res->num_channels = 0;
+	res->ended = FALSE;
+	session = NULL;
+	for (pos = 0; pos < file->len; pos += count) {
+		count = MIN(file->len - pos, FEED_SIZE);
+		if (!session && (sdi = sr_input_dev_inst_get(in))) {
+			sr_session_new(srtest_ctx, &session);
+			sr_session_datafeed_callback_add(session, datafeed_in, res);
+			sr_session_dev_add(session, sdi);
+		}
+		chunk = g_string_new_len(file->str + pos, count);
+		ret = sr_input_send(in, chunk);
+		fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+		g_string_free(chunk, TRUE);
+	}
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+	fail_unless(res->ended, "No end packet received.");
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+}
+
+/* Check that the wav input reads back what the PCM formats write. */
+START_TEST(test_output_wav_roundtrip)
+{
+	static const char *pcm_formats[] = { "pcm16", "pcm24", NULL };
+	static const float full_scale[] = { PCM16_MAX, PCM24_MAX };
+	struct sr_dev_inst *sdi;
+	struct wav_result res;
+	GString *text;
+	float values[2 * 100], expected;
+	unsigned int i, f;
+
+	sdi = new_analog_device(2);
+	for (i = 0; i < G_N_ELEMENTS(values); i++)
+		values[i] = sinf(i * 0.1) * (i % 2 ? 1.25 : 0.75);
+
+	for (f = 0; pcm_formats[f]; f++) {
+		text = write_wav(sdi, pcm_formats[f], values,
+			G_N_ELEMENTS(values) / 2);
+		read_wav(text, &res);
+		fail_unless(res.num_channels == 2,
+			"Wrong number of '%s' channels.", pcm_formats[f]);
+		fail_unless(res.values->len == G_N_ELEMENTS(values),
+			"Expected %zu '%s' values, got %u.",
+			G_N_ELEMENTS(values), pcm_formats[f], res.values->len);
+		for (i = 0; i < res.values->len; i++) {
+			expected = CLAMP(lrintf(values[i] * full_scale[f]),
+				-full_scale[f], full_scale[f]) / full_scale[f];
+			fail_unless(g_array_index(res.values, float, i) == expected,
+				"Wrong '%s' value %u.", pcm_formats[f], i);
+		}
+		g_array_free(res.values, TRUE);
+		g_string_free(text, TRUE);
+	}
+}
+END_TEST
+
+Suite *suite_output_wav(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("output-wav");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_output_wav_header);
+	tcase_add_test(tc, test_output_wav_pcm);
+	tcase_add_test(tc, test_output_wav_interleave);
+	tcase_add_test(tc, test_output_wav_roundtrip);
+	suite_add_tcase(s, tc);
+
+	return s;
+}